@@ -79,6 +79,49 @@ static void handle_udp_data_packet(
 #define OTW_GPIO_BANK_TO_NUM(bank) \
     (((bank) == USRP2_DIR_RX)? (GPIO_RX_BANK) : (GPIO_TX_BANK))
 
+//response buffer for batch control packets (too big for the stack)
+static uint8_t batch_buff[sizeof(usrp2_ctrl_data_t) + USRP2_CTRL_BATCH_MAX_OPS*sizeof(usrp2_ctrl_batch_op_t)];
+
+static uint32_t do_spi_transact(
+    uint8_t readback, uint32_t dev, uint32_t data,
+    uint8_t num_bits, uint8_t mosi_edge, uint8_t miso_edge
+){
+    return spi_transact(
+        (readback == 0)? SPI_TXONLY : SPI_TXRX,
+        dev,      //which device
+        data,     //32 bit data
+        num_bits, //length in bits
+        (mosi_edge == USRP2_CLK_EDGE_RISE)? SPIF_PUSH_FALL : SPIF_PUSH_RISE |
+        (miso_edge == USRP2_CLK_EDGE_RISE)? SPIF_LATCH_RISE : SPIF_LATCH_FALL
+    );
+}
+
+static uint32_t do_reg_action(uint8_t action, uint32_t addr, uint32_t data){
+    switch(action){
+    case USRP2_REG_ACTION_FPGA_PEEK32:
+        return *((uint32_t *) addr);
+
+    case USRP2_REG_ACTION_FPGA_PEEK16:
+        return *((uint16_t *) addr);
+
+    case USRP2_REG_ACTION_FPGA_POKE32:
+        *((uint32_t *) addr) = (uint32_t)data;
+        break;
+
+    case USRP2_REG_ACTION_FPGA_POKE16:
+        *((uint16_t *) addr) = (uint16_t)data;
+        break;
+
+    case USRP2_REG_ACTION_FW_PEEK32:
+        return fw_regs[addr];
+
+    case USRP2_REG_ACTION_FW_POKE32:
+        fw_regs[addr] = data;
+        break;
+    }
+    return data;
+}
+
 static void handle_udp_ctrl_packet(
     struct socket_address src, struct socket_address dst,
     unsigned char *payload, int payload_len
@@ -125,13 +168,13 @@ static void handle_udp_ctrl_packet(
      ******************************************************************/
     case USRP2_CTRL_ID_TRANSACT_ME_SOME_SPI_BRO:{
             //transact
-            uint32_t result = spi_transact(
-                (ctrl_data_in->data.spi_args.readback == 0)? SPI_TXONLY : SPI_TXRX,
+            uint32_t result = do_spi_transact(
+                ctrl_data_in->data.spi_args.readback,
                 ctrl_data_in->data.spi_args.dev,      //which device
                 ctrl_data_in->data.spi_args.data,     //32 bit data
                 ctrl_data_in->data.spi_args.num_bits, //length in bits
-                (ctrl_data_in->data.spi_args.mosi_edge == USRP2_CLK_EDGE_RISE)? SPIF_PUSH_FALL : SPIF_PUSH_RISE |
-                (ctrl_data_in->data.spi_args.miso_edge == USRP2_CLK_EDGE_RISE)? SPIF_LATCH_RISE : SPIF_LATCH_FALL
+                ctrl_data_in->data.spi_args.mosi_edge,
+                ctrl_data_in->data.spi_args.miso_edge
             );
 
             //load output
@@ -171,35 +214,48 @@ static void handle_udp_ctrl_packet(
      * Peek and Poke Register
      ******************************************************************/
     case USRP2_CTRL_ID_GET_THIS_REGISTER_FOR_ME_BRO:
-        switch(ctrl_data_in->data.reg_args.action){
-            case USRP2_REG_ACTION_FPGA_PEEK32:
-                ctrl_data_out.data.reg_args.data = *((uint32_t *) ctrl_data_in->data.reg_args.addr);
-                break;
-
-            case USRP2_REG_ACTION_FPGA_PEEK16:
-                ctrl_data_out.data.reg_args.data = *((uint16_t *) ctrl_data_in->data.reg_args.addr);
-                break;
-
-            case USRP2_REG_ACTION_FPGA_POKE32:
-                *((uint32_t *) ctrl_data_in->data.reg_args.addr) = (uint32_t)ctrl_data_in->data.reg_args.data;
-                break;
-
-            case USRP2_REG_ACTION_FPGA_POKE16:
-                *((uint16_t *) ctrl_data_in->data.reg_args.addr) = (uint16_t)ctrl_data_in->data.reg_args.data;
-                break;
-
-            case USRP2_REG_ACTION_FW_PEEK32:
-                ctrl_data_out.data.reg_args.data = fw_regs[(ctrl_data_in->data.reg_args.addr)];
-                break;
-
-            case USRP2_REG_ACTION_FW_POKE32:
-                fw_regs[(ctrl_data_in->data.reg_args.addr)] = ctrl_data_in->data.reg_args.data;
-                break;
-
-        }
+        ctrl_data_out.data.reg_args.data = do_reg_action(
+            ctrl_data_in->data.reg_args.action,
+            ctrl_data_in->data.reg_args.addr,
+            ctrl_data_in->data.reg_args.data
+        );
         ctrl_data_out.id = USRP2_CTRL_ID_OMG_GOT_REGISTER_SO_BAD_DUDE;
         break;
 
+    /*******************************************************************
+     * Batch of register and SPI operations
+     ******************************************************************/
+    case USRP2_CTRL_ID_DO_ALL_THESE_THINGS_BRO:{
+            uint32_t num_ops = ctrl_data_in->data.batch_args.num_ops;
+            if (num_ops > USRP2_CTRL_BATCH_MAX_OPS ||
+                payload_len < sizeof(usrp2_ctrl_data_t) + num_ops*sizeof(usrp2_ctrl_batch_op_t)
+            ){
+                printf("!Error in control packet handler: Bad batch of %d ops\n", (int)num_ops);
+                break; //reply with huh what
+            }
+
+            const usrp2_ctrl_batch_op_t *ops_in = (const usrp2_ctrl_batch_op_t *)(payload + sizeof(usrp2_ctrl_data_t));
+            usrp2_ctrl_batch_op_t *ops_out = (usrp2_ctrl_batch_op_t *)(batch_buff + sizeof(usrp2_ctrl_data_t));
+            for (uint32_t i = 0; i < num_ops; i++){
+                ops_out[i] = ops_in[i];
+                if (ops_in[i].action == USRP2_REG_ACTION_SPI_WRITE) do_spi_transact(
+                    0, ops_in[i].addr, ops_in[i].data, ops_in[i].num_bits,
+                    ops_in[i].mosi_edge, ops_in[i].miso_edge
+                );
+                else ops_out[i].data = do_reg_action(
+                    ops_in[i].action, ops_in[i].addr, ops_in[i].data
+                );
+            }
+
+            ctrl_data_out.id = USRP2_CTRL_ID_DID_ALL_THOSE_THINGS_DUDE;
+            ctrl_data_out.data.batch_args.num_ops = num_ops;
+            memcpy(batch_buff, &ctrl_data_out, sizeof(usrp2_ctrl_data_t));
+            send_udp_pkt(USRP2_UDP_CTRL_PORT, src, batch_buff,
+                sizeof(usrp2_ctrl_data_t) + num_ops*sizeof(usrp2_ctrl_batch_op_t)
+            );
+        }
+        return;
+
     /*******************************************************************
      * UART Control
      ******************************************************************/
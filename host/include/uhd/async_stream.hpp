@@ -0,0 +1,177 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_UHD_ASYNC_STREAM_HPP
+#define INCLUDED_UHD_ASYNC_STREAM_HPP
+
+#include <uhd/config.hpp>
+#include <uhd/device.hpp>
+#include <uhd/stream.hpp>
+#include <uhd/types/metadata.hpp>
+#include <uhd/types/io_type.hpp>
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <vector>
+
+namespace uhd{
+
+//! How an asynchronous request completed
+enum async_status_t{
+    //! The request was carried out (see the sample count and metadata)
+    ASYNC_STATUS_DONE = 'd',
+    //! The request was cancelled before it was carried out
+    ASYNC_STATUS_CANCELLED = 'c'
+};
+
+/*!
+ * An asynchronous receive stream:
+ * The application submits buffers, and an I/O thread of the stream
+ * receives into the buffers in the order of submission.
+ * The handler of each request is called on the I/O thread when the
+ * request completes, the buffers belong to the application again.
+ *
+ * The samples are converted from the transport frames straight into
+ * the submitted buffers, like the blocking recv (no extra copy).
+ * At most max_in_flight requests are submitted and not yet completed:
+ * submit blocks (up to its timeout) when the bound is reached.
+ * When no buffers are submitted, the stream is not read,
+ * and the device reports an overflow like a blocking recv that is not called.
+ */
+class UHD_API async_rx_stream : boost::noncopyable{
+public:
+    typedef boost::shared_ptr<async_rx_stream> sptr;
+
+    /*!
+     * The completion handler of a receive request:
+     * Called with the status, the number of samples received,
+     * and the metadata of the recv (see uhd::device::recv).
+     */
+    typedef boost::function<void(async_status_t, size_t, const rx_metadata_t &)> handler_type;
+
+    /*!
+     * Make an asynchronous receive stream and start its I/O thread.
+     * The stream must not be received from by the application at once.
+     * \param stream the receive stream to read
+     * \param io_type the type of data to fill into the buffers
+     * \param max_in_flight the most requests not yet completed
+     * \return a new asynchronous receive stream
+     */
+    static sptr make(rx_stream::sptr stream, const io_type_t &io_type, size_t max_in_flight);
+
+    /*!
+     * Cancel the pending requests and stop the I/O thread.
+     * The handlers of the pending requests are called with cancelled.
+     */
+    virtual ~async_rx_stream(void){}
+
+    /*!
+     * Submit buffers to fill with IF data (in the full buffer recv mode).
+     * \param buffs a vector of writable memory, one per channel of the stream
+     * \param nsamps_per_buff the size of each buffer in number of samples
+     * \param handler the completion handler (called on the I/O thread)
+     * \param timeout the timeout in seconds to wait for room in flight
+     * \return true when submitted, false when the bound is still reached on timeout
+     */
+    virtual bool submit(
+        const std::vector<void *> &buffs,
+        size_t nsamps_per_buff,
+        const handler_type &handler,
+        double timeout = 0.1
+    ) = 0;
+
+    /*!
+     * Cancel the requests submitted so far, does not block on the handlers.
+     * The requests that did not receive any samples complete with cancelled,
+     * a recv in progress completes as usual (it is at most a short timeout).
+     */
+    virtual void cancel(void) = 0;
+
+    //! Get the number of requests submitted and not yet completed
+    virtual size_t get_num_in_flight(void) = 0;
+};
+
+/*!
+ * An asynchronous send stream:
+ * The application submits buffers, and an I/O thread of the stream
+ * sends the buffers in the order of submission with the device send.
+ * The handler of each request is called on the I/O thread when the
+ * request completes, the buffers belong to the application again.
+ *
+ * The samples are converted from the submitted buffers straight into
+ * the transport frames, like the blocking send (no extra copy).
+ * At most max_in_flight requests are submitted and not yet completed:
+ * submit blocks (up to its timeout) when the bound is reached,
+ * which happens when the device does not take the samples as fast as submitted.
+ */
+class UHD_API async_tx_stream : boost::noncopyable{
+public:
+    typedef boost::shared_ptr<async_tx_stream> sptr;
+
+    /*!
+     * The completion handler of a send request:
+     * Called with the status and the number of samples sent.
+     */
+    typedef boost::function<void(async_status_t, size_t)> handler_type;
+
+    /*!
+     * Make an asynchronous send stream and start its I/O thread.
+     * The device must not be sent to by the application at once.
+     * \param dev the device to send to
+     * \param io_type the type of data loaded in the buffers
+     * \param max_in_flight the most requests not yet completed
+     * \return a new asynchronous send stream
+     */
+    static sptr make(device::sptr dev, const io_type_t &io_type, size_t max_in_flight);
+
+    /*!
+     * Cancel the pending requests and stop the I/O thread.
+     * The handlers of the pending requests are called with cancelled.
+     */
+    virtual ~async_tx_stream(void){}
+
+    /*!
+     * Submit buffers of IF data to send (in the full buffer send mode).
+     * \param buffs a vector of read-only memory, one per channel
+     * \param nsamps_per_buff the number of samples to send, per buffer
+     * \param metadata data describing the buffers' contents
+     * \param handler the completion handler (called on the I/O thread)
+     * \param timeout the timeout in seconds to wait for room in flight
+     * \return true when submitted, false when the bound is still reached on timeout
+     */
+    virtual bool submit(
+        const std::vector<const void *> &buffs,
+        size_t nsamps_per_buff,
+        const tx_metadata_t &metadata,
+        const handler_type &handler,
+        double timeout = 0.1
+    ) = 0;
+
+    /*!
+     * Cancel the requests submitted so far, does not block on the handlers.
+     * The requests complete with cancelled and the number of samples sent so far.
+     * A burst cut short by the cancel is not ended (send an end of burst).
+     */
+    virtual void cancel(void) = 0;
+
+    //! Get the number of requests submitted and not yet completed
+    virtual size_t get_num_in_flight(void) = 0;
+};
+
+} //namespace uhd
+
+#endif /* INCLUDED_UHD_ASYNC_STREAM_HPP */
@@ -22,14 +22,18 @@
 #include <uhd/types/device_addr.hpp>
 #include <uhd/types/metadata.hpp>
 #include <uhd/types/io_type.hpp>
+#include <uhd/types/stream_cmd.hpp>
 #include <uhd/types/ref_vector.hpp>
 #include <uhd/wax.hpp>
 #include <boost/utility.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
+#include <vector>
 
 namespace uhd{
 
+class rx_stream; //forward declaration
+
 /*!
  * The usrp device interface represents the usrp hardware.
  * The api allows for discovery, configuration, and streaming.
@@ -96,6 +100,17 @@ public:
         RECV_MODE_ONE_PACKET = 1
     };
 
+    /*!
+     * Overflow policies for the subscriber of a shared receive stream:
+     * what a subscriber that falls behind the stream drops.
+     */
+    enum subscriber_policy_t{
+        //! Drop the newest packets until the subscriber catches up
+        SUBSCRIBER_DROP_NEWEST = 0,
+        //! Drop the oldest packets that the subscriber has not read yet
+        SUBSCRIBER_DROP_OLDEST = 1
+    };
+
     //! Typedef for a pointer to a single, or a collection of send buffers
     typedef ref_vector<const void *> send_buffs_type;
 
@@ -197,6 +212,57 @@ public:
         async_metadata_t &async_metadata, double timeout = 0.1
     ) = 0;
 
+    /*!
+     * Make a receive stream over a subset of the rx channels.
+     * The stream is independent of the device recv and of other streams,
+     * see uhd::rx_stream (include <uhd/stream.hpp>) for details.
+     * \param chans the channel indexes (the buffer indexes of the device recv)
+     * \return a new receive stream
+     * \throw uhd::not_implemented_error when the device has no streams
+     */
+    virtual boost::shared_ptr<rx_stream> get_rx_stream(const std::vector<size_t> &chans);
+
+    /*!
+     * Make a receive stream that shares its channels with other subscribers.
+     * Every subscriber of a channel gets every packet of the channel,
+     * without copies, and converts the samples to its own io type.
+     * A subscriber that falls behind drops packets by its own policy
+     * (reported as sequence errors), and never stalls the other subscribers.
+     * \param chans the channel indexes (the buffer indexes of the device recv)
+     * \param depth the most packets per channel that the subscriber holds
+     * \param policy what the subscriber drops when it holds depth packets
+     * \return a new receive stream
+     * \throw uhd::value_error when the transports have too few frames for the depth
+     * \throw uhd::not_implemented_error when the device has no streams
+     */
+    virtual boost::shared_ptr<rx_stream> subscribe_rx_stream(
+        const std::vector<size_t> &chans, size_t depth,
+        subscriber_policy_t policy = SUBSCRIBER_DROP_NEWEST
+    );
+
+    /*!
+     * Issue a stream command to a set of rx channels at once.
+     * The commands go out concurrently, one control transaction per mboard,
+     * rather than one channel after the other.
+     * A timed command should be issued well ahead of its time spec:
+     * the skew tells how far the channels were apart on the control path.
+     * \param stream_cmd the stream command to issue
+     * \param chans the channel indexes (the buffer indexes of the device recv)
+     * \return the worst case issue skew across the channels in seconds
+     * \throw uhd::not_implemented_error when the device issues by channel only
+     */
+    virtual double issue_stream_cmd(const stream_cmd_t &stream_cmd, const std::vector<size_t> &chans);
+
+    /*!
+     * Set the time of all mboards at a pps edge, when the edge time is unknown.
+     * The device waits for a pps edge, then sets the time at the next one
+     * on all mboards at once, and checks that their times agree.
+     * \param time_spec the time at the next pps
+     * \throw uhd::runtime_error when there is no pps
+     * \throw uhd::not_implemented_error when the device sets its time by mboard only
+     */
+    virtual void set_time_unknown_pps(const time_spec_t &time_spec);
+
 };
 
 } //namespace uhd
@@ -0,0 +1,124 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_UHD_STREAM_HPP
+#define INCLUDED_UHD_STREAM_HPP
+
+#include <uhd/config.hpp>
+#include <uhd/device.hpp>
+#include <uhd/types/metadata.hpp>
+#include <uhd/types/io_type.hpp>
+#include <uhd/transport/zero_copy.hpp>
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+namespace uhd{
+
+/*!
+ * A received packet of one channel, seen in its transport frame.
+ * The samples are in the wire format (see io_type_t::COMPLEX_INT16_ITEM32_BE).
+ * The frame is held until the buffer is reset or destroyed,
+ * and may be held past the lifetime of the stream.
+ */
+struct UHD_API rx_frame{
+    //! The transport frame that holds the samples
+    transport::managed_recv_buffer::sptr buff;
+
+    //! A pointer to the samples in the frame
+    const void *samps;
+
+    //! The number of samples in the frame
+    size_t nsamps;
+
+    rx_frame(void): samps(NULL), nsamps(0){}
+};
+
+/*!
+ * A receive stream over a subset of the channels of a device.
+ *
+ * A stream has its own transports and packet handler state,
+ * so that separate streams can be read concurrently by separate threads.
+ * The channels of a stream are aligned on their timestamps,
+ * channels in separate streams are independent.
+ * Set the rate and issue the stream commands on the stream's channels
+ * through the device properties (ex: multi_usrp with the channel index).
+ *
+ * A channel must not be received through a stream and the device recv at once.
+ * The stream must not outlive its device.
+ */
+class UHD_API rx_stream : boost::noncopyable{
+public:
+    typedef boost::shared_ptr<rx_stream> sptr;
+
+    virtual ~rx_stream(void){}
+
+    //! Get the number of channels in this stream
+    virtual size_t get_num_channels(void) const = 0;
+
+    /*!
+     * Get the maximum number of samples per packet on recv.
+     * \return the number of samples
+     */
+    virtual size_t get_max_num_samps(void) const = 0;
+
+    /*!
+     * Receive buffers containing IF data described by the metadata.
+     * The semantics are those of the device recv:
+     * see uhd::device::recv for fragments and recv modes.
+     *
+     * \param buffs a vector of writable memory, one per channel of the stream
+     * \param nsamps_per_buff the size of each buffer in number of samples
+     * \param metadata data to fill describing the buffer
+     * \param io_type the type of data to fill into the buffer
+     * \param recv_mode tells recv how to load the buffer
+     * \param timeout the timeout in seconds to wait for a packet
+     * \return the number of samples received or 0 on error
+     */
+    virtual size_t recv(
+        const device::recv_buffs_type &buffs,
+        size_t nsamps_per_buff,
+        rx_metadata_t &metadata,
+        const io_type_t &io_type,
+        device::recv_mode_t recv_mode,
+        double timeout = 0.1
+    ) = 0;
+
+    /*!
+     * Receive one packet per channel without copying the samples.
+     * The frames are handed to the caller instead of being copied out,
+     * and go back to the transport when the caller releases them.
+     * The frames held by the caller are bounded (a fraction of the transport frames),
+     * this call waits for the caller to release frames when the bound is reached.
+     * The metadata is that of a one packet recv, without zero fill of sequence gaps.
+     *
+     * \param frames filled with one frame per channel of the stream
+     * \param metadata data to fill describing the frames
+     * \param timeout the timeout in seconds to wait for a packet
+     * \return the number of samples per frame or 0 on error
+     * \throw uhd::not_implemented_error when the stream cannot hand over frames
+     */
+    virtual size_t recv_frames(
+        std::vector<rx_frame> &frames,
+        rx_metadata_t &metadata,
+        double timeout = 0.1
+    );
+};
+
+} //namespace uhd
+
+#endif /* INCLUDED_UHD_STREAM_HPP */
@@ -25,7 +25,7 @@
 #include <boost/thread/condition.hpp>
 #include <boost/thread/locks.hpp>
 
-namespace uhd{ namespace transport{ namespace{ /*anon*/
+namespace uhd{ namespace transport{
 
     template <typename elem_type> class bounded_buffer_detail{
     public:
@@ -142,6 +142,6 @@ namespace uhd{ namespace transport{ namespace{ /*anon*/
         }
 
     };
-}}} //namespace
+}} //namespace
 
 #endif /* INCLUDED_UHD_TRANSPORT_BOUNDED_BUFFER_IPP */
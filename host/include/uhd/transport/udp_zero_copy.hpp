@@ -58,6 +58,22 @@ public:
         const std::string &port,
         const device_addr_t &hints = device_addr_t()
     );
+
+    //! The most pieces of memory in a gathered send
+    static const size_t max_gather_pieces = 4;
+
+    /*!
+     * Send one datagram gathered from pieces of memory (scatter-gather).
+     * The pieces are not copied into a send frame: the caller keeps the memory,
+     * and may reuse it when the call returns (the send is blocking like a commit).
+     * A gathered send and the commits of send buffers go out in the order called.
+     * \param mems the pointers to the pieces
+     * \param lens the lengths of the pieces in bytes
+     * \param num_pieces the number of pieces (at most max gather pieces)
+     * \return the number of bytes sent
+     * \throw uhd::io_error when the socket fails to send
+     */
+    virtual size_t send_gather(const void * const *mems, const size_t *lens, size_t num_pieces) = 0;
 };
 
 }} //namespace
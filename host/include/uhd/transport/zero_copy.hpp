@@ -19,6 +19,7 @@
 #define INCLUDED_UHD_TRANSPORT_ZERO_COPY_HPP
 
 #include <uhd/config.hpp>
+#include <uhd/utils/atomic.hpp>
 #include <boost/utility.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/intrusive_ptr.hpp>
@@ -27,7 +28,7 @@ namespace uhd{ namespace transport{
 
     //! Create smart pointer to a reusable managed buffer
     template <typename T> UHD_INLINE boost::intrusive_ptr<T> make_managed_buffer(T *p){
-        p->_ref_count = 1; //reset the count to 1 reference
+        p->_ref_count.write(1); //reset the count to 1 reference
         return boost::intrusive_ptr<T>(p, false);
     }
 
@@ -67,15 +68,15 @@ namespace uhd{ namespace transport{
         virtual const void *get_buff(void) const = 0;
         virtual size_t get_size(void) const = 0;
 
-    public: int _ref_count;
+    public: uhd::atomic_uint32_t _ref_count;
     };
 
     UHD_INLINE void intrusive_ptr_add_ref(managed_recv_buffer *p){
-        ++(p->_ref_count);
+        p->_ref_count.inc();
     }
 
     UHD_INLINE void intrusive_ptr_release(managed_recv_buffer *p){
-        if (--(p->_ref_count) == 0) p->release();
+        if (p->_ref_count.dec() == 1) p->release();
     }
 
     /*!
@@ -115,15 +116,15 @@ namespace uhd{ namespace transport{
         virtual void *get_buff(void) const = 0;
         virtual size_t get_size(void) const = 0;
 
-    public: int _ref_count;
+    public: uhd::atomic_uint32_t _ref_count;
     };
 
     UHD_INLINE void intrusive_ptr_add_ref(managed_send_buffer *p){
-        ++(p->_ref_count);
+        p->_ref_count.inc();
     }
 
     UHD_INLINE void intrusive_ptr_release(managed_send_buffer *p){
-        if (--(p->_ref_count) == 0) p->commit(0);
+        if (p->_ref_count.dec() == 1) p->commit(0);
     }
 
     /*!
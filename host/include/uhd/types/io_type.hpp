@@ -42,7 +42,9 @@ namespace uhd{
             //! Complex signed integer (16-bit integers) range [-32768, +32767]
             COMPLEX_INT16 =   int('s'),
             //! Complex signed integer (8-bit integers) range [-128, 127]
-            COMPLEX_INT8 =    int('b')
+            COMPLEX_INT8 =    int('b'),
+            //! Complex signed integer (16-bit integers) in big endian 32-bit words, real in the high half
+            COMPLEX_INT16_ITEM32_BE = int('w')
         };
 
         /*!
@@ -69,6 +69,7 @@ namespace uhd{
          * - late command
          * - broken chain
          * - overflow
+         * - sequence error
          */
         enum error_code_t {
             //! No error associated with this metadata.
@@ -84,8 +85,24 @@ namespace uhd{
             //! Multi-channel alignment failed.
             ERROR_CODE_ALIGNMENT    = 0xc,
             //! The packet could not be parsed.
-            ERROR_CODE_BAD_PACKET   = 0xf
+            ERROR_CODE_BAD_PACKET   = 0xf,
+            //! Packets were lost (see the lost packet and sample counts).
+            ERROR_CODE_SEQUENCE_ERROR = 0x10
         } error_code;
+
+        /*!
+         * Lost packet accounting for a sequence error:
+         * The number of packets and samples (per channel) lost in the gap.
+         * The time spec is the time of the first lost sample when known.
+         * The sample count comes from the timestamps when possible,
+         * otherwise it is estimated from the size of the previous packet.
+         *
+         * When zero fill is enabled, the samples returned with a sequence error
+         * are zeros standing in for the lost samples (the sample timeline stays contiguous).
+         * Otherwise no samples are returned with a sequence error.
+         */
+        size_t num_lost_packets;
+        size_t num_lost_samps;
     };
 
     /*!
@@ -49,6 +49,7 @@ namespace uhd{ namespace usrp{
         MBOARD_PROP_TIME_PPS,                //wo, time_spec_t
         MBOARD_PROP_EEPROM_MAP,              //wr, mboard_eeprom_t
         MBOARD_PROP_IFACE,                   //ro, mboard_iface::sptr
+        MBOARD_PROP_TIME_NOW_EXACT,          //ro, time_spec_t
     };
 
 }} //namespace
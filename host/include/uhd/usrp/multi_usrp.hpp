@@ -146,11 +146,20 @@ public:
 
     /*!
      * Get the current time in the usrp time registers.
+     * The device may estimate the time from its last reads and timestamps,
+     * without a read of the registers (see the time_now_error sensor).
      * \param mboard which motherboard to query
      * \return a timespec representing current usrp time
      */
     virtual time_spec_t get_time_now(size_t mboard = 0) = 0;
 
+    /*!
+     * Get the current time with a read of the usrp time registers.
+     * \param mboard which motherboard to query
+     * \return a timespec representing current usrp time
+     */
+    virtual time_spec_t get_time_now_exact(size_t mboard = 0) = 0;
+
     /*!
      * Get the time when the last pps pulse occured.
      * \param mboard which motherboard to query
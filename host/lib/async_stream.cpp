@@ -0,0 +1,293 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <uhd/async_stream.hpp>
+#include <uhd/exception.hpp>
+#include <uhd/utils/msg.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/bind.hpp>
+#include <deque>
+
+using namespace uhd;
+
+//the I/O thread checks for a cancel between device calls with this timeout
+static const double io_timeout = 0.1;
+
+/***********************************************************************
+ * Request queue:
+ * The requests in flight, in the order of submission, and the bound.
+ * A cancel marks every request submitted before it by its number.
+ **********************************************************************/
+template <typename request_type> class async_request_queue{
+public:
+    async_request_queue(size_t max_in_flight):
+        _max_in_flight(max_in_flight), _num_in_flight(0),
+        _num_submitted(0), _num_cancelled(0), _running(true)
+    {
+        if (max_in_flight == 0) throw uhd::value_error("cannot stream with no requests in flight");
+    }
+
+    //! Push a request, block up to the timeout on the bound, false when stopped
+    bool push(request_type &request, double timeout){
+        boost::mutex::scoped_lock lock(_mutex);
+        if (not _room_cond.timed_wait(
+            lock, boost::posix_time::microseconds(long(timeout*1e6)),
+            boost::bind(&async_request_queue::has_room, this)
+        ) or not _running) return false;
+        request.number = _num_submitted++;
+        _requests.push_back(request);
+        _num_in_flight++;
+        lock.unlock();
+        _request_cond.notify_one();
+        return true;
+    }
+
+    //! Pop the next request, false when stopped and empty (on the I/O thread)
+    bool pop(request_type &request){
+        boost::mutex::scoped_lock lock(_mutex);
+        while (_running and _requests.empty()) _request_cond.wait(lock);
+        if (_requests.empty()) return false;
+        request = _requests.front();
+        _requests.pop_front();
+        return true;
+    }
+
+    //! Take a request out of flight before its handler is called
+    void complete(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        _num_in_flight--;
+        lock.unlock();
+        _room_cond.notify_all();
+    }
+
+    bool is_cancelled(const request_type &request){
+        boost::mutex::scoped_lock lock(_mutex);
+        return request.number < _num_cancelled;
+    }
+
+    void cancel(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        _num_cancelled = _num_submitted;
+    }
+
+    //! Cancel the requests and let pop return false once they are done
+    void stop(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        _num_cancelled = _num_submitted;
+        _running = false;
+        lock.unlock();
+        _request_cond.notify_one();
+        _room_cond.notify_all(); //wake the blocked producers
+    }
+
+    size_t get_num_in_flight(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _num_in_flight;
+    }
+
+private:
+    bool has_room(void) const{return not _running or _num_in_flight < _max_in_flight;} //or stopped
+
+    const size_t _max_in_flight;
+    boost::mutex _mutex;
+    boost::condition _request_cond, _room_cond;
+    std::deque<request_type> _requests;
+    size_t _num_in_flight, _num_submitted, _num_cancelled;
+    bool _running;
+};
+
+/***********************************************************************
+ * Asynchronous receive stream
+ **********************************************************************/
+class async_rx_stream_impl : public async_rx_stream{
+public:
+    async_rx_stream_impl(rx_stream::sptr stream, const io_type_t &io_type, size_t max_in_flight):
+        _stream(stream), _io_type(io_type), _requests(max_in_flight)
+    {
+        _thread_group.create_thread(boost::bind(&async_rx_stream_impl::io_loop, this));
+    }
+
+    ~async_rx_stream_impl(void){
+        _requests.stop();
+        _thread_group.join_all();
+    }
+
+    bool submit(const std::vector<void *> &buffs, size_t nsamps_per_buff, const handler_type &handler, double timeout){
+        UHD_ASSERT_THROW(buffs.size() == _stream->get_num_channels());
+        request_t request;
+        request.buffs = buffs;
+        request.nsamps_per_buff = nsamps_per_buff;
+        request.handler = handler;
+        return _requests.push(request, timeout);
+    }
+
+    void cancel(void){
+        _requests.cancel();
+    }
+
+    size_t get_num_in_flight(void){
+        return _requests.get_num_in_flight();
+    }
+
+private:
+    struct request_t{
+        std::vector<void *> buffs;
+        size_t nsamps_per_buff;
+        handler_type handler;
+        size_t number;
+    };
+
+    void io_loop(void){
+        request_t request;
+        while (_requests.pop(request)){
+            async_status_t status = ASYNC_STATUS_DONE;
+            rx_metadata_t metadata;
+            size_t num_samps = 0;
+            try{
+                //wait out the timeouts until there are samples or a cancel
+                while (true){
+                    if (_requests.is_cancelled(request)){
+                        status = ASYNC_STATUS_CANCELLED;
+                        break;
+                    }
+                    num_samps = _stream->recv(
+                        request.buffs, request.nsamps_per_buff, metadata,
+                        _io_type, device::RECV_MODE_FULL_BUFF, io_timeout
+                    );
+                    if (num_samps != 0 or metadata.error_code != rx_metadata_t::ERROR_CODE_TIMEOUT) break;
+                }
+            }catch(const std::exception &e){
+                UHD_MSG(error) << "Error (async recv): " << e.what() << std::endl;
+                status = ASYNC_STATUS_CANCELLED;
+            }
+            _requests.complete();
+            try{
+                request.handler(status, num_samps, metadata);
+            }catch(const std::exception &e){
+                UHD_MSG(error) << "Error (async stream handler): " << e.what() << std::endl;
+            }
+        }
+    }
+
+    rx_stream::sptr _stream;
+    const io_type_t _io_type;
+    async_request_queue<request_t> _requests;
+    boost::thread_group _thread_group;
+};
+
+async_rx_stream::sptr async_rx_stream::make(rx_stream::sptr stream, const io_type_t &io_type, size_t max_in_flight){
+    return sptr(new async_rx_stream_impl(stream, io_type, max_in_flight));
+}
+
+/***********************************************************************
+ * Asynchronous send stream
+ **********************************************************************/
+class async_tx_stream_impl : public async_tx_stream{
+public:
+    async_tx_stream_impl(device::sptr dev, const io_type_t &io_type, size_t max_in_flight):
+        _dev(dev), _io_type(io_type), _requests(max_in_flight)
+    {
+        _thread_group.create_thread(boost::bind(&async_tx_stream_impl::io_loop, this));
+    }
+
+    ~async_tx_stream_impl(void){
+        _requests.stop();
+        _thread_group.join_all();
+    }
+
+    bool submit(
+        const std::vector<const void *> &buffs, size_t nsamps_per_buff,
+        const tx_metadata_t &metadata, const handler_type &handler, double timeout
+    ){
+        UHD_ASSERT_THROW(not buffs.empty());
+        request_t request;
+        request.buffs = buffs;
+        request.nsamps_per_buff = nsamps_per_buff;
+        request.metadata = metadata;
+        request.handler = handler;
+        return _requests.push(request, timeout);
+    }
+
+    void cancel(void){
+        _requests.cancel();
+    }
+
+    size_t get_num_in_flight(void){
+        return _requests.get_num_in_flight();
+    }
+
+private:
+    struct request_t{
+        std::vector<const void *> buffs;
+        size_t nsamps_per_buff;
+        tx_metadata_t metadata;
+        handler_type handler;
+        size_t number;
+    };
+
+    void io_loop(void){
+        request_t request;
+        while (_requests.pop(request)){
+            async_status_t status = ASYNC_STATUS_DONE;
+            size_t num_samps = 0;
+            try{
+                //send until done or cancelled, at least once for a burst with no samples
+                do{
+                    if (_requests.is_cancelled(request)){
+                        status = ASYNC_STATUS_CANCELLED;
+                        break;
+                    }
+                    std::vector<const void *> buffs(request.buffs);
+                    for (size_t i = 0; i < buffs.size(); i++){
+                        buffs[i] = reinterpret_cast<const char *>(buffs[i]) + num_samps*_io_type.size;
+                    }
+                    const size_t num_sent = _dev->send(
+                        buffs, request.nsamps_per_buff - num_samps, request.metadata,
+                        _io_type, device::SEND_MODE_FULL_BUFF, io_timeout
+                    );
+                    //the rest of a partial send continues the burst
+                    if (num_sent != 0){
+                        request.metadata.start_of_burst = false;
+                        request.metadata.has_time_spec = false;
+                    }
+                    num_samps += num_sent;
+                } while (num_samps < request.nsamps_per_buff);
+            }catch(const std::exception &e){
+                UHD_MSG(error) << "Error (async send): " << e.what() << std::endl;
+                status = ASYNC_STATUS_CANCELLED;
+            }
+            _requests.complete();
+            try{
+                request.handler(status, num_samps);
+            }catch(const std::exception &e){
+                UHD_MSG(error) << "Error (async stream handler): " << e.what() << std::endl;
+            }
+        }
+    }
+
+    device::sptr _dev;
+    const io_type_t _io_type;
+    async_request_queue<request_t> _requests;
+    boost::thread_group _thread_group;
+};
+
+async_tx_stream::sptr async_tx_stream::make(device::sptr dev, const io_type_t &io_type, size_t max_in_flight){
+    return sptr(new async_tx_stream_impl(dev, io_type, max_in_flight));
+}
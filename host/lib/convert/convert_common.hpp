@@ -20,6 +20,7 @@
 
 #include <uhd/convert.hpp>
 #include <uhd/utils/static.hpp>
+#include <uhd/utils/byteswap.hpp>
 #include <boost/cstdint.hpp>
 #include <complex>
 
@@ -46,6 +47,18 @@ typedef std::complex<float>          fc32_t;
 typedef std::complex<boost::int16_t> sc16_t;
 typedef std::complex<boost::int8_t>  sc8_t;
 typedef boost::uint32_t              item32_t;
+typedef boost::uint32_t              w32_t; //an item32 in the wire format (big endian)
+
+/***********************************************************************
+ * Convert wire format items32 to and from host order items32
+ **********************************************************************/
+static UHD_INLINE item32_t w32_to_item32(w32_t item){
+    return uhd::ntohx(item);
+}
+
+static UHD_INLINE w32_t item32_to_w32(item32_t item){
+    return uhd::htonx(item);
+}
 
 /***********************************************************************
  * Convert complex short buffer to items32
@@ -75,6 +75,7 @@ pred_type make_pred(const std::string &markup, dir_type &dir){
         else if (cpu_type == "fc32") pred |= $ph.fc32_p;
         else if (cpu_type == "sc16") pred |= $ph.sc16_p;
         else if (cpu_type == "sc8")  pred |= $ph.sc8_p;
+        else if (cpu_type == "w32")  pred |= $ph.w32_p;
         else throw pred_error("unhandled io type " + cpu_type);
 
         if (otw_type == "item32") pred |= $ph.item32_p;
@@ -125,6 +126,7 @@ static pred_vector_type get_pred_io_type_table(void){
     table[pred_table_index(io_type_t::COMPLEX_FLOAT64)]    = $ph.fc64_p;
     table[pred_table_index(io_type_t::COMPLEX_FLOAT32)]    = $ph.fc32_p;
     table[pred_table_index(io_type_t::COMPLEX_INT16)]      = $ph.sc16_p;
+    table[pred_table_index(io_type_t::COMPLEX_INT16_ITEM32_BE)] = $ph.w32_p;
     return table;
 }
 
@@ -178,6 +180,7 @@ class ph:
     chan2_p  = 0b01000
     chan3_p  = 0b10000
     chan4_p  = 0b11000
+    w32_p    = 0b100000
 
 if __name__ == '__main__':
     import sys, os
@@ -16,6 +16,7 @@
 //
 
 #include <uhd/device.hpp>
+#include <uhd/stream.hpp>
 #include <uhd/types/dict.hpp>
 #include <uhd/exception.hpp>
 #include <uhd/utils/log.hpp>
@@ -153,3 +154,26 @@ device::sptr device::make(const device_addr_t &hint, size_t which){
         return dev;
     }
 }
+
+/***********************************************************************
+ * Streams
+ **********************************************************************/
+rx_stream::sptr device::get_rx_stream(const std::vector<size_t> &){
+    throw uhd::not_implemented_error("this device does not support receive streams");
+}
+
+rx_stream::sptr device::subscribe_rx_stream(const std::vector<size_t> &, size_t, subscriber_policy_t){
+    throw uhd::not_implemented_error("this device does not support receive streams");
+}
+
+double device::issue_stream_cmd(const stream_cmd_t &, const std::vector<size_t> &){
+    throw uhd::not_implemented_error("this device does not issue stream commands at once");
+}
+
+void device::set_time_unknown_pps(const time_spec_t &){
+    throw uhd::not_implemented_error("this device does not set the time of all mboards at once");
+}
+
+size_t rx_stream::recv_frames(std::vector<rx_frame> &, rx_metadata_t &, double){
+    throw uhd::not_implemented_error("this stream does not support receiving frames");
+}
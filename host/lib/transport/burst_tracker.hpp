@@ -0,0 +1,156 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_BURST_TRACKER_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_BURST_TRACKER_HPP
+
+#include <uhd/config.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+#include <algorithm>
+#include <deque>
+
+namespace uhd{ namespace transport{
+
+/***********************************************************************
+ * Burst tracker for a single tx channel:
+ *  - the send thread calls sent when the end of a burst went out,
+ *    with the sequence of the end of burst packet
+ *  - the thread that receives the async reports calls ack
+ *    with the sequence of the burst ack (the low 16 bits of the packet)
+ *
+ * An ack completes the pending burst with its sequence,
+ * the pending bursts sent before it had their acks lost
+ * (or the device dropped their end of burst packets).
+ * The latency of a burst is the time from its send to its ack.
+ **********************************************************************/
+class burst_tracker : boost::noncopyable{
+public:
+    typedef boost::shared_ptr<burst_tracker> sptr;
+
+    /*!
+     * Make a new burst tracker.
+     * \param max_pending the most bursts waiting on their acks
+     */
+    burst_tracker(size_t max_pending = 256):
+        _max_pending(max_pending),
+        _num_sent(0), _num_acked(0), _num_lost(0),
+        _latency_sum(0.0), _latency_min(0.0), _latency_max(0.0)
+    {
+        /* NOP */
+    }
+
+    /*!
+     * The end of a burst was sent.
+     * \param seq the sequence of the end of burst packet
+     * \param now the time in seconds
+     */
+    void sent(boost::uint32_t seq, double now){
+        boost::mutex::scoped_lock lock(_mutex);
+        if (_pending.size() == _max_pending){
+            _pending.pop_front();
+            _num_lost++;
+        }
+        burst_t burst = {boost::uint16_t(seq & 0xffff), now};
+        _pending.push_back(burst);
+        _num_sent++;
+    }
+
+    /*!
+     * The ack of a burst came in.
+     * \param seq the low 16 bits of the sequence of the end of burst packet
+     * \param now the time in seconds
+     * \param latency the latency of the burst in seconds
+     * \return false when no pending burst has the sequence
+     */
+    bool ack(boost::uint16_t seq, double now, double &latency){
+        boost::mutex::scoped_lock lock(_mutex);
+        std::deque<burst_t>::iterator it = _pending.begin();
+        while (it != _pending.end() and it->seq != seq) ++it;
+        if (it == _pending.end()) return false;
+
+        latency = now - it->time;
+        _num_lost += it - _pending.begin();
+        _pending.erase(_pending.begin(), it + 1);
+
+        _latency_min = (_num_acked == 0)? latency : std::min(_latency_min, latency);
+        _latency_max = (_num_acked == 0)? latency : std::max(_latency_max, latency);
+        _latency_sum += latency;
+        _num_acked++;
+        return true;
+    }
+
+    //! Get the number of bursts sent
+    size_t get_num_sent(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _num_sent;
+    }
+
+    //! Get the number of bursts acked
+    size_t get_num_acked(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _num_acked;
+    }
+
+    //! Get the number of bursts without an ack (a later burst was acked)
+    size_t get_num_lost(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _num_lost;
+    }
+
+    //! Get the number of bursts waiting on their acks
+    size_t get_num_pending(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _pending.size();
+    }
+
+    //! Get the smallest latency in seconds (zero until acked)
+    double get_latency_min(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _latency_min;
+    }
+
+    //! Get the mean latency in seconds (zero until acked)
+    double get_latency_mean(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return (_num_acked == 0)? 0.0 : _latency_sum/_num_acked;
+    }
+
+    //! Get the largest latency in seconds (zero until acked)
+    double get_latency_max(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _latency_max;
+    }
+
+private:
+    struct burst_t{
+        boost::uint16_t seq;
+        double time;
+    };
+
+    boost::mutex _mutex;
+    const size_t _max_pending;
+    std::deque<burst_t> _pending;
+    size_t _num_sent, _num_acked, _num_lost;
+    double _latency_sum, _latency_min, _latency_max;
+};
+
+}} //namespace
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_BURST_TRACKER_HPP */
@@ -0,0 +1,158 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_CONCURRENT_ISSUER_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_CONCURRENT_ISSUER_HPP
+
+#include <uhd/config.hpp>
+#include <uhd/exception.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/utility.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace uhd{ namespace transport{
+
+/***********************************************************************
+ * Concurrent issuer:
+ * Runs a set of blocking control transactions (ex: one per mboard)
+ * at the same time, instead of one after the other.
+ *  - the threads are started once and wait for the next issue,
+ *    so that they are released together (the caller runs the first)
+ *  - the issue skew is the worst case spread of the transactions:
+ *    each one took effect between its start and its completion,
+ *    so the skew is the last completion minus the first start
+ *  - an error in a transaction is thrown from issue,
+ *    after all of the transactions of the issue have completed
+ *  - the issues of concurrent callers are made one after the other
+ **********************************************************************/
+    class concurrent_issuer : boost::noncopyable{
+    public:
+        typedef boost::shared_ptr<concurrent_issuer> sptr;
+        typedef boost::function<void(void)> issue_type;
+
+        /*!
+         * Make a new concurrent issuer and start its threads.
+         * \param max_issues the most transactions per issue
+         */
+        concurrent_issuer(size_t max_issues):
+            _max_issues(max_issues),
+            _generation(0), _num_pending(0),
+            _starts(max_issues), _dones(max_issues),
+            _running(true)
+        {
+            UHD_ASSERT_THROW(_max_issues > 0);
+            for (size_t i = 1; i < _max_issues; i++){
+                _thread_group.create_thread(boost::bind(&concurrent_issuer::issue_loop, this, i));
+            }
+        }
+
+        ~concurrent_issuer(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            _running = false;
+            lock.unlock();
+            _issue_cond.notify_all();
+            _thread_group.join_all();
+        }
+
+        /*!
+         * Run the transactions concurrently, and wait for all of them.
+         * \param issues the transactions (at most max issues)
+         * \return the worst case issue skew in seconds
+         * \throw uhd::runtime_error with the message of a failed transaction
+         */
+        double issue(const std::vector<issue_type> &issues){
+            UHD_ASSERT_THROW(issues.size() <= _max_issues);
+            if (issues.empty()) return 0.0;
+
+            boost::mutex::scoped_lock issue_lock(_issue_mutex);
+            boost::mutex::scoped_lock lock(_mutex);
+            _issues = issues;
+            _error.clear();
+            _num_pending = issues.size() - 1;
+            _generation++;
+            lock.unlock();
+            _issue_cond.notify_all();
+
+            //the caller runs the first transaction
+            this->run(0);
+
+            lock.lock();
+            while (_num_pending != 0) _done_cond.wait(lock);
+            _issues.clear();
+            if (not _error.empty()) throw uhd::runtime_error(_error);
+
+            const boost::system_time first_start = *std::min_element(_starts.begin(), _starts.begin() + issues.size());
+            const boost::system_time last_done = *std::max_element(_dones.begin(), _dones.begin() + issues.size());
+            return double((last_done - first_start).total_microseconds())/1e6;
+        }
+
+    private:
+        void run(size_t index){
+            std::string error;
+            const boost::system_time start = boost::get_system_time();
+            try{
+                _issues[index]();
+            }catch(const std::exception &e){
+                error = e.what();
+            }
+            const boost::system_time done = boost::get_system_time();
+
+            boost::mutex::scoped_lock lock(_mutex);
+            _starts[index] = start;
+            _dones[index] = done;
+            if (_error.empty()) _error = error;
+        }
+
+        void issue_loop(size_t index){
+            //start from the first generation: an issue may come before the thread runs
+            size_t generation = 0;
+            boost::mutex::scoped_lock lock(_mutex);
+            while (true){
+                while (_running and _generation == generation) _issue_cond.wait(lock);
+                if (not _running) return;
+                generation = _generation;
+                if (index >= _issues.size()) continue;
+
+                lock.unlock();
+                this->run(index);
+                lock.lock();
+                if (--_num_pending == 0) _done_cond.notify_one();
+            }
+        }
+
+        const size_t _max_issues;
+        boost::mutex _issue_mutex, _mutex;
+        boost::condition _issue_cond, _done_cond;
+        std::vector<issue_type> _issues;
+        size_t _generation, _num_pending;
+        std::vector<boost::system_time> _starts, _dones;
+        std::string _error;
+        bool _running;
+        boost::thread_group _thread_group;
+    };
+
+}} //namespace
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_CONCURRENT_ISSUER_HPP */
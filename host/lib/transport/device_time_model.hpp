@@ -0,0 +1,234 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_DEVICE_TIME_MODEL_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_DEVICE_TIME_MODEL_HPP
+
+#include <uhd/config.hpp>
+#include <uhd/exception.hpp>
+#include <uhd/types/time_spec.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <deque>
+
+//the host clock of the time models: monotonic, and not slewed by ntp when possible
+#if defined(CLOCK_MONOTONIC_RAW)
+#  define UHD_TIME_MODEL_CLOCK CLOCK_MONOTONIC_RAW
+#elif defined(CLOCK_MONOTONIC)
+#  define UHD_TIME_MODEL_CLOCK CLOCK_MONOTONIC
+#endif
+
+namespace uhd{ namespace transport{
+
+/***********************************************************************
+ * Device time model:
+ * Estimates the time of a device from the host clock, without io.
+ *  - a sync is an exact read of the device time, taken between two
+ *    host times (the error is half of the span)
+ *  - the device time is a line fit of the last syncs over the host time,
+ *    the fitted rate is kept within the max drift of the host rate
+ *  - an observation is a timestamp that the device sent before a host
+ *    time (rx data, async reports): the device time is at least that,
+ *    which narrows the estimate (or resets the model when the time moved)
+ * The error bound is the largest error of a sync (plus its residual),
+ * plus the max drift over the host time since the last sync.
+ * All calls are thread safe.
+ **********************************************************************/
+    class device_time_model : boost::noncopyable{
+    public:
+        /*!
+         * Make a new device time model.
+         * \param max_drift the bound on the error of the fitted rate
+         * \param num_syncs the number of syncs in the fit
+         */
+        device_time_model(double max_drift = 50e-6, size_t num_syncs = 8):
+            _max_drift(max_drift), _num_syncs(num_syncs),
+            _hold_until(0.0), _has_bound(false)
+        {
+            UHD_ASSERT_THROW(_num_syncs > 0);
+        }
+
+        //! Get the host time in seconds (the same for all of the models, monotonic)
+        static double get_host_time(void){
+            static const time_spec_t start_time = get_host_clock();
+            return (get_host_clock() - start_time).get_real_secs();
+        }
+
+        /*!
+         * Add an exact read of the device time.
+         * A sync that the fit does not predict (the time was set) restarts the fit.
+         * \param host_before the host time before the read
+         * \param device_time the device time that was read
+         * \param host_after the host time after the read
+         */
+        void sync(double host_before, const time_spec_t &device_time, double host_after){
+            boost::mutex::scoped_lock lock(_mutex);
+            if (host_before < _hold_until) return; //the time may still change
+            const sync_point point = {(host_before + host_after)/2, device_time, (host_after - host_before)/2};
+            double est, err;
+            if (not _syncs.empty() and this->fit(point.host, est, err)){
+                if (std::abs(est - this->relative(device_time)) > err + point.error) this->clear();
+            }
+            if (_syncs.empty()) _ref = device_time;
+            _syncs.push_back(point);
+            if (_syncs.size() > _num_syncs) _syncs.pop_front();
+            this->update_fit();
+        }
+
+        /*!
+         * Add a timestamp that the device sent before a host time.
+         * \param host_time the host time when the timestamp was received
+         * \param device_time the timestamp
+         */
+        void observe(double host_time, const time_spec_t &device_time){
+            boost::mutex::scoped_lock lock(_mutex);
+            double est, err;
+            if (not this->fit(host_time, est, err)) return;
+            const double bound = this->relative(device_time);
+            if (bound > est + err){ //the time moved ahead of the fit
+                this->clear();
+                return;
+            }
+            //keep the bound that is the tightest at the host time
+            if (_has_bound and this->get_bound(host_time) >= bound) return;
+            _has_bound = true;
+            _bound_host = host_time;
+            _bound_device = bound;
+        }
+
+        /*!
+         * Forget the syncs, ex: when the device time is set.
+         * \param hold_until the host time before which there are no syncs
+         * (ex: the time is set at the next pps, which is up to a second later)
+         */
+        void reset(double hold_until = 0.0){
+            boost::mutex::scoped_lock lock(_mutex);
+            this->clear();
+            _hold_until = hold_until;
+        }
+
+        /*!
+         * Estimate the device time at a host time.
+         * \param host_time the host time
+         * \param device_time the estimated device time
+         * \param error the bound on the error in seconds
+         * \return false when there is no estimate (a sync is needed)
+         */
+        bool estimate(double host_time, time_spec_t &device_time, double &error) const{
+            boost::mutex::scoped_lock lock(_mutex);
+            double est, err;
+            if (host_time < _hold_until or not this->fit(host_time, est, err)) return false;
+            double lower = est - err;
+            const double upper = est + err;
+            if (_has_bound) lower = std::min(upper, std::max(lower, this->get_bound(host_time)));
+            device_time = _ref + time_spec_t((lower + upper)/2);
+            error = (upper - lower)/2;
+            return true;
+        }
+
+        //! Get the number of syncs in the fit
+        size_t get_num_syncs(void) const{
+            boost::mutex::scoped_lock lock(_mutex);
+            return _syncs.size();
+        }
+
+    private:
+        static time_spec_t get_host_clock(void){
+        #ifdef UHD_TIME_MODEL_CLOCK
+            timespec ts; clock_gettime(UHD_TIME_MODEL_CLOCK, &ts);
+            return time_spec_t(time_t(ts.tv_sec), long(ts.tv_nsec), 1e9);
+        #else
+            //no monotonic clock: the system time (a time step breaks the fit)
+            static const boost::system_time start_time = boost::get_system_time();
+            return time_spec_t(double((boost::get_system_time() - start_time).total_microseconds())/1e6);
+        #endif
+        }
+
+        struct sync_point{
+            double host;
+            time_spec_t device;
+            double error;
+        };
+
+        double relative(const time_spec_t &device_time) const{
+            return (device_time - _ref).get_real_secs();
+        }
+
+        //the bound propagated to a host time (at the slowest rate)
+        double get_bound(double host_time) const{
+            return _bound_device + (host_time - _bound_host)*(_rate - _max_drift);
+        }
+
+        bool fit(double host_time, double &est, double &err) const{
+            if (_syncs.empty()) return false;
+            est = _offset + _rate*(host_time - _syncs.back().host);
+            err = _fit_error + _max_drift*std::abs(host_time - _syncs.back().host);
+            return true;
+        }
+
+        void clear(void){
+            _syncs.clear();
+            _has_bound = false;
+        }
+
+        //least squares over the syncs, relative to the last sync
+        void update_fit(void){
+            const double host0 = _syncs.back().host;
+            double mean_x = 0, mean_y = 0;
+            for (size_t i = 0; i < _syncs.size(); i++){
+                mean_x += _syncs[i].host - host0;
+                mean_y += this->relative(_syncs[i].device);
+            }
+            mean_x /= _syncs.size();
+            mean_y /= _syncs.size();
+            double sxx = 0, sxy = 0;
+            for (size_t i = 0; i < _syncs.size(); i++){
+                const double dx = _syncs[i].host - host0 - mean_x;
+                sxx += dx*dx;
+                sxy += dx*(this->relative(_syncs[i].device) - mean_y);
+            }
+            _rate = (sxx > 0)? sxy/sxx : 1.0;
+            _rate = std::max(1.0 - _max_drift, std::min(1.0 + _max_drift, _rate));
+            _offset = mean_y - _rate*mean_x;
+
+            _fit_error = 0;
+            for (size_t i = 0; i < _syncs.size(); i++){
+                const double residual = this->relative(_syncs[i].device) - (_offset + _rate*(_syncs[i].host - host0));
+                _fit_error = std::max(_fit_error, _syncs[i].error + std::abs(residual));
+            }
+        }
+
+        const double _max_drift;
+        const size_t _num_syncs;
+        mutable boost::mutex _mutex;
+
+        std::deque<sync_point> _syncs;
+        time_spec_t _ref;
+        double _rate, _offset, _fit_error;
+        double _hold_until;
+
+        bool _has_bound;
+        double _bound_host, _bound_device;
+    };
+
+}} //namespace
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_DEVICE_TIME_MODEL_HPP */
@@ -0,0 +1,159 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_FLOW_CONTROL_MONITOR_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_FLOW_CONTROL_MONITOR_HPP
+
+#include <uhd/config.hpp>
+#include <uhd/utils/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/utility.hpp>
+
+namespace uhd{ namespace transport{
+
+/***********************************************************************
+ * Flow control monitor for a single tx channel:
+ *  - the send thread calls check for every packet to go out
+ *  - the thread that receives the acks calls update
+ *
+ * The sequence counters are atomic, so that check does not lock
+ * while the window has room: it spins on the ack count for a while,
+ * and only blocks on the condition when the window stays full.
+ * Update only locks to notify when the send thread is blocked.
+ *
+ * The monitor also samples the ack round trip time: one packet at a time
+ * is timed from its check until the ack that covers it.
+ **********************************************************************/
+class flow_control_monitor : boost::noncopyable{
+public:
+    typedef boost::uint32_t seq_type;
+    typedef boost::shared_ptr<flow_control_monitor> sptr;
+
+    /*!
+     * Make a new flow control monitor.
+     * \param max_seqs_out num seqs before throttling
+     */
+    flow_control_monitor(seq_type max_seqs_out):
+        _rtt_seq(0), _rtt(0.0), _has_rtt(false)
+    {
+        _max_seqs_out.write(max_seqs_out);
+        _ready_fcn = boost::bind(&flow_control_monitor::ready, this);
+    }
+
+    /*!
+     * Check the flow control condition (called by one send thread).
+     * \param seq the sequence to go out
+     * \param timeout the timeout in seconds
+     * \return false on timeout
+     */
+    UHD_INLINE bool check_fc_condition(seq_type seq, double timeout){
+        _last_seq_out.write(seq);
+        if (_rtt_pending.read() == 0){
+            _rtt_time = boost::get_system_time();
+            _rtt_seq = seq;
+            _rtt_pending.write(1); //publishes the time and sequence
+        }
+        for (size_t i = 0; i < num_spins; i++){
+            if (this->ready()) return true;
+        }
+
+        //the window stays full: block until an ack makes room
+        boost::unique_lock<boost::mutex> lock(_fc_mutex);
+        _waiting.write(1); //a barrier before the ready check of the wait
+        boost::this_thread::disable_interruption di; //disable because the wait can throw
+        const bool ready = _fc_cond.timed_wait(
+            lock, boost::posix_time::microseconds(long(timeout*1e6)), _ready_fcn
+        );
+        _waiting.write(0);
+        return ready;
+    }
+
+    /*!
+     * Update the flow control condition.
+     * \param seq the last sequence number to be ACK'd
+     */
+    UHD_INLINE void update_fc_condition(seq_type seq){
+        _last_seq_ack.write(seq); //a barrier before the waiting check
+        if (_rtt_pending.read() != 0 and seq_type(seq - _rtt_seq) < (seq_type(1) << 31)){
+            _rtt = double((boost::get_system_time() - _rtt_time).total_microseconds())/1e6;
+            _has_rtt = true;
+            _rtt_pending.write(0);
+        }
+        if (_waiting.read() == 0) return;
+        boost::unique_lock<boost::mutex> lock(_fc_mutex);
+        lock.unlock();
+        _fc_cond.notify_one();
+    }
+
+    /*!
+     * Take the last round trip time measured by update (same thread).
+     * \param rtt the round trip time in seconds
+     * \return true when there was a new measurement
+     */
+    bool pop_rtt(double &rtt){
+        if (not _has_rtt) return false;
+        rtt = _rtt;
+        _has_rtt = false;
+        return true;
+    }
+
+    //! Set the number of seqs before throttling
+    void set_max_seqs_out(seq_type max_seqs_out){
+        _max_seqs_out.write(max_seqs_out);
+    }
+
+    //! Get the number of seqs before throttling
+    seq_type get_max_seqs_out(void){
+        return _max_seqs_out.read();
+    }
+
+    //! Get the number of seqs out and not yet ACK'd
+    seq_type get_num_seqs_out(void){
+        return seq_type(_last_seq_out.read() - _last_seq_ack.read());
+    }
+
+private:
+    //the number of ack checks before the send thread blocks
+    static const size_t num_spins = 64;
+
+    bool ready(void){
+        return get_num_seqs_out() < _max_seqs_out.read();
+    }
+
+    boost::mutex _fc_mutex;
+    boost::condition _fc_cond;
+    atomic_uint32_t _last_seq_out, _last_seq_ack, _max_seqs_out, _waiting;
+    boost::function<bool(void)> _ready_fcn;
+
+    //the round trip sample: set by the send thread while not pending
+    atomic_uint32_t _rtt_pending;
+    boost::system_time _rtt_time;
+    seq_type _rtt_seq;
+    double _rtt; //only accessed by the update thread
+    bool _has_rtt;
+};
+
+}} //namespace
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_FLOW_CONTROL_MONITOR_HPP */
@@ -0,0 +1,171 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_FLOW_CONTROL_TUNER_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_FLOW_CONTROL_TUNER_HPP
+
+#include <uhd/config.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+#include <algorithm>
+
+namespace uhd{ namespace transport{
+
+/***********************************************************************
+ * Flow control tuner for a single tx channel:
+ * Picks the flow control window (packets in flight) and the device ack
+ * cadence (packets per update) from the measured ack round trip time,
+ * the ack rate, and the underflows reported by the device.
+ *
+ *  - The window needed to keep the device fed is the packets consumed
+ *    in a round trip plus the packets between acks. The round trip is
+ *    the smallest one measured: the samples buffered in the device add
+ *    to the measured round trips, and they are what the window limits.
+ *    The window tracks twice the need: it grows at once and shrinks
+ *    by a quarter per update, so the samples buffered in the device
+ *    (the tx latency) stay small.
+ *  - An underflow means the acks came too late for the window:
+ *    the window doubles, the device acks twice as often,
+ *    and the round trip starts over from the smoothed one.
+ *  - After quiet updates, the ack cadence relaxes back towards its maximum.
+ *
+ * The window stays within the device buffer (the max window),
+ * and the packets per update within the window and its maximum.
+ * A max packets per update of zero leaves the ack cadence disabled.
+ *
+ * The events and the update are called by the thread that receives the acks,
+ * the parameters can be read from any thread.
+ **********************************************************************/
+class flow_control_tuner : boost::noncopyable{
+public:
+    typedef boost::shared_ptr<flow_control_tuner> sptr;
+
+    /*!
+     * Make a new flow control tuner.
+     * \param max_window the packets that fit in the device buffer
+     * \param max_packets_per_up the configured packets per update
+     */
+    flow_control_tuner(size_t max_window, size_t max_packets_per_up):
+        _max_window(max_window),
+        _min_window(std::min(max_window, size_t(min_window))),
+        _max_packets_per_up(max_packets_per_up),
+        _window(max_window),
+        _packets_per_up(max_packets_per_up),
+        _rtt(0.0), _min_rtt(0.0),
+        _last_seq_ack(0), _num_acked(0), _num_underflows(0),
+        _num_quiet_updates(0), _last_update(-1.0),
+        _update_interval(0.1)
+    {
+        /* NOP */
+    }
+
+    //! An ack of a sequence number came in
+    void on_ack(boost::uint32_t seq){
+        _num_acked += boost::uint32_t(seq - _last_seq_ack);
+        _last_seq_ack = seq;
+    }
+
+    //! A round trip time was measured (in seconds)
+    void on_rtt(double rtt){
+        boost::mutex::scoped_lock lock(_mutex);
+        _rtt = (_rtt == 0.0)? rtt : _rtt + (rtt - _rtt)/8;
+        _min_rtt = (_min_rtt == 0.0)? rtt : std::min(_min_rtt, rtt);
+    }
+
+    //! The device reported an underflow
+    void on_underflow(void){
+        _num_underflows++;
+    }
+
+    /*!
+     * Update the parameters, at most once per update interval.
+     * \param now the time in seconds
+     * \return true when the window or the packets per update changed
+     */
+    bool update(double now){
+        if (_last_update < 0.0) _last_update = now;
+        if (now - _last_update < _update_interval) return false;
+        const double rate = _num_acked/(now - _last_update);
+
+        boost::mutex::scoped_lock lock(_mutex);
+        const size_t window = _window, packets_per_up = _packets_per_up;
+        if (_num_underflows != 0){
+            _window = std::min(_window*2, _max_window);
+            _packets_per_up /= 2;
+            _min_rtt = std::max(_min_rtt, _rtt);
+            _num_quiet_updates = 0;
+        }
+        else if (_num_acked != 0){ //no acks: idle, nothing to learn
+            const size_t target = std::max(_min_window, std::min(_max_window,
+                size_t(2*rate*_min_rtt) + _packets_per_up + 1
+            ));
+            if (target > _window) _window = target;
+            else _window -= (_window - target)/4;
+            if (++_num_quiet_updates >= num_relax_updates){
+                _packets_per_up *= 2;
+                _num_quiet_updates = 0;
+            }
+        }
+        _packets_per_up = (_max_packets_per_up == 0)? 0 : std::max<size_t>(1,
+            std::min(_packets_per_up, std::min(_max_packets_per_up, _window/4))
+        );
+
+        _num_acked = 0;
+        _num_underflows = 0;
+        _last_update = now;
+        return _window != window or _packets_per_up != packets_per_up;
+    }
+
+    //! Get the flow control window in packets
+    size_t get_window(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _window;
+    }
+
+    //! Get the device packets per update (zero when disabled)
+    size_t get_packets_per_up(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _packets_per_up;
+    }
+
+    //! Get the smoothed ack round trip time in seconds (zero until measured)
+    double get_rtt(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _rtt;
+    }
+
+private:
+    static const size_t min_window = 32;
+    static const size_t num_relax_updates = 10;
+
+    boost::mutex _mutex;
+    const size_t _max_window, _min_window, _max_packets_per_up;
+    size_t _window, _packets_per_up;
+    double _rtt, _min_rtt;
+
+    //ack thread only
+    boost::uint32_t _last_seq_ack;
+    size_t _num_acked, _num_underflows, _num_quiet_updates;
+    double _last_update;
+    const double _update_interval; //seconds
+};
+
+}} //namespace
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_FLOW_CONTROL_TUNER_HPP */
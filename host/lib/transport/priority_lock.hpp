@@ -0,0 +1,127 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_PRIORITY_LOCK_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_PRIORITY_LOCK_HPP
+
+#include <uhd/config.hpp>
+#include <uhd/exception.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/utility.hpp>
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace uhd{ namespace transport{
+
+/***********************************************************************
+ * Priority lock:
+ * A recursive lock for a channel with one transaction at a time
+ * (ex: the control path of a device), where the waiting threads
+ * take the channel in the order of their priorities.
+ *  - a higher priority waiter overtakes the lower priority waiters,
+ *    but does not preempt the owner (a transaction is not cut short)
+ *  - the waiters of a priority take the channel first come, first served
+ *  - the owner may lock again (nested calls), at any priority
+ * The longest wait of each priority is kept for the stats.
+ **********************************************************************/
+    class priority_lock : boost::noncopyable{
+    public:
+        /*!
+         * Make a new priority lock.
+         * \param num_priorities the priorities are 0 (lowest) to num - 1
+         */
+        priority_lock(size_t num_priorities):
+            _depth(0), _next_ticket(0), _wait_max(num_priorities, 0.0)
+        {
+            UHD_ASSERT_THROW(num_priorities > 0);
+        }
+
+        //! Lock the channel, wait behind the waiters of a higher or equal priority
+        void lock(size_t priority){
+            UHD_ASSERT_THROW(priority < _wait_max.size());
+            boost::mutex::scoped_lock lock(_mutex);
+            if (_depth != 0 and _owner == boost::this_thread::get_id()){
+                _depth++;
+                return;
+            }
+
+            //the waiters are ordered by priority (highest first), then by ticket
+            const boost::system_time start = boost::get_system_time();
+            const waiter_type waiter(-int(priority), _next_ticket++);
+            _waiters.insert(waiter);
+            while (_depth != 0 or *_waiters.begin() != waiter) _cond.wait(lock);
+            _waiters.erase(waiter);
+            _owner = boost::this_thread::get_id();
+            _depth = 1;
+
+            const double wait = double((boost::get_system_time() - start).total_microseconds())/1e6;
+            _wait_max[priority] = std::max(_wait_max[priority], wait);
+        }
+
+        //! Unlock the channel (the last unlock of the owner lets the next waiter in)
+        void unlock(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            UHD_ASSERT_THROW(_depth != 0 and _owner == boost::this_thread::get_id());
+            if (--_depth != 0) return;
+            lock.unlock();
+            _cond.notify_all();
+        }
+
+        //! Get the longest wait of a priority in seconds
+        double get_wait_max(size_t priority){
+            boost::mutex::scoped_lock lock(_mutex);
+            return _wait_max.at(priority);
+        }
+
+        //! Get the number of threads waiting for the channel
+        size_t get_num_waiters(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            return _waiters.size();
+        }
+
+        //! Locks the channel for the scope
+        class scoped_lock : boost::noncopyable{
+        public:
+            scoped_lock(priority_lock &lock, size_t priority): _lock(lock){
+                _lock.lock(priority);
+            }
+            ~scoped_lock(void){
+                _lock.unlock();
+            }
+        private:
+            priority_lock &_lock;
+        };
+
+    private:
+        typedef std::pair<int, size_t> waiter_type;
+
+        boost::mutex _mutex;
+        boost::condition _cond;
+        boost::thread::id _owner;
+        size_t _depth, _next_ticket;
+        std::set<waiter_type> _waiters;
+        std::vector<double> _wait_max;
+    };
+
+}} //namespace
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_PRIORITY_LOCK_HPP */
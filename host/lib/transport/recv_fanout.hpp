@@ -0,0 +1,299 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_RECV_FANOUT_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_RECV_FANOUT_HPP
+
+#include <uhd/config.hpp>
+#include <uhd/exception.hpp>
+#include <uhd/transport/zero_copy.hpp>
+#include <uhd/utils/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/format.hpp>
+#include <boost/bind.hpp>
+#include <boost/utility.hpp>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+namespace uhd{ namespace transport{
+
+/***********************************************************************
+ * Receive fan-out:
+ * A thread reads the frames of one transport and hands each frame to
+ * every subscriber. A subscriber is a receive transport of its own,
+ * its buffers are views of the shared frames (no copies), and a frame
+ * goes back to the transport when the last view is released.
+ *
+ * Each subscriber holds at most depth frames (queued or in use).
+ * A subscriber that falls behind drops frames by its own policy,
+ * so it never stalls the other subscribers. The dropped frames show up
+ * as sequence gaps in the subscriber's stream.
+ *
+ * All of the book keeping is under one lock, and only for short updates:
+ * the view counts of the frames and the queues and free lists of the
+ * subscribers are shared by the read thread and the subscriber threads.
+ * A view that was handed out keeps the state of its subscriber alive,
+ * so a view may be released after its subscriber was destroyed.
+ **********************************************************************/
+    class recv_fanout : boost::noncopyable, public boost::enable_shared_from_this<recv_fanout>{
+    public:
+        typedef boost::shared_ptr<recv_fanout> sptr;
+
+        //! What a subscriber does with a new frame when it holds depth frames
+        enum overflow_policy_t{
+            //! Drop the new frame
+            DROP_NEWEST = 'n',
+            //! Drop the oldest frame in the queue to make room (the new frame if none are queued)
+            DROP_OLDEST = 'o'
+        };
+
+        /*!
+         * Make a new fan-out and start its thread.
+         * \param xport the receive transport to read
+         * \return a new fan-out
+         */
+        static sptr make(zero_copy_if::sptr xport){
+            sptr fanout(new recv_fanout(xport));
+            fanout->_thread_group.create_thread(boost::bind(&recv_fanout::read_loop, fanout.get()));
+            return fanout;
+        }
+
+        ~recv_fanout(void){
+            _running.write(0);
+            _thread_group.join_all();
+        }
+
+        /*!
+         * Subscribe to the frames of the transport.
+         * The subscriber keeps the fan-out alive.
+         * \param depth the most frames that the subscriber holds
+         * \param policy what to drop when the subscriber holds depth frames
+         * \return a receive transport for the subscriber
+         * \throw uhd::value_error when the transport has too few frames
+         */
+        zero_copy_if::sptr subscribe(size_t depth, overflow_policy_t policy){
+            boost::mutex::scoped_lock lock(_mutex);
+            //the reader needs one frame, the subscribers share the rest
+            size_t num_frames = depth + 1;
+            for (size_t i = 0; i < _subscribers.size(); i++) num_frames += _subscribers[i]->depth;
+            if (depth == 0 or num_frames > _xport->get_num_recv_frames()) throw uhd::value_error(str(
+                boost::format("cannot subscribe with a depth of %u frames, the transport has %u frames")
+                % depth % _xport->get_num_recv_frames()
+            ));
+            subscriber_sptr sub(new subscriber_state(shared_from_this(), depth, policy));
+            _subscribers.push_back(sub.get());
+            return zero_copy_if::sptr(new subscriber_impl(sub));
+        }
+
+        /*!
+         * Get the number of frames that a subscriber dropped.
+         * \param xport a transport made by subscribe
+         * \return the number of frames
+         */
+        static size_t get_num_dropped(zero_copy_if::sptr xport){
+            subscriber_state &sub = *dynamic_cast<subscriber_impl &>(*xport).state;
+            boost::mutex::scoped_lock lock(sub.fanout->_mutex);
+            return sub.num_dropped;
+        }
+
+    private:
+        struct subscriber_state;
+        typedef boost::shared_ptr<subscriber_state> subscriber_sptr;
+
+        //! A frame of the transport and the number of views of it
+        struct frame_t{
+            managed_recv_buffer::sptr buff;
+            size_t num_views;
+        };
+
+        //! A subscriber's view of a frame, a queued or handed out view holds its subscriber
+        class view_buffer : public managed_recv_buffer{
+        public:
+            view_buffer(void): frame(NULL){
+                _ref_count.write(0);
+            }
+
+            void release(void){
+                //the subscriber may go away with this reference: unlock first
+                const subscriber_sptr owner = sub;
+                boost::mutex::scoped_lock lock(owner->fanout->_mutex);
+                owner->fanout->release_view(this);
+            }
+
+            subscriber_sptr sub; //null while the view is free
+            frame_t *frame;
+
+        private:
+            const void *get_buff(void) const{return frame->buff->cast<const void *>();}
+            size_t get_size(void) const{return frame->buff->size();}
+        };
+
+        //! The state of a subscriber, held by its transport and by its views
+        struct subscriber_state : boost::enable_shared_from_this<subscriber_state>{
+            subscriber_state(recv_fanout::sptr fanout, size_t depth, overflow_policy_t policy):
+                fanout(fanout), depth(depth), policy(policy),
+                num_views(0), num_dropped(0)
+            {
+                /* NOP */
+            }
+
+            bool has_views(void) const{return not queue.empty();}
+
+            const recv_fanout::sptr fanout;
+            const size_t depth;
+            const overflow_policy_t policy;
+            size_t num_views, num_dropped;
+            std::deque<view_buffer *> queue;
+            std::vector<boost::shared_ptr<view_buffer> > views;
+            std::vector<view_buffer *> free_views;
+            boost::condition cond;
+        };
+
+        //! A subscriber: a receive transport over the views of the frames
+        class subscriber_impl : public zero_copy_if{
+        public:
+            subscriber_impl(subscriber_sptr state): state(state){
+                /* NOP */
+            }
+
+            ~subscriber_impl(void){
+                //stop the fan-out to this subscriber, the views handed out stay valid
+                boost::mutex::scoped_lock lock(state->fanout->_mutex);
+                std::vector<subscriber_state *> &subs = state->fanout->_subscribers;
+                subs.erase(std::find(subs.begin(), subs.end(), state.get()));
+                while (not state->queue.empty()){
+                    view_buffer *view = state->queue.front();
+                    state->queue.pop_front();
+                    state->fanout->release_view(view);
+                }
+            }
+
+            managed_recv_buffer::sptr get_recv_buff(double timeout){
+                boost::mutex::scoped_lock lock(state->fanout->_mutex);
+                if (state->queue.empty() and not state->cond.timed_wait(
+                    lock, boost::posix_time::microseconds(long(timeout*1e6)),
+                    boost::bind(&subscriber_state::has_views, state.get())
+                )) return managed_recv_buffer::sptr();
+                view_buffer *view = state->queue.front();
+                state->queue.pop_front();
+                return managed_recv_buffer::sptr(view, false); //the view was made with one reference
+            }
+
+            size_t get_num_recv_frames(void) const{return state->depth;}
+            size_t get_recv_frame_size(void) const{return state->fanout->_xport->get_recv_frame_size();}
+
+            //a subscriber only receives
+            managed_send_buffer::sptr get_send_buff(double){
+                throw uhd::not_implemented_error("cannot send on a receive subscriber");
+            }
+            size_t get_num_send_frames(void) const{return 0;}
+            size_t get_send_frame_size(void) const{return 0;}
+
+            const subscriber_sptr state;
+        };
+
+        recv_fanout(zero_copy_if::sptr xport): _xport(xport){
+            _running.write(1);
+        }
+
+        //! Hand a frame to the subscribers (called with the lock held)
+        void fanout(managed_recv_buffer::sptr &buff){
+            frame_t *frame;
+            if (_free_frames.empty()){
+                _frames.push_back(boost::shared_ptr<frame_t>(new frame_t()));
+                frame = _frames.back().get();
+            }
+            else{
+                frame = _free_frames.back();
+                _free_frames.pop_back();
+            }
+            frame->buff.swap(buff);
+            frame->num_views = 0;
+
+            for (size_t i = 0; i < _subscribers.size(); i++){
+                subscriber_state *sub = _subscribers[i];
+                if (sub->num_views >= sub->depth){
+                    sub->num_dropped++;
+                    if (sub->policy == DROP_NEWEST or sub->queue.empty()) continue;
+                    view_buffer *oldest = sub->queue.front();
+                    sub->queue.pop_front();
+                    release_view(oldest);
+                }
+
+                view_buffer *view;
+                if (sub->free_views.empty()){
+                    sub->views.push_back(boost::shared_ptr<view_buffer>(new view_buffer()));
+                    view = sub->views.back().get();
+                }
+                else{
+                    view = sub->free_views.back();
+                    sub->free_views.pop_back();
+                }
+                view->sub = sub->shared_from_this();
+                view->frame = frame;
+                view->_ref_count.write(1); //the reference handed out by get recv buff
+                frame->num_views++;
+                sub->num_views++;
+                sub->queue.push_back(view);
+                sub->cond.notify_one();
+            }
+
+            //no subscribers: the frame goes right back
+            if (frame->num_views == 0){
+                frame->buff.reset();
+                _free_frames.push_back(frame);
+            }
+        }
+
+        //! Release a view, and its frame when it was the last view (called with the lock held)
+        void release_view(view_buffer *view){
+            frame_t *frame = view->frame;
+            if (--frame->num_views == 0){
+                frame->buff.reset();
+                _free_frames.push_back(frame);
+            }
+            view->sub->num_views--;
+            view->sub->free_views.push_back(view);
+            view->sub.reset(); //never the last reference: the caller holds the subscriber
+        }
+
+        void read_loop(void){
+            while (_running.read()){
+                managed_recv_buffer::sptr buff = _xport->get_recv_buff(0.01); //short timeout to see the shutdown
+                if (buff.get() == NULL) continue;
+                boost::mutex::scoped_lock lock(_mutex);
+                this->fanout(buff);
+            }
+        }
+
+        zero_copy_if::sptr _xport;
+        boost::mutex _mutex;
+        std::vector<subscriber_state *> _subscribers;
+        std::vector<boost::shared_ptr<frame_t> > _frames;
+        std::vector<frame_t *> _free_frames;
+        boost::thread_group _thread_group;
+        atomic_uint32_t _running;
+    };
+
+}} //namespace
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_RECV_FANOUT_HPP */
@@ -0,0 +1,108 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_REG_SHADOW_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_REG_SHADOW_HPP
+
+#include <uhd/config.hpp>
+#include <boost/function.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+#include <map>
+
+namespace uhd{ namespace transport{
+
+/***********************************************************************
+ * Register shadow:
+ * Holds the last value the host wrote to each host-owned register,
+ * so that the control transactions that would not change the device
+ * can be skipped (a poke of the held value, a peek of a held value).
+ *  - the policy tells the host-owned registers from the rest
+ *    (strobes, readback, and registers the device writes itself)
+ *  - the shadow must be invalidated when the device state is unknown
+ *    (a failed transaction, a device restart)
+ *  - the calls are not thread safe, the caller serializes them
+ **********************************************************************/
+    class reg_shadow : boost::noncopyable{
+    public:
+        typedef boost::function<bool(boost::uint32_t)> policy_type;
+
+        /*!
+         * Make a new register shadow (disabled).
+         * \param is_host_owned true for the registers that may be shadowed
+         */
+        reg_shadow(const policy_type &is_host_owned):
+            _is_host_owned(is_host_owned), _enabled(false), _num_suppressed(0)
+        {
+            /* NOP */
+        }
+
+        //! Enable or disable the shadow, the held values are forgotten
+        void set_enabled(bool enb){
+            _enabled = enb;
+            _values.clear();
+        }
+
+        bool is_enabled(void) const{
+            return _enabled;
+        }
+
+        //! Forget the held values (the next transactions go to the device)
+        void invalidate(void){
+            _values.clear();
+        }
+
+        //! True when the poke would not change the held value (the poke is skipped)
+        bool suppress_poke(boost::uint32_t addr, boost::uint32_t data){
+            if (not _enabled) return false;
+            std::map<boost::uint32_t, boost::uint32_t>::const_iterator it = _values.find(addr);
+            if (it == _values.end() or it->second != data) return false;
+            _num_suppressed++;
+            return true;
+        }
+
+        //! True when the peek was served from the held value
+        bool suppress_peek(boost::uint32_t addr, boost::uint32_t &data){
+            if (not _enabled) return false;
+            std::map<boost::uint32_t, boost::uint32_t>::const_iterator it = _values.find(addr);
+            if (it == _values.end()) return false;
+            data = it->second;
+            _num_suppressed++;
+            return true;
+        }
+
+        //! Record a value written to the device
+        void update(boost::uint32_t addr, boost::uint32_t data){
+            if (not _enabled or not _is_host_owned(addr)) return;
+            _values[addr] = data;
+        }
+
+        //! Get the number of peeks and pokes that were skipped
+        size_t get_num_suppressed(void) const{
+            return _num_suppressed;
+        }
+
+    private:
+        const policy_type _is_host_owned;
+        bool _enabled;
+        std::map<boost::uint32_t, boost::uint32_t> _values;
+        size_t _num_suppressed;
+    };
+
+}} //namespace
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_REG_SHADOW_HPP */
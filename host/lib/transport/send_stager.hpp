@@ -0,0 +1,292 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_SEND_STAGER_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_SEND_STAGER_HPP
+
+#include <uhd/config.hpp>
+#include <uhd/exception.hpp>
+#include <uhd/transport/zero_copy.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/bind.hpp>
+#include <boost/utility.hpp>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+namespace uhd{ namespace transport{
+
+/***********************************************************************
+ * Send stager:
+ * The send thread fills the frames of the transports as usual,
+ * but a commit stages the frame instead of sending it. A thread of the
+ * stager waits on the send condition (the flow control) of each frame
+ * and commits the frames to their transports, in the order staged.
+ *
+ * The samples staged on a transport are bounded by the max latency:
+ * getting a buffer blocks only while the staged samples exceed it.
+ * The samples of a frame are counted from its payload bytes.
+ *
+ * The book keeping is under one lock, and the reference counts of the
+ * transport buffers are only touched by the thread that owns them:
+ * the send thread until the frame is staged, the stager thread after.
+ * The reference counts of the staged buffers are only touched by the
+ * send thread.
+ **********************************************************************/
+    class send_stager : boost::noncopyable{
+    public:
+        typedef boost::shared_ptr<send_stager> sptr;
+
+        /*!
+         * The send condition of a frame (called in the stager thread).
+         * Takes the transport index, the frame sequence, and a timeout,
+         * and returns true when the frame may be sent.
+         */
+        typedef boost::function<bool(size_t, boost::uint32_t, double)> send_cond_type;
+
+        /*!
+         * Make a new send stager and start its thread.
+         * \param xports the send transports
+         * \param max_latency_samps the most samples staged per transport
+         * \param bytes_per_samp the bytes of a sample in the payload
+         * \param hdr_bytes the bytes before the payload of a frame
+         * \param send_cond the send condition of a frame
+         */
+        send_stager(
+            const std::vector<zero_copy_if::sptr> &xports,
+            size_t max_latency_samps,
+            size_t bytes_per_samp,
+            size_t hdr_bytes,
+            const send_cond_type &send_cond
+        ):
+            _xports(xports),
+            _max_latency_samps(max_latency_samps),
+            _bytes_per_samp(bytes_per_samp),
+            _hdr_bytes(hdr_bytes),
+            _send_cond(send_cond),
+            _stats(xports.size()),
+            _running(true)
+        {
+            UHD_ASSERT_THROW(_max_latency_samps > 0 and _bytes_per_samp > 0);
+
+            //one staged buffer for every frame of the transports
+            for (size_t i = 0; i < _xports.size(); i++){
+                for (size_t j = 0; j < _xports[i]->get_num_send_frames(); j++){
+                    _buffs.push_back(boost::shared_ptr<staged_buffer>(new staged_buffer(*this)));
+                    _free.push_back(_buffs.back().get());
+                }
+            }
+            _thread_group.create_thread(boost::bind(&send_stager::send_loop, this));
+        }
+
+        ~send_stager(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            _running = false;
+            lock.unlock();
+            _staged_cond.notify_one();
+            _thread_group.join_all();
+
+            //the frames still staged are dropped
+            while (not _staged.empty()){
+                _staged.front()->buff.reset();
+                _staged.pop_front();
+            }
+        }
+
+        /*!
+         * Get a send buffer of a transport (called by one send thread).
+         * Blocks while the samples staged on the transport exceed the max latency.
+         * \param index the transport index
+         * \param seq the sequence of the frame (for the send condition)
+         * \param timeout the timeout in seconds
+         * \return a managed buffer, or null sptr on timeout/error
+         */
+        managed_send_buffer::sptr get_send_buff(size_t index, boost::uint32_t seq, double timeout){
+            const boost::system_time exit_time = boost::get_system_time() +
+                boost::posix_time::microseconds(long(timeout*1e6));
+
+            boost::mutex::scoped_lock lock(_mutex);
+            stats_t &stats = _stats.at(index);
+            if (stats.depth >= _max_latency_samps){
+                stats.num_blocks++;
+                while (stats.depth >= _max_latency_samps){
+                    if (not _room_cond.timed_wait(lock, exit_time)) return managed_send_buffer::sptr();
+                }
+            }
+            lock.unlock();
+
+            const double remaining = double((exit_time - boost::get_system_time()).total_microseconds())/1e6;
+            managed_send_buffer::sptr buff = _xports[index]->get_send_buff(std::max(remaining, 0.0));
+            if (not buff.get()) return managed_send_buffer::sptr();
+
+            //there are as many staged buffers as transport frames
+            lock.lock();
+            UHD_ASSERT_THROW(not _free.empty());
+            staged_buffer *staged = _free.front();
+            _free.pop_front();
+            lock.unlock();
+
+            staged->index = index;
+            staged->seq = seq;
+            staged->buff.swap(buff);
+            staged->armed = true;
+            //add a reference: the send thread may still hold the buffer from its last use
+            return managed_send_buffer::sptr(staged);
+        }
+
+        //! Get the samples staged on a transport
+        size_t get_depth(size_t index){
+            boost::mutex::scoped_lock lock(_mutex);
+            return _stats.at(index).depth;
+        }
+
+        //! Get the most samples that were staged on a transport
+        size_t get_peak_depth(size_t index){
+            boost::mutex::scoped_lock lock(_mutex);
+            return _stats.at(index).peak_depth;
+        }
+
+        //! Get the mean samples staged on a transport (sampled at each stage)
+        double get_mean_depth(size_t index){
+            boost::mutex::scoped_lock lock(_mutex);
+            const stats_t &stats = _stats.at(index);
+            return (stats.num_staged == 0)? 0.0 : stats.sum_depth/stats.num_staged;
+        }
+
+        //! Get the number of times that the send thread blocked on the max latency
+        size_t get_num_blocks(size_t index){
+            boost::mutex::scoped_lock lock(_mutex);
+            return _stats.at(index).num_blocks;
+        }
+
+    private:
+        //! A transport buffer held from get until its commit in the stager thread
+        class staged_buffer : public managed_send_buffer{
+        public:
+            staged_buffer(send_stager &stager):
+                armed(false), index(0), seq(0), num_bytes(0), num_samps(0), _stager(stager)
+            {
+                _ref_count.write(0);
+            }
+
+            void commit(size_t num_bytes){
+                if (not armed) return; //staged or released already
+                armed = false;
+                if (num_bytes == 0) _stager.release(this);
+                else _stager.stage(this, num_bytes);
+            }
+
+            managed_send_buffer::sptr buff;
+            bool armed; //send thread only
+            size_t index;
+            boost::uint32_t seq;
+            size_t num_bytes, num_samps;
+
+        private:
+            void *get_buff(void) const{return buff->cast<void *>();}
+            size_t get_size(void) const{return buff->size();}
+
+            send_stager &_stager;
+        };
+
+        struct stats_t{
+            stats_t(void): depth(0), peak_depth(0), num_staged(0), num_blocks(0), sum_depth(0.0){}
+            size_t depth, peak_depth, num_staged, num_blocks;
+            double sum_depth;
+        };
+
+        //called by the send thread, which owns the buffer
+        void release(staged_buffer *staged){
+            staged->buff.reset();
+            boost::mutex::scoped_lock lock(_mutex);
+            _free.push_back(staged);
+        }
+
+        //called by the send thread, the buffer goes to the stager thread
+        void stage(staged_buffer *staged, size_t num_bytes){
+            staged->num_bytes = num_bytes;
+            staged->num_samps = (num_bytes > _hdr_bytes)? (num_bytes - _hdr_bytes)/_bytes_per_samp : 0;
+
+            boost::mutex::scoped_lock lock(_mutex);
+            stats_t &stats = _stats[staged->index];
+            stats.depth += staged->num_samps;
+            stats.peak_depth = std::max(stats.peak_depth, stats.depth);
+            stats.sum_depth += double(stats.depth);
+            stats.num_staged++;
+            _staged.push_back(staged);
+            lock.unlock();
+            _staged_cond.notify_one();
+        }
+
+        bool is_running(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            return _running;
+        }
+
+        void send_loop(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            while (_running){
+                if (_staged.empty()){
+                    _staged_cond.wait(lock);
+                    continue;
+                }
+                staged_buffer *staged = _staged.front();
+                lock.unlock();
+
+                //wait out the send condition, then send the frame
+                bool ready = false;
+                while (not ready and is_running()){
+                    ready = _send_cond(staged->index, staged->seq, 0.1);
+                }
+                if (ready){
+                    staged->buff->commit(staged->num_bytes);
+                    staged->buff.reset();
+                }
+
+                lock.lock();
+                if (not ready) break; //stopped, the destructor drops the staged frames
+                _staged.pop_front();
+                _stats[staged->index].depth -= staged->num_samps;
+                _free.push_back(staged);
+                _room_cond.notify_all();
+            }
+        }
+
+        const std::vector<zero_copy_if::sptr> _xports;
+        const size_t _max_latency_samps, _bytes_per_samp, _hdr_bytes;
+        const send_cond_type _send_cond;
+
+        boost::mutex _mutex;
+        boost::condition _staged_cond, _room_cond;
+        std::vector<boost::shared_ptr<staged_buffer> > _buffs;
+        std::deque<staged_buffer *> _free;
+        std::deque<staged_buffer *> _staged;
+        std::vector<stats_t> _stats;
+        bool _running;
+        boost::thread_group _thread_group;
+    };
+
+}} //namespace
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_SEND_STAGER_HPP */
@@ -23,6 +23,7 @@
 #include <uhd/utils/msg.hpp>
 #include <uhd/utils/log.hpp>
 #include <boost/format.hpp>
+#include <boost/array.hpp>
 #include <list>
 
 using namespace uhd;
@@ -233,6 +234,19 @@ public:
     size_t get_num_send_frames(void) const {return _num_send_frames;}
     size_t get_send_frame_size(void) const {return _send_frame_size;}
 
+    //asio gathers the buffers into one sendmsg (or WSASend), unused pieces are empty
+    size_t send_gather(const void * const *mems, const size_t *lens, size_t num_pieces){
+        UHD_ASSERT_THROW(num_pieces <= max_gather_pieces);
+        boost::array<asio::const_buffer, max_gather_pieces> pieces;
+        for (size_t i = 0; i < max_gather_pieces; i++){
+            pieces[i] = (i < num_pieces)? asio::const_buffer(mems[i], lens[i]) : asio::const_buffer();
+        }
+        boost::system::error_code ec;
+        const size_t num_bytes = _socket->send(pieces, 0, ec);
+        if (ec) throw uhd::io_error("udp send gather: " + ec.message());
+        return num_bytes;
+    }
+
 private:
     //memory management -> buffers and fifos
     const size_t _recv_frame_size, _num_recv_frames;
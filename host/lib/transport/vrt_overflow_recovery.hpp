@@ -0,0 +1,158 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_VRT_OVERFLOW_RECOVERY_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_VRT_OVERFLOW_RECOVERY_HPP
+
+#include "vrt_packet_handler.hpp"
+#include <uhd/utils/msg.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/utility.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace vrt_packet_handler{
+
+/***********************************************************************
+ * Overflow recovery:
+ * The packet handler reports an overflow from inside recv,
+ * but the recovery (re-issue the stream command) is a control round trip.
+ * The recovery runs in a thread instead, and recv only signals it,
+ * so that recv returns the overflow metadata right away.
+ * The overflows of a channel whose recovery is pending are coalesced.
+ **********************************************************************/
+    class overflow_recovery : boost::noncopyable{
+    public:
+        typedef boost::shared_ptr<overflow_recovery> sptr;
+
+        /*!
+         * Make the overflow recovery and start its thread.
+         * \param num_chans the number of channels
+         * \param recover the recovery for a channel (called in the thread)
+         */
+        overflow_recovery(size_t num_chans, const handle_overflow_t &recover):
+            _recover(recover),
+            _pending(num_chans, false),
+            _running(true),
+            _num_recoveries(0)
+        {
+            _thread_group.create_thread(boost::bind(&overflow_recovery::recover_loop, this));
+        }
+
+        ~overflow_recovery(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            _running = false;
+            lock.unlock();
+            _cond.notify_one();
+            _thread_group.join_all();
+        }
+
+        /*!
+         * Signal an overflow on a channel, does not block on the recovery.
+         * This is the handle overflow callable for the packet handler.
+         * \param chan the channel index
+         */
+        void operator()(size_t chan){
+            boost::mutex::scoped_lock lock(_mutex);
+            if (_pending.at(chan)) return;
+            _pending[chan] = true;
+            lock.unlock();
+            _cond.notify_one();
+        }
+
+        //! Get the number of recoveries done so far
+        size_t get_num_recoveries(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            return _num_recoveries;
+        }
+
+    private:
+        void recover_loop(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            while (true){
+                while (_running and std::find(_pending.begin(), _pending.end(), true) == _pending.end()){
+                    _cond.wait(lock);
+                }
+                if (not _running) return;
+
+                //recover the pending channels without the lock held
+                const std::vector<bool> pending = _pending;
+                std::fill(_pending.begin(), _pending.end(), false);
+                lock.unlock();
+                for (size_t chan = 0; chan < pending.size(); chan++){
+                    if (not pending[chan]) continue;
+                    try{
+                        _recover(chan);
+                    }catch(const std::exception &e){
+                        UHD_MSG(error) << "Error (overflow recovery): " << e.what() << std::endl;
+                    }
+                }
+                lock.lock();
+                _num_recoveries += size_t(std::count(pending.begin(), pending.end(), true));
+            }
+        }
+
+        const handle_overflow_t _recover;
+        boost::mutex _mutex;
+        boost::condition _cond;
+        std::vector<bool> _pending;
+        bool _running;
+        size_t _num_recoveries;
+        boost::thread_group _thread_group;
+    };
+
+/***********************************************************************
+ * Stream command state:
+ * The recovery re-issues the continuous stream command of a channel
+ * from its thread, while the user may issue a stream command at any time.
+ * The stream commands are issued with the lock held, and the recovery
+ * checks the state and re-issues with the lock held, so that a recovery
+ * can never follow a stop (the device would keep streaming).
+ **********************************************************************/
+    class stream_cmd_state : boost::noncopyable{
+    public:
+        stream_cmd_state(size_t num_chans): _continuous(num_chans, false){
+            /* NOP */
+        }
+
+        //! Get the lock held while issuing a stream command (until it was sent)
+        boost::mutex &get_mutex(void){
+            return _mutex;
+        }
+
+        //! Record the stream command of a channel (the caller holds the lock)
+        void set_continuous(size_t chan, bool continuous){
+            _continuous.at(chan) = continuous;
+        }
+
+        //! True when the channel streams continuously (the caller holds the lock)
+        bool is_continuous(size_t chan) const{
+            return _continuous.at(chan);
+        }
+
+    private:
+        boost::mutex _mutex;
+        std::vector<bool> _continuous;
+    };
+
+} //namespace vrt_packet_handler
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_VRT_OVERFLOW_RECOVERY_HPP */
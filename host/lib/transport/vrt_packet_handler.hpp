@@ -28,9 +28,13 @@
 #include <uhd/transport/vrt_if_packet.hpp>
 #include <uhd/convert.hpp>
 #include <uhd/transport/zero_copy.hpp>
+#include "../convert/convert_common.hpp"
 #include <boost/function.hpp>
+#include <boost/math/special_functions/round.hpp>
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 namespace vrt_packet_handler{
@@ -48,6 +52,66 @@ template <typename T> UHD_INLINE T get_context_code(
     return T(word0 & 0xff);
 }
 
+/***********************************************************************
+ * Tx async reports (big endian):
+ * The context word holds the sequence of the packet that the report
+ * refers to (the low 16 bits of its sequence) above the event code.
+ **********************************************************************/
+template <typename T> UHD_INLINE T get_context_code_be(
+    const boost::uint32_t *vrt_hdr,
+    const uhd::transport::vrt::if_packet_info_t &if_packet_info
+){
+    return T(uhd::ntohx(vrt_hdr[if_packet_info.num_header_words32]) & 0xffff);
+}
+
+UHD_INLINE boost::uint16_t get_context_seq_be(
+    const boost::uint32_t *vrt_hdr,
+    const uhd::transport::vrt::if_packet_info_t &if_packet_info
+){
+    return boost::uint16_t(uhd::ntohx(vrt_hdr[if_packet_info.num_header_words32]) >> 16);
+}
+
+/***********************************************************************
+ * Timestamps as integer ticks:
+ * The packet handler and alignment logic handle timestamps as 64-bit
+ * tick counts (seconds * tick rate + fractional ticks), which compare
+ * exactly and do not drift. A time_spec_t is only made or taken apart
+ * at the metadata boundary.
+ **********************************************************************/
+//! Get the number of ticks in one second (the tsf rolls over here)
+static UHD_INLINE boost::uint64_t get_ticks_per_sec(double tick_rate){
+    return boost::uint64_t(boost::math::llround(tick_rate));
+}
+
+//! Get the tick count of the integer and fractional timestamp fields
+static UHD_INLINE boost::uint64_t get_ticks(
+    const uhd::transport::vrt::if_packet_info_t &if_packet_info,
+    boost::uint64_t ticks_per_sec
+){
+    return if_packet_info.tsi*ticks_per_sec + if_packet_info.tsf;
+}
+
+//! Split a tick count into the integer and fractional timestamp fields
+static UHD_INLINE void set_ticks(
+    uhd::transport::vrt::if_packet_info_t &if_packet_info,
+    boost::uint64_t ticks, boost::uint64_t ticks_per_sec
+){
+    if_packet_info.tsi = boost::uint32_t(ticks/ticks_per_sec);
+    if_packet_info.tsf = ticks%ticks_per_sec;
+}
+
+//! Convert a tick count into a time spec
+static UHD_INLINE uhd::time_spec_t ticks_to_time_spec(boost::uint64_t ticks, double tick_rate){
+    const boost::uint64_t ticks_per_sec = get_ticks_per_sec(tick_rate);
+    return uhd::time_spec_t(time_t(ticks/ticks_per_sec), double(ticks%ticks_per_sec)/tick_rate);
+}
+
+//! Convert a time spec into a tick count (rounds to the nearest tick)
+static UHD_INLINE boost::uint64_t time_spec_to_ticks(const uhd::time_spec_t &time_spec, double tick_rate){
+    return boost::uint64_t(time_spec.get_full_secs())*get_ticks_per_sec(tick_rate)
+        + boost::uint64_t(boost::math::llround(time_spec.get_frac_secs()*tick_rate));
+}
+
 /***********************************************************************
  * vrt packet handler for recv
  **********************************************************************/
@@ -58,6 +122,28 @@ template <typename T> UHD_INLINE T get_context_code(
 
     static inline void handle_overflow_nop(size_t){}
 
+    /*!
+     * The sequence state of one receive channel:
+     * Remembers the last packet to detect gaps in the 4-bit sequence,
+     * and learns the ticks per sample from consecutive timestamps
+     * to count the samples lost in a gap.
+     */
+    struct sequence_state{
+        bool valid, has_ticks;
+        size_t next_packet_seq;
+        boost::uint64_t ticks, ticks_per_samp;
+        size_t nsamps;
+
+        sequence_state(void):
+            valid(false), has_ticks(false),
+            next_packet_seq(0),
+            ticks(0), ticks_per_samp(0),
+            nsamps(0)
+        {
+            /* NOP */
+        }
+    };
+
     struct recv_state{
         //width of the receiver in channels
         size_t width;
@@ -70,30 +156,123 @@ template <typename T> UHD_INLINE T get_context_code(
         std::vector<void *> io_buffs;
         std::vector<const void *> otw_buffs;
 
-        recv_state(size_t width = 1):
+        //state variables to handle sequence gaps
+        std::vector<sequence_state> sequences;
+        bool zero_fill;
+        size_t num_lost_packets, num_lost_samps;
+        bool has_gap_ticks; boost::uint64_t gap_ticks, gap_ticks_per_samp;
+        size_t num_fill_samps;
+        bool has_pending_gap, has_pending_metadata;
+        uhd::rx_metadata_t pending_metadata;
+
+        recv_state(size_t width = 1, bool zero_fill = false):
             width(width),
             managed_buffs(width),
             copy_buffs(width, NULL),
             size_of_copy_buffs(0),
             fragment_offset_in_samps(0),
-            io_buffs(0) //resized later
+            io_buffs(0), //resized later
+            sequences(width),
+            zero_fill(zero_fill),
+            num_lost_packets(0), num_lost_samps(0),
+            has_gap_ticks(false), gap_ticks(0), gap_ticks_per_samp(0),
+            num_fill_samps(0),
+            has_pending_gap(false), has_pending_metadata(false)
         {
             /* NOP */
         }
     };
 
+    /*******************************************************************
+     * Check the sequence number of a received packet for a gap.
+     *  - helper function for vrt_packet_handler::_recv1_helper
+     * The lost samples are counted from the timestamps when the
+     * result agrees with the 4-bit sequence gap, otherwise the
+     * size of the previous packet is used as an estimate.
+     ******************************************************************/
+    static UHD_INLINE void _recv1_check_sequence(
+        recv_state &state,
+        sequence_state &seq,
+        const uhd::transport::vrt::if_packet_info_t &if_packet_info,
+        boost::uint64_t ticks_per_sec,
+        size_t chans_per_otw_buff
+    ){
+        const size_t packet_seq = if_packet_info.packet_count & 0xf;
+        size_t seq_gap = (packet_seq - seq.next_packet_seq) & 0xf;
+        const bool was_valid = seq.valid;
+        seq.valid = true;
+        seq.next_packet_seq = (packet_seq + 1) & 0xf;
+
+        //a context packet breaks the timestamp chain, do not learn across it
+        if (if_packet_info.packet_type != uhd::transport::vrt::if_packet_info_t::PACKET_TYPE_DATA){
+            seq.has_ticks = false;
+            return;
+        }
+
+        const bool has_ticks = if_packet_info.has_tsi and if_packet_info.has_tsf;
+        const boost::uint64_t ticks = has_ticks? get_ticks(if_packet_info, ticks_per_sec) : 0;
+        const size_t nsamps = (if_packet_info.num_payload_words32*sizeof(boost::uint32_t))/OTW_BYTES_PER_SAMP/chans_per_otw_buff;
+        const bool can_use_ticks = has_ticks and seq.has_ticks and ticks > seq.ticks and seq.nsamps != 0;
+
+        //a packet split by the receive aligner repeats the sequence number,
+        //the pieces follow each other when the timestamps say so
+        if (seq_gap == 0xf and can_use_ticks and (seq.ticks_per_samp == 0 or
+            ticks == seq.ticks + seq.nsamps*seq.ticks_per_samp)
+        ) seq_gap = 0;
+
+        //consecutive packets: learn the ticks per sample
+        if (was_valid and seq_gap == 0){
+            if (can_use_ticks and (ticks - seq.ticks)%seq.nsamps == 0){
+                seq.ticks_per_samp = (ticks - seq.ticks)/seq.nsamps;
+            }
+        }
+
+        //a gap in the sequence: count the lost packets and samples
+        else if (was_valid){
+            size_t num_lost_packets = seq_gap, num_lost_samps = seq_gap*seq.nsamps;
+            const boost::uint64_t gap_ticks = seq.ticks + seq.nsamps*seq.ticks_per_samp;
+            const bool has_gap_ticks = can_use_ticks and seq.ticks_per_samp != 0 and ticks >= gap_ticks;
+            if (has_gap_ticks and (ticks - gap_ticks)%seq.ticks_per_samp == 0){
+                const boost::uint64_t ticks_lost_samps = (ticks - gap_ticks)/seq.ticks_per_samp;
+                const boost::uint64_t ticks_lost_packets = (ticks_lost_samps + seq.nsamps - 1)/seq.nsamps;
+                if ((ticks_lost_packets & 0xf) == seq_gap){
+                    num_lost_packets = size_t(ticks_lost_packets);
+                    num_lost_samps = size_t(ticks_lost_samps);
+                }
+            }
+
+            //keep the largest gap of all channels
+            if (num_lost_samps >= state.num_lost_samps){
+                state.num_lost_packets = num_lost_packets;
+                state.num_lost_samps = num_lost_samps;
+                state.has_gap_ticks = has_gap_ticks;
+                state.gap_ticks = gap_ticks;
+                state.gap_ticks_per_samp = seq.ticks_per_samp;
+            }
+        }
+
+        seq.has_ticks = has_ticks;
+        seq.ticks = ticks;
+        seq.nsamps = nsamps;
+    }
+
     /*******************************************************************
      * Unpack a received vrt header and set the copy buffer.
      *  - helper function for vrt_packet_handler::_recv1
      ******************************************************************/
+    template <typename vrt_unpacker_type>
     static UHD_INLINE void _recv1_helper(
         recv_state &state,
         uhd::rx_metadata_t &metadata,
         double tick_rate,
-        const vrt_unpacker_t &vrt_unpacker,
+        const vrt_unpacker_type &vrt_unpacker,
         const handle_overflow_t &handle_overflow,
-        size_t vrt_header_offset_words32
+        size_t vrt_header_offset_words32,
+        size_t chans_per_otw_buff
     ){
+        state.num_lost_packets = 0;
+        state.num_lost_samps = 0;
+
         //vrt unpack each managed buffer
         uhd::transport::vrt::if_packet_info_t if_packet_info;
         for (size_t i = 0; i < state.width; i++){
@@ -110,6 +289,12 @@ template <typename T> UHD_INLINE T get_context_code(
             if_packet_info.num_packet_words32 = num_packet_words32 - vrt_header_offset_words32;
             vrt_unpacker(vrt_hdr, if_packet_info);
 
+            //check for lost packets on this channel
+            _recv1_check_sequence(
+                state, state.sequences[i], if_packet_info,
+                get_ticks_per_sec(tick_rate), chans_per_otw_buff
+            );
+
             //handle the non-data packet case and parse its contents
             if (if_packet_info.packet_type != uhd::transport::vrt::if_packet_info_t::PACKET_TYPE_DATA){
 
@@ -132,8 +317,8 @@ template <typename T> UHD_INLINE T get_context_code(
 
         //store the last vrt info into the metadata
         metadata.has_time_spec = if_packet_info.has_tsi and if_packet_info.has_tsf;
-        metadata.time_spec = uhd::time_spec_t(
-            time_t(if_packet_info.tsi), size_t(if_packet_info.tsf), tick_rate
+        metadata.time_spec = ticks_to_time_spec(
+            get_ticks(if_packet_info, get_ticks_per_sec(tick_rate)), tick_rate
         );
         static const int tlr_sob_flags = (1 << 21) | (1 << 9); //enable and indicator bits
         metadata.start_of_burst = if_packet_info.has_tlr and (int(if_packet_info.tlr & tlr_sob_flags) == tlr_sob_flags);
@@ -141,28 +326,73 @@ template <typename T> UHD_INLINE T get_context_code(
         metadata.end_of_burst   = if_packet_info.has_tlr and (int(if_packet_info.tlr & tlr_eob_flags) == tlr_eob_flags);
     }
 
+    /*******************************************************************
+     * Fill the io buffers with zeros in place of lost samples.
+     *  - helper function for vrt_packet_handler::_recv1
+     ******************************************************************/
+    static UHD_INLINE size_t _recv1_fill(
+        recv_state &state,
+        const uhd::device::recv_buffs_type &buffs,
+        size_t offset_bytes,
+        size_t total_samps,
+        uhd::rx_metadata_t &metadata,
+        size_t bytes_per_io_samp,
+        double tick_rate
+    ){
+        const size_t nsamps_to_fill = std::min(total_samps, state.num_fill_samps);
+        for (size_t i = 0; i < buffs.size(); i++){
+            std::memset(reinterpret_cast<boost::uint8_t *>(buffs[i]) + offset_bytes, 0, nsamps_to_fill*bytes_per_io_samp);
+        }
+
+        metadata.has_time_spec = state.has_gap_ticks;
+        metadata.time_spec = ticks_to_time_spec(state.gap_ticks, tick_rate);
+        metadata.more_fragments = false;
+        metadata.fragment_offset = 0;
+        metadata.start_of_burst = false;
+        metadata.end_of_burst = false;
+
+        state.num_fill_samps -= nsamps_to_fill;
+        state.gap_ticks += nsamps_to_fill*state.gap_ticks_per_samp;
+        return nsamps_to_fill;
+    }
+
     /*******************************************************************
      * Recv data, unpack a vrt header, and copy-convert the data.
      *  - helper function for vrt_packet_handler::recv
      ******************************************************************/
+    template <typename converter_type, typename vrt_unpacker_type, typename get_recv_buffs_type>
     static UHD_INLINE size_t _recv1(
         recv_state &state,
         const uhd::device::recv_buffs_type &buffs,
         size_t offset_bytes,
         size_t total_samps,
         uhd::rx_metadata_t &metadata,
-        uhd::convert::function_type &converter,
+        const converter_type &converter,
+        size_t bytes_per_io_samp,
         double tick_rate,
-        const vrt_unpacker_t &vrt_unpacker,
-        const get_recv_buffs_t &get_recv_buffs,
+        const vrt_unpacker_type &vrt_unpacker,
+        const get_recv_buffs_type &get_recv_buffs,
         const handle_overflow_t &handle_overflow,
         size_t vrt_header_offset_words32,
         size_t chans_per_otw_buff
     ){
         metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_NONE;
+        metadata.num_lost_packets = 0;
+        metadata.num_lost_samps = 0;
+
+        //fill in zeros for the samples lost in a sequence gap
+        if (state.num_fill_samps != 0){
+            return _recv1_fill(state, buffs, offset_bytes, total_samps, metadata, bytes_per_io_samp, tick_rate);
+        }
+
+        //the packet after a sequence gap was received on a previous call
+        if (state.has_pending_metadata and not state.has_pending_gap){
+            state.has_pending_metadata = false;
+            metadata = state.pending_metadata;
+        }
 
         //perform a receive if no rx data is waiting to be copied
-        if (state.size_of_copy_buffs == 0){
+        else if (not state.has_pending_gap and state.size_of_copy_buffs == 0){
             state.fragment_offset_in_samps = 0;
             if (not get_recv_buffs(state.managed_buffs)){
                 metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
@@ -172,7 +402,8 @@ template <typename T> UHD_INLINE T get_context_code(
                 _recv1_helper(
                     state, metadata, tick_rate,
                     vrt_unpacker, handle_overflow,
-                    vrt_header_offset_words32
+                    vrt_header_offset_words32,
+                    chans_per_otw_buff
                 );
             }catch(const std::exception &e){
                 state.size_of_copy_buffs = 0; //reset copy buffs size
@@ -180,14 +411,44 @@ template <typename T> UHD_INLINE T get_context_code(
                 metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_BAD_PACKET;
                 return 0;
             }
+
+            //a sequence gap before the data packet:
+            //the packet is kept and delivered after the gap is reported
+            if (state.num_lost_packets != 0 and metadata.error_code == uhd::rx_metadata_t::ERROR_CODE_NONE){
+                state.has_pending_gap = true;
+                state.has_pending_metadata = true;
+                state.pending_metadata = metadata;
+            }
         }
         //defaults for the metadata when this is a fragment
-        else{
+        else if (not state.has_pending_gap){
             metadata.has_time_spec = false;
             metadata.start_of_burst = false;
             metadata.end_of_burst = false;
         }
 
+        //report a sequence gap with the lost packets and samples
+        if (state.has_pending_gap){
+            //a full buffer recv without zero fill ends before the gap, the next call reports it
+            if (offset_bytes != 0 and not state.zero_fill) return 0;
+            state.has_pending_gap = false;
+
+            metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_SEQUENCE_ERROR;
+            metadata.num_lost_packets = state.num_lost_packets;
+            metadata.num_lost_samps = state.num_lost_samps;
+            if (state.zero_fill and state.num_lost_samps != 0){
+                state.num_fill_samps = state.num_lost_samps;
+                return _recv1_fill(state, buffs, offset_bytes, total_samps, metadata, bytes_per_io_samp, tick_rate);
+            }
+            metadata.has_time_spec = state.has_gap_ticks;
+            metadata.time_spec = ticks_to_time_spec(state.gap_ticks, tick_rate);
+            metadata.more_fragments = false;
+            metadata.fragment_offset = 0;
+            metadata.start_of_burst = false;
+            metadata.end_of_burst = false;
+            return 0;
+        }
+
         //extract the number of samples available to copy
         size_t bytes_per_item = OTW_BYTES_PER_SAMP;
         size_t nsamps_available = state.size_of_copy_buffs/bytes_per_item;
@@ -221,29 +482,26 @@ template <typename T> UHD_INLINE T get_context_code(
 
     /*******************************************************************
      * Recv vrt packets and copy convert the samples into the buffer.
+     *  - helper function for the runtime and static recv
      ******************************************************************/
-    static UHD_INLINE size_t recv(
+    template <typename converter_type, typename vrt_unpacker_type, typename get_recv_buffs_type>
+    static UHD_INLINE size_t _recv(
         recv_state &state,
         const uhd::device::recv_buffs_type &buffs,
         const size_t total_num_samps,
         uhd::rx_metadata_t &metadata,
         uhd::device::recv_mode_t recv_mode,
-        const uhd::io_type_t &io_type,
-        const uhd::otw_type_t &otw_type,
+        const size_t bytes_per_io_samp,
+        const converter_type &converter,
         double tick_rate,
-        const vrt_unpacker_t &vrt_unpacker,
-        const get_recv_buffs_t &get_recv_buffs,
-        const handle_overflow_t &handle_overflow = &handle_overflow_nop,
-        size_t vrt_header_offset_words32 = 0,
-        size_t chans_per_otw_buff = 1
+        const vrt_unpacker_type &vrt_unpacker,
+        const get_recv_buffs_type &get_recv_buffs,
+        const handle_overflow_t &handle_overflow,
+        size_t vrt_header_offset_words32,
+        size_t chans_per_otw_buff
     ){
         state.io_buffs.resize(chans_per_otw_buff);
 
-        uhd::convert::function_type converter(
-            uhd::convert::get_converter_otw_to_cpu(
-                io_type, otw_type, 1, chans_per_otw_buff
-        ));
-
         switch(recv_mode){
 
         ////////////////////////////////////////////////////////////////
@@ -255,6 +513,7 @@ template <typename T> UHD_INLINE T get_context_code(
                 total_num_samps,
                 metadata,
                 converter,
+                bytes_per_io_samp,
                 tick_rate,
                 vrt_unpacker,
                 get_recv_buffs,
@@ -272,10 +531,11 @@ template <typename T> UHD_INLINE T get_context_code(
             while(accum_num_samps < total_num_samps){
                 size_t num_samps = _recv1(
                     state,
-                    buffs, accum_num_samps*io_type.size,
+                    buffs, accum_num_samps*bytes_per_io_samp,
                     total_num_samps - accum_num_samps,
                     (accum_num_samps == 0)? metadata : tmp_md, //only the first metadata gets kept
                     converter,
+                    bytes_per_io_samp,
                     tick_rate,
                     vrt_unpacker,
                     get_recv_buffs,
@@ -283,6 +543,12 @@ template <typename T> UHD_INLINE T get_context_code(
                     vrt_header_offset_words32,
                     chans_per_otw_buff
                 );
+                //zeros filled into a later part of the buffer: report the gap in the kept metadata
+                if (accum_num_samps != 0 and tmp_md.error_code == uhd::rx_metadata_t::ERROR_CODE_SEQUENCE_ERROR){
+                    metadata.error_code = tmp_md.error_code;
+                    metadata.num_lost_packets += tmp_md.num_lost_packets;
+                    metadata.num_lost_samps += tmp_md.num_lost_samps;
+                }
                 if (num_samps == 0) break; //had a recv timeout or error, break loop
                 accum_num_samps += num_samps;
             }
@@ -293,6 +559,37 @@ template <typename T> UHD_INLINE T get_context_code(
         }//switch(recv_mode)
     }
 
+    /*******************************************************************
+     * Recv vrt packets and copy convert the samples into the buffer.
+     ******************************************************************/
+    static UHD_INLINE size_t recv(
+        recv_state &state,
+        const uhd::device::recv_buffs_type &buffs,
+        const size_t total_num_samps,
+        uhd::rx_metadata_t &metadata,
+        uhd::device::recv_mode_t recv_mode,
+        const uhd::io_type_t &io_type,
+        const uhd::otw_type_t &otw_type,
+        double tick_rate,
+        const vrt_unpacker_t &vrt_unpacker,
+        const get_recv_buffs_t &get_recv_buffs,
+        const handle_overflow_t &handle_overflow = &handle_overflow_nop,
+        size_t vrt_header_offset_words32 = 0,
+        size_t chans_per_otw_buff = 1
+    ){
+        const uhd::convert::function_type &converter(
+            uhd::convert::get_converter_otw_to_cpu(
+                io_type, otw_type, 1, chans_per_otw_buff
+        ));
+
+        return _recv(
+            state, buffs, total_num_samps,
+            metadata, recv_mode, io_type.size, converter, tick_rate,
+            vrt_unpacker, get_recv_buffs, handle_overflow,
+            vrt_header_offset_words32, chans_per_otw_buff
+        );
+    }
+
 /***********************************************************************
  * vrt packet handler for send
  **********************************************************************/
@@ -302,12 +599,120 @@ template <typename T> UHD_INLINE T get_context_code(
 
     static const boost::uint64_t zeros = 0;
 
+    /*!
+     * A vrt header template for the send path:
+     * The vrt packer builds the header once for a set of header flags.
+     * Packets with the same flags copy the template words and patch
+     * the variable fields (count, size, burst flags, and timestamp).
+     * The endianness of the packer is detected while making the template,
+     * and a packer that cannot be templated is used directly instead.
+     */
+    struct send_hdr_template{
+        bool made, usable, swapped;
+        uhd::transport::vrt::if_packet_info_t info;
+        boost::uint32_t words[uhd::transport::vrt::max_if_hdr_words32];
+        size_t tsi_index, tsf_index;
+        size_t num_extra_words32; //header + trailer words
+
+        send_hdr_template(void): made(false), usable(false), swapped(false){
+            /* NOP */
+        }
+
+        //! Can this template pack a header with these flags?
+        UHD_INLINE bool matches(const uhd::transport::vrt::if_packet_info_t &if_packet_info) const{
+            return made and
+                info.packet_type == if_packet_info.packet_type and
+                info.has_sid == if_packet_info.has_sid and
+                info.has_cid == if_packet_info.has_cid and
+                info.has_tsi == if_packet_info.has_tsi and
+                info.has_tsf == if_packet_info.has_tsf and
+                info.has_tlr == if_packet_info.has_tlr and
+                (not info.has_sid or info.sid == if_packet_info.sid) and
+                (not info.has_cid or info.cid == if_packet_info.cid)
+            ;
+        }
+
+        //! Make the template for the flags in the packet info
+        template <typename vrt_packer_type> void make(
+            const vrt_packer_type &vrt_packer,
+            const uhd::transport::vrt::if_packet_info_t &if_packet_info
+        ){
+            made = true;
+            info = if_packet_info;
+            info.packet_count = 0;
+            info.sob = info.eob = false;
+            info.tsi = 0; info.tsf = 0;
+            vrt_packer(words, info);
+            num_extra_words32 = info.num_packet_words32 - info.num_payload_words32;
+            tsi_index = 1 + (info.has_sid? 1 : 0) + (info.has_cid? 2 : 0);
+            tsf_index = tsi_index + (info.has_tsi? 1 : 0);
+
+            //detect the endianness from the position of the packet count bits
+            uhd::transport::vrt::if_packet_info_t info1 = info;
+            boost::uint32_t words1[uhd::transport::vrt::max_if_hdr_words32];
+            info1.packet_count = 1;
+            vrt_packer(words1, info1);
+            const boost::uint32_t count_bits = words[0] ^ words1[0];
+            usable = count_bits == (1 << 16) or count_bits == uhd::byteswap(boost::uint32_t(1 << 16));
+            swapped = count_bits != (1 << 16);
+            if (not usable) return;
+
+            //verify the template against the packer with all variable fields set
+            info1.packet_count = 0xa;
+            info1.sob = info1.eob = true;
+            info1.tsi = 0x01234567;
+            info1.tsf = 0x0123456789abcdefull;
+            vrt_packer(words1, info1);
+            boost::uint32_t words2[uhd::transport::vrt::max_if_hdr_words32];
+            this->pack(words2, info1);
+            usable = std::equal(words1, words1 + info.num_header_words32, words2);
+        }
+
+        //! Pack a header by patching a copy of the template words
+        UHD_INLINE void pack(
+            boost::uint32_t *packet_buff,
+            uhd::transport::vrt::if_packet_info_t &if_packet_info
+        ) const{
+            if_packet_info.num_header_words32 = info.num_header_words32;
+            if_packet_info.num_packet_words32 = num_extra_words32 + if_packet_info.num_payload_words32;
+
+            //patch the header word: count, size, and burst flags
+            static const boost::uint32_t variable_mask = (0x3 << 24) | (0xf << 16) | 0xffff;
+            const boost::uint32_t hdr = (this->to_host(words[0]) & ~variable_mask)
+                | (if_packet_info.sob? (0x1 << 25) : 0)
+                | (if_packet_info.eob? (0x1 << 24) : 0)
+                | ((if_packet_info.packet_count & 0xf) << 16)
+                | (if_packet_info.num_packet_words32 & 0xffff)
+            ;
+            packet_buff[0] = this->to_otw(hdr);
+
+            //copy the constant words and patch the timestamp
+            for (size_t i = 1; i < info.num_header_words32; i++) packet_buff[i] = words[i];
+            if (info.has_tsi){
+                packet_buff[tsi_index] = this->to_otw(if_packet_info.tsi);
+            }
+            if (info.has_tsf){
+                packet_buff[tsf_index+0] = this->to_otw(boost::uint32_t(if_packet_info.tsf >> 32));
+                packet_buff[tsf_index+1] = this->to_otw(boost::uint32_t(if_packet_info.tsf >> 0));
+            }
+        }
+
+        UHD_INLINE boost::uint32_t to_host(boost::uint32_t word) const{
+            return swapped? uhd::byteswap(word) : word;
+        }
+
+        UHD_INLINE boost::uint32_t to_otw(boost::uint32_t word) const{
+            return swapped? uhd::byteswap(word) : word;
+        }
+    };
+
     struct send_state{
         //init the expected seq number
         size_t next_packet_seq;
         managed_send_buffs_t managed_buffs;
         std::vector<const void *> zero_buffs;
         std::vector<const void *> io_buffs;
+        send_hdr_template hdr_template;
 
         send_state(size_t width = 1):
             next_packet_seq(0),
@@ -319,19 +724,76 @@ template <typename T> UHD_INLINE T get_context_code(
         }
     };
 
+    /*!
+     * A send buffer that can send the payload from the io memory:
+     * The buffer holds the header, and a gathered commit sends the header
+     * and the payload as one packet, without copying the payload in.
+     */
+    class gather_send_buffer : public uhd::transport::managed_send_buffer{
+    public:
+        /*!
+         * Send the header in this buffer and the payload in the io memory.
+         * The io memory may be reused when the call returns.
+         * \param hdr_bytes the bytes written into this buffer
+         * \param payload the payload in the io memory
+         * \param payload_bytes the bytes of the payload
+         */
+        virtual void commit_gather(size_t hdr_bytes, const void *payload, size_t payload_bytes) = 0;
+    };
+
+    //! The marker converter of io buffers already in the otw format (sent with a gathered commit)
+    struct gather_converter{
+        static const size_t chans_per_otw_buff = 1;
+    };
+
+    /*******************************************************************
+     * Fill the payload of a packet and commit it.
+     *  - helper function for vrt_packet_handler::_send1
+     ******************************************************************/
+    template <typename converter_type>
+    static UHD_INLINE void _commit_payload(
+        uhd::transport::managed_send_buffer &buff,
+        const converter_type &converter,
+        const std::vector<const void *> &io_buffs,
+        boost::uint32_t *payload_mem,
+        const size_t num_samps,
+        const size_t hdr_bytes,
+        const size_t payload_bytes
+    ){
+        //copy-convert the samples into the send buffer
+        converter(io_buffs, payload_mem, num_samps);
+
+        //commit the samples to the zero-copy interface
+        buff.commit(hdr_bytes + payload_bytes);
+    }
+
+    static UHD_INLINE void _commit_payload(
+        uhd::transport::managed_send_buffer &buff,
+        const gather_converter &,
+        const std::vector<const void *> &io_buffs,
+        boost::uint32_t *,
+        const size_t,
+        const size_t hdr_bytes,
+        const size_t payload_bytes
+    ){
+        //send the header with the payload in the io buffer
+        static_cast<gather_send_buffer &>(buff).commit_gather(hdr_bytes, io_buffs[0], payload_bytes);
+    }
+
     /*******************************************************************
      * Pack a vrt header, copy-convert the data, and send it.
      *  - helper function for vrt_packet_handler::send
      ******************************************************************/
+    template <typename converter_type, typename vrt_packer_type, typename get_send_buffs_type>
     static UHD_INLINE size_t _send1(
         send_state &state,
         const uhd::device::send_buffs_type &buffs,
         const size_t offset_bytes,
         const size_t num_samps,
         uhd::transport::vrt::if_packet_info_t &if_packet_info,
-        uhd::convert::function_type &converter,
-        const vrt_packer_t &vrt_packer,
-        const get_send_buffs_t &get_send_buffs,
+        const converter_type &converter,
+        const vrt_packer_type &vrt_packer,
+        const get_send_buffs_type &get_send_buffs,
         const size_t vrt_header_offset_words32,
         const size_t chans_per_otw_buff
     ){
@@ -342,6 +804,11 @@ template <typename T> UHD_INLINE T get_context_code(
         //get send buffers for each otw channel
         if (not get_send_buffs(state.managed_buffs)) return 0;
 
+        //remake the header template when the header flags change
+        if (not state.hdr_template.matches(if_packet_info)){
+            state.hdr_template.make(vrt_packer, if_packet_info);
+        }
+
         for (size_t i = 0; i < buffs.size(); i+=chans_per_otw_buff){
             //calculate pointers with offsets to io and otw memory
             for (size_t j = 0; j < chans_per_otw_buff; j++){
@@ -350,15 +817,16 @@ template <typename T> UHD_INLINE T get_context_code(
             boost::uint32_t *otw_mem = state.managed_buffs[i]->cast<boost::uint32_t *>() + vrt_header_offset_words32;
 
             //pack metadata into a vrt header
-            vrt_packer(otw_mem, if_packet_info);
+            if (state.hdr_template.usable) state.hdr_template.pack(otw_mem, if_packet_info);
+            else vrt_packer(otw_mem, if_packet_info);
             otw_mem += if_packet_info.num_header_words32;
 
-            //copy-convert the samples into the send buffer
-            converter(state.io_buffs, otw_mem, num_samps);
-
-            //commit the samples to the zero-copy interface
-            size_t num_bytes_total = (vrt_header_offset_words32+if_packet_info.num_packet_words32)*sizeof(boost::uint32_t);
-            state.managed_buffs[i]->commit(num_bytes_total);
+            //fill in the samples and commit them to the zero-copy interface
+            _commit_payload(
+                *state.managed_buffs[i], converter, state.io_buffs, otw_mem, num_samps,
+                (vrt_header_offset_words32+if_packet_info.num_header_words32)*sizeof(boost::uint32_t),
+                if_packet_info.num_payload_words32*sizeof(boost::uint32_t)
+            );
         }
         state.next_packet_seq++; //increment sequence after commits
         return num_samps;
@@ -366,36 +834,36 @@ template <typename T> UHD_INLINE T get_context_code(
 
     /*******************************************************************
      * Send vrt packets and copy convert the samples into the buffer.
+     *  - helper function for the runtime and static send
      ******************************************************************/
-    static UHD_INLINE size_t send(
+    template <typename converter_type, typename vrt_packer_type, typename get_send_buffs_type>
+    static UHD_INLINE size_t _send(
         send_state &state,
         const uhd::device::send_buffs_type &buffs,
         const size_t total_num_samps,
         const uhd::tx_metadata_t &metadata,
         uhd::device::send_mode_t send_mode,
-        const uhd::io_type_t &io_type,
-        const uhd::otw_type_t &otw_type,
+        const size_t bytes_per_io_samp,
+        const converter_type &converter,
         double tick_rate,
-        const vrt_packer_t &vrt_packer,
-        const get_send_buffs_t &get_send_buffs,
+        const vrt_packer_type &vrt_packer,
+        const get_send_buffs_type &get_send_buffs,
         size_t max_samples_per_packet,
-        size_t vrt_header_offset_words32 = 0,
-        size_t chans_per_otw_buff = 1
+        size_t vrt_header_offset_words32,
+        size_t chans_per_otw_buff
     ){
         state.io_buffs.resize(chans_per_otw_buff);
 
-        uhd::convert::function_type converter(
-            uhd::convert::get_converter_cpu_to_otw(
-                io_type, otw_type, chans_per_otw_buff, 1
-        ));
-
         //translate the metadata to vrt if packet info
         uhd::transport::vrt::if_packet_info_t if_packet_info;
+        if_packet_info.packet_type = uhd::transport::vrt::if_packet_info_t::PACKET_TYPE_DATA;
         if_packet_info.has_sid = false;
         if_packet_info.has_cid = false;
         if_packet_info.has_tlr = false;
-        if_packet_info.tsi = boost::uint32_t(metadata.time_spec.get_full_secs());
-        if_packet_info.tsf = boost::uint64_t(metadata.time_spec.get_tick_count(tick_rate));
+        set_ticks(
+            if_packet_info, time_spec_to_ticks(metadata.time_spec, tick_rate),
+            get_ticks_per_sec(tick_rate)
+        );
 
         if (total_num_samps <= max_samples_per_packet) send_mode = uhd::device::SEND_MODE_ONE_PACKET;
         switch(send_mode){
@@ -446,7 +914,7 @@ template <typename T> UHD_INLINE T get_context_code(
                 //send the fragment with the helper function
                 const size_t num_samps_sent = _send1(
                     state,
-                    buffs, total_num_samps_sent*io_type.size,
+                    buffs, total_num_samps_sent*bytes_per_io_samp,
                     std::min(total_num_samps_unsent, max_samples_per_packet),
                     if_packet_info,
                     converter,
@@ -465,6 +933,248 @@ template <typename T> UHD_INLINE T get_context_code(
         }//switch(send_mode)
     }
 
+    /*******************************************************************
+     * Send vrt packets and copy convert the samples into the buffer.
+     ******************************************************************/
+    static UHD_INLINE size_t send(
+        send_state &state,
+        const uhd::device::send_buffs_type &buffs,
+        const size_t total_num_samps,
+        const uhd::tx_metadata_t &metadata,
+        uhd::device::send_mode_t send_mode,
+        const uhd::io_type_t &io_type,
+        const uhd::otw_type_t &otw_type,
+        double tick_rate,
+        const vrt_packer_t &vrt_packer,
+        const get_send_buffs_t &get_send_buffs,
+        size_t max_samples_per_packet,
+        size_t vrt_header_offset_words32 = 0,
+        size_t chans_per_otw_buff = 1
+    ){
+        const uhd::convert::function_type &converter(
+            uhd::convert::get_converter_cpu_to_otw(
+                io_type, otw_type, chans_per_otw_buff, 1
+        ));
+
+        return _send(
+            state, buffs, total_num_samps,
+            metadata, send_mode, io_type.size, converter, tick_rate,
+            vrt_packer, get_send_buffs, max_samples_per_packet,
+            vrt_header_offset_words32, chans_per_otw_buff
+        );
+    }
+
+/***********************************************************************
+ * Compile-time specialized packet handler:
+ * The transport, the vrt header codec, and the converter are template
+ * parameters instead of boost::function objects, so that the calls
+ * made for every packet and channel are direct and may be inlined.
+ * The runtime recv and send above remain the fallback for
+ * configurations without a specialization.
+ **********************************************************************/
+    //! The vrt header codec and item byte order of a big endian transport
+    struct vrt_codec_be{
+        static UHD_INLINE void unpack(const boost::uint32_t *packet_buff, uhd::transport::vrt::if_packet_info_t &if_packet_info){
+            uhd::transport::vrt::if_hdr_unpack_be(packet_buff, if_packet_info);
+        }
+        static UHD_INLINE void pack(boost::uint32_t *packet_buff, uhd::transport::vrt::if_packet_info_t &if_packet_info){
+            uhd::transport::vrt::if_hdr_pack_be(packet_buff, if_packet_info);
+        }
+        static UHD_INLINE boost::uint32_t to_host(boost::uint32_t item){return uhd::ntohx(item);}
+        static UHD_INLINE boost::uint32_t to_otw(boost::uint32_t item){return uhd::htonx(item);}
+        static const bool big_endian = true;
+    };
+
+    //! The vrt header codec and item byte order of a little endian transport
+    struct vrt_codec_le{
+        static UHD_INLINE void unpack(const boost::uint32_t *packet_buff, uhd::transport::vrt::if_packet_info_t &if_packet_info){
+            uhd::transport::vrt::if_hdr_unpack_le(packet_buff, if_packet_info);
+        }
+        static UHD_INLINE void pack(boost::uint32_t *packet_buff, uhd::transport::vrt::if_packet_info_t &if_packet_info){
+            uhd::transport::vrt::if_hdr_pack_le(packet_buff, if_packet_info);
+        }
+        #ifdef BOOST_BIG_ENDIAN
+        static UHD_INLINE boost::uint32_t to_host(boost::uint32_t item){return uhd::byteswap(item);}
+        static UHD_INLINE boost::uint32_t to_otw(boost::uint32_t item){return uhd::byteswap(item);}
+        #else
+        static UHD_INLINE boost::uint32_t to_host(boost::uint32_t item){return item;}
+        static UHD_INLINE boost::uint32_t to_otw(boost::uint32_t item){return item;}
+        #endif
+        static const bool big_endian = false;
+    };
+
+    //! Convert between the item32 otw type and the cpu types
+    static UHD_INLINE void item32_to_cpu(item32_t item, sc16_t &num){num = item32_to_sc16(item);}
+    static UHD_INLINE item32_t cpu_to_item32(const sc16_t &num){return sc16_to_item32(num);}
+
+    /*!
+     * An inline item32 converter:
+     * Converts one otw buffer to/from width io buffers
+     * (the channels of an otw buffer are interleaved item by item).
+     */
+    template <typename vrt_codec_type, typename cpu_type, size_t width = 1> struct item32_converter{
+        static const size_t chans_per_otw_buff = width;
+
+        UHD_INLINE void operator()(const void *input, const std::vector<void *> &outputs, size_t nsamps) const{
+            const item32_t *items = reinterpret_cast<const item32_t *>(input);
+            for (size_t w = 0; w < width; w++){
+                cpu_type *samps = reinterpret_cast<cpu_type *>(outputs[w]);
+                for (size_t i = 0; i < nsamps; i++) item32_to_cpu(vrt_codec_type::to_host(items[i*width + w]), samps[i]);
+            }
+        }
+
+        UHD_INLINE void operator()(const std::vector<const void *> &inputs, void *output, size_t nsamps) const{
+            item32_t *items = reinterpret_cast<item32_t *>(output);
+            for (size_t w = 0; w < width; w++){
+                const cpu_type *samps = reinterpret_cast<const cpu_type *>(inputs[w]);
+                for (size_t i = 0; i < nsamps; i++) items[i*width + w] = vrt_codec_type::to_otw(cpu_to_item32(samps[i]));
+            }
+        }
+    };
+
+    /*!
+     * A converter that calls the registered converter kernel directly:
+     * Keeps the simd kernels registered for a type (ex: fc32 with sse2),
+     * but looks up the kernel once and calls it without boost::function.
+     */
+    template <typename vrt_codec_type, uhd::io_type_t::tid_t tid, size_t width = 1> struct kernel_converter{
+        static const size_t chans_per_otw_buff = width;
+        typedef void (*kernel_type)(const uhd::convert::input_type &, const uhd::convert::output_type &, size_t);
+
+        static kernel_type get_kernel(const uhd::convert::function_type &fcn){
+            const kernel_type *kernel = fcn.template target<kernel_type>();
+            UHD_ASSERT_THROW(kernel != NULL);
+            return *kernel;
+        }
+
+        static uhd::otw_type_t get_otw_type(void){
+            uhd::otw_type_t otw_type;
+            otw_type.width = 16;
+            otw_type.shift = 0;
+            otw_type.byteorder = vrt_codec_type::big_endian? uhd::otw_type_t::BO_BIG_ENDIAN : uhd::otw_type_t::BO_LITTLE_ENDIAN;
+            return otw_type;
+        }
+
+        UHD_INLINE void operator()(const void *input, const std::vector<void *> &outputs, size_t nsamps) const{
+            static const kernel_type kernel = get_kernel(uhd::convert::get_converter_otw_to_cpu(tid, get_otw_type(), 1, width));
+            kernel(input, outputs, nsamps);
+        }
+
+        UHD_INLINE void operator()(const std::vector<const void *> &inputs, void *output, size_t nsamps) const{
+            static const kernel_type kernel = get_kernel(uhd::convert::get_converter_cpu_to_otw(tid, get_otw_type(), width, 1));
+            kernel(inputs, output, nsamps);
+        }
+    };
+
+    /*!
+     * A copy converter for io buffers already in the otw format:
+     * The io items are big endian item32s (the usrp2 wire format),
+     * copied as is for a big endian transport, and swapped for a little endian one.
+     */
+    template <typename vrt_codec_type> struct copy_converter{
+        static const size_t chans_per_otw_buff = 1;
+
+        UHD_INLINE void operator()(const void *input, const std::vector<void *> &outputs, size_t nsamps) const{
+            if (vrt_codec_type::big_endian){
+                std::memcpy(outputs[0], input, nsamps*sizeof(item32_t));
+                return;
+            }
+            const item32_t *items = reinterpret_cast<const item32_t *>(input);
+            item32_t *samps = reinterpret_cast<item32_t *>(outputs[0]);
+            for (size_t i = 0; i < nsamps; i++) samps[i] = uhd::htonx(vrt_codec_type::to_host(items[i]));
+        }
+
+        UHD_INLINE void operator()(const std::vector<const void *> &inputs, void *output, size_t nsamps) const{
+            if (vrt_codec_type::big_endian){
+                std::memcpy(output, inputs[0], nsamps*sizeof(item32_t));
+                return;
+            }
+            const item32_t *samps = reinterpret_cast<const item32_t *>(inputs[0]);
+            item32_t *items = reinterpret_cast<item32_t *>(output);
+            for (size_t i = 0; i < nsamps; i++) items[i] = vrt_codec_type::to_otw(uhd::ntohx(samps[i]));
+        }
+    };
+
+    //! The converter for a cpu type and width: inline for sc16, the registered kernel for fc32
+    template <typename vrt_codec_type, typename cpu_type, size_t width = 1> struct static_converter{
+        typedef item32_converter<vrt_codec_type, cpu_type, width> type;
+    };
+
+    template <typename vrt_codec_type, size_t width> struct static_converter<vrt_codec_type, fc32_t, width>{
+        typedef kernel_converter<vrt_codec_type, uhd::io_type_t::COMPLEX_FLOAT32, width> type;
+    };
+
+    //! Calls the get buffs methods of a transport type directly
+    template <typename transport_type> struct transport_buffs{
+        transport_type &transport;
+        transport_buffs(transport_type &transport): transport(transport){}
+        UHD_INLINE bool operator()(managed_recv_buffs_t &buffs) const{return transport.get_recv_buffs(buffs);}
+        UHD_INLINE bool operator()(managed_send_buffs_t &buffs) const{return transport.get_send_buffs(buffs);}
+    };
+
+    //! Calls the unpack and pack functions of a vrt header codec directly
+    template <typename vrt_codec_type> struct vrt_codec_fcns{
+        UHD_INLINE void operator()(const boost::uint32_t *packet_buff, uhd::transport::vrt::if_packet_info_t &if_packet_info) const{
+            vrt_codec_type::unpack(packet_buff, if_packet_info);
+        }
+        UHD_INLINE void operator()(boost::uint32_t *packet_buff, uhd::transport::vrt::if_packet_info_t &if_packet_info) const{
+            vrt_codec_type::pack(packet_buff, if_packet_info);
+        }
+    };
+
+    /*!
+     * A packet handler specialized for a vrt header codec and a cpu type.
+     * The transport type must have get_recv_buffs and get_send_buffs methods.
+     * Each otw buffer carries the converter's chans_per_otw_buff channels
+     * (ex: static_converter<vrt_codec_type, cpu_type, 2>::type for 2 channels,
+     * the registered converters go up to 4 channels per otw buffer).
+     */
+    template <
+        typename vrt_codec_type, typename cpu_type,
+        typename converter_type = typename static_converter<vrt_codec_type, cpu_type>::type
+    > struct static_handler{
+
+        template <typename transport_type> static UHD_INLINE size_t recv(
+            recv_state &state,
+            const uhd::device::recv_buffs_type &buffs,
+            const size_t total_num_samps,
+            uhd::rx_metadata_t &metadata,
+            uhd::device::recv_mode_t recv_mode,
+            double tick_rate,
+            transport_type &transport,
+            const handle_overflow_t &handle_overflow = &handle_overflow_nop,
+            size_t vrt_header_offset_words32 = 0
+        ){
+            return _recv(
+                state, buffs, total_num_samps,
+                metadata, recv_mode, sizeof(cpu_type),
+                converter_type(), tick_rate,
+                vrt_codec_fcns<vrt_codec_type>(), transport_buffs<transport_type>(transport),
+                handle_overflow, vrt_header_offset_words32, converter_type::chans_per_otw_buff
+            );
+        }
+
+        template <typename transport_type> static UHD_INLINE size_t send(
+            send_state &state,
+            const uhd::device::send_buffs_type &buffs,
+            const size_t total_num_samps,
+            const uhd::tx_metadata_t &metadata,
+            uhd::device::send_mode_t send_mode,
+            double tick_rate,
+            transport_type &transport,
+            size_t max_samples_per_packet,
+            size_t vrt_header_offset_words32 = 0
+        ){
+            return _send(
+                state, buffs, total_num_samps,
+                metadata, send_mode, sizeof(cpu_type),
+                converter_type(), tick_rate,
+                vrt_codec_fcns<vrt_codec_type>(), transport_buffs<transport_type>(transport),
+                max_samples_per_packet, vrt_header_offset_words32, converter_type::chans_per_otw_buff
+            );
+        }
+    };
+
 } //namespace vrt_packet_handler
 
 #endif /* INCLUDED_LIBUHD_TRANSPORT_VRT_PACKET_HANDLER_HPP */
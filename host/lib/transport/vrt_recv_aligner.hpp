@@ -0,0 +1,429 @@
+//
+// Copyright 2010-2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_VRT_RECV_ALIGNER_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_VRT_RECV_ALIGNER_HPP
+
+#include "vrt_packet_handler.hpp"
+#include <uhd/exception.hpp>
+#include <uhd/transport/zero_copy.hpp>
+#include <uhd/transport/vrt_if_packet.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/foreach.hpp>
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace vrt_packet_handler{
+
+/***********************************************************************
+ * Multi-channel receive alignment:
+ * Each channel has a small queue of received packets, keyed by the
+ * integer tick timestamp of the first sample not yet handed out.
+ * The queue heads are aligned on the newest head timestamp:
+ *  - a head that ends before that timestamp is dropped,
+ *  - a head that straddles that timestamp is trimmed to the sample,
+ *  - heads of unequal length are split, so that every channel
+ *    hands out the same span of samples.
+ * Aligned whole packets are passed through untouched, trimmed and
+ * split packets are copied into piece buffers from a pool.
+ * A piece handed out keeps the pool alive, so that it may outlive
+ * the aligner, and it may be released in any thread.
+ *
+ * The ticks per sample of a channel are learned from consecutive
+ * packets; until they are known, the aligner can only drop whole packets.
+ *
+ * A timestamp that goes backwards (ex: the time was set) starts a new
+ * epoch, the packets of older epochs are dropped. The epochs are shared
+ * by the channels, a channel that did not stream before the time was set
+ * never sees its timestamps go backwards:
+ *  - the first packet of a channel joins the newest epoch, or starts
+ *    a new one when it is more than a second behind that epoch,
+ *  - a channel that streams on an older epoch for more than a second
+ *    missed the time set and joins the newest epoch.
+ **********************************************************************/
+    template <typename vrt_codec_type> class recv_aligner{
+    public:
+        /*!
+         * Make a new receive aligner.
+         * \param width the number of channels
+         * \param ticks_per_sec the ticks per second of the timestamps
+         * \param queue_depth the packets queued per channel (at least 2)
+         */
+        recv_aligner(size_t width = 1, boost::uint64_t ticks_per_sec = 1, size_t queue_depth = 2):
+            _ticks_per_sec(ticks_per_sec),
+            _channels(width, channel_t(std::max<size_t>(queue_depth, 2))),
+            _epoch(0), _epoch_ticks(0),
+            _num_dropped_samps(0), _num_seq_gaps(0),
+            _pieces(new piece_pool())
+        {
+            /* NOP */
+        }
+
+        /*!
+         * Get an aligned set of buffers, one buffer per channel.
+         * A message (non-data) packet is handed out alone,
+         * the buffers of the other channels are set to NULL.
+         * \param buffs the managed buffers to fill
+         * \param get_buff a callable: managed_recv_buffer::sptr(size_t chan, double timeout)
+         * \param timeout the timeout in seconds
+         * \return false on timeout (the queued packets are kept)
+         */
+        template <typename get_buff_type> bool get_recv_buffs(
+            managed_recv_buffs_t &buffs, const get_buff_type &get_buff, double timeout
+        ){
+            UHD_ASSERT_THROW(buffs.size() == _channels.size());
+            const boost::system_time exit_time = boost::get_system_time() + boost::posix_time::microseconds(long(timeout*1e6));
+
+            while (true){
+                //load a packet into the head of every queue
+                for (size_t i = 0; i < _channels.size(); i++){
+                    if (_channels[i].queue.empty() and not pull(i, get_buff, exit_time)) return false;
+                }
+
+                //a message packet is handed out alone
+                for (size_t i = 0; i < _channels.size(); i++){
+                    if (_channels[i].queue.front().data) continue;
+                    for (size_t j = 0; j < buffs.size(); j++) buffs[j].reset();
+                    buffs[i] = _channels[i].queue.front().buff;
+                    _channels[i].queue.pop();
+                    return true;
+                }
+
+                //the target is the newest head of the newest epoch
+                size_t target_epoch = 0;
+                boost::uint64_t target_ticks = 0;
+                for (size_t i = 0; i < _channels.size(); i++){
+                    const packet_t &head = _channels[i].queue.front();
+                    if (i == 0 or head.epoch > target_epoch or (head.epoch == target_epoch and head.ticks > target_ticks)){
+                        target_epoch = head.epoch;
+                        target_ticks = head.ticks;
+                    }
+                }
+
+                //bring every head to the target, count the aligned heads
+                size_t num_aligned = 0;
+                for (size_t i = 0; i < _channels.size(); i++){
+                    channel_t &chan = _channels[i];
+                    const bool same_epoch = chan.queue.front().epoch == target_epoch;
+                    const boost::uint64_t behind = same_epoch? target_ticks - chan.queue.front().ticks : 0;
+                    if (same_epoch and (behind == 0 or 2*behind < chan.ticks_per_samp)){
+                        num_aligned++; continue;
+                    }
+
+                    //learn the ticks per sample from the next packet before giving up on a trim
+                    if (same_epoch and chan.ticks_per_samp == 0 and chan.queue.size() == 1){
+                        if (not pull(i, get_buff, exit_time)) return false;
+                    }
+
+                    //a channel streaming on an older epoch for a second missed the time set
+                    if (not same_epoch and chan.queue.front().ticks != 0){
+                        const boost::uint64_t ticks = chan.queue.front().ticks;
+                        if (not chan.has_stale_ticks){
+                            chan.has_stale_ticks = true;
+                            chan.stale_ticks = ticks;
+                        }
+                        else if (ticks > chan.stale_ticks and ticks - chan.stale_ticks > _ticks_per_sec){
+                            set_epoch(chan, target_epoch);
+                            continue;
+                        }
+                    }
+
+                    //drop the head when it cannot be trimmed to the target
+                    packet_t &head = chan.queue.front();
+                    const boost::uint64_t nsamps_behind = (chan.ticks_per_samp == 0)? head.remaining() :
+                        (behind + chan.ticks_per_samp/2)/chan.ticks_per_samp;
+                    if (not same_epoch or nsamps_behind >= head.remaining()){
+                        _num_dropped_samps += head.remaining();
+                        chan.queue.pop();
+                        continue;
+                    }
+
+                    //trim the head to the sample
+                    head.offset += size_t(nsamps_behind);
+                    head.ticks += nsamps_behind*chan.ticks_per_samp;
+                    _num_dropped_samps += size_t(nsamps_behind);
+                    num_aligned++;
+                }
+                if (num_aligned != _channels.size()) continue;
+
+                //hand out the same span of samples on every channel
+                size_t nsamps = _channels.front().queue.front().remaining();
+                for (size_t i = 1; i < _channels.size(); i++){
+                    nsamps = std::min(nsamps, _channels[i].queue.front().remaining());
+                }
+
+                //learn the ticks per sample from the next packet before a split
+                for (size_t i = 0; i < _channels.size(); i++){
+                    channel_t &chan = _channels[i];
+                    if (chan.ticks_per_samp != 0 or chan.queue.size() != 1 or chan.queue.front().remaining() == nsamps) continue;
+                    if (not pull(i, get_buff, exit_time)) return false;
+                }
+                for (size_t i = 0; i < _channels.size(); i++){
+                    buffs[i] = take(_channels[i], nsamps);
+                }
+                return true;
+            }
+        }
+
+        //! Get the number of samples dropped to align the channels (total)
+        size_t get_num_dropped_samps(void) const{
+            return _num_dropped_samps;
+        }
+
+        //! Get the number of gaps in the received packet sequences (total)
+        size_t get_num_seq_gaps(void) const{
+            return _num_seq_gaps;
+        }
+
+    private:
+        //! A received packet and the part of it not yet handed out
+        struct packet_t{
+            uhd::transport::managed_recv_buffer::sptr buff;
+            uhd::transport::vrt::if_packet_info_t info;
+            bool data;
+            size_t epoch;
+            boost::uint64_t ticks; //ticks of the first sample not yet handed out
+            size_t offset, nsamps; //first sample not yet handed out, samples in the packet
+            size_t remaining(void) const{return nsamps - offset;}
+        };
+
+        //! A fixed capacity ring of packets (no allocations in the fast path)
+        class packet_queue{
+        public:
+            packet_queue(size_t depth): _packets(depth), _head(0), _size(0){}
+            bool empty(void) const{return _size == 0;}
+            size_t size(void) const{return _size;}
+            packet_t &at(size_t i){return _packets[(_head + i)%_packets.size()];}
+            packet_t &front(void){return _packets[_head];}
+            const packet_t &front(void) const{return _packets[_head];}
+            void push(const packet_t &packet){
+                UHD_ASSERT_THROW(_size < _packets.size());
+                _packets[(_head + _size++)%_packets.size()] = packet;
+            }
+            void pop(void){
+                _packets[_head].buff.reset(); //release the buffer now
+                _head = (_head + 1)%_packets.size();
+                _size--;
+            }
+        private:
+            std::vector<packet_t> _packets;
+            size_t _head, _size;
+        };
+
+        class piece_pool;
+
+        //! Memory for a trimmed or split packet (back to the pool once released)
+        class piece_buffer : public uhd::transport::managed_recv_buffer{
+        public:
+            piece_buffer(void): num_words32(0){_ref_count.write(0);}
+            void release(void){
+                boost::shared_ptr<piece_pool> pool;
+                pool.swap(this->pool); //the pool may go with the last piece
+                pool->put(this);
+            }
+            std::vector<boost::uint32_t> mem;
+            size_t num_words32;
+            boost::shared_ptr<piece_pool> pool; //held while handed out
+        private:
+            const void *get_buff(void) const{return &mem.front();}
+            size_t get_size(void) const{return num_words32*sizeof(boost::uint32_t);}
+        };
+
+        //! The free piece buffers (shared by the aligner and the pieces handed out)
+        class piece_pool : public boost::enable_shared_from_this<piece_pool>, boost::noncopyable{
+        public:
+            ~piece_pool(void){
+                BOOST_FOREACH(piece_buffer *piece, _free) delete piece;
+            }
+
+            piece_buffer *get(void){
+                boost::mutex::scoped_lock lock(_mutex);
+                piece_buffer *piece = NULL;
+                if (_free.empty()) piece = new piece_buffer();
+                else{
+                    piece = _free.back();
+                    _free.pop_back();
+                }
+                lock.unlock();
+                piece->pool = this->shared_from_this();
+                return piece;
+            }
+
+            void put(piece_buffer *piece){
+                boost::mutex::scoped_lock lock(_mutex);
+                _free.push_back(piece);
+            }
+
+        private:
+            std::vector<piece_buffer *> _free;
+            boost::mutex _mutex;
+        };
+
+        struct channel_t{
+            packet_queue queue;
+            size_t epoch;
+            boost::uint64_t ticks_per_samp; //zero when not yet known
+
+            //the first dropped packet of an older epoch (since the last epoch change)
+            bool has_stale_ticks; boost::uint64_t stale_ticks;
+
+            //the last packet pulled (sequence and timestamp history)
+            bool has_last_seq; size_t last_seq; bool last_data;
+            bool has_last_ticks; boost::uint64_t last_ticks; size_t last_nsamps;
+
+            channel_t(size_t queue_depth):
+                queue(queue_depth), epoch(0), ticks_per_samp(0),
+                has_stale_ticks(false), stale_ticks(0),
+                has_last_seq(false), last_seq(0), last_data(false),
+                has_last_ticks(false), last_ticks(0), last_nsamps(0)
+            {
+                /* NOP */
+            }
+        };
+
+        /*******************************************************************
+         * Pull a packet from the transport into the queue of a channel:
+         * Counts the sequence gaps, starts a new epoch when the timestamp
+         * goes backwards, and learns the ticks per sample.
+         ******************************************************************/
+        template <typename get_buff_type> bool pull(
+            size_t index, const get_buff_type &get_buff, const boost::system_time &exit_time
+        ){
+            const double timeout = std::max(0.0, 1e-6*(exit_time - boost::get_system_time()).total_microseconds());
+            uhd::transport::managed_recv_buffer::sptr buff = get_buff(index, timeout);
+            if (buff.get() == NULL) return false;
+
+            channel_t &chan = _channels[index];
+            packet_t packet;
+            packet.buff = buff;
+            packet.info.num_packet_words32 = buff->size()/sizeof(boost::uint32_t);
+            vrt_codec_type::unpack(buff->cast<const boost::uint32_t *>(), packet.info);
+            packet.data = packet.info.packet_type == uhd::transport::vrt::if_packet_info_t::PACKET_TYPE_DATA;
+            const bool has_ticks = packet.info.has_tsi and packet.info.has_tsf;
+            packet.ticks = has_ticks? get_ticks(packet.info, _ticks_per_sec) : 0;
+            packet.offset = 0;
+            packet.nsamps = (packet.info.num_payload_words32*sizeof(boost::uint32_t))/OTW_BYTES_PER_SAMP;
+
+            //count the gaps in the 4-bit sequence
+            const size_t seq = packet.info.packet_count & 0xf;
+            const bool consecutive = chan.has_last_seq and seq == ((chan.last_seq + 1) & 0xf);
+            if (chan.has_last_seq and not consecutive) _num_seq_gaps++;
+
+            if (packet.data and has_ticks){
+                //a timestamp that goes backwards starts a new epoch
+                if (chan.has_last_ticks and packet.ticks < chan.last_ticks){
+                    set_epoch(chan, chan.epoch + 1);
+                }
+
+                //the first packet of a channel joins the newest epoch,
+                //unless it is more than a second behind (the time was set before it)
+                if (not chan.has_last_ticks){
+                    const bool behind = packet.ticks + _ticks_per_sec < _epoch_ticks;
+                    set_epoch(chan, behind? _epoch + 1 : _epoch);
+                }
+                if (chan.epoch == _epoch) _epoch_ticks = std::max(_epoch_ticks, packet.ticks);
+
+                //learn the ticks per sample from consecutive data packets
+                if (consecutive and chan.last_data and chan.has_last_ticks and chan.last_nsamps != 0
+                    and packet.ticks > chan.last_ticks and (packet.ticks - chan.last_ticks)%chan.last_nsamps == 0
+                ) chan.ticks_per_samp = (packet.ticks - chan.last_ticks)/chan.last_nsamps;
+
+                chan.has_last_ticks = true;
+                chan.last_ticks = packet.ticks;
+                chan.last_nsamps = packet.nsamps;
+            }
+            packet.epoch = chan.epoch;
+
+            chan.has_last_seq = true;
+            chan.last_seq = seq;
+            chan.last_data = packet.data and has_ticks;
+            chan.queue.push(packet);
+            return true;
+        }
+
+        //! Move a channel to an epoch (the newest epoch when it is newer)
+        void set_epoch(channel_t &chan, size_t epoch){
+            if (epoch > _epoch){
+                _epoch = epoch;
+                _epoch_ticks = 0;
+            }
+            chan.epoch = epoch;
+            chan.has_stale_ticks = false;
+            for (size_t i = 0; i < chan.queue.size(); i++) chan.queue.at(i).epoch = epoch;
+        }
+
+        /*******************************************************************
+         * Take a span of samples from the head of a channel queue:
+         * A whole packet is passed through, otherwise the span is copied
+         * into a piece buffer with its own header. The pieces of a packet
+         * keep the sequence number of the packet.
+         ******************************************************************/
+        uhd::transport::managed_recv_buffer::sptr take(channel_t &chan, size_t nsamps){
+            packet_t &head = chan.queue.front();
+            if (head.offset == 0 and nsamps == head.nsamps){
+                uhd::transport::managed_recv_buffer::sptr buff = head.buff;
+                chan.queue.pop();
+                return buff;
+            }
+
+            //get a free piece buffer (the handler or the app may still hold the last ones)
+            piece_buffer *piece = _pieces->get();
+
+            //pack a header for the span, the trailer burst flags only apply at the packet ends
+            uhd::transport::vrt::if_packet_info_t info = head.info;
+            if (info.has_tsi and info.has_tsf) set_ticks(info, head.ticks, _ticks_per_sec);
+            info.num_payload_words32 = (nsamps*OTW_BYTES_PER_SAMP)/sizeof(boost::uint32_t);
+            if (head.offset != 0) info.tlr &= ~boost::uint32_t(1 << 9); //sob indicator
+            if (head.offset + nsamps != head.nsamps) info.tlr &= ~boost::uint32_t(1 << 8); //eob indicator
+            piece->mem.resize(uhd::transport::vrt::max_if_hdr_words32 + info.num_payload_words32 + 1);
+            vrt_codec_type::pack(&piece->mem.front(), info);
+
+            //copy the payload and trailer
+            const boost::uint32_t *payload = head.buff->template cast<const boost::uint32_t *>()
+                + head.info.num_header_words32 + (head.offset*OTW_BYTES_PER_SAMP)/sizeof(boost::uint32_t);
+            std::memcpy(&piece->mem[info.num_header_words32], payload, info.num_payload_words32*sizeof(boost::uint32_t));
+            if (info.has_tlr) piece->mem[info.num_header_words32 + info.num_payload_words32] = vrt_codec_type::to_otw(info.tlr);
+            piece->num_words32 = info.num_packet_words32;
+
+            //advance the head, pop it when it was handed out completely
+            //(or when the timestamp of the rest is not known: the rest is dropped)
+            head.offset += nsamps;
+            head.ticks += nsamps*chan.ticks_per_samp;
+            if (head.offset != head.nsamps and chan.ticks_per_samp == 0){
+                _num_dropped_samps += head.remaining();
+                head.offset = head.nsamps;
+            }
+            if (head.offset == head.nsamps) chan.queue.pop();
+            return uhd::transport::make_managed_buffer<uhd::transport::managed_recv_buffer>(piece);
+        }
+
+        boost::uint64_t _ticks_per_sec;
+        std::vector<channel_t> _channels;
+        size_t _epoch;                //the newest epoch of the channels
+        boost::uint64_t _epoch_ticks; //the newest timestamp of the newest epoch
+        size_t _num_dropped_samps, _num_seq_gaps;
+        boost::shared_ptr<piece_pool> _pieces;
+    };
+
+} //namespace vrt_packet_handler
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_VRT_RECV_ALIGNER_HPP */
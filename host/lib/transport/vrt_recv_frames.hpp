@@ -0,0 +1,249 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_VRT_RECV_FRAMES_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_VRT_RECV_FRAMES_HPP
+
+#include "vrt_packet_handler.hpp"
+#include <uhd/stream.hpp>
+#include <uhd/transport/zero_copy.hpp>
+#include <uhd/utils/msg.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+#include <vector>
+
+namespace vrt_packet_handler{
+
+/***********************************************************************
+ * Frame leases:
+ * The transport frames handed to the application are leased:
+ *  - a leased frame keeps its transport alive until it is released,
+ *    so the frame may outlive the stream (and the device);
+ *    a piece copied by the aligner keeps its own pool alive
+ *  - the leased frames are bounded, so that the application cannot
+ *    hold all of the transport frames (the rest keep the reads going)
+ * A leased frame may be released in any thread,
+ * but each frame by one thread at a time.
+ **********************************************************************/
+    class frame_leases : public boost::enable_shared_from_this<frame_leases>, boost::noncopyable{
+    public:
+        typedef boost::shared_ptr<frame_leases> sptr;
+
+        /*!
+         * Make new frame leases.
+         * \param max_leased the most frames leased at once
+         */
+        static sptr make(size_t max_leased){
+            return sptr(new frame_leases(max_leased));
+        }
+
+        /*!
+         * Wait until a number of frames can be leased.
+         * \param num_frames the number of frames
+         * \param timeout the timeout in seconds
+         * \return false on timeout
+         */
+        bool wait_for_room(size_t num_frames, double timeout){
+            const boost::system_time exit_time = boost::get_system_time() +
+                boost::posix_time::microseconds(long(timeout*1e6));
+            boost::mutex::scoped_lock lock(_mutex);
+            while (_num_leased + num_frames > _max_leased){
+                if (not _cond.timed_wait(lock, exit_time)) return false;
+            }
+            return true;
+        }
+
+        /*!
+         * Lease a transport frame.
+         * \param buff the transport frame (the reference is taken)
+         * \param xport the transport of the frame (kept alive by the lease)
+         * \return the leased frame
+         */
+        uhd::transport::managed_recv_buffer::sptr lease(
+            uhd::transport::managed_recv_buffer::sptr &buff, uhd::transport::zero_copy_if::sptr xport
+        ){
+            boost::mutex::scoped_lock lock(_mutex);
+            _num_leased++;
+            lock.unlock();
+            return uhd::transport::make_managed_buffer<uhd::transport::managed_recv_buffer>(
+                new leased_frame(buff, xport, shared_from_this())
+            );
+        }
+
+        //! Get the number of frames leased
+        size_t get_num_leased(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            return _num_leased;
+        }
+
+    private:
+        frame_leases(size_t max_leased): _max_leased(max_leased), _num_leased(0){
+            UHD_ASSERT_THROW(_max_leased > 0);
+        }
+
+        class leased_frame : public uhd::transport::managed_recv_buffer{
+        public:
+            leased_frame(
+                uhd::transport::managed_recv_buffer::sptr &buff,
+                uhd::transport::zero_copy_if::sptr xport,
+                frame_leases::sptr leases
+            ): _xport(xport), _leases(leases){
+                _buff.swap(buff);
+            }
+
+            virtual ~leased_frame(void){}
+
+            void release(void){
+                _buff.reset(); //back to the transport, which is still alive
+                _leases->returned();
+                delete this; //the transport may go with it
+            }
+
+        private:
+            const void *get_buff(void) const{return _buff->cast<const void *>();}
+            size_t get_size(void) const{return _buff->size();}
+
+            uhd::transport::managed_recv_buffer::sptr _buff;
+            uhd::transport::zero_copy_if::sptr _xport;
+            frame_leases::sptr _leases;
+        };
+
+        void returned(void){
+            boost::mutex::scoped_lock lock(_mutex);
+            _num_leased--;
+            lock.unlock();
+            _cond.notify_all();
+        }
+
+        const size_t _max_leased;
+        size_t _num_leased;
+        boost::mutex _mutex;
+        boost::condition _cond;
+    };
+
+    /*******************************************************************
+     * Recv one packet per channel and hand over the transport frames.
+     * The samples are not copied: each frame points to its payload.
+     *  - the sequence gaps are reported like recv does (without zero fill),
+     *    the packet after a gap is handed over on the next call
+     *  - the rest of a packet partly copied out by recv is handed over
+     *    first, with its fragment offset
+     *  - the recv state keeps no reference to the frames handed over
+     * \return the number of samples per channel, 0 on error
+     ******************************************************************/
+    template <typename vrt_unpacker_type, typename get_recv_buffs_type>
+    static UHD_INLINE size_t recv_frames(
+        recv_state &state,
+        std::vector<uhd::rx_frame> &frames,
+        uhd::rx_metadata_t &metadata,
+        double tick_rate,
+        const vrt_unpacker_type &vrt_unpacker,
+        const get_recv_buffs_type &get_recv_buffs,
+        const handle_overflow_t &handle_overflow = &handle_overflow_nop,
+        size_t vrt_header_offset_words32 = 0
+    ){
+        metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_NONE;
+        metadata.num_lost_packets = 0;
+        metadata.num_lost_samps = 0;
+        metadata.more_fragments = false;
+        metadata.fragment_offset = 0;
+        frames.resize(state.width);
+        for (size_t i = 0; i < frames.size(); i++) frames[i] = uhd::rx_frame();
+
+        //zeros are not filled into frames (the gap was reported already)
+        state.num_fill_samps = 0;
+
+        //the packet after a sequence gap was received on a previous call
+        if (state.has_pending_metadata and not state.has_pending_gap){
+            state.has_pending_metadata = false;
+            metadata = state.pending_metadata;
+        }
+
+        //perform a receive if no rx data is waiting
+        else if (not state.has_pending_gap and state.size_of_copy_buffs == 0){
+            state.fragment_offset_in_samps = 0;
+            if (not get_recv_buffs(state.managed_buffs)){
+                metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
+                return 0;
+            }
+            try{
+                _recv1_helper(
+                    state, metadata, tick_rate,
+                    vrt_unpacker, handle_overflow,
+                    vrt_header_offset_words32, 1
+                );
+            }catch(const std::exception &e){
+                state.size_of_copy_buffs = 0; //reset copy buffs size
+                UHD_MSG(error) << "Error (recv frames): " << e.what() << std::endl;
+                metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_BAD_PACKET;
+                return 0;
+            }
+
+            //a sequence gap before the data packet:
+            //the packet is kept and handed over after the gap is reported
+            if (state.num_lost_packets != 0 and metadata.error_code == uhd::rx_metadata_t::ERROR_CODE_NONE){
+                state.has_pending_gap = true;
+                state.has_pending_metadata = true;
+                state.pending_metadata = metadata;
+            }
+        }
+
+        //the rest of a packet partly copied out by recv
+        else if (not state.has_pending_gap){
+            metadata.has_time_spec = false;
+            metadata.start_of_burst = false;
+            metadata.end_of_burst = false;
+            metadata.fragment_offset = state.fragment_offset_in_samps;
+        }
+
+        //report a sequence gap with the lost packets and samples
+        if (state.has_pending_gap){
+            state.has_pending_gap = false;
+            metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_SEQUENCE_ERROR;
+            metadata.num_lost_packets = state.num_lost_packets;
+            metadata.num_lost_samps = state.num_lost_samps;
+            metadata.has_time_spec = state.has_gap_ticks;
+            metadata.time_spec = ticks_to_time_spec(state.gap_ticks, tick_rate);
+            metadata.start_of_burst = false;
+            metadata.end_of_burst = false;
+            return 0;
+        }
+
+        //hand over the frames (or release the frames of a message packet)
+        const size_t nsamps = state.size_of_copy_buffs/OTW_BYTES_PER_SAMP;
+        for (size_t i = 0; i < state.width; i++){
+            if (nsamps == 0){
+                state.managed_buffs[i].reset();
+                continue;
+            }
+            frames[i].buff.swap(state.managed_buffs[i]);
+            state.managed_buffs[i].reset();
+            frames[i].samps = state.copy_buffs[i];
+            frames[i].nsamps = nsamps;
+        }
+        state.size_of_copy_buffs = 0;
+        return nsamps;
+    }
+
+} //namespace vrt_packet_handler
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_VRT_RECV_FRAMES_HPP */
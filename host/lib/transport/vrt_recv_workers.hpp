@@ -0,0 +1,274 @@
+//
+// Copyright 2010-2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_LIBUHD_TRANSPORT_VRT_RECV_WORKERS_HPP
+#define INCLUDED_LIBUHD_TRANSPORT_VRT_RECV_WORKERS_HPP
+
+#include "vrt_packet_handler.hpp"
+#include <uhd/exception.hpp>
+#include <uhd/transport/zero_copy.hpp>
+#include <uhd/transport/bounded_buffer.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+#include <vector>
+
+namespace vrt_packet_handler{
+
+/***********************************************************************
+ * Parallel receive workers:
+ * Each worker owns the channels where (channel % num workers) is its index.
+ *  - The reader thread of a worker reads ahead from the transports
+ *    of its channels into a small queue per channel.
+ *  - The packet handler runs in the caller's thread, so that the
+ *    alignment and metadata decisions stay in one place, but it only
+ *    records the copy-conversions of each channel.
+ *  - The recorded conversions are done by the workers in parallel
+ *    (the caller is worker zero), and the workers meet at a barrier.
+ * The managed buffers stay held until their conversions are done.
+ * A recv call converts at the end, or sooner when too many are held.
+ * A reader takes a reference for the queue and hands it over as a raw
+ * pointer, so that the reference moves to the caller without a copy.
+ **********************************************************************/
+    class recv_workers : boost::noncopyable{
+    public:
+        typedef boost::shared_ptr<recv_workers> sptr;
+        typedef boost::function<uhd::transport::managed_recv_buffer::sptr(size_t, double)> get_buff_t;
+
+        /*!
+         * Make the receive workers and start their threads.
+         * \param width the number of channels
+         * \param num_workers the number of workers (at most one per channel)
+         * \param get_buff reads a buffer from the transport of a channel
+         * \param read_ahead_depth the buffers read ahead per channel
+         * \param max_held_packets the packets per channel held before converting
+         */
+        recv_workers(
+            size_t width, size_t num_workers, const get_buff_t &get_buff,
+            size_t read_ahead_depth, size_t max_held_packets
+        ):
+            _width(width),
+            _num_workers(std::max<size_t>(1, std::min(width, num_workers))),
+            _get_buff(get_buff),
+            _max_held_buffs(std::max<size_t>(1, max_held_packets)*width),
+            _jobs(width), _next_chan(0), _num_jobs(0),
+            _io_buffs(_num_workers, std::vector<void *>(1)),
+            _start_barrier(_num_workers), _done_barrier(_num_workers),
+            _running(true)
+        {
+            for (size_t i = 0; i < width; i++){
+                _queues.push_back(boost::shared_ptr<queue_type>(new queue_type(std::max<size_t>(1, read_ahead_depth))));
+            }
+            for (size_t i = 0; i < _num_workers; i++){
+                _threads.create_thread(boost::bind(&recv_workers::read_loop, this, i));
+                if (i != 0) _threads.create_thread(boost::bind(&recv_workers::convert_loop, this, i));
+            }
+        }
+
+        ~recv_workers(void){
+            _running = false;
+            if (_num_workers > 1) _start_barrier.wait(); //release the convert loops
+            _threads.join_all();
+
+            //release the buffers that were read ahead
+            for (size_t chan = 0; chan < _width; chan++){
+                while ((*this)(chan, 0).get() != NULL){}
+            }
+        }
+
+        //! Get the number of workers
+        size_t get_num_workers(void) const{
+            return _num_workers;
+        }
+
+        /*!
+         * Get a buffer that was read ahead for a channel.
+         * This is the get buff callable for the receive aligner.
+         * \param chan the channel index
+         * \param timeout the timeout in seconds
+         * \return the buffer or NULL on timeout
+         */
+        uhd::transport::managed_recv_buffer::sptr operator()(size_t chan, double timeout) const{
+            uhd::transport::managed_recv_buffer *buff;
+            if (not _queues[chan]->pop_with_timed_wait(buff, timeout)) return uhd::transport::managed_recv_buffer::sptr();
+            return uhd::transport::managed_recv_buffer::sptr(buff, false); //adopt the reference of the reader
+        }
+
+        /*!
+         * Recv vrt packets and copy-convert the samples with the workers.
+         * The parameters are those of the packet handler's recv,
+         * the converter is called by the workers.
+         */
+        template <typename converter_type, typename vrt_unpacker_type, typename get_recv_buffs_type>
+        size_t recv(
+            recv_state &state,
+            const uhd::device::recv_buffs_type &buffs,
+            const size_t total_num_samps,
+            uhd::rx_metadata_t &metadata,
+            uhd::device::recv_mode_t recv_mode,
+            const size_t bytes_per_io_samp,
+            const converter_type &converter,
+            double tick_rate,
+            const vrt_unpacker_type &vrt_unpacker,
+            const get_recv_buffs_type &get_recv_buffs,
+            const handle_overflow_t &handle_overflow = &handle_overflow_nop,
+            size_t vrt_header_offset_words32 = 0
+        ){
+            UHD_ASSERT_THROW(buffs.size() == _width);
+            const recv_guard guard(*this); //no recorded conversions outlive the call
+            _convert_share = boost::bind(&recv_workers::convert_share<converter_type>, this, boost::cref(converter), _1);
+            const size_t num_samps = _recv(
+                state, buffs, total_num_samps,
+                metadata, recv_mode, bytes_per_io_samp,
+                deferred_converter(*this), tick_rate,
+                vrt_unpacker, holding_get_recv_buffs<get_recv_buffs_type>(*this, get_recv_buffs),
+                handle_overflow, vrt_header_offset_words32, 1
+            );
+            convert();
+            return num_samps;
+        }
+
+    private:
+        typedef uhd::transport::bounded_buffer<uhd::transport::managed_recv_buffer *> queue_type;
+
+        //! A recorded copy-conversion of one channel
+        struct job_t{
+            const void *input;
+            void *output;
+            size_t nsamps;
+        };
+
+        //! Records the copy-conversions (the handler converts the channels in order)
+        struct deferred_converter{
+            recv_workers &workers;
+            deferred_converter(recv_workers &workers): workers(workers){}
+            UHD_INLINE void operator()(const void *input, const std::vector<void *> &outputs, size_t nsamps) const{
+                const job_t job = {input, outputs[0], nsamps};
+                workers._jobs[workers._next_chan].push_back(job);
+                workers._next_chan = (workers._next_chan + 1)%workers._width;
+                workers._num_jobs++;
+            }
+        };
+
+        //! Holds the buffers that the handler replaces, converts when too many are held
+        template <typename get_recv_buffs_type> struct holding_get_recv_buffs{
+            recv_workers &workers;
+            const get_recv_buffs_type &get_recv_buffs;
+            holding_get_recv_buffs(recv_workers &workers, const get_recv_buffs_type &get_recv_buffs):
+                workers(workers), get_recv_buffs(get_recv_buffs){}
+            UHD_INLINE bool operator()(managed_recv_buffs_t &managed_buffs) const{
+                //the conversions of the last buffers may still be pending
+                if (workers._num_jobs != 0){
+                    if (workers._held_buffs.size() >= workers._max_held_buffs) workers.convert();
+                    else workers._held_buffs.insert(workers._held_buffs.end(), managed_buffs.begin(), managed_buffs.end());
+                }
+                return get_recv_buffs(managed_buffs);
+            }
+        };
+
+        //! Forgets the recorded conversions when a recv call exits (ex: the handler threw)
+        struct recv_guard{
+            recv_workers &workers;
+            recv_guard(recv_workers &workers): workers(workers){}
+            ~recv_guard(void){
+                workers.clear_jobs();
+                workers._convert_share.clear();
+            }
+        };
+
+        //! Run the recorded conversions on all workers, then release the held buffers
+        void convert(void){
+            if (_num_jobs != 0){
+                if (_num_workers > 1) _start_barrier.wait();
+                _convert_share(0);
+                if (_num_workers > 1) _done_barrier.wait();
+            }
+            clear_jobs();
+        }
+
+        void clear_jobs(void){
+            for (size_t i = 0; i < _width; i++) _jobs[i].clear();
+            _num_jobs = 0;
+            _next_chan = 0;
+            _held_buffs.clear();
+        }
+
+        //! Do the recorded conversions of the channels owned by a worker
+        template <typename converter_type> void convert_share(const converter_type &converter, size_t worker){
+            std::vector<void *> &io_buffs = _io_buffs[worker];
+            for (size_t chan = worker; chan < _width; chan += _num_workers){
+                const std::vector<job_t> &jobs = _jobs[chan];
+                for (size_t i = 0; i < jobs.size(); i++){
+                    io_buffs[0] = jobs[i].output;
+                    converter(jobs[i].input, io_buffs, jobs[i].nsamps);
+                }
+            }
+        }
+
+        void convert_loop(size_t worker){
+            while (true){
+                _start_barrier.wait();
+                if (not _running) return;
+                _convert_share(worker);
+                _done_barrier.wait();
+            }
+        }
+
+        void read_loop(size_t worker){
+            while (_running){
+                for (size_t chan = worker; chan < _width; chan += _num_workers){
+                    //short timeouts so that the loop can see the shutdown
+                    uhd::transport::managed_recv_buffer::sptr buff = _get_buff(chan, 0.01);
+                    if (buff.get() == NULL) continue;
+
+                    //take a reference for the queue and drop ours in this thread
+                    uhd::transport::managed_recv_buffer *raw_buff = buff.get();
+                    intrusive_ptr_add_ref(raw_buff);
+                    buff.reset();
+
+                    while (not _queues[chan]->push_with_timed_wait(raw_buff, 0.01)){
+                        if (_running) continue;
+                        intrusive_ptr_release(raw_buff);
+                        return;
+                    }
+                }
+            }
+        }
+
+        const size_t _width, _num_workers;
+        get_buff_t _get_buff;
+        std::vector<boost::shared_ptr<queue_type> > _queues;
+
+        //the conversions recorded by the handler and their buffers
+        const size_t _max_held_buffs;
+        std::vector<std::vector<job_t> > _jobs;
+        size_t _next_chan, _num_jobs;
+        managed_recv_buffs_t _held_buffs;
+        boost::function<void(size_t)> _convert_share;
+        std::vector<std::vector<void *> > _io_buffs;
+
+        boost::barrier _start_barrier, _done_barrier;
+        boost::thread_group _threads;
+        bool _running;
+    };
+
+} //namespace vrt_packet_handler
+
+#endif /* INCLUDED_LIBUHD_TRANSPORT_VRT_RECV_WORKERS_HPP */
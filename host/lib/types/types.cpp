@@ -73,6 +73,7 @@ static std::vector<size_t> get_tid_size_table(void){
     table[size_t(io_type_t::COMPLEX_FLOAT32)] = sizeof(std::complex<float>);
     table[size_t(io_type_t::COMPLEX_INT16)]   = sizeof(std::complex<boost::int16_t>);
     table[size_t(io_type_t::COMPLEX_INT8)]    = sizeof(std::complex<boost::int8_t>);
+    table[size_t(io_type_t::COMPLEX_INT16_ITEM32_BE)] = sizeof(boost::uint32_t);
     return table;
 }
 
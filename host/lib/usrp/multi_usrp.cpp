@@ -167,6 +167,10 @@ public:
         return _mboard(mboard)[MBOARD_PROP_TIME_NOW].as<time_spec_t>();
     }
 
+    time_spec_t get_time_now_exact(size_t mboard = 0){
+        return _mboard(mboard)[MBOARD_PROP_TIME_NOW_EXACT].as<time_spec_t>();
+    }
+
     time_spec_t get_time_last_pps(size_t mboard = 0){
         return _mboard(mboard)[MBOARD_PROP_TIME_PPS].as<time_spec_t>();
     }
@@ -188,12 +192,19 @@ public:
     }
 
     void set_time_unknown_pps(const time_spec_t &time_spec){
+        //set all mboards at once when the device can
+        try{
+            _dev->set_time_unknown_pps(time_spec);
+            return;
+        }
+        catch(const uhd::not_implemented_error &){}
+
         UHD_MSG(status) << "    1) catch time transition at pps edge" << std::endl;
-        time_spec_t time_start = get_time_now();
+        time_spec_t time_start = get_time_now_exact();
         time_spec_t time_start_last_pps = get_time_last_pps();
         while(true){
             if (get_time_last_pps() != time_start_last_pps) break;
-            if ((get_time_now() - time_start) > time_spec_t(1.1)){
+            if ((get_time_now_exact() - time_start) > time_spec_t(1.1)){
                 throw uhd::runtime_error(
                     "Board 0 may not be getting a PPS signal!\n"
                     "No PPS detected within the time interval.\n"
@@ -208,8 +219,8 @@ public:
 
         //verify that the time registers are read to be within a few RTT
         for (size_t m = 1; m < get_num_mboards(); m++){
-            time_spec_t time_0 = _mboard(0)[MBOARD_PROP_TIME_NOW].as<time_spec_t>();
-            time_spec_t time_i = _mboard(m)[MBOARD_PROP_TIME_NOW].as<time_spec_t>();
+            time_spec_t time_0 = get_time_now_exact(0);
+            time_spec_t time_i = get_time_now_exact(m);
             if (time_i < time_0 or (time_i - time_0) > time_spec_t(0.01)){ //10 ms: greater than RTT but not too big
                 UHD_MSG(warning) << boost::format(
                     "Detected time deviation between board %d and board 0.\n"
@@ -221,9 +232,10 @@ public:
     }
 
     bool get_time_synchronized(void){
+        //the time now reads may be estimates, made one right after the other
         for (size_t m = 1; m < get_num_mboards(); m++){
-            time_spec_t time_0 = _mboard(0)[MBOARD_PROP_TIME_NOW].as<time_spec_t>();
-            time_spec_t time_i = _mboard(m)[MBOARD_PROP_TIME_NOW].as<time_spec_t>();
+            time_spec_t time_0 = get_time_now(0);
+            time_spec_t time_i = get_time_now(m);
             if (time_i < time_0 or (time_i - time_0) > time_spec_t(0.01)) return false;
         }
         return true;
@@ -234,6 +246,14 @@ public:
             _rx_dsp(chan)[DSP_PROP_STREAM_CMD] = stream_cmd;
             return;
         }
+        //issue to all channels at once when the device can
+        std::vector<size_t> chans;
+        for (size_t c = 0; c < get_rx_num_channels(); c++) chans.push_back(c);
+        try{
+            _dev->issue_stream_cmd(stream_cmd, chans);
+            return;
+        }
+        catch(const uhd::not_implemented_error &){}
         for (size_t c = 0; c < get_rx_num_channels(); c++){
             issue_stream_cmd(stream_cmd, c);
         }
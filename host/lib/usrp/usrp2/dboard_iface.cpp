@@ -257,6 +257,8 @@ void usrp2_dboard_iface::write_spi(
     boost::uint32_t data,
     size_t num_bits
 ){
+    //the dboard spi programs the synthesizers (tune)
+    usrp2_iface::ctrl_priority_scope priority(usrp2_iface::CTRL_PRIORITY_CRITICAL);
     _iface->write_spi(unit_to_spi_dev[unit], config, data, num_bits);
 }
 
@@ -266,6 +268,7 @@ boost::uint32_t usrp2_dboard_iface::read_write_spi(
     boost::uint32_t data,
     size_t num_bits
 ){
+    usrp2_iface::ctrl_priority_scope priority(usrp2_iface::CTRL_PRIORITY_CRITICAL);
     return _iface->read_spi(unit_to_spi_dev[unit], config, data, num_bits);
 }
 
@@ -18,6 +18,7 @@
 #include "usrp2_impl.hpp"
 #include "usrp2_regs.hpp"
 #include "fw_common.h"
+#include "desc_cache.hpp"
 #include <uhd/usrp/misc_utils.hpp>
 #include <uhd/usrp/dsp_utils.hpp>
 #include <uhd/usrp/subdev_props.hpp>
@@ -34,11 +35,38 @@ using namespace uhd::usrp;
 /***********************************************************************
  * Helper Methods
  **********************************************************************/
-void usrp2_mboard_impl::dboard_init(void){
-    //read the dboard eeprom to extract the dboard ids
-    _rx_db_eeprom.load(*_iface, USRP2_I2C_ADDR_RX_DB);
-    _tx_db_eeprom.load(*_iface, USRP2_I2C_ADDR_TX_DB);
-    _gdb_eeprom.load(*_iface, USRP2_I2C_ADDR_TX_DB ^ 5);
+static void load_db_eeprom(
+    dboard_eeprom_t &db_eeprom, usrp2_iface &iface, boost::uint8_t addr,
+    const device_addr_t &cached_desc, const std::string &prefix
+){
+    if (cached_desc.has_key(prefix + "id")){
+        //read the eeprom header (magic byte, id lsb, id msb) to check the cached id:
+        //a swapped dboard drops the cached id and the whole eeprom is loaded
+        const byte_vector_t header = iface.read_eeprom(addr, 0, 3);
+        const dboard_id_t id = (header.size() == 3 and header[0] == 0xdb)?
+            dboard_id_t::from_uint16(header[1] | (boost::uint16_t(header[2]) << 8)) : dboard_id_t::none();
+        if (id == dboard_id_t::from_string(cached_desc[prefix + "id"])){
+            db_eeprom.id = id;
+            db_eeprom.serial = cached_desc.get(prefix + "serial", "");
+            return;
+        }
+    }
+    db_eeprom.load(iface, addr);
+}
+
+static void save_db_eeprom(
+    const dboard_eeprom_t &db_eeprom,
+    device_addr_t &desc, const std::string &prefix
+){
+    desc[prefix + "id"] = db_eeprom.id.to_string();
+    desc[prefix + "serial"] = db_eeprom.serial;
+}
+
+void usrp2_mboard_impl::dboard_init(const device_addr_t &cached_desc){
+    //read the dboard eeprom to extract the dboard ids (or use the cached ids)
+    load_db_eeprom(_rx_db_eeprom, *_iface, USRP2_I2C_ADDR_RX_DB, cached_desc, "rx_db.");
+    load_db_eeprom(_tx_db_eeprom, *_iface, USRP2_I2C_ADDR_TX_DB, cached_desc, "tx_db.");
+    load_db_eeprom(_gdb_eeprom, *_iface, USRP2_I2C_ADDR_TX_DB ^ 5, cached_desc, "gdb.");
 
     //create a new dboard interface and manager
     _dboard_iface = make_usrp2_dboard_iface(_iface, _clock_ctrl);
@@ -59,6 +87,14 @@ void usrp2_mboard_impl::dboard_init(void){
     );
 }
 
+device_addr_t usrp2_mboard_impl::get_cache_desc(void){
+    device_addr_t desc = usrp2_desc_cache::get_identity(*_iface);
+    save_db_eeprom(_rx_db_eeprom, desc, "rx_db.");
+    save_db_eeprom(_tx_db_eeprom, desc, "tx_db.");
+    save_db_eeprom(_gdb_eeprom, desc, "gdb.");
+    return desc;
+}
+
 /***********************************************************************
  * RX DBoard Properties
  **********************************************************************/
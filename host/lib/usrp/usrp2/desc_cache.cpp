@@ -0,0 +1,217 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "desc_cache.hpp"
+#include "usrp2_regs.hpp"
+#include <uhd/utils/msg.hpp>
+#include <uhd/exception.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/foreach.hpp>
+#ifdef BOOST_MSVC
+//whoops! https://svn.boost.org/trac/boost/ticket/5287
+//enjoy this useless dummy class instead
+namespace boost{ namespace interprocess{
+    struct file_lock{
+        file_lock(const char * = NULL){}
+        void lock(void){}
+        void unlock(void){}
+        void lock_sharable(void){}
+        void unlock_sharable(void){}
+    };
+}} //namespace
+#else
+#include <boost/interprocess/sync/file_lock.hpp>
+#endif
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/interprocess/sync/sharable_lock.hpp>
+#include <cstdlib> //getenv
+#include <fstream>
+#include <vector>
+
+using namespace uhd;
+namespace fs = boost::filesystem;
+namespace ip = boost::interprocess;
+
+static const std::string mb_eeprom_prefix = "mb_eeprom.";
+
+/***********************************************************************
+ * Cache file location
+ **********************************************************************/
+static fs::path get_config_path(void){
+    const char *path = NULL;
+
+    //try the official uhd config path environment variable
+    path = std::getenv("UHD_CONFIG_PATH");
+    if (path != NULL) return path;
+
+    //try the windows application data path
+    path = std::getenv("APPDATA");
+    if (path != NULL) return fs::path(path) / "uhd";
+
+    //try the xdg config path, then the home directory default
+    path = std::getenv("XDG_CONFIG_HOME");
+    if (path != NULL) return fs::path(path) / "uhd";
+
+    path = std::getenv("HOME");
+    if (path != NULL) return fs::path(path) / ".config" / "uhd";
+
+    throw uhd::runtime_error("cannot determine the user's config directory");
+}
+
+/***********************************************************************
+ * Cache file format:
+ * One key=value pair per line, a blank line ends each descriptor.
+ **********************************************************************/
+static std::vector<device_addr_t> read_descs(const fs::path &cache_path){
+    std::vector<device_addr_t> descs(1);
+    std::ifstream cache_file(cache_path.string().c_str());
+    std::string line;
+    while (std::getline(cache_file, line)){
+        if (line.empty()){
+            if (descs.back().size() != 0) descs.push_back(device_addr_t());
+            continue;
+        }
+        const size_t delim = line.find('=');
+        if (delim == std::string::npos) continue; //ignore garbage
+        descs.back()[line.substr(0, delim)] = line.substr(delim+1);
+    }
+    if (descs.back().size() == 0) descs.pop_back();
+    return descs;
+}
+
+static void write_descs(const fs::path &cache_path, const std::vector<device_addr_t> &descs){
+    //write a temporary file and rename it over the cache file,
+    //so that readers see either the old or the new file, never a partial one
+    const fs::path tmp_path = cache_path.string() + ".tmp";
+    {
+        std::ofstream tmp_file(tmp_path.string().c_str(), std::ofstream::out | std::ofstream::trunc);
+        BOOST_FOREACH(const device_addr_t &desc, descs){
+            BOOST_FOREACH(const std::string &key, desc.keys()){
+                tmp_file << key << "=" << desc[key] << std::endl;
+            }
+            tmp_file << std::endl;
+        }
+        tmp_file.close();
+        if (tmp_file.fail()) throw uhd::runtime_error("failed to write " + tmp_path.string());
+    }
+    fs::rename(tmp_path, cache_path);
+}
+
+//! Can this descriptor be stored in the line based file format?
+static bool is_storable(const device_addr_t &desc){
+    BOOST_FOREACH(const std::string &key, desc.keys()){
+        if (key.empty() or key.find_first_of("=\r\n") != std::string::npos) return false;
+        if (desc[key].find_first_of("\r\n") != std::string::npos) return false;
+    }
+    return true;
+}
+
+/***********************************************************************
+ * Cache file access:
+ * The file lock serializes processes, the mutex serializes threads.
+ **********************************************************************/
+static boost::mutex cache_mutex;
+
+static fs::path get_cache_path(void){
+    return get_config_path() / "usrp2_desc_cache";
+}
+
+static fs::path get_lock_path(void){
+    //the lock file must exist before it can be locked
+    const fs::path lock_path = get_config_path() / "usrp2_desc_cache.lock";
+    fs::create_directories(lock_path.parent_path());
+    std::ofstream(lock_path.string().c_str(), std::ofstream::out | std::ofstream::app);
+    return lock_path;
+}
+
+static std::vector<device_addr_t> load_cache(void){
+    boost::mutex::scoped_lock lock(cache_mutex);
+    const fs::path cache_path = get_cache_path();
+    if (not fs::exists(cache_path)) return std::vector<device_addr_t>();
+    ip::file_lock file_lock(get_lock_path().string().c_str());
+    ip::sharable_lock<ip::file_lock> file_lock_guard(file_lock);
+    return read_descs(cache_path);
+}
+
+/***********************************************************************
+ * Descriptor cache implementation
+ **********************************************************************/
+bool usrp2_desc_cache::enabled(const device_addr_t &device_addr){
+    return device_addr.cast<int>("desc_cache", 0) != 0;
+}
+
+device_addr_t usrp2_desc_cache::get_identity(usrp2_iface &iface){
+    device_addr_t identity;
+    identity["serial"] = iface.mb_eeprom["serial"];
+    identity["fw_compat"] = boost::lexical_cast<std::string>(iface.get_fw_compat_num());
+    identity["fpga_compat"] = boost::lexical_cast<std::string>(iface.peek32(U2_REG_COMPAT_NUM_RB));
+    BOOST_FOREACH(const std::string &key, iface.mb_eeprom.keys()){
+        identity[mb_eeprom_prefix + key] = iface.mb_eeprom[key];
+    }
+    return identity;
+}
+
+device_addr_t usrp2_desc_cache::lookup(const std::string &key, const std::string &value){
+    try{
+        BOOST_FOREACH(const device_addr_t &desc, load_cache()){
+            if (desc.has_key(key) and desc[key] == value) return desc;
+        }
+    }
+    catch(const std::exception &e){
+        UHD_MSG(warning) << "Failed to read the USRP2 descriptor cache:\n" << e.what() << std::endl;
+    }
+    return device_addr_t();
+}
+
+device_addr_t usrp2_desc_cache::lookup(usrp2_iface &iface, const std::string &addr){
+    const device_addr_t desc = lookup("addr", addr);
+    if (desc.size() == 0) return desc;
+
+    //every identity key must match, otherwise the descriptor is stale
+    const device_addr_t identity = get_identity(iface);
+    BOOST_FOREACH(const std::string &key, identity.keys()){
+        if (not desc.has_key(key) or desc[key] != identity[key]) return device_addr_t();
+    }
+    return desc;
+}
+
+void usrp2_desc_cache::store(const device_addr_t &desc){
+    if (not desc.has_key("serial") or not desc.has_key("addr") or not is_storable(desc)) return;
+    try{
+        boost::mutex::scoped_lock lock(cache_mutex);
+        ip::file_lock file_lock(get_lock_path().string().c_str());
+        ip::scoped_lock<ip::file_lock> file_lock_guard(file_lock);
+
+        //replace the descriptors for this serial or address
+        const fs::path cache_path = get_cache_path();
+        std::vector<device_addr_t> descs;
+        if (fs::exists(cache_path)){
+            BOOST_FOREACH(const device_addr_t &old_desc, read_descs(cache_path)){
+                if (old_desc.get("serial", "") == desc["serial"]) continue;
+                if (old_desc.get("addr", "") == desc["addr"]) continue;
+                descs.push_back(old_desc);
+            }
+        }
+        descs.push_back(desc);
+        write_descs(cache_path, descs);
+    }
+    catch(const std::exception &e){
+        UHD_MSG(warning) << "Failed to write the USRP2 descriptor cache:\n" << e.what() << std::endl;
+    }
+}
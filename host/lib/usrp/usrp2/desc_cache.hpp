@@ -0,0 +1,77 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_USRP2_DESC_CACHE_HPP
+#define INCLUDED_USRP2_DESC_CACHE_HPP
+
+#include "usrp2_iface.hpp"
+#include <uhd/types/device_addr.hpp>
+#include <string>
+
+/*!
+ * The usrp2 descriptor cache:
+ * Remembers what startup learned about a device (eeprom contents,
+ * frame sizes, dboard ids, address) in a file under the user's
+ * config directory, so that the next startup may skip the slow paths.
+ *
+ * A descriptor is a set of key/value pairs. Its identity keys are
+ * the serial, the compat numbers, and the mboard eeprom contents.
+ * A cached descriptor is only used when all identity keys match the device.
+ * The cached dboard ids are checked against the dboard eeprom headers,
+ * and a descriptor that differs from what startup learned is stored again.
+ *
+ * The cache is shared by processes through a lock file and atomic renames.
+ * Cache errors are never fatal: the device is simply initialized the slow way.
+ */
+namespace usrp2_desc_cache{
+
+    //! Is the cache enabled by these device args? (desc_cache=1)
+    bool enabled(const uhd::device_addr_t &device_addr);
+
+    /*!
+     * Get the identity keys of a device through its control interface.
+     * \param iface the usrp2 control interface (eeprom already loaded)
+     * \return a descriptor with only the identity keys
+     */
+    uhd::device_addr_t get_identity(usrp2_iface &iface);
+
+    /*!
+     * Find a cached descriptor.
+     * \param key the descriptor key to match (ex: addr or serial)
+     * \param value the value the key must have
+     * \return the first matching descriptor or an empty one
+     */
+    uhd::device_addr_t lookup(const std::string &key, const std::string &value);
+
+    /*!
+     * Find the cached descriptor for a device and check its identity.
+     * \param iface the usrp2 control interface of the device
+     * \param addr the address used to reach the device
+     * \return the descriptor, or an empty one on a miss or mismatch
+     */
+    uhd::device_addr_t lookup(usrp2_iface &iface, const std::string &addr);
+
+    /*!
+     * Store a descriptor in the cache.
+     * Descriptors with the same serial or address are replaced.
+     * \param desc the descriptor, must have a serial and addr
+     */
+    void store(const uhd::device_addr_t &desc);
+
+} //namespace usrp2_desc_cache
+
+#endif /* INCLUDED_USRP2_DESC_CACHE_HPP */
@@ -17,6 +17,7 @@
 
 #include "usrp2_impl.hpp"
 #include "usrp2_regs.hpp"
+#include "../../transport/vrt_overflow_recovery.hpp"
 #include <uhd/usrp/dsp_utils.hpp>
 #include <uhd/usrp/dsp_props.hpp>
 #include <boost/bind.hpp>
@@ -32,12 +33,13 @@ using namespace uhd::usrp;
  * DSP impl and methods
  **********************************************************************/
 struct usrp2_mboard_impl::dsp_impl{
+    dsp_impl(void): stream_cmds(NUM_RX_DSPS){}
     uhd::dict<size_t, size_t> ddc_decim;
     uhd::dict<size_t, double> ddc_freq;
     uhd::dict<size_t, size_t> duc_interp;
     uhd::dict<size_t, double> duc_freq;
     std::vector<size_t> decim_and_interp_rates;
-    uhd::dict<size_t, bool> continuous_streaming;
+    vrt_packet_handler::stream_cmd_state stream_cmds; //shared with the overflow recovery
 };
 
 void usrp2_mboard_impl::dsp_init(void){
@@ -64,22 +66,24 @@ void usrp2_mboard_impl::dsp_init(void){
         );
 
         //initial config and update
-        ddc_set(DSP_PROP_FREQ_SHIFT, double(0), i);
-        ddc_set(DSP_PROP_HOST_RATE, double(get_master_clock_freq()/16), i);
+        usrp2_iface::batch_t batch;
+        ddc_set(DSP_PROP_FREQ_SHIFT, double(0), i, batch);
+        ddc_set(DSP_PROP_HOST_RATE, double(get_master_clock_freq()/16), i, batch);
 
         //setup the rx control registers
-        _iface->poke32(U2_REG_RX_CTRL_CLEAR(i), 1); //reset
-        _iface->poke32(U2_REG_RX_CTRL_NSAMPS_PP(i), _device.get_max_recv_samps_per_packet());
-        _iface->poke32(U2_REG_RX_CTRL_NCHANNELS(i), 1);
-        _iface->poke32(U2_REG_RX_CTRL_VRT_HDR(i), 0
+        batch.poke32(U2_REG_RX_CTRL_CLEAR(i), 1); //reset
+        batch.poke32(U2_REG_RX_CTRL_NSAMPS_PP(i), _device.get_max_recv_samps_per_packet());
+        batch.poke32(U2_REG_RX_CTRL_NCHANNELS(i), 1);
+        batch.poke32(U2_REG_RX_CTRL_VRT_HDR(i), 0
             | (0x1 << 28) //if data with stream id
             | (0x1 << 26) //has trailer
             | (0x3 << 22) //integer time other
             | (0x1 << 20) //fractional time sample count
         );
-        _iface->poke32(U2_REG_RX_CTRL_VRT_SID(i), usrp2_impl::RECV_SID);
-        _iface->poke32(U2_REG_RX_CTRL_VRT_TLR(i), 0);
-        _iface->poke32(U2_REG_TIME64_TPS, size_t(get_master_clock_freq()));
+        batch.poke32(U2_REG_RX_CTRL_VRT_SID(i), usrp2_impl::RECV_SID);
+        batch.poke32(U2_REG_RX_CTRL_VRT_TLR(i), 0);
+        batch.poke32(U2_REG_TIME64_TPS, size_t(get_master_clock_freq()));
+        _iface->transact_batch(batch);
     }
 
     //bind and initialize the tx dsps
@@ -90,14 +94,16 @@ void usrp2_mboard_impl::dsp_init(void){
         );
 
         //initial config and update
-        duc_set(DSP_PROP_FREQ_SHIFT, double(0), i);
-        duc_set(DSP_PROP_HOST_RATE, double(get_master_clock_freq()/16), i);
+        usrp2_iface::batch_t batch;
+        duc_set(DSP_PROP_FREQ_SHIFT, double(0), i, batch);
+        duc_set(DSP_PROP_HOST_RATE, double(get_master_clock_freq()/16), i, batch);
 
         //init the tx control registers
-        _iface->poke32(U2_REG_TX_CTRL_CLEAR_STATE, 1); //reset
-        _iface->poke32(U2_REG_TX_CTRL_NUM_CHAN, 0);    //1 channel
-        _iface->poke32(U2_REG_TX_CTRL_REPORT_SID, usrp2_impl::ASYNC_SID);
-        _iface->poke32(U2_REG_TX_CTRL_POLICY, U2_FLAG_TX_CTRL_POLICY_NEXT_PACKET);
+        batch.poke32(U2_REG_TX_CTRL_CLEAR_STATE, 1); //reset
+        batch.poke32(U2_REG_TX_CTRL_NUM_CHAN, 0);    //1 channel
+        batch.poke32(U2_REG_TX_CTRL_REPORT_SID, usrp2_impl::get_async_sid(i));
+        batch.poke32(U2_REG_TX_CTRL_POLICY, U2_FLAG_TX_CTRL_POLICY_NEXT_PACKET);
+        _iface->transact_batch(batch);
     }
 }
 
@@ -112,18 +118,51 @@ static rate_type pick_closest_rate(double exact_rate, const std::vector<rate_typ
 }
 
 void usrp2_mboard_impl::issue_ddc_stream_cmd(const stream_cmd_t &stream_cmd, size_t which_dsp){
-    _dsp_impl->continuous_streaming[which_dsp] = stream_cmd.stream_mode == stream_cmd_t::STREAM_MODE_START_CONTINUOUS;
-    _iface->poke32(U2_REG_RX_CTRL_STREAM_CMD(which_dsp), dsp_type1::calc_stream_cmd_word(stream_cmd));
-    _iface->poke32(U2_REG_RX_CTRL_TIME_SECS(which_dsp),  boost::uint32_t(stream_cmd.time_spec.get_full_secs()));
-    _iface->poke32(U2_REG_RX_CTRL_TIME_TICKS(which_dsp), stream_cmd.time_spec.get_tick_count(get_master_clock_freq()));
+    usrp2_iface::ctrl_priority_scope priority(usrp2_iface::CTRL_PRIORITY_CRITICAL);
+    boost::mutex::scoped_lock lock(_dsp_impl->stream_cmds.get_mutex());
+    usrp2_iface::batch_t batch;
+    this->issue_ddc_stream_cmd(stream_cmd, which_dsp, batch);
+    _iface->transact_batch(batch);
+    _dsp_impl->stream_cmds.set_continuous(which_dsp, stream_cmd.stream_mode == stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
 }
 
-void usrp2_mboard_impl::handle_overflow(size_t which_dsp){
-    if (_dsp_impl->continuous_streaming[which_dsp]){ //re-issue the stream command if already continuous
-        this->issue_ddc_stream_cmd(stream_cmd_t::STREAM_MODE_START_CONTINUOUS, which_dsp);
+void usrp2_mboard_impl::issue_ddc_stream_cmd(
+    const stream_cmd_t &stream_cmd, size_t which_dsp, usrp2_iface::batch_t &batch
+){
+    //the caller holds the stream command lock until the batch is transacted,
+    //and records the continuous mode only once the device took the command
+    batch.poke32(U2_REG_RX_CTRL_STREAM_CMD(which_dsp), dsp_type1::calc_stream_cmd_word(stream_cmd));
+    batch.poke32(U2_REG_RX_CTRL_TIME_SECS(which_dsp),  boost::uint32_t(stream_cmd.time_spec.get_full_secs()));
+    batch.poke32(U2_REG_RX_CTRL_TIME_TICKS(which_dsp), stream_cmd.time_spec.get_tick_count(get_master_clock_freq()));
+}
+
+void usrp2_mboard_impl::issue_ddc_stream_cmds(
+    const stream_cmd_t &stream_cmd, const std::vector<size_t> &which_dsps
+){
+    usrp2_iface::ctrl_priority_scope priority(usrp2_iface::CTRL_PRIORITY_CRITICAL);
+    boost::mutex::scoped_lock lock(_dsp_impl->stream_cmds.get_mutex());
+    usrp2_iface::batch_t batch;
+    BOOST_FOREACH(size_t which_dsp, which_dsps){
+        this->issue_ddc_stream_cmd(stream_cmd, which_dsp, batch);
+    }
+    _iface->transact_batch(batch);
+    BOOST_FOREACH(size_t which_dsp, which_dsps){
+        _dsp_impl->stream_cmds.set_continuous(which_dsp, stream_cmd.stream_mode == stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
     }
 }
 
+void usrp2_mboard_impl::handle_overflow(size_t which_dsp){
+    //check and re-issue under the stream command lock (a stop may be issued meanwhile)
+    usrp2_iface::ctrl_priority_scope priority(usrp2_iface::CTRL_PRIORITY_CRITICAL);
+    boost::mutex::scoped_lock lock(_dsp_impl->stream_cmds.get_mutex());
+    if (not _dsp_impl->stream_cmds.is_continuous(which_dsp)) return;
+
+    //re-issue the stream command if already continuous
+    usrp2_iface::batch_t batch;
+    this->issue_ddc_stream_cmd(stream_cmd_t::STREAM_MODE_START_CONTINUOUS, which_dsp, batch);
+    _iface->transact_batch(batch);
+}
+
 /***********************************************************************
  * DDC Properties
  **********************************************************************/
@@ -155,18 +194,29 @@ void usrp2_mboard_impl::ddc_get(const wax::obj &key_, wax::obj &val, size_t whic
     }
 }
 
-void usrp2_mboard_impl::ddc_set(const wax::obj &key_, const wax::obj &val, size_t which_dsp){
+void usrp2_mboard_impl::ddc_set(const wax::obj &key, const wax::obj &val, size_t which_dsp){
+    //stream commands, rate and frequency changes go ahead of the housekeeping io
+    usrp2_iface::ctrl_priority_scope priority(usrp2_iface::CTRL_PRIORITY_CRITICAL);
+    boost::mutex::scoped_lock lock(_dsp_impl->stream_cmds.get_mutex()); //the key may be a stream command
+    usrp2_iface::batch_t batch;
+    this->ddc_set(key, val, which_dsp, batch);
+    _iface->transact_batch(batch);
+}
+
+void usrp2_mboard_impl::ddc_set(
+    const wax::obj &key_, const wax::obj &val, size_t which_dsp, usrp2_iface::batch_t &batch
+){
     named_prop_t key = named_prop_t::extract(key_);
 
     switch(key.as<dsp_prop_t>()){
 
     case DSP_PROP_STREAM_CMD:
-        issue_ddc_stream_cmd(val.as<stream_cmd_t>(), which_dsp);
+        issue_ddc_stream_cmd(val.as<stream_cmd_t>(), which_dsp, batch);
         return;
 
     case DSP_PROP_FREQ_SHIFT:{
             double new_freq = val.as<double>();
-            _iface->poke32(U2_REG_DSP_RX_FREQ(which_dsp),
+            batch.poke32(U2_REG_DSP_RX_FREQ(which_dsp),
                 dsp_type1::calc_cordic_word_and_update(new_freq, get_master_clock_freq())
             );
             _dsp_impl->ddc_freq[which_dsp] = new_freq; //shadow
@@ -178,11 +228,11 @@ void usrp2_mboard_impl::ddc_set(const wax::obj &key_, const wax::obj &val, size_
             _dsp_impl->ddc_decim[which_dsp] = pick_closest_rate(extact_rate, _dsp_impl->decim_and_interp_rates);
 
             //set the decimation
-            _iface->poke32(U2_REG_DSP_RX_DECIM(which_dsp), dsp_type1::calc_cic_filter_word(_dsp_impl->ddc_decim[which_dsp]));
+            batch.poke32(U2_REG_DSP_RX_DECIM(which_dsp), dsp_type1::calc_cic_filter_word(_dsp_impl->ddc_decim[which_dsp]));
 
             //set the scaling
             static const boost::int16_t default_rx_scale_iq = 1024;
-            _iface->poke32(U2_REG_DSP_RX_SCALE_IQ(which_dsp),
+            batch.poke32(U2_REG_DSP_RX_SCALE_IQ(which_dsp),
                 dsp_type1::calc_iq_scale_word(default_rx_scale_iq, default_rx_scale_iq)
             );
         }
@@ -223,7 +273,16 @@ void usrp2_mboard_impl::duc_get(const wax::obj &key_, wax::obj &val, size_t whic
     }
 }
 
-void usrp2_mboard_impl::duc_set(const wax::obj &key_, const wax::obj &val, size_t which_dsp){
+void usrp2_mboard_impl::duc_set(const wax::obj &key, const wax::obj &val, size_t which_dsp){
+    usrp2_iface::ctrl_priority_scope priority(usrp2_iface::CTRL_PRIORITY_CRITICAL);
+    usrp2_iface::batch_t batch;
+    this->duc_set(key, val, which_dsp, batch);
+    _iface->transact_batch(batch);
+}
+
+void usrp2_mboard_impl::duc_set(
+    const wax::obj &key_, const wax::obj &val, size_t which_dsp, usrp2_iface::batch_t &batch
+){
     named_prop_t key = named_prop_t::extract(key_);
 
     switch(key.as<dsp_prop_t>()){
@@ -242,7 +301,7 @@ void usrp2_mboard_impl::duc_set(const wax::obj &key_, const wax::obj &val, size_
             if (zone == 0) _codec_ctrl->set_tx_mod_mode(0); //no shift
             else _codec_ctrl->set_tx_mod_mode(sign*4/zone); //DAC interp = 4
 
-            _iface->poke32(U2_REG_DSP_TX_FREQ,
+            batch.poke32(U2_REG_DSP_TX_FREQ,
                 dsp_type1::calc_cordic_word_and_update(new_freq, codec_rate)
             );
             _dsp_impl->duc_freq[which_dsp] = new_freq + dac_shift; //shadow
@@ -254,10 +313,10 @@ void usrp2_mboard_impl::duc_set(const wax::obj &key_, const wax::obj &val, size_
             _dsp_impl->duc_interp[which_dsp] = pick_closest_rate(extact_rate, _dsp_impl->decim_and_interp_rates);
 
             //set the interpolation
-            _iface->poke32(U2_REG_DSP_TX_INTERP_RATE, dsp_type1::calc_cic_filter_word(_dsp_impl->duc_interp[which_dsp]));
+            batch.poke32(U2_REG_DSP_TX_INTERP_RATE, dsp_type1::calc_cic_filter_word(_dsp_impl->duc_interp[which_dsp]));
 
             //set the scaling
-            _iface->poke32(U2_REG_DSP_TX_SCALE_IQ, dsp_type1::calc_iq_scale_word(_dsp_impl->duc_interp[which_dsp]));
+            batch.poke32(U2_REG_DSP_TX_SCALE_IQ, dsp_type1::calc_iq_scale_word(_dsp_impl->duc_interp[which_dsp]));
         }
         return;
 
@@ -31,7 +31,7 @@ extern "C" {
 
 //fpga and firmware compatibility numbers
 #define USRP2_FPGA_COMPAT_NUM 6
-#define USRP2_FW_COMPAT_NUM 10
+#define USRP2_FW_COMPAT_NUM 11
 
 //used to differentiate control packets over data port
 #define USRP2_INVALID_VRT_HEADER 0
@@ -89,6 +89,9 @@ typedef enum{
     USRP2_CTRL_ID_HOLLER_AT_ME_BRO = 'l',
     USRP2_CTRL_ID_HOLLER_BACK_DUDE = 'L',
 
+    USRP2_CTRL_ID_DO_ALL_THESE_THINGS_BRO = 'b',
+    USRP2_CTRL_ID_DID_ALL_THOSE_THINGS_DUDE = 'B',
+
     USRP2_CTRL_ID_PEACE_OUT = '~'
 
 } usrp2_ctrl_id_t;
@@ -109,9 +112,30 @@ typedef enum{
     USRP2_REG_ACTION_FPGA_POKE32 = 3,
     USRP2_REG_ACTION_FPGA_POKE16 = 4,
     USRP2_REG_ACTION_FW_PEEK32   = 5,
-    USRP2_REG_ACTION_FW_POKE32   = 6
+    USRP2_REG_ACTION_FW_POKE32   = 6,
+    USRP2_REG_ACTION_SPI_WRITE   = 7  //only valid in a batch
 } usrp2_reg_action_t;
 
+//max number of operations in a batch control packet:
+//keeps the batch packet well under the minimum ethernet mtu
+#define USRP2_CTRL_BATCH_MAX_OPS 64
+
+/*!
+ * A single operation in a batch control packet.
+ * The batch packet is a usrp2_ctrl_data_t header (with batch_args)
+ * followed immediately by num_ops of these structures.
+ * The response carries the same operations back to the host,
+ * with peek results filled into the data field.
+ */
+typedef struct{
+    uint8_t action;    //usrp2_reg_action_t
+    uint8_t num_bits;  //spi only
+    uint8_t miso_edge; //spi only
+    uint8_t mosi_edge; //spi only
+    uint32_t addr;     //register address or spi slave device
+    uint32_t data;
+} usrp2_ctrl_batch_op_t;
+
 typedef struct{
     uint32_t proto_ver;
     uint32_t id;
@@ -144,6 +168,9 @@ typedef struct{
         struct {
             uint32_t len;
         } echo_args;
+        struct {
+            uint32_t num_ops;
+        } batch_args;
     } data;
 } usrp2_ctrl_data_t;
 
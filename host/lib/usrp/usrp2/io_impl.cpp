@@ -16,6 +16,15 @@
 //
 
 #include "../../transport/vrt_packet_handler.hpp"
+#include "../../transport/vrt_recv_aligner.hpp"
+#include "../../transport/vrt_recv_workers.hpp"
+#include "../../transport/vrt_overflow_recovery.hpp"
+#include "../../transport/vrt_recv_frames.hpp"
+#include "../../transport/recv_fanout.hpp"
+#include "../../transport/flow_control_monitor.hpp"
+#include "../../transport/flow_control_tuner.hpp"
+#include "../../transport/send_stager.hpp"
+#include "../../transport/burst_tracker.hpp"
 #include "usrp2_impl.hpp"
 #include "usrp2_regs.hpp"
 #include <uhd/utils/log.hpp>
@@ -25,28 +34,19 @@
 #include <uhd/utils/byteswap.hpp>
 #include <uhd/utils/thread_priority.hpp>
 #include <uhd/transport/bounded_buffer.hpp>
+#include <uhd/transport/udp_zero_copy.hpp>
 #include <boost/format.hpp>
 #include <boost/bind.hpp>
+#include <boost/assign/list_of.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/barrier.hpp>
+#include <boost/foreach.hpp>
 #include <iostream>
 
 using namespace uhd;
 using namespace uhd::usrp;
 using namespace uhd::transport;
 namespace asio = boost::asio;
-namespace pt = boost::posix_time;
-
-/***********************************************************************
- * helpers
- **********************************************************************/
-static UHD_INLINE pt::time_duration to_time_dur(double timeout){
-    return pt::microseconds(long(timeout*1e6));
-}
-
-static UHD_INLINE double from_time_dur(const pt::time_duration &time_dur){
-    return 1e-6*time_dur.total_microseconds();
-}
 
 /***********************************************************************
  * constants
@@ -59,108 +59,321 @@ static const int underflow_flags = 0
 static const size_t vrt_send_header_offset_words32 = 1;
 
 /***********************************************************************
- * flow control monitor for a single tx channel
- *  - the pirate thread calls update
- *  - the get send buffer calls check
+ * receive stream over a set of dsp transports
+ *  - the device recv is a stream over all of the rx channels
+ *  - the channels of a stream are aligned on their timestamps
+ *  - separate streams share no state and can be read concurrently
+ *  - overflows are recovered in a thread, recv only signals them
  **********************************************************************/
-class flow_control_monitor{
+static UHD_INLINE void check_packet_count(
+    managed_recv_buffer::sptr &buff,
+    vrt::if_packet_info_t &prev_info
+){
+    //extract packet info
+    vrt::if_packet_info_t next_info;
+    next_info.num_packet_words32 = buff->size()/sizeof(boost::uint32_t);
+    vrt::if_hdr_unpack_be(buff->cast<const boost::uint32_t *>(), next_info);
+
+    //handle the packet count / sequence number
+    if ((prev_info.packet_count+1)%16 != next_info.packet_count){
+        UHD_MSG(fastpath) << "O"; //report overflow (drops in the kernel)
+    }
+    prev_info = next_info;
+}
+
+static managed_recv_buffer::sptr get_dsp_recv_buff(
+    const std::vector<zero_copy_if::sptr> &xports, size_t index, double timeout
+){
+    return xports[index]->get_recv_buff(timeout);
+}
+
+class usrp2_recv_stream : public rx_stream{
 public:
-    typedef boost::uint32_t seq_type;
-    typedef boost::shared_ptr<flow_control_monitor> sptr;
-
-    /*!
-     * Make a new flow control monitor.
-     * \param max_seqs_out num seqs before throttling
-     */
-    flow_control_monitor(seq_type max_seqs_out){
-        _last_seq_out = 0;
-        _last_seq_ack = 0;
-        _max_seqs_out = max_seqs_out;
-        _ready_fcn = boost::bind(&flow_control_monitor::ready, this);
-    }
-
-    /*!
-     * Check the flow control condition.
-     * \param seq the sequence to go out
-     * \param timeout the timeout in seconds
-     * \return false on timeout
-     */
-    UHD_INLINE bool check_fc_condition(seq_type seq, double timeout){
-        boost::unique_lock<boost::mutex> lock(_fc_mutex);
-        _last_seq_out = seq;
-        if (this->ready()) return true;
-        boost::this_thread::disable_interruption di; //disable because the wait can throw
-        return _fc_cond.timed_wait(lock, to_time_dur(timeout), _ready_fcn);
-    }
-
-    /*!
-     * Update the flow control condition.
-     * \param seq the last sequence number to be ACK'd
-     */
-    UHD_INLINE void update_fc_condition(seq_type seq){
-        boost::unique_lock<boost::mutex> lock(_fc_mutex);
-        _last_seq_ack = seq;
-        lock.unlock();
-        _fc_cond.notify_one();
+    typedef boost::function<void(const time_spec_t &)> observe_time_t;
+    typedef boost::function<void(size_t)> count_drops_t;
+
+    usrp2_recv_stream(
+        const std::vector<zero_copy_if::sptr> &xports,
+        double tick_rate, const otw_type_t &otw_type,
+        size_t max_num_samps, bool zero_fill, size_t num_workers,
+        const vrt_packet_handler::handle_overflow_t &recover_overflow,
+        const observe_time_t &observe_time,
+        const count_drops_t &count_align_drops
+    ):
+        _xports(xports),
+        _tick_rate(tick_rate),
+        _otw_type(otw_type),
+        _max_num_samps(max_num_samps),
+        _overflow_recovery(xports.size(), recover_overflow),
+        _handle_overflow(boost::ref(_overflow_recovery)),
+        _observe_time(observe_time),
+        _count_align_drops(count_align_drops),
+        _get_recv_buffs_fcn(boost::bind(&usrp2_recv_stream::get_recv_buffs, this, _1)),
+        _aligner(xports.size(), vrt_packet_handler::get_ticks_per_sec(tick_rate)),
+        _aligner_num_dropped_samps(0), _aligner_num_seq_gaps(0),
+        _state(xports.size(), zero_fill),
+        _frame_leases(vrt_packet_handler::frame_leases::make(
+            std::max<size_t>(1, xports.front()->get_num_recv_frames()/2)*xports.size()
+        ))
+    {
+        //init empty packet info
+        vrt::if_packet_info_t packet_info = vrt::if_packet_info_t();
+        packet_info.packet_count = 0xf;
+        packet_info.has_tsi = true;
+        packet_info.tsi = 0;
+        packet_info.has_tsf = true;
+        packet_info.tsf = 0;
+        _prev_info = packet_info;
+
+        //the workers read a quarter of the frames ahead, and hold a quarter until converted
+        if (num_workers > 1 and xports.size() > 1){
+            const size_t num_frames = xports.front()->get_num_recv_frames();
+            _workers.reset(new vrt_packet_handler::recv_workers(
+                xports.size(), num_workers,
+                boost::bind(&get_dsp_recv_buff, xports, _1, _2),
+                num_frames/4, num_frames/4
+            ));
+        }
     }
 
-private:
-    bool ready(void){
-        return seq_type(_last_seq_out -_last_seq_ack) < _max_seqs_out;
+    size_t get_num_channels(void) const{
+        return _xports.size();
+    }
+
+    size_t get_max_num_samps(void) const{
+        return _max_num_samps;
+    }
+
+    size_t recv(
+        const device::recv_buffs_type &buffs, size_t num_samps,
+        rx_metadata_t &metadata, const io_type_t &io_type,
+        device::recv_mode_t recv_mode, double timeout
+    ){
+        const size_t nsamps = this->recv_packets(buffs, num_samps, metadata, io_type, recv_mode, timeout);
+        this->observe_time(metadata);
+        return nsamps;
     }
 
-    boost::mutex _fc_mutex;
-    boost::condition _fc_cond;
-    seq_type _last_seq_out, _last_seq_ack, _max_seqs_out;
-    boost::function<bool(void)> _ready_fcn;
+    size_t recv_packets(
+        const device::recv_buffs_type &buffs, size_t num_samps,
+        rx_metadata_t &metadata, const io_type_t &io_type,
+        device::recv_mode_t recv_mode, double timeout
+    ){
+        _timeout = timeout;
+
+        //use the packet handler specialized for the common io types (otw type is always be 16-bit)
+        typedef vrt_packet_handler::vrt_codec_be codec;
+        if (_workers.get() != NULL) switch(io_type.tid){
+        case io_type_t::COMPLEX_FLOAT32: return _workers->recv(
+            _state, buffs, num_samps, metadata, recv_mode,
+            sizeof(std::complex<float>), vrt_packet_handler::static_converter<codec, std::complex<float> >::type(),
+            _tick_rate, vrt_packet_handler::vrt_codec_fcns<codec>(),
+            vrt_packet_handler::transport_buffs<usrp2_recv_stream>(*this), _handle_overflow
+        );
+        case io_type_t::COMPLEX_INT16: return _workers->recv(
+            _state, buffs, num_samps, metadata, recv_mode,
+            sizeof(std::complex<boost::int16_t>), vrt_packet_handler::static_converter<codec, std::complex<boost::int16_t> >::type(),
+            _tick_rate, vrt_packet_handler::vrt_codec_fcns<codec>(),
+            vrt_packet_handler::transport_buffs<usrp2_recv_stream>(*this), _handle_overflow
+        );
+        default: return _workers->recv(
+            _state, buffs, num_samps, metadata, recv_mode,
+            io_type.size, uhd::convert::get_converter_otw_to_cpu(io_type, _otw_type, 1, 1),
+            _tick_rate, uhd::transport::vrt::if_hdr_unpack_be,
+            _get_recv_buffs_fcn, _handle_overflow
+        );
+        }
+        switch(io_type.tid){
+        case io_type_t::COMPLEX_FLOAT32: return vrt_packet_handler::static_handler<codec, std::complex<float> >::recv(
+            _state, buffs, num_samps, metadata, recv_mode,
+            _tick_rate, *this, _handle_overflow
+        );
+        case io_type_t::COMPLEX_INT16: return vrt_packet_handler::static_handler<codec, std::complex<boost::int16_t> >::recv(
+            _state, buffs, num_samps, metadata, recv_mode,
+            _tick_rate, *this, _handle_overflow
+        );
+        default: break;
+        }
+
+        return vrt_packet_handler::recv(
+            _state,                                    //last state of the recv handler
+            buffs, num_samps,                          //buffer to fill
+            metadata, recv_mode,                       //samples metadata
+            io_type, _otw_type,                        //input and output types to convert
+            _tick_rate,                                //master clock tick rate
+            uhd::transport::vrt::if_hdr_unpack_be,
+            _get_recv_buffs_fcn,
+            _handle_overflow
+        );
+    }
+
+    size_t recv_frames(
+        std::vector<rx_frame> &frames, rx_metadata_t &metadata, double timeout
+    ){
+        //the caller holds at most half of the transport frames
+        if (not _frame_leases->wait_for_room(_xports.size(), timeout)){
+            metadata.error_code = rx_metadata_t::ERROR_CODE_TIMEOUT;
+            return 0;
+        }
+        _timeout = timeout;
+
+        const size_t nsamps = vrt_packet_handler::recv_frames(
+            _state, frames, metadata, _tick_rate,
+            vrt_packet_handler::vrt_codec_fcns<vrt_packet_handler::vrt_codec_be>(),
+            vrt_packet_handler::transport_buffs<usrp2_recv_stream>(*this), _handle_overflow
+        );
+
+        //the leased frames keep their transports alive
+        for (size_t i = 0; i < frames.size(); i++){
+            if (frames[i].buff.get() != NULL) frames[i].buff = _frame_leases->lease(frames[i].buff, _xports[i]);
+        }
+        this->observe_time(metadata);
+        return nsamps;
+    }
+
+    //the samples were received after their time (narrows the time model of the mboards)
+    void observe_time(const rx_metadata_t &metadata){
+        if (metadata.error_code != rx_metadata_t::ERROR_CODE_NONE or not metadata.has_time_spec) return;
+        _observe_time(metadata.time_spec);
+    }
+
+    bool get_recv_buffs(vrt_packet_handler::managed_recv_buffs_t &buffs){
+        if (buffs.size() == 1){
+            buffs[0] = _xports[0]->get_recv_buff(_timeout);
+            if (buffs[0].get() == NULL) return false;
+            //check the packet count to handle printing the overflows
+            check_packet_count(buffs[0], _prev_info);
+            return true;
+        }
+
+        //align the channels on their timestamps
+        UHD_ASSERT_THROW(_xports.size() == buffs.size());
+        const bool ok = _aligner.get_recv_buffs(buffs, *this, _timeout);
+
+        //report overflows (drops in the kernel) and samples dropped to align
+        if (_aligner.get_num_seq_gaps() != _aligner_num_seq_gaps){
+            _aligner_num_seq_gaps = _aligner.get_num_seq_gaps();
+            UHD_MSG(fastpath) << "O";
+        }
+        if (_aligner.get_num_dropped_samps() != _aligner_num_dropped_samps){
+            _count_align_drops(_aligner.get_num_dropped_samps() - _aligner_num_dropped_samps);
+            _aligner_num_dropped_samps = _aligner.get_num_dropped_samps();
+        }
+        return ok;
+    }
+
+    //get a buffer from the transport of a channel (used by the aligner)
+    managed_recv_buffer::sptr operator()(size_t index, double timeout) const{
+        if (_workers.get() != NULL) return (*_workers)(index, timeout);
+        return _xports[index]->get_recv_buff(timeout);
+    }
+
+private:
+    const std::vector<zero_copy_if::sptr> _xports;
+    const double _tick_rate;
+    const otw_type_t _otw_type;
+    const size_t _max_num_samps;
+
+    //the handler signals the overflows to the recovery thread
+    vrt_packet_handler::overflow_recovery _overflow_recovery;
+    const vrt_packet_handler::handle_overflow_t _handle_overflow;
+
+    //called with the timestamps of the received samples
+    const observe_time_t _observe_time;
+
+    //called with the number of samples dropped to align the channels
+    const count_drops_t _count_align_drops;
+
+    //timeout set on calls to recv (passed into get buffs methods)
+    double _timeout;
+
+    //bound callback for get buffs (bound once here, not in fast-path)
+    vrt_packet_handler::get_recv_buffs_t _get_recv_buffs_fcn;
+
+    //previous packet info of a single channel
+    vrt::if_packet_info_t _prev_info;
+
+    //optional parallel workers for multi-channel receive (read ahead and convert)
+    vrt_packet_handler::recv_workers::sptr _workers;
+
+    //multi-channel alignment logic and its counters at the last report
+    vrt_packet_handler::recv_aligner<vrt_packet_handler::vrt_codec_be> _aligner;
+    size_t _aligner_num_dropped_samps, _aligner_num_seq_gaps;
+
+    //state management for the vrt packet handler code
+    vrt_packet_handler::recv_state _state;
+
+    //the frames handed to the caller by recv frames
+    vrt_packet_handler::frame_leases::sptr _frame_leases;
 };
 
 /***********************************************************************
- * Alignment indexes class: keeps track of indexes
+ * gather send buffer of a dsp transport:
+ *  - holds the flow control word and the vrt header of a packet
+ *  - the gathered commit sends them with the payload in the io buffer
+ *  - reused for every packet by the send thread (armed while held)
  **********************************************************************/
-class alignment_indexes{
+class usrp2_gather_buffer : public vrt_packet_handler::gather_send_buffer{
 public:
-    alignment_indexes(void){_indexes = 0;}
-    void reset(size_t len){_indexes = (1 << len) - 1;}
-    size_t front(void){ //TODO replace with look-up table
-        size_t index = 0;
-        while ((_indexes & (1 << index)) == 0) index++;
-        return index;
-    }
-    void remove(size_t index){_indexes &= ~(1 << index);}
-    bool empty(void){return _indexes == 0;}
-private: size_t _indexes;
+    typedef boost::shared_ptr<usrp2_gather_buffer> sptr;
+
+    usrp2_gather_buffer(udp_zero_copy::sptr xport):
+        armed(false), _xport(xport)
+    {
+        _ref_count.write(0);
+    }
+
+    void commit(size_t num_bytes){
+        if (not armed) return; //sent or released already
+        armed = false;
+        if (num_bytes == 0) return;
+        UHD_ASSERT_THROW(num_bytes <= sizeof(_hdr));
+        const void *mems[] = {_hdr};
+        const size_t lens[] = {num_bytes};
+        _xport->send_gather(mems, lens, 1);
+    }
+
+    void commit_gather(size_t hdr_bytes, const void *payload, size_t payload_bytes){
+        if (not armed) return;
+        armed = false;
+        UHD_ASSERT_THROW(hdr_bytes <= sizeof(_hdr));
+        const void *mems[] = {_hdr, payload};
+        const size_t lens[] = {hdr_bytes, payload_bytes};
+        _xport->send_gather(mems, lens, 2);
+    }
+
+    bool armed;
+
+private:
+    void *get_buff(void) const{return const_cast<boost::uint32_t *>(_hdr);}
+    size_t get_size(void) const{return sizeof(_hdr);}
+
+    boost::uint32_t _hdr[vrt_send_header_offset_words32 + vrt::max_if_hdr_words32];
+    udp_zero_copy::sptr _xport;
 };
 
 /***********************************************************************
  * io impl details (internal to this file)
  * - pirate crew
- * - alignment buffer
+ * - receive stream
  * - thread loop
  * - vrt packet handler states
  **********************************************************************/
 struct usrp2_impl::io_impl{
 
-    io_impl(std::vector<zero_copy_if::sptr> &dsp_xports):
+    io_impl(std::vector<zero_copy_if::sptr> &dsp_xports, double tick_rate, size_t async_msg_depth):
         dsp_xports(dsp_xports), //the assumption is that all data transports should be identical
-        get_recv_buffs_fcn(boost::bind(&usrp2_impl::io_impl::get_recv_buffs, this, _1)),
+        ticks_per_sec(vrt_packet_handler::get_ticks_per_sec(tick_rate)),
         get_send_buffs_fcn(boost::bind(&usrp2_impl::io_impl::get_send_buffs, this, _1)),
-        async_msg_fifo(100/*messages deep*/)
+        fc_adapt(false), start_time(boost::get_system_time()),
+        async_msg_fifo(async_msg_depth)
     {
         for (size_t i = 0; i < dsp_xports.size(); i++){
             fc_mons.push_back(flow_control_monitor::sptr(new flow_control_monitor(
                 usrp2_impl::sram_bytes/dsp_xports.front()->get_send_frame_size()
-            )));;
+            )));
+            burst_trackers.push_back(burst_tracker::sptr(new burst_tracker()));
         }
-
-        //init empty packet infos
-        vrt::if_packet_info_t packet_info = vrt::if_packet_info_t();
-        packet_info.packet_count = 0xf;
-        packet_info.has_tsi = true;
-        packet_info.tsi = 0;
-        packet_info.has_tsf = true;
-        packet_info.tsf = 0;
-        prev_infos.resize(dsp_xports.size(), packet_info);
     }
 
     ~io_impl(void){
@@ -176,7 +389,14 @@ struct usrp2_impl::io_impl{
         const boost::uint32_t fc_word32 = packet_handler_send_state.next_packet_seq;
 
         //grab a managed buffer for each index
+        //(the stager waits on the flow control when the frame goes out)
         for (size_t i = 0; i < buffs.size(); i++){
+            if (tx_stager.get() != NULL){
+                buffs[i] = tx_stager->get_send_buff(send_map[i], fc_word32, send_timeout);
+                if (not buffs[i].get()) return false;
+                buffs[i]->cast<boost::uint32_t *>()[0] = uhd::htonx(fc_word32);
+                continue;
+            }
             if (not fc_mons[send_map[i]]->check_fc_condition(fc_word32, send_timeout)) return false;
             buffs[i] = dsp_xports[send_map[i]]->get_send_buff(send_timeout);
             if (not buffs[i].get()) return false;
@@ -185,30 +405,76 @@ struct usrp2_impl::io_impl{
         return true;
     }
 
-    alignment_indexes indexes_to_do; //used in alignment logic
-    time_spec_t expected_time; //used in alignment logic
-    bool get_recv_buffs(vrt_packet_handler::managed_recv_buffs_t &buffs);
+    //the gather buffers of the dsp xports (empty unless all are udp)
+    std::vector<usrp2_gather_buffer::sptr> gather_buffs;
+
+    bool get_gather_buffs(vrt_packet_handler::managed_send_buffs_t &buffs){
+        UHD_ASSERT_THROW(send_map.size() == buffs.size());
+        const boost::uint32_t fc_word32 = packet_handler_send_state.next_packet_seq;
+        for (size_t i = 0; i < buffs.size(); i++){
+            if (not fc_mons[send_map[i]]->check_fc_condition(fc_word32, send_timeout)) return false;
+            usrp2_gather_buffer &buff = *gather_buffs[send_map[i]];
+            buff.cast<boost::uint32_t *>()[0] = uhd::htonx(fc_word32);
+            buff.armed = true;
+            //add a reference: the send state may still hold the buffer from its last packet
+            buffs[i] = managed_send_buffer::sptr(&buff);
+        }
+        return true;
+    }
+
+    //calls get gather buffs for the packet handler
+    struct gather_transport{
+        io_impl &impl;
+        gather_transport(io_impl &impl): impl(impl){}
+        UHD_INLINE bool get_send_buffs(vrt_packet_handler::managed_send_buffs_t &buffs){
+            return impl.get_gather_buffs(buffs);
+        }
+    };
 
     std::vector<zero_copy_if::sptr> &dsp_xports;
 
+    //ticks per second of the timestamps (used in alignment logic)
+    const boost::uint64_t ticks_per_sec;
+
     //mappings from channel index to dsp xport
     std::vector<size_t> send_map, recv_map;
 
-    //timeouts set on calls to recv/send (passed into get buffs methods)
-    double recv_timeout, send_timeout;
+    //timeout set on calls to send (passed into get buffs methods)
+    double send_timeout;
 
-    //bound callbacks for get buffs (bound once here, not in fast-path)
-    vrt_packet_handler::get_recv_buffs_t get_recv_buffs_fcn;
+    //bound callback for get buffs (bound once here, not in fast-path)
     vrt_packet_handler::get_send_buffs_t get_send_buffs_fcn;
 
-    //previous state for each buffer
-    std::vector<vrt::if_packet_info_t> prev_infos;
-
-    //flow control monitors
+    //flow control monitors and their tuners (tuned when adapt is set)
     std::vector<flow_control_monitor::sptr> fc_mons;
+    std::vector<flow_control_tuner::sptr> fc_tuners;
+    bool fc_adapt;
+    void tune_flow_control(usrp2_mboard_impl::sptr, size_t);
+
+    //the host time in seconds (since the io impl was made)
+    const boost::system_time start_time;
+    double get_host_time(void) const{
+        return double((boost::get_system_time() - start_time).total_microseconds())/1e6;
+    }
+
+    //the bursts of the tx dsps waiting on their acks
+    std::vector<burst_tracker::sptr> burst_trackers;
+
+    //the send condition of a staged frame (called in the stager thread)
+    bool check_fc_condition(size_t index, boost::uint32_t seq, double timeout){
+        return fc_mons[index]->check_fc_condition(seq, timeout);
+    }
+
+    //stages the send frames when set (after the monitors, before the send state)
+    send_stager::sptr tx_stager;
+
+    //the device recv is a stream over all of the rx channels
+    rx_stream::sptr recv_stream;
+
+    //the fan-outs of the dsp xports with subscribers (kept alive by the subscribers)
+    uhd::dict<size_t, boost::weak_ptr<recv_fanout> > recv_fanouts;
 
     //state management for the vrt packet handler code
-    vrt_packet_handler::recv_state packet_handler_recv_state;
     vrt_packet_handler::send_state packet_handler_send_state;
 
     //methods and variables for the pirate crew
@@ -216,6 +482,7 @@ struct usrp2_impl::io_impl{
     boost::thread_group recv_pirate_crew;
     bool recv_pirate_crew_raiding;
     bounded_buffer<async_metadata_t> async_msg_fifo;
+    atomic_uint32_t async_msg_num_dropped;
 };
 
 /***********************************************************************
@@ -234,11 +501,9 @@ void usrp2_impl::io_impl::recv_pirate_loop(
     spawn_barrier.wait();
     set_thread_priority_safe();
 
-    //store a reference to the flow control monitor (offset by max dsps)
-    flow_control_monitor &fc_mon = *(this->fc_mons[index*usrp2_mboard_impl::MAX_NUM_DSPS]);
-
     while(recv_pirate_crew_raiding){
         managed_recv_buffer::sptr buff = err_xport->get_recv_buff();
+        if (fc_adapt) this->tune_flow_control(mboard, index);
         if (not buff.get()) continue; //ignore timeout/error buffers
 
         try{
@@ -249,28 +514,53 @@ void usrp2_impl::io_impl::recv_pirate_loop(
             vrt::if_hdr_unpack_be(vrt_hdr, if_packet_info);
 
             //handle a tx async report message
-            if (if_packet_info.sid == usrp2_impl::ASYNC_SID and if_packet_info.packet_type != vrt::if_packet_info_t::PACKET_TYPE_DATA){
+            if (usrp2_impl::is_async_sid(if_packet_info.sid) and if_packet_info.packet_type != vrt::if_packet_info_t::PACKET_TYPE_DATA){
 
                 //fill in the async metadata
                 async_metadata_t metadata;
                 metadata.channel = index;
                 metadata.has_time_spec = if_packet_info.has_tsi and if_packet_info.has_tsf;
-                metadata.time_spec = time_spec_t(
-                    time_t(if_packet_info.tsi), size_t(if_packet_info.tsf), mboard->get_master_clock_freq()
+                metadata.time_spec = vrt_packet_handler::ticks_to_time_spec(
+                    vrt_packet_handler::get_ticks(if_packet_info, ticks_per_sec), mboard->get_master_clock_freq()
                 );
-                metadata.event_code = vrt_packet_handler::get_context_code<async_metadata_t::event_code_t>(vrt_hdr, if_packet_info);
+                metadata.event_code = vrt_packet_handler::get_context_code_be<async_metadata_t::event_code_t>(vrt_hdr, if_packet_info);
 
-                //catch the flow control packets and react
+                //catch the flow control packets and credit the monitor of the dsp (offset by max dsps)
                 if (metadata.event_code == 0){
                     boost::uint32_t fc_word32 = (vrt_hdr + if_packet_info.num_header_words32)[1];
-                    fc_mon.update_fc_condition(uhd::ntohx(fc_word32));
+                    const size_t dsp = usrp2_impl::get_async_sid_dsp(if_packet_info.sid);
+                    if (dsp < usrp2_mboard_impl::MAX_NUM_DSPS){
+                        const size_t dsp_index = index*usrp2_mboard_impl::MAX_NUM_DSPS + dsp;
+                        fc_mons[dsp_index]->update_fc_condition(uhd::ntohx(fc_word32));
+                        fc_tuners[dsp_index]->on_ack(uhd::ntohx(fc_word32));
+                        double rtt;
+                        if (fc_mons[dsp_index]->pop_rtt(rtt)) fc_tuners[dsp_index]->on_rtt(rtt);
+                    }
                     continue;
                 }
 
+                //the report was sent after its time (narrows the time model of the mboard)
+                if (metadata.has_time_spec) mboard->observe_time(metadata.time_spec);
+
+                //match the burst acks to the bursts of the dsp
+                if (metadata.event_code == async_metadata_t::EVENT_CODE_BURST_ACK){
+                    const size_t dsp = usrp2_impl::get_async_sid_dsp(if_packet_info.sid);
+                    double latency;
+                    if (dsp < usrp2_mboard_impl::MAX_NUM_DSPS) burst_trackers[index*usrp2_mboard_impl::MAX_NUM_DSPS + dsp]->ack(
+                        vrt_packet_handler::get_context_seq_be(vrt_hdr, if_packet_info), get_host_time(), latency
+                    );
+                }
+
                 //print the famous U, and push the metadata into the message queue
-                if (metadata.event_code & underflow_flags) UHD_MSG(fastpath) << "U";
+                if (metadata.event_code & underflow_flags){
+                    UHD_MSG(fastpath) << "U";
+                    const size_t dsp = usrp2_impl::get_async_sid_dsp(if_packet_info.sid);
+                    if (dsp < usrp2_mboard_impl::MAX_NUM_DSPS){
+                        fc_tuners[index*usrp2_mboard_impl::MAX_NUM_DSPS + dsp]->on_underflow();
+                    }
+                }
                 //else UHD_MSG(often) << "metadata.event_code " << metadata.event_code << std::endl;
-                async_msg_fifo.push_with_pop_on_full(metadata);
+                if (not async_msg_fifo.push_with_pop_on_full(metadata)) async_msg_num_dropped.inc();
             }
             else{
                 //TODO unknown received packet, may want to print error...
@@ -281,13 +571,58 @@ void usrp2_impl::io_impl::recv_pirate_loop(
     }
 }
 
+/***********************************************************************
+ * Tune the flow control of the tx dsps of an mboard (in its pirate thread)
+ * - apply the window to the monitor
+ * - request the ack cadence of the mboard (its housekeeping thread
+ *   makes the control transaction, the pirate thread keeps draining)
+ **********************************************************************/
+void usrp2_impl::io_impl::tune_flow_control(usrp2_mboard_impl::sptr mboard, size_t index){
+    const double now = get_host_time();
+    for (size_t dsp = 0; dsp < usrp2_mboard_impl::NUM_TX_DSPS; dsp++){
+        const size_t dsp_index = index*usrp2_mboard_impl::MAX_NUM_DSPS + dsp;
+        flow_control_tuner &tuner = *fc_tuners[dsp_index];
+        if (not tuner.update(now)) continue;
+        fc_mons[dsp_index]->set_max_seqs_out(flow_control_monitor::seq_type(tuner.get_window()));
+        mboard->request_tx_packets_per_up(tuner.get_packets_per_up());
+    }
+}
+
 /***********************************************************************
  * Helper Functions
  **********************************************************************/
 void usrp2_impl::io_init(void){
 
     //create new io impl
-    _io_impl = UHD_PIMPL_MAKE(io_impl, (dsp_xports));
+    _io_impl = UHD_PIMPL_MAKE(io_impl, (dsp_xports, _mboards.front()->get_master_clock_freq(), _async_msg_depth));
+
+    //the tuners start from the configured window and ack cadence
+    for (size_t i = 0; i < dsp_xports.size(); i++){
+        _io_impl->fc_tuners.push_back(flow_control_tuner::sptr(new flow_control_tuner(
+            _io_impl->fc_mons[i]->get_max_seqs_out(),
+            _mboards.at(i/usrp2_mboard_impl::MAX_NUM_DSPS)->get_tx_packets_per_up()
+        )));
+    }
+    _io_impl->fc_adapt = _tx_fc_adapt;
+
+    //the stager takes over the flow control waits and the sends
+    if (_tx_stage_samps != 0){
+        _io_impl->tx_stager.reset(new send_stager(
+            dsp_xports, _tx_stage_samps, _tx_otw_type.get_sample_size(),
+            (vrt_send_header_offset_words32 + 1)*sizeof(boost::uint32_t), //the offset and the vrt header word
+            boost::bind(&usrp2_impl::io_impl::check_fc_condition, _io_impl.get(), _1, _2, _3)
+        ));
+    }
+
+    //the wire format io type is sent without a copy when all dsp xports are udp
+    BOOST_FOREACH(zero_copy_if::sptr xport, dsp_xports){
+        udp_zero_copy::sptr udp_xport = boost::dynamic_pointer_cast<udp_zero_copy>(xport);
+        if (udp_xport.get() == NULL){
+            _io_impl->gather_buffs.clear();
+            break;
+        }
+        _io_impl->gather_buffs.push_back(usrp2_gather_buffer::sptr(new usrp2_gather_buffer(udp_xport)));
+    }
 
     //create a new pirate thread for each zc if (yarr!!)
     boost::barrier spawn_barrier(_mboards.size()+1);
@@ -327,7 +662,10 @@ void usrp2_impl::update_xport_channel_mapping(void){
 
     }
 
-    _io_impl->packet_handler_recv_state = vrt_packet_handler::recv_state(_io_impl->recv_map.size());
+    _io_impl->recv_stream.reset(); //release the transports before the new stream
+    std::vector<zero_copy_if::sptr> xports;
+    BOOST_FOREACH(size_t dsp_index, _io_impl->recv_map) xports.push_back(dsp_xports.at(dsp_index));
+    _io_impl->recv_stream = make_recv_stream(_io_impl->recv_map, xports);
     _io_impl->packet_handler_send_state = vrt_packet_handler::send_state(_io_impl->send_map.size());
 }
 
@@ -341,6 +679,102 @@ bool usrp2_impl::recv_async_msg(
     return _io_impl->async_msg_fifo.pop_with_timed_wait(async_metadata, timeout);
 }
 
+prop_names_t usrp2_impl::get_tx_sensor_names(void){
+    prop_names_t names = boost::assign::list_of
+        ("tx_fc_window")("tx_fc_occupancy")("tx_fc_rtt")("tx_fc_packets_per_up");
+    if (_tx_stage_samps != 0){
+        names.push_back("tx_stage_depth");
+        names.push_back("tx_stage_peak_depth");
+        names.push_back("tx_stage_mean_depth");
+        names.push_back("tx_stage_num_blocks");
+    }
+    names.push_back("tx_async_num_dropped");
+    names.push_back("tx_burst_num_acked");
+    names.push_back("tx_burst_num_lost");
+    names.push_back("tx_burst_latency_mean");
+    names.push_back("tx_burst_latency_max");
+    return names;
+}
+
+sensor_value_t usrp2_impl::get_tx_sensor(size_t dsp_index, const std::string &name){
+    UHD_ASSERT_THROW(_io_impl.get() != NULL);
+    flow_control_monitor &fc_mon = *_io_impl->fc_mons.at(dsp_index);
+    send_stager::sptr stager = _io_impl->tx_stager;
+    if (stager.get() != NULL and name == "tx_stage_depth"){
+        return sensor_value_t("TX stage depth", int(stager->get_depth(dsp_index)), "samples");
+    }
+    if (stager.get() != NULL and name == "tx_stage_peak_depth"){
+        return sensor_value_t("TX stage peak depth", int(stager->get_peak_depth(dsp_index)), "samples");
+    }
+    if (stager.get() != NULL and name == "tx_stage_mean_depth"){
+        return sensor_value_t("TX stage mean depth", stager->get_mean_depth(dsp_index), "samples");
+    }
+    if (stager.get() != NULL and name == "tx_stage_num_blocks"){
+        return sensor_value_t("TX stage blocked sends", int(stager->get_num_blocks(dsp_index)), "");
+    }
+    if (name == "tx_fc_window"){
+        return sensor_value_t("TX FC window", int(fc_mon.get_max_seqs_out()), "packets");
+    }
+    if (name == "tx_fc_occupancy"){
+        return sensor_value_t("TX FC occupancy", int(fc_mon.get_num_seqs_out()), "packets");
+    }
+    if (name == "tx_fc_rtt"){
+        return sensor_value_t("TX FC RTT", _io_impl->fc_tuners.at(dsp_index)->get_rtt(), "seconds");
+    }
+    burst_tracker &tracker = *_io_impl->burst_trackers.at(dsp_index);
+    if (name == "tx_async_num_dropped"){
+        return sensor_value_t("TX async messages dropped", int(_io_impl->async_msg_num_dropped.read()), "");
+    }
+    if (name == "tx_burst_num_acked"){
+        return sensor_value_t("TX bursts acked", int(tracker.get_num_acked()), "");
+    }
+    if (name == "tx_burst_num_lost"){
+        return sensor_value_t("TX bursts without ack", int(tracker.get_num_lost()), "");
+    }
+    if (name == "tx_burst_latency_mean"){
+        return sensor_value_t("TX burst latency (mean)", tracker.get_latency_mean(), "seconds");
+    }
+    if (name == "tx_burst_latency_max"){
+        return sensor_value_t("TX burst latency (max)", tracker.get_latency_max(), "seconds");
+    }
+    if (name == "tx_fc_packets_per_up"){
+        return sensor_value_t("TX FC packets per update", int(
+            _mboards.at(dsp_index/usrp2_mboard_impl::MAX_NUM_DSPS)->get_tx_packets_per_up()
+        ), "packets");
+    }
+    throw uhd::key_error("unknown tx sensor: " + name);
+}
+
+/***********************************************************************
+ * Stream Commands
+ * - the channels are grouped by mboard, one control batch per mboard
+ * - the batches go out concurrently, so the time to issue the command
+ *   to all channels is about one control round trip, not one per channel
+ **********************************************************************/
+double usrp2_impl::issue_stream_cmd(const stream_cmd_t &stream_cmd, const std::vector<size_t> &chans){
+    UHD_ASSERT_THROW(_io_impl.get() != NULL);
+
+    std::vector<std::vector<size_t> > mboard_dsps(_mboards.size());
+    BOOST_FOREACH(size_t chan, chans){
+        const size_t dsp_index = _io_impl->recv_map.at(chan);
+        mboard_dsps.at(dsp_index/usrp2_mboard_impl::MAX_NUM_DSPS).push_back(dsp_index%usrp2_mboard_impl::MAX_NUM_DSPS);
+    }
+
+    std::vector<concurrent_issuer::issue_type> issues;
+    for (size_t i = 0; i < _mboards.size(); i++){
+        if (mboard_dsps[i].empty()) continue;
+        issues.push_back(boost::bind(
+            &usrp2_mboard_impl::issue_ddc_stream_cmds, _mboards[i], stream_cmd, mboard_dsps[i]
+        ));
+    }
+    const double skew = _mboard_issuer->issue(issues);
+
+    boost::mutex::scoped_lock lock(_ctrl_stats_mutex);
+    _stream_cmd_skew = skew;
+    _stream_cmd_skew_max = std::max(_stream_cmd_skew_max, skew);
+    return skew;
+}
+
 /***********************************************************************
  * Send Data
  **********************************************************************/
@@ -350,7 +784,7 @@ size_t usrp2_impl::get_max_send_samps_per_packet(void) const{
         + vrt_send_header_offset_words32*sizeof(boost::uint32_t)
         - sizeof(vrt::if_packet_info_t().cid) //no class id ever used
     ;
-    const size_t bpp = dsp_xports.front()->get_send_frame_size() - hdr_size;
+    const size_t bpp = send_frame_size - hdr_size;
     return bpp/_tx_otw_type.get_sample_size();
 }
 
@@ -360,12 +794,62 @@ size_t usrp2_impl::send(
     send_mode_t send_mode, double timeout
 ){
     _io_impl->send_timeout = timeout;
+    const size_t num_sent = this->send_packets(buffs, num_samps, metadata, io_type, send_mode);
+
+    //the end of burst went out: track the burst until its ack
+    if (metadata.end_of_burst and num_sent != 0 and (
+        send_mode == SEND_MODE_ONE_PACKET or num_samps <= get_max_send_samps_per_packet() or num_sent == num_samps
+    )){
+        const boost::uint32_t eob_seq = _io_impl->packet_handler_send_state.next_packet_seq - 1;
+        const double now = _io_impl->get_host_time();
+        BOOST_FOREACH(size_t dsp_index, _io_impl->send_map){
+            _io_impl->burst_trackers[dsp_index]->sent(eob_seq, now);
+        }
+    }
+    return num_sent;
+}
+
+size_t usrp2_impl::send_packets(
+    const send_buffs_type &buffs, size_t num_samps,
+    const tx_metadata_t &metadata, const io_type_t &io_type,
+    send_mode_t send_mode
+){
+    const double tick_rate = _mboards.front()->get_master_clock_freq();
+
+    //use the packet handler specialized for the common io types (otw type is always be 16-bit)
+    typedef vrt_packet_handler::vrt_codec_be codec;
+    switch(io_type.tid){
+    case io_type_t::COMPLEX_FLOAT32: return vrt_packet_handler::static_handler<codec, std::complex<float> >::send(
+        _io_impl->packet_handler_send_state, buffs, num_samps, metadata, send_mode,
+        tick_rate, *_io_impl, get_max_send_samps_per_packet(), vrt_send_header_offset_words32
+    );
+    case io_type_t::COMPLEX_INT16: return vrt_packet_handler::static_handler<codec, std::complex<boost::int16_t> >::send(
+        _io_impl->packet_handler_send_state, buffs, num_samps, metadata, send_mode,
+        tick_rate, *_io_impl, get_max_send_samps_per_packet(), vrt_send_header_offset_words32
+    );
+    case io_type_t::COMPLEX_INT16_ITEM32_BE:{
+        //the samples are the payload: gather them into the packets (unless the stager holds the frames)
+        if (_io_impl->tx_stager.get() == NULL and not _io_impl->gather_buffs.empty()){
+            io_impl::gather_transport gather_xport(*_io_impl);
+            return vrt_packet_handler::static_handler<codec, item32_t, vrt_packet_handler::gather_converter>::send(
+                _io_impl->packet_handler_send_state, buffs, num_samps, metadata, send_mode,
+                tick_rate, gather_xport, get_max_send_samps_per_packet(), vrt_send_header_offset_words32
+            );
+        }
+        return vrt_packet_handler::static_handler<codec, item32_t, vrt_packet_handler::copy_converter<codec> >::send(
+            _io_impl->packet_handler_send_state, buffs, num_samps, metadata, send_mode,
+            tick_rate, *_io_impl, get_max_send_samps_per_packet(), vrt_send_header_offset_words32
+        );
+    }
+    default: break;
+    }
+
     return vrt_packet_handler::send(
         _io_impl->packet_handler_send_state,       //last state of the send handler
         buffs, num_samps,                          //buffer to fill
         metadata, send_mode,                       //samples metadata
         io_type, _tx_otw_type,                     //input and output types to convert
-        _mboards.front()->get_master_clock_freq(), //master clock tick rate
+        tick_rate,                                 //master clock tick rate
         uhd::transport::vrt::if_hdr_pack_be,
         _io_impl->get_send_buffs_fcn,
         get_max_send_samps_per_packet(),
@@ -374,141 +858,79 @@ size_t usrp2_impl::send(
 }
 
 /***********************************************************************
- * Alignment logic on receive
+ * Receive Data
  **********************************************************************/
-static UHD_INLINE time_spec_t extract_time_spec(
-    const vrt::if_packet_info_t &packet_info
-){
-    return time_spec_t( //assumes has_tsi and has_tsf are true
-        time_t(packet_info.tsi), size_t(packet_info.tsf),
-        100e6 //tick rate does not have to be correct for comparison purposes
-    );
+size_t usrp2_impl::get_max_recv_samps_per_packet(void) const{
+    static const size_t hdr_size = 0
+        + vrt::max_if_hdr_words32*sizeof(boost::uint32_t)
+        + sizeof(vrt::if_packet_info_t().tlr) //forced to have trailer
+        - sizeof(vrt::if_packet_info_t().cid) //no class id ever used
+    ;
+    const size_t bpp = recv_frame_size - hdr_size;
+    return bpp/_rx_otw_type.get_sample_size();
 }
 
-static UHD_INLINE void extract_packet_info(
-    managed_recv_buffer::sptr &buff,
-    vrt::if_packet_info_t &prev_info,
-    time_spec_t &time, bool &clear, bool &msg
-){
-    //extract packet info
-    vrt::if_packet_info_t next_info;
-    next_info.num_packet_words32 = buff->size()/sizeof(boost::uint32_t);
-    vrt::if_hdr_unpack_be(buff->cast<const boost::uint32_t *>(), next_info);
-
-    //handle the packet count / sequence number
-    if ((prev_info.packet_count+1)%16 != next_info.packet_count){
-        UHD_MSG(fastpath) << "O"; //report overflow (drops in the kernel)
-    }
-
-    time = extract_time_spec(next_info);
-    clear = extract_time_spec(prev_info) > time;
-    msg = next_info.packet_type != vrt::if_packet_info_t::PACKET_TYPE_DATA;
-    prev_info = next_info;
+void usrp2_impl::handle_overflow(const std::vector<size_t> &dsp_indexes, size_t index){
+    UHD_MSG(fastpath) << "O";
+    const size_t dsp_index = dsp_indexes.at(index);
+    _mboards.at(dsp_index/usrp2_mboard_impl::MAX_NUM_DSPS)->handle_overflow(dsp_index%usrp2_mboard_impl::MAX_NUM_DSPS);
 }
 
-static UHD_INLINE bool handle_msg_packet(
-    vrt_packet_handler::managed_recv_buffs_t &buffs, size_t index
+rx_stream::sptr usrp2_impl::make_recv_stream(
+    const std::vector<size_t> &dsp_indexes, const std::vector<zero_copy_if::sptr> &xports
 ){
-    for (size_t i = 0; i < buffs.size(); i++){
-        if (i == index) continue;
-        buffs[i].reset(); //set NULL
-    }
-    return true;
+    return rx_stream::sptr(new usrp2_recv_stream(
+        xports, _mboards.at(dsp_indexes.front()/usrp2_mboard_impl::MAX_NUM_DSPS)->get_master_clock_freq(),
+        _rx_otw_type, get_max_recv_samps_per_packet(), _recv_zero_fill, _recv_num_workers,
+        boost::bind(&usrp2_impl::handle_overflow, this, dsp_indexes, _1),
+        boost::bind(&usrp2_impl::observe_rx_time, this, dsp_indexes, _1),
+        boost::bind(&usrp2_impl::count_rx_align_drops, this, _1)
+    ));
 }
 
-UHD_INLINE bool usrp2_impl::io_impl::get_recv_buffs(
-    vrt_packet_handler::managed_recv_buffs_t &buffs
-){
-    if (buffs.size() == 1){
-        buffs[0] = dsp_xports[recv_map[0]]->get_recv_buff(recv_timeout);
-        if (buffs[0].get() == NULL) return false;
-        bool clear, msg; time_spec_t time; //unused variables
-        //call extract_packet_info to handle printing the overflows
-        extract_packet_info(buffs[0], this->prev_infos[recv_map[0]], time, clear, msg);
-        return true;
-    }
-    //-------------------- begin alignment logic ---------------------//
-    UHD_ASSERT_THROW(recv_map.size() == buffs.size());
-    boost::system_time exit_time = boost::get_system_time() + to_time_dur(recv_timeout);
-    managed_recv_buffer::sptr buff_tmp;
-    bool clear, msg;
-    size_t index;
-
-    //If we did not enter this routine with an empty indexes set,
-    //jump to after the clear so we can preserve the previous state.
-    //This saves buffers from being lost when using non-blocking recv.
-    if (not indexes_to_do.empty()) goto skip_pop_initial;
-
-    //respond to a clear by starting from scratch
-    got_clear:
-    indexes_to_do.reset(buffs.size());
-    clear = false;
-
-    //do an initial pop to load an initial sequence id
-    index = indexes_to_do.front();
-    buff_tmp = dsp_xports[recv_map[index]]->get_recv_buff(from_time_dur(exit_time - boost::get_system_time()));
-    if (buff_tmp.get() == NULL) return false;
-    extract_packet_info(buff_tmp, this->prev_infos[recv_map[index]], expected_time, clear, msg);
-    if (clear) goto got_clear;
-    buffs[index] = buff_tmp;
-    if (msg) return handle_msg_packet(buffs, index);
-    indexes_to_do.remove(index);
-    skip_pop_initial:
-
-    //get an aligned set of elements from the buffers:
-    while(not indexes_to_do.empty()){
-
-        //pop an element off for this index
-        index = indexes_to_do.front();
-        buff_tmp = dsp_xports[recv_map[index]]->get_recv_buff(from_time_dur(exit_time - boost::get_system_time()));
-        if (buff_tmp.get() == NULL) return false;
-        time_spec_t this_time;
-        extract_packet_info(buff_tmp, this->prev_infos[recv_map[index]], this_time, clear, msg);
-        if (clear) goto got_clear;
-        buffs[index] = buff_tmp;
-        if (msg) return handle_msg_packet(buffs, index);
-
-        //if the sequence id matches:
-        //  remove this index from the list and continue
-        if (this_time == expected_time){
-            indexes_to_do.remove(index);
-        }
-
-        //if the sequence id is newer:
-        //  use the new expected time for comparison
-        //  add all other indexes back into the list
-        else if (this_time > expected_time){
-            expected_time = this_time;
-            indexes_to_do.reset(buffs.size());
-            indexes_to_do.remove(index);
-        }
-
-        //if the sequence id is older:
-        //  continue with the same index to try again
-        //else if (this_time < expected_time)...
+void usrp2_impl::count_rx_align_drops(size_t num_samps){
+    boost::mutex::scoped_lock lock(_ctrl_stats_mutex);
+    _rx_align_num_dropped += num_samps;
+}
 
+void usrp2_impl::observe_rx_time(const std::vector<size_t> &dsp_indexes, const time_spec_t &time_spec){
+    BOOST_FOREACH(size_t dsp_index, dsp_indexes){
+        _mboards.at(dsp_index/usrp2_mboard_impl::MAX_NUM_DSPS)->observe_time(time_spec);
     }
-    return true;
-    //-------------------- end alignment logic -----------------------//
 }
 
-/***********************************************************************
- * Receive Data
- **********************************************************************/
-size_t usrp2_impl::get_max_recv_samps_per_packet(void) const{
-    static const size_t hdr_size = 0
-        + vrt::max_if_hdr_words32*sizeof(boost::uint32_t)
-        + sizeof(vrt::if_packet_info_t().tlr) //forced to have trailer
-        - sizeof(vrt::if_packet_info_t().cid) //no class id ever used
-    ;
-    const size_t bpp = dsp_xports.front()->get_recv_frame_size() - hdr_size;
-    return bpp/_rx_otw_type.get_sample_size();
+rx_stream::sptr usrp2_impl::get_rx_stream(const std::vector<size_t> &chans){
+    UHD_ASSERT_THROW(not chans.empty());
+    std::vector<size_t> dsp_indexes;
+    std::vector<zero_copy_if::sptr> xports;
+    BOOST_FOREACH(size_t chan, chans){
+        dsp_indexes.push_back(_io_impl->recv_map.at(chan));
+        xports.push_back(dsp_xports.at(dsp_indexes.back()));
+    }
+    return make_recv_stream(dsp_indexes, xports);
 }
 
-void usrp2_impl::handle_overflow(size_t chan){
-    UHD_MSG(fastpath) << "O";
-    ldiv_t indexes = ldiv(chan, usrp2_mboard_impl::NUM_RX_DSPS);
-    _mboards.at(indexes.quot)->handle_overflow(indexes.rem);
+rx_stream::sptr usrp2_impl::subscribe_rx_stream(
+    const std::vector<size_t> &chans, size_t depth, subscriber_policy_t policy
+){
+    UHD_ASSERT_THROW(not chans.empty());
+    std::vector<size_t> dsp_indexes;
+    std::vector<zero_copy_if::sptr> xports;
+    BOOST_FOREACH(size_t chan, chans){
+        dsp_indexes.push_back(_io_impl->recv_map.at(chan));
+
+        //share the fan-out of the dsp xport, make one for the first subscriber
+        recv_fanout::sptr fanout;
+        if (_io_impl->recv_fanouts.has_key(dsp_indexes.back())) fanout = _io_impl->recv_fanouts[dsp_indexes.back()].lock();
+        if (fanout.get() == NULL){
+            fanout = recv_fanout::make(dsp_xports.at(dsp_indexes.back()));
+            _io_impl->recv_fanouts[dsp_indexes.back()] = fanout;
+        }
+        xports.push_back(fanout->subscribe(depth,
+            (policy == SUBSCRIBER_DROP_OLDEST)? recv_fanout::DROP_OLDEST : recv_fanout::DROP_NEWEST
+        ));
+    }
+    return make_recv_stream(dsp_indexes, xports);
 }
 
 size_t usrp2_impl::recv(
@@ -516,15 +938,5 @@ size_t usrp2_impl::recv(
     rx_metadata_t &metadata, const io_type_t &io_type,
     recv_mode_t recv_mode, double timeout
 ){
-    _io_impl->recv_timeout = timeout;
-    return vrt_packet_handler::recv(
-        _io_impl->packet_handler_recv_state,       //last state of the recv handler
-        buffs, num_samps,                          //buffer to fill
-        metadata, recv_mode,                       //samples metadata
-        io_type, _rx_otw_type,                     //input and output types to convert
-        _mboards.front()->get_master_clock_freq(), //master clock tick rate
-        uhd::transport::vrt::if_hdr_unpack_be,
-        _io_impl->get_recv_buffs_fcn,
-        boost::bind(&usrp2_impl::handle_overflow, this, _1)
-    );
+    return _io_impl->recv_stream->recv(buffs, num_samps, metadata, io_type, recv_mode, timeout);
 }
@@ -62,12 +62,11 @@ static void init_xport(zero_copy_if::sptr xport){
  **********************************************************************/
 usrp2_mboard_impl::usrp2_mboard_impl(
     const device_addr_t &device_addr,
-    size_t index, usrp2_impl &device
+    size_t index, usrp2_impl &device,
+    usrp2_iface::sptr iface,
+    const device_addr_t &cached_desc
 ):
-    _index(index), _device(device),
-    _iface(usrp2_iface::make(udp_simple::make_connected(
-        device_addr["addr"], BOOST_STRINGIZE(USRP2_UDP_CTRL_PORT)
-    )))
+    _index(index), _device(device), _iface(iface)
 {
 
     //check the fpga compatibility number
@@ -84,24 +83,32 @@ usrp2_mboard_impl::usrp2_mboard_impl(
     //lock the device/motherboard to this process
     _iface->lock_device(true);
 
+    //skip redundant register transactions when requested
+    _iface->set_reg_shadow_enabled(device_addr.cast<int>("shadow_regs", 0) != 0);
+
     //construct transports for dsp and async errors
+    //(mboards are made in parallel, only touch the slots for this index)
+    zero_copy_if::sptr &dsp0_xport = device.dsp_xports.at(_index*MAX_NUM_DSPS + 0);
+    zero_copy_if::sptr &dsp1_xport = device.dsp_xports.at(_index*MAX_NUM_DSPS + 1);
+    zero_copy_if::sptr &err0_xport = device.err_xports.at(_index);
+
     UHD_LOG << "Making transport for DSP0..." << std::endl;
-    device.dsp_xports.push_back(udp_zero_copy::make(
+    dsp0_xport = udp_zero_copy::make(
         device_addr["addr"], BOOST_STRINGIZE(USRP2_UDP_DSP0_PORT), device_addr
-    ));
-    init_xport(device.dsp_xports.back());
+    );
+    init_xport(dsp0_xport);
 
     UHD_LOG << "Making transport for DSP1..." << std::endl;
-    device.dsp_xports.push_back(udp_zero_copy::make(
+    dsp1_xport = udp_zero_copy::make(
         device_addr["addr"], BOOST_STRINGIZE(USRP2_UDP_DSP1_PORT), device_addr
-    ));
-    init_xport(device.dsp_xports.back());
+    );
+    init_xport(dsp1_xport);
 
     UHD_LOG << "Making transport for ERR0..." << std::endl;
-    device.err_xports.push_back(udp_zero_copy::make(
+    err0_xport = udp_zero_copy::make(
         device_addr["addr"], BOOST_STRINGIZE(USRP2_UDP_ERR0_PORT), device_addr_t()
-    ));
-    init_xport(device.err_xports.back());
+    );
+    init_xport(err0_xport);
 
     //contruct the interfaces to mboard perifs
     _clock_ctrl = usrp2_clock_ctrl::make(_iface);
@@ -116,19 +123,22 @@ usrp2_mboard_impl::usrp2_mboard_impl(
     dsp_init();
 
     //setting the cycles per update (disabled by default)
+    usrp2_iface::batch_t ups_batch;
     const double ups_per_sec = device_addr.cast<double>("ups_per_sec", 20);
     if (ups_per_sec > 0.0){
         const size_t cycles_per_up = size_t(_clock_ctrl->get_master_clock_rate()/ups_per_sec);
-        _iface->poke32(U2_REG_TX_CTRL_CYCLES_PER_UP, U2_FLAG_TX_CTRL_UP_ENB | cycles_per_up);
+        ups_batch.poke32(U2_REG_TX_CTRL_CYCLES_PER_UP, U2_FLAG_TX_CTRL_UP_ENB | cycles_per_up);
     }
 
     //setting the packets per update (enabled by default)
-    size_t send_frame_size = device.dsp_xports[0]->get_send_frame_size();
+    size_t send_frame_size = dsp0_xport->get_send_frame_size();
     const double ups_per_fifo = device_addr.cast<double>("ups_per_fifo", 8.0);
+    _tx_packets_per_up = 0;
     if (ups_per_fifo > 0.0){
-        const size_t packets_per_up = size_t(usrp2_impl::sram_bytes/ups_per_fifo/send_frame_size);
-        _iface->poke32(U2_REG_TX_CTRL_PACKETS_PER_UP, U2_FLAG_TX_CTRL_UP_ENB | packets_per_up);
+        _tx_packets_per_up = size_t(usrp2_impl::sram_bytes/ups_per_fifo/send_frame_size);
+        ups_batch.poke32(U2_REG_TX_CTRL_PACKETS_PER_UP, U2_FLAG_TX_CTRL_UP_ENB | _tx_packets_per_up);
     }
+    _iface->transact_batch(ups_batch);
 
     //initialize the clock configuration
     if (device_addr.has_key("mimo_mode")){
@@ -156,7 +166,7 @@ usrp2_mboard_impl::usrp2_mboard_impl(
     codec_init();
 
     //init the tx and rx dboards (do last)
-    dboard_init();
+    dboard_init(cached_desc);
 
     //set default subdev specs
     (*this)[MBOARD_PROP_RX_SUBDEV_SPEC] = subdev_spec_t();
@@ -166,7 +176,7 @@ usrp2_mboard_impl::usrp2_mboard_impl(
     //This is a hack/fix for the lingering packet problem.
     stream_cmd_t stream_cmd(stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE);
     for (size_t i = 0; i < NUM_RX_DSPS; i++){
-        size_t index = device.dsp_xports.size() - NUM_RX_DSPS + i;
+        size_t index = _index*MAX_NUM_DSPS + i;
         stream_cmd.num_samps = 1;
         this->issue_ddc_stream_cmd(stream_cmd, i);
         device.dsp_xports.at(index)->get_recv_buff(0.01).get(); //recv with timeout for lingering
@@ -174,12 +184,22 @@ usrp2_mboard_impl::usrp2_mboard_impl(
         _iface->poke32(U2_REG_RX_CTRL_CLEAR(i), 1); //resets sequence
     }
     //------------------------------------------------------------------
+
+    //start the housekeeping io (do last)
+    _tx_packets_per_up_request = _tx_packets_per_up;
+    boost::barrier spawn_barrier(2);
+    _housekeeping_thread_group.create_thread(boost::bind(
+        &usrp2_mboard_impl::housekeeping_loop, this, boost::ref(spawn_barrier)
+    ));
+    spawn_barrier.wait();
 }
 
 usrp2_mboard_impl::~usrp2_mboard_impl(void){
     //Safely destruct all RAII objects in an mboard.
     //This prevents the mboard deconstructor from throwing,
     //which allows the device to be safely deconstructed.
+    UHD_SAFE_CALL(_housekeeping_thread_group.interrupt_all();)
+    UHD_SAFE_CALL(_housekeeping_thread_group.join_all();)
     UHD_SAFE_CALL(_iface->poke32(U2_REG_TX_CTRL_CYCLES_PER_UP, 0);)
     UHD_SAFE_CALL(_iface->poke32(U2_REG_TX_CTRL_PACKETS_PER_UP, 0);)
     UHD_SAFE_CALL(_dboard_manager.reset();)
@@ -194,6 +214,7 @@ usrp2_mboard_impl::~usrp2_mboard_impl(void){
  **********************************************************************/
 void usrp2_mboard_impl::update_clock_config(void){
     boost::uint32_t pps_flags = 0;
+    usrp2_iface::batch_t batch;
 
     //slave mode overrides clock config settings
     if (not _mimo_clocking_mode_is_master){
@@ -204,13 +225,13 @@ void usrp2_mboard_impl::update_clock_config(void){
     //translate pps source enums
     switch(_clock_config.pps_source){
     case clock_config_t::PPS_MIMO:
-        _iface->poke32(U2_REG_TIME64_MIMO_SYNC,
+        batch.poke32(U2_REG_TIME64_MIMO_SYNC,
             (1 << 8) | (mimo_clock_sync_delay_cycles & 0xff)
         );
         break;
 
     case clock_config_t::PPS_SMA:
-        _iface->poke32(U2_REG_TIME64_MIMO_SYNC, 0);
+        batch.poke32(U2_REG_TIME64_MIMO_SYNC, 0);
         pps_flags |= U2_FLAG_TIME64_PPS_SMA;
         break;
 
@@ -225,7 +246,7 @@ void usrp2_mboard_impl::update_clock_config(void){
     }
 
     //set the pps flags
-    _iface->poke32(U2_REG_TIME64_FLAGS, pps_flags);
+    batch.poke32(U2_REG_TIME64_FLAGS, pps_flags);
 
     //clock source ref 10mhz
     switch(_iface->get_rev()){
@@ -234,26 +255,30 @@ void usrp2_mboard_impl::update_clock_config(void){
     case usrp2_iface::USRP_N200_R4:
     case usrp2_iface::USRP_N210_R4:
         switch(_clock_config.ref_source){
-        case clock_config_t::REF_INT : _iface->poke32(U2_REG_MISC_CTRL_CLOCK, 0x12); break;
-        case clock_config_t::REF_SMA : _iface->poke32(U2_REG_MISC_CTRL_CLOCK, 0x1C); break;
-        case clock_config_t::REF_MIMO: _iface->poke32(U2_REG_MISC_CTRL_CLOCK, 0x15); break;
+        case clock_config_t::REF_INT : batch.poke32(U2_REG_MISC_CTRL_CLOCK, 0x12); break;
+        case clock_config_t::REF_SMA : batch.poke32(U2_REG_MISC_CTRL_CLOCK, 0x1C); break;
+        case clock_config_t::REF_MIMO: batch.poke32(U2_REG_MISC_CTRL_CLOCK, 0x15); break;
         default: throw uhd::value_error("unhandled clock configuration reference source");
         }
+        _iface->transact_batch(batch);
         _clock_ctrl->enable_external_ref(true); //USRP2P has an internal 10MHz TCXO
         break;
 
     case usrp2_iface::USRP2_REV3:
     case usrp2_iface::USRP2_REV4:
         switch(_clock_config.ref_source){
-        case clock_config_t::REF_INT : _iface->poke32(U2_REG_MISC_CTRL_CLOCK, 0x10); break;
-        case clock_config_t::REF_SMA : _iface->poke32(U2_REG_MISC_CTRL_CLOCK, 0x1C); break;
-        case clock_config_t::REF_MIMO: _iface->poke32(U2_REG_MISC_CTRL_CLOCK, 0x15); break;
+        case clock_config_t::REF_INT : batch.poke32(U2_REG_MISC_CTRL_CLOCK, 0x10); break;
+        case clock_config_t::REF_SMA : batch.poke32(U2_REG_MISC_CTRL_CLOCK, 0x1C); break;
+        case clock_config_t::REF_MIMO: batch.poke32(U2_REG_MISC_CTRL_CLOCK, 0x15); break;
         default: throw uhd::value_error("unhandled clock configuration reference source");
         }
+        _iface->transact_batch(batch);
         _clock_ctrl->enable_external_ref(_clock_config.ref_source != clock_config_t::REF_INT);
         break;
 
-    case usrp2_iface::USRP_NXXX: break;
+    case usrp2_iface::USRP_NXXX:
+        _iface->transact_batch(batch);
+        break;
     }
 
     //masters always drive the clock over serdes
@@ -280,18 +305,119 @@ void usrp2_mboard_impl::update_clock_config(void){
 }
 
 void usrp2_mboard_impl::set_time_spec(const time_spec_t &time_spec, bool now){
+    //the time model starts over (for slave devices too, the master time is set with them)
+    //the time of a next pps set may change for up to a second (and a margin)
+    _time_model.reset((now)? 0.0 : _time_model.get_host_time() + 1.1);
+
     //dont set the time for slave devices, they always take from mimo cable
     if (not _mimo_clocking_mode_is_master) return;
 
     //set the ticks
-    _iface->poke32(U2_REG_TIME64_TICKS, time_spec.get_tick_count(get_master_clock_freq()));
+    usrp2_iface::batch_t batch;
+    batch.poke32(U2_REG_TIME64_TICKS, time_spec.get_tick_count(get_master_clock_freq()));
 
     //set the flags register
     boost::uint32_t imm_flags = (now)? U2_FLAG_TIME64_LATCH_NOW : U2_FLAG_TIME64_LATCH_NEXT_PPS;
-    _iface->poke32(U2_REG_TIME64_IMM, imm_flags);
+    batch.poke32(U2_REG_TIME64_IMM, imm_flags);
 
     //set the seconds (latches in all 3 registers)
-    _iface->poke32(U2_REG_TIME64_SECS, boost::uint32_t(time_spec.get_full_secs()));
+    batch.poke32(U2_REG_TIME64_SECS, boost::uint32_t(time_spec.get_full_secs()));
+    _iface->transact_batch(batch);
+}
+
+/***********************************************************************
+ * Device Time
+ * - the time now reads are estimates of the time model (without io)
+ * - the time model is synced by the exact reads, and once per period
+ *   in the housekeeping thread (a control timeout only delays the next sync)
+ **********************************************************************/
+static const double time_model_sync_period = 1.0; //seconds
+
+time_spec_t usrp2_mboard_impl::get_time_now_exact(void){
+    while(true){
+        const boost::uint32_t secs = _iface->peek32(U2_REG_TIME64_SECS_RB_IMM);
+        //the time is read by the ticks peek (when the secs dont roll over)
+        const double host_before = _time_model.get_host_time();
+        const boost::uint32_t ticks = _iface->peek32(U2_REG_TIME64_TICKS_RB_IMM);
+        const double host_after = _time_model.get_host_time();
+        if (secs != _iface->peek32(U2_REG_TIME64_SECS_RB_IMM)) continue;
+        const time_spec_t time_now(secs, ticks, get_master_clock_freq());
+        _time_model.sync(host_before, time_now, host_after);
+        return time_now;
+    }
+}
+
+bool usrp2_mboard_impl::wait_for_pps(double timeout){
+    const double exit_time = _time_model.get_host_time() + timeout;
+    const boost::uint32_t pps_secs = _iface->peek32(U2_REG_TIME64_SECS_RB_PPS);
+    while (_iface->peek32(U2_REG_TIME64_SECS_RB_PPS) == pps_secs){
+        if (_time_model.get_host_time() > exit_time) return false;
+    }
+    return true;
+}
+
+bool usrp2_mboard_impl::set_time_next_pps(const time_spec_t &time_spec, double timeout){
+    const double exit_time = _time_model.get_host_time() + timeout;
+    boost::uint32_t pps_secs = _iface->peek32(U2_REG_TIME64_SECS_RB_PPS);
+    this->set_time_spec(time_spec, false);
+
+    //the time of the last pps is the time set, once a pps edge latched it
+    //(the latched time may equal the time set before the edge, ex: a board
+    //without a pps input that still holds time 0, so only an edge counts)
+    while (true){
+        const boost::uint32_t latched_secs = _iface->peek32(U2_REG_TIME64_SECS_RB_PPS);
+        if (latched_secs != pps_secs){
+            if (latched_secs == boost::uint32_t(time_spec.get_full_secs())) break;
+            pps_secs = latched_secs; //an edge before the time set took effect
+        }
+        if (_time_model.get_host_time() > exit_time) return false;
+    }
+
+    //sync the time model with the new time
+    _time_model.reset();
+    this->get_time_now_exact();
+    return true;
+}
+
+void usrp2_mboard_impl::housekeeping_loop(boost::barrier &spawn_barrier){
+    spawn_barrier.wait();
+    usrp2_iface::ctrl_priority_scope priority(usrp2_iface::CTRL_PRIORITY_HOUSEKEEPING);
+
+    try{
+        double next_sync = 0.0;
+        while(true){
+            //sync the time model once per period
+            if (_time_model.get_host_time() >= next_sync){
+                next_sync = _time_model.get_host_time() + time_model_sync_period;
+                try{
+                    this->get_time_now_exact();
+                }catch(const std::exception &e){
+                    UHD_MSG(error) << "Error (usrp2 time model sync): " << e.what() << std::endl;
+                }
+            }
+
+            //apply the last requested tx packets per update
+            boost::mutex::scoped_lock lock(_housekeeping_mutex);
+            const size_t packets_per_up = _tx_packets_per_up_request;
+            if (packets_per_up != _tx_packets_per_up){
+                lock.unlock();
+                try{
+                    this->set_tx_packets_per_up(packets_per_up);
+                }catch(const std::exception &e){
+                    UHD_MSG(error) << "Error (usrp2 flow control tuning): " << e.what() << std::endl;
+                }
+                lock.lock();
+            }
+
+            //wait for the next sync or a new request (a failed poke is tried again then)
+            if (_tx_packets_per_up_request != packets_per_up) continue;
+            const double wait = next_sync - _time_model.get_host_time();
+            if (wait > 0) _housekeeping_cond.timed_wait(lock, boost::posix_time::microseconds(long(wait*1e6)));
+        }
+    }
+    catch(const boost::thread_interrupted &){
+        /* NOP */
+    }
 }
 
 /***********************************************************************
@@ -349,13 +475,19 @@ void usrp2_mboard_impl::get(const wax::obj &key_, wax::obj &val){
         val = _clock_config;
         return;
 
-    case MBOARD_PROP_TIME_NOW: while(true){
-        uint32_t secs = _iface->peek32(U2_REG_TIME64_SECS_RB_IMM);
-        uint32_t ticks = _iface->peek32(U2_REG_TIME64_TICKS_RB_IMM);
-        if (secs != _iface->peek32(U2_REG_TIME64_SECS_RB_IMM)) continue;
-        val = time_spec_t(secs, ticks, get_master_clock_freq());
+    case MBOARD_PROP_TIME_NOW:{
+            time_spec_t time_now;
+            double error;
+            if (not _time_model.estimate(_time_model.get_host_time(), time_now, error)){
+                time_now = this->get_time_now_exact();
+            }
+            val = time_now;
+        }
+        return;
+
+    case MBOARD_PROP_TIME_NOW_EXACT:
+        val = this->get_time_now_exact();
         return;
-    }
 
     case MBOARD_PROP_TIME_PPS: while(true){
         uint32_t secs = _iface->peek32(U2_REG_TIME64_SECS_RB_PPS);
@@ -383,7 +515,15 @@ void usrp2_mboard_impl::get(const wax::obj &key_, wax::obj &val){
 
     case SUBDEV_PROP_SENSOR_NAMES:{
             prop_names_t names = boost::assign::list_of("mimo_locked")("ref_locked");
+            const prop_names_t tx_names = _device.get_tx_sensor_names();
+            names.insert(names.end(), tx_names.begin(), tx_names.end());
+            const prop_names_t ctrl_names = _device.get_ctrl_sensor_names();
+            names.insert(names.end(), ctrl_names.begin(), ctrl_names.end());
             if (_gps_ctrl.get()) names.push_back("gps_time");
+            names.push_back("time_now_error");
+            names.push_back("reg_shadow_num_suppressed");
+            names.push_back("ctrl_critical_wait_max");
+            names.push_back("ctrl_housekeeping_wait_max");
             val = names;
         }
         return;
@@ -400,6 +540,31 @@ void usrp2_mboard_impl::get(const wax::obj &key_, wax::obj &val){
         else if(key.name == "gps_time" and _gps_ctrl.get()) {
             val = sensor_value_t("GPS time", int(_gps_ctrl->get_epoch_time()), "seconds");
         }
+        else if(key.name == "time_now_error") {
+            //without an estimate (ex: a time set is pending) the time now reads are exact
+            time_spec_t time_now;
+            double error = 0.0;
+            if (not _time_model.estimate(_time_model.get_host_time(), time_now, error)){
+                this->get_time_now_exact();
+                if (not _time_model.estimate(_time_model.get_host_time(), time_now, error)) error = 0.0;
+            }
+            val = sensor_value_t("Time now error", error, "seconds");
+        }
+        else if(key.name == "reg_shadow_num_suppressed") {
+            val = sensor_value_t("Register shadow suppressed", int(_iface->get_num_suppressed_transactions()), "transactions");
+        }
+        else if(key.name == "ctrl_critical_wait_max") {
+            val = sensor_value_t("Control critical max wait", _iface->get_ctrl_wait_max(usrp2_iface::CTRL_PRIORITY_CRITICAL), "seconds");
+        }
+        else if(key.name == "ctrl_housekeeping_wait_max") {
+            val = sensor_value_t("Control housekeeping max wait", _iface->get_ctrl_wait_max(usrp2_iface::CTRL_PRIORITY_HOUSEKEEPING), "seconds");
+        }
+        else if(key.name.find("tx_") == 0) {
+            val = _device.get_tx_sensor(_index*MAX_NUM_DSPS, key.name);
+        }
+        else if(uhd::has(_device.get_ctrl_sensor_names(), key.name)) {
+            val = _device.get_ctrl_sensor(key.name);
+        }
         else {
             UHD_THROW_PROP_GET_ERROR();
         }
@@ -409,6 +574,20 @@ void usrp2_mboard_impl::get(const wax::obj &key_, wax::obj &val){
     }
 }
 
+void usrp2_mboard_impl::set_tx_packets_per_up(size_t packets_per_up){
+    _iface->poke32(U2_REG_TX_CTRL_PACKETS_PER_UP, U2_FLAG_TX_CTRL_UP_ENB | packets_per_up);
+    boost::mutex::scoped_lock lock(_housekeeping_mutex);
+    _tx_packets_per_up = packets_per_up;
+}
+
+void usrp2_mboard_impl::request_tx_packets_per_up(size_t packets_per_up){
+    boost::mutex::scoped_lock lock(_housekeeping_mutex);
+    if (_tx_packets_per_up_request == packets_per_up) return;
+    _tx_packets_per_up_request = packets_per_up;
+    lock.unlock();
+    _housekeeping_cond.notify_one();
+}
+
 bool usrp2_mboard_impl::get_mimo_locked(void) {
   return bool((_iface->peek32(U2_REG_IRQ_RB) & (1<<10)) > 0);
 }
@@ -427,6 +606,7 @@ void usrp2_mboard_impl::set(const wax::obj &key, const wax::obj &val){
     case MBOARD_PROP_CLOCK_CONFIG:
         _clock_config = val.as<clock_config_t>();
         update_clock_config();
+        _time_model.reset(); //the rate may change with the reference
         return;
 
     case MBOARD_PROP_TIME_NOW:
@@ -443,10 +623,14 @@ void usrp2_mboard_impl::set(const wax::obj &key, const wax::obj &val){
         //sanity check
         UHD_ASSERT_THROW(_rx_subdev_spec.size() <= NUM_RX_DSPS);
         //set the mux
-        for (size_t i = 0; i < _rx_subdev_spec.size(); i++){
-            _iface->poke32(U2_REG_DSP_RX_MUX(i), dsp_type1::calc_rx_mux_word(
-                _dboard_manager->get_rx_subdev(_rx_subdev_spec[i].sd_name)[SUBDEV_PROP_CONNECTION].as<subdev_conn_t>()
-            ));
+        {
+            usrp2_iface::batch_t batch;
+            for (size_t i = 0; i < _rx_subdev_spec.size(); i++){
+                batch.poke32(U2_REG_DSP_RX_MUX(i), dsp_type1::calc_rx_mux_word(
+                    _dboard_manager->get_rx_subdev(_rx_subdev_spec[i].sd_name)[SUBDEV_PROP_CONNECTION].as<subdev_conn_t>()
+                ));
+            }
+            _iface->transact_batch(batch);
         }
         _device.update_xport_channel_mapping();
         return;
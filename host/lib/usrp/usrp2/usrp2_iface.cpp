@@ -18,6 +18,8 @@
 #include "usrp2_regs.hpp"
 #include "fw_common.h"
 #include "usrp2_iface.hpp"
+#include "../../transport/priority_lock.hpp"
+#include "../../transport/reg_shadow.hpp"
 #include <uhd/exception.hpp>
 #include <uhd/utils/msg.hpp>
 #include <uhd/types/dict.hpp>
@@ -32,6 +34,7 @@
 #include <boost/functional/hash.hpp>
 #include <algorithm>
 #include <iostream>
+#include <cstring>
 
 using namespace uhd;
 using namespace uhd::usrp;
@@ -43,8 +46,52 @@ static const boost::uint32_t MIN_PROTO_COMPAT_SPI = 7;
 static const boost::uint32_t MIN_PROTO_COMPAT_I2C = 7;
 // The register compat number must reflect the protocol compatibility
 // and the compatibility of the register mapping (more likely to change).
-static const boost::uint32_t MIN_PROTO_COMPAT_REG = USRP2_FW_COMPAT_NUM;
+static const boost::uint32_t MIN_PROTO_COMPAT_REG = 10;
 static const boost::uint32_t MIN_PROTO_COMPAT_UART = 7;
+static const boost::uint32_t MIN_PROTO_COMPAT_BATCH = 11;
+
+/***********************************************************************
+ * Register shadow policy:
+ * The first range that contains an address determines its policy.
+ * Addresses not covered by the table are always volatile.
+ **********************************************************************/
+enum reg_policy_t{
+    REG_POLICY_VOLATILE, //always sent to the device (strobes, readback, fw-owned)
+    REG_POLICY_SHADOW    //only written by the host, value held in the shadow
+};
+
+struct reg_policy_range_t{
+    boost::uint32_t first, last;
+    reg_policy_t policy;
+};
+
+static const reg_policy_range_t reg_policy_table[] = {
+    //settings written by the firmware
+    {U2_REG_MISC_CTRL_LEDS,            U2_REG_SR_ADDR(SR_TIME64 - 1),   REG_POLICY_VOLATILE},
+    {U2_REG_SR_ADDR(SR_BUF_POOL),      U2_REG_SR_ADDR(SR_RX_FRONT - 1), REG_POLICY_VOLATILE},
+    {U2_REG_SR_ADDR(SR_UDP_SM),        U2_REG_SR_ADDR(SR_UDP_SM + 63),  REG_POLICY_VOLATILE},
+    //settings that act on every write (latches and strobes)
+    {U2_REG_TIME64_SECS,               U2_REG_TIME64_TICKS,             REG_POLICY_VOLATILE},
+    {U2_REG_TIME64_IMM,                U2_REG_TIME64_IMM,               REG_POLICY_VOLATILE},
+    {U2_REG_RX_CTRL_STREAM_CMD(0),     U2_REG_RX_CTRL_CLEAR(0),         REG_POLICY_VOLATILE},
+    {U2_REG_RX_CTRL_STREAM_CMD(1),     U2_REG_RX_CTRL_CLEAR(1),         REG_POLICY_VOLATILE},
+    {U2_REG_TX_CTRL_CLEAR_STATE,       U2_REG_TX_CTRL_CLEAR_STATE,      REG_POLICY_VOLATILE},
+    //remaining settings and the gpio/atr configuration are host-owned
+    {U2_REG_SR_ADDR(0),                U2_REG_SR_ADDR(SR_UDP_SM - 1),   REG_POLICY_SHADOW},
+    {U2_REG_GPIO_DDR,                  U2_REG_GPIO_RX_SEL,              REG_POLICY_SHADOW},
+    {U2_REG_ATR_IDLE_TXSIDE,           U2_REG_ATR_FULL_RXSIDE,          REG_POLICY_SHADOW},
+};
+
+static reg_policy_t get_reg_policy(boost::uint32_t addr){
+    BOOST_FOREACH(const reg_policy_range_t &range, reg_policy_table){
+        if (addr >= range.first and addr <= range.last) return range.policy;
+    }
+    return REG_POLICY_VOLATILE;
+}
+
+static bool is_reg_shadowed(boost::uint32_t addr){
+    return get_reg_policy(addr) == REG_POLICY_SHADOW;
+}
 
 // Map for virtual firmware regs (not very big so we can keep it here for now)
 #define U2_FW_REG_LOCK_TIME 0
@@ -84,8 +131,10 @@ public:
  **********************************************************************/
     usrp2_iface_impl(udp_simple::sptr ctrl_transport):
         _ctrl_transport(ctrl_transport),
+        _ctrl_lock(NUM_CTRL_PRIORITIES),
         _ctrl_seq_num(0),
-        _protocol_compat(0) //initialized below...
+        _protocol_compat(0), //initialized below...
+        _shadow(&is_reg_shadowed)
     {
         //Obtain the firmware's compat number.
         //Save the response compat number for communication.
@@ -134,10 +183,17 @@ public:
 
     void lock_loop(boost::barrier &spawn_barrier){
         spawn_barrier.wait();
+        ctrl_priority_scope priority(CTRL_PRIORITY_HOUSEKEEPING);
 
         try{
             this->get_reg<boost::uint32_t, USRP2_REG_ACTION_FW_POKE32>(U2_FW_REG_LOCK_GPID, boost::uint32_t(get_gpid()));
             while(true){
+                //the lock is lost when the firmware restarted (or another process took over),
+                //either way the register values in the shadow are not to be trusted
+                if (this->get_reg<boost::uint32_t, USRP2_REG_ACTION_FW_PEEK32>(U2_FW_REG_LOCK_GPID) != boost::uint32_t(get_gpid())){
+                    this->invalidate_reg_shadow();
+                    this->get_reg<boost::uint32_t, USRP2_REG_ACTION_FW_POKE32>(U2_FW_REG_LOCK_GPID, boost::uint32_t(get_gpid()));
+                }
                 //re-lock in loop
                 boost::uint32_t curr_secs = this->peek32(U2_REG_TIME64_SECS_RB_IMM);
                 this->get_reg<boost::uint32_t, USRP2_REG_ACTION_FW_POKE32>(U2_FW_REG_LOCK_TIME, curr_secs);
@@ -161,15 +217,27 @@ public:
  * Peek and Poke
  **********************************************************************/
     void poke32(boost::uint32_t addr, boost::uint32_t data){
+        ctrl_lock_type ctrl_lock(_ctrl_lock, get_ctrl_priority());
+        boost::recursive_mutex::scoped_lock lock(_shadow_mutex);
+        if (_shadow.suppress_poke(addr, data)) return;
         this->get_reg<boost::uint32_t, USRP2_REG_ACTION_FPGA_POKE32>(addr, data);
+        _shadow.update(addr, data);
     }
 
     boost::uint32_t peek32(boost::uint32_t addr){
+        ctrl_lock_type ctrl_lock(_ctrl_lock, get_ctrl_priority());
+        boost::recursive_mutex::scoped_lock lock(_shadow_mutex);
+        boost::uint32_t data;
+        if (_shadow.suppress_peek(addr, data)) return data;
         return this->get_reg<boost::uint32_t, USRP2_REG_ACTION_FPGA_PEEK32>(addr);
     }
 
     void poke16(boost::uint32_t addr, boost::uint16_t data){
+        ctrl_lock_type ctrl_lock(_ctrl_lock, get_ctrl_priority());
+        boost::recursive_mutex::scoped_lock lock(_shadow_mutex);
+        if (_shadow.suppress_poke(addr, data)) return;
         this->get_reg<boost::uint16_t, USRP2_REG_ACTION_FPGA_POKE16>(addr, data);
+        _shadow.update(addr, data);
     }
 
     boost::uint16_t peek16(boost::uint32_t addr){
@@ -191,6 +259,140 @@ public:
         return T(ntohl(in_data.data.reg_args.data));
     }
 
+/***********************************************************************
+ * Register shadow
+ **********************************************************************/
+    void set_reg_shadow_enabled(bool enb){
+        boost::recursive_mutex::scoped_lock lock(_shadow_mutex);
+        _shadow.set_enabled(enb);
+    }
+
+    void invalidate_reg_shadow(void){
+        boost::recursive_mutex::scoped_lock lock(_shadow_mutex);
+        _shadow.invalidate();
+    }
+
+    size_t get_num_suppressed_transactions(void){
+        boost::recursive_mutex::scoped_lock lock(_shadow_mutex);
+        return _shadow.get_num_suppressed();
+    }
+
+    double get_ctrl_wait_max(ctrl_priority_t priority){
+        return _ctrl_lock.get_wait_max(priority);
+    }
+
+/***********************************************************************
+ * Batch
+ **********************************************************************/
+    std::vector<boost::uint32_t> transact_batch(const batch_t &batch){
+        ctrl_lock_type ctrl_lock(_ctrl_lock, get_ctrl_priority());
+        boost::recursive_mutex::scoped_lock lock(_shadow_mutex);
+        if (not _shadow.is_enabled()) return this->transact_batch_ops(batch);
+
+        //filter out the operations that the shadow can satisfy,
+        //the shadow is updated in order so later ops see earlier pokes
+        std::vector<boost::uint32_t> results(batch.ops.size());
+        std::vector<size_t> indexes;
+        batch_t remaining;
+        for (size_t i = 0; i < batch.ops.size(); i++){
+            const usrp2_ctrl_batch_op_t &op = batch.ops[i];
+            switch(op.action){
+            case USRP2_REG_ACTION_FPGA_POKE32:
+            case USRP2_REG_ACTION_FPGA_POKE16:
+                results[i] = op.data;
+                if (_shadow.suppress_poke(op.addr, op.data)) continue;
+                _shadow.update(op.addr, op.data);
+                break;
+            case USRP2_REG_ACTION_FPGA_PEEK32:
+                if (_shadow.suppress_peek(op.addr, results[i])) continue;
+                break;
+            default: break;
+            }
+            remaining.ops.push_back(op);
+            indexes.push_back(i);
+        }
+        if (remaining.ops.empty()) return results;
+
+        //the device state is unknown when the batch fails part way
+        std::vector<boost::uint32_t> remaining_results;
+        try{
+            remaining_results = this->transact_batch_ops(remaining);
+        }
+        catch(...){
+            _shadow.invalidate();
+            throw;
+        }
+        for (size_t i = 0; i < indexes.size(); i++){
+            results[indexes[i]] = remaining_results[i];
+        }
+        return results;
+    }
+
+    std::vector<boost::uint32_t> transact_batch_ops(const batch_t &batch){
+        std::vector<boost::uint32_t> results;
+        results.reserve(batch.ops.size());
+
+        //older firmware: one control transaction per operation
+        if (_protocol_compat < MIN_PROTO_COMPAT_BATCH){
+            BOOST_FOREACH(const usrp2_ctrl_batch_op_t &op, batch.ops){
+                results.push_back(this->transact_batch_op(op));
+            }
+            return results;
+        }
+
+        //send the operations in chunks of the max ops per packet
+        std::vector<boost::uint8_t> out_mem, in_mem;
+        for (size_t first = 0; first < batch.ops.size(); first += USRP2_CTRL_BATCH_MAX_OPS){
+            const size_t num_ops = std::min<size_t>(batch.ops.size() - first, USRP2_CTRL_BATCH_MAX_OPS);
+            const size_t num_bytes = sizeof(usrp2_ctrl_data_t) + num_ops*sizeof(usrp2_ctrl_batch_op_t);
+            out_mem.resize(num_bytes); in_mem.resize(num_bytes);
+
+            //setup the out data
+            usrp2_ctrl_data_t *out_data = reinterpret_cast<usrp2_ctrl_data_t *>(&out_mem.front());
+            out_data->id = htonl(USRP2_CTRL_ID_DO_ALL_THESE_THINGS_BRO);
+            out_data->data.batch_args.num_ops = htonl(num_ops);
+            usrp2_ctrl_batch_op_t *ops_out = reinterpret_cast<usrp2_ctrl_batch_op_t *>(&out_mem.front() + sizeof(usrp2_ctrl_data_t));
+            for (size_t i = 0; i < num_ops; i++){
+                ops_out[i] = batch.ops[first + i];
+                ops_out[i].addr = htonl(ops_out[i].addr);
+                ops_out[i].data = htonl(ops_out[i].data);
+            }
+
+            //send and recv
+            size_t len = this->ctrl_send_and_recv(&out_mem.front(), num_bytes, &in_mem.front(), num_bytes, MIN_PROTO_COMPAT_BATCH);
+            const usrp2_ctrl_data_t *in_data = reinterpret_cast<const usrp2_ctrl_data_t *>(&in_mem.front());
+            UHD_ASSERT_THROW(ntohl(in_data->id) == USRP2_CTRL_ID_DID_ALL_THOSE_THINGS_DUDE);
+            UHD_ASSERT_THROW(ntohl(in_data->data.batch_args.num_ops) == num_ops and len >= num_bytes);
+
+            //copy out the resulting data words
+            const usrp2_ctrl_batch_op_t *ops_in = reinterpret_cast<const usrp2_ctrl_batch_op_t *>(&in_mem.front() + sizeof(usrp2_ctrl_data_t));
+            for (size_t i = 0; i < num_ops; i++){
+                results.push_back(ntohl(ops_in[i].data));
+            }
+        }
+        return results;
+    }
+
+    boost::uint32_t transact_batch_op(const usrp2_ctrl_batch_op_t &op){
+        switch(op.action){
+        //bypass the shadow here, the batch was already filtered by it
+        case USRP2_REG_ACTION_FPGA_PEEK32: return this->get_reg<boost::uint32_t, USRP2_REG_ACTION_FPGA_PEEK32>(op.addr);
+        case USRP2_REG_ACTION_FPGA_POKE32: return this->get_reg<boost::uint32_t, USRP2_REG_ACTION_FPGA_POKE32>(op.addr, op.data);
+        case USRP2_REG_ACTION_FPGA_PEEK16: return this->get_reg<boost::uint16_t, USRP2_REG_ACTION_FPGA_PEEK16>(op.addr);
+        case USRP2_REG_ACTION_FPGA_POKE16: return this->get_reg<boost::uint16_t, USRP2_REG_ACTION_FPGA_POKE16>(op.addr, op.data);
+        case USRP2_REG_ACTION_FW_PEEK32: return this->get_reg<boost::uint32_t, USRP2_REG_ACTION_FW_PEEK32>(op.addr);
+        case USRP2_REG_ACTION_FW_POKE32: return this->get_reg<boost::uint32_t, USRP2_REG_ACTION_FW_POKE32>(op.addr, op.data);
+        case USRP2_REG_ACTION_SPI_WRITE:{
+                spi_config_t config;
+                config.mosi_edge = (op.mosi_edge == USRP2_CLK_EDGE_RISE)? spi_config_t::EDGE_RISE : spi_config_t::EDGE_FALL;
+                config.miso_edge = (op.miso_edge == USRP2_CLK_EDGE_RISE)? spi_config_t::EDGE_RISE : spi_config_t::EDGE_FALL;
+                this->write_spi(op.addr, config, op.data, op.num_bits);
+            }
+            return op.data;
+        }
+        UHD_THROW_INVALID_CODE_PATH();
+    }
+
 /***********************************************************************
  * SPI
  **********************************************************************/
@@ -265,6 +467,20 @@ public:
         return result;
     }
 
+    byte_vector_t read_eeprom(boost::uint8_t addr, boost::uint8_t offset, size_t num_bytes){
+        //The default implementation reads one byte per transaction.
+        //Use the eeprom's sequential read to get as many bytes as an i2c read allows.
+        static const size_t max_i2c_bytes = sizeof(usrp2_ctrl_data_t().data.i2c_args.data);
+        byte_vector_t bytes;
+        while (bytes.size() < num_bytes){
+            //do a zero byte write to start read cycle
+            this->write_i2c(addr, byte_vector_t(1, boost::uint8_t(offset + bytes.size())));
+            byte_vector_t chunk = this->read_i2c(addr, std::min(num_bytes - bytes.size(), max_i2c_bytes));
+            bytes.insert(bytes.end(), chunk.begin(), chunk.end());
+        }
+        return bytes;
+    }
+
 /***********************************************************************
  * UART
  **********************************************************************/
@@ -317,12 +533,23 @@ public:
       return result;
     }
     
+    //the gps io is housekeeping: it waits behind the other control transactions
+    void write_gps_uart(const std::string &buf){
+        ctrl_priority_scope priority(CTRL_PRIORITY_HOUSEKEEPING);
+        this->write_uart(2, buf); //2 is the GPS UART port on USRP2
+    }
+
+    std::string read_gps_uart(void){
+        ctrl_priority_scope priority(CTRL_PRIORITY_HOUSEKEEPING);
+        return this->read_uart(2); //2 is the GPS UART port on USRP2
+    }
+
     gps_send_fn_t get_gps_write_fn(void) {
-        return boost::bind(&usrp2_iface_impl::write_uart, this, 2, _1); //2 is the GPS UART port on USRP2
+        return boost::bind(&usrp2_iface_impl::write_gps_uart, this, _1);
     }
     
     gps_recv_fn_t get_gps_read_fn(void) {
-        return boost::bind(&usrp2_iface_impl::read_uart, this, 2); //2 is the GPS UART port on USRP2
+        return boost::bind(&usrp2_iface_impl::read_gps_uart, this);
     }
 
 /***********************************************************************
@@ -333,13 +560,30 @@ public:
         boost::uint32_t lo = USRP2_FW_COMPAT_NUM,
         boost::uint32_t hi = USRP2_FW_COMPAT_NUM
     ){
-        boost::mutex::scoped_lock lock(_ctrl_mutex);
+        usrp2_ctrl_data_t out_copy = out_data, in_data;
+        this->ctrl_send_and_recv(&out_copy, sizeof(out_copy), &in_data, sizeof(in_data), lo, hi);
+        return in_data;
+    }
+
+    /*!
+     * Send and recv a control packet of arbitrary length.
+     * The out buffer must begin with a usrp2_ctrl_data_t header,
+     * the protocol version and sequence number are filled in here.
+     * \return the number of bytes received into the in buffer
+     */
+    size_t ctrl_send_and_recv(
+        void *out_mem, size_t out_len,
+        void *in_mem, size_t in_len,
+        boost::uint32_t lo = USRP2_FW_COMPAT_NUM,
+        boost::uint32_t hi = USRP2_FW_COMPAT_NUM
+    ){
+        ctrl_lock_type lock(_ctrl_lock, get_ctrl_priority());
 
         //fill in the seq number and send
-        usrp2_ctrl_data_t out_copy = out_data;
-        out_copy.proto_ver = htonl(_protocol_compat);
-        out_copy.seq = htonl(++_ctrl_seq_num);
-        _ctrl_transport->send(boost::asio::buffer(&out_copy, sizeof(usrp2_ctrl_data_t)));
+        usrp2_ctrl_data_t *out_hdr = reinterpret_cast<usrp2_ctrl_data_t *>(out_mem);
+        out_hdr->proto_ver = htonl(_protocol_compat);
+        out_hdr->seq = htonl(++_ctrl_seq_num);
+        _ctrl_transport->send(boost::asio::buffer(out_mem, out_len));
 
         //loop until we get the packet or timeout
         boost::uint8_t usrp2_ctrl_data_in_mem[udp_simple::mtu]; //allocate max bytes for recv
@@ -356,14 +600,21 @@ public:
                 ) % ((lo == hi)? (boost::format("%d") % hi) : (boost::format("[%d to %d]") % lo % hi)) % compat));
             }
             if (len >= sizeof(usrp2_ctrl_data_t) and ntohl(ctrl_data_in->seq) == _ctrl_seq_num){
-                return *ctrl_data_in;
+                std::memcpy(in_mem, usrp2_ctrl_data_in_mem, std::min(len, in_len));
+                return len;
             }
             if (len == 0) break; //timeout
             //didnt get seq or bad packet, continue looking...
         }
+        //the device may have restarted, its registers are unknown
+        this->invalidate_reg_shadow();
         throw uhd::runtime_error("no control response");
     }
 
+    boost::uint32_t get_fw_compat_num(void){
+        return _protocol_compat;
+    }
+
     rev_type get_rev(void){
         switch (boost::lexical_cast<boost::uint16_t>(mb_eeprom["rev"])){
         case 0x0300:
@@ -394,15 +645,74 @@ private:
     //this lovely lady makes it all possible
     udp_simple::sptr _ctrl_transport;
 
-    //used in send/recv
-    boost::mutex _ctrl_mutex;
+    //used in send/recv (taken before the shadow lock)
+    typedef uhd::transport::priority_lock::scoped_lock ctrl_lock_type;
+    uhd::transport::priority_lock _ctrl_lock;
     boost::uint32_t _ctrl_seq_num;
     boost::uint32_t _protocol_compat;
 
+    //register shadow (address to last written value)
+    boost::recursive_mutex _shadow_mutex;
+    reg_shadow _shadow;
+
     //lock thread stuff
     boost::thread_group _lock_thread_group;
 };
 
+/***********************************************************************
+ * Control priority of the calling thread
+ **********************************************************************/
+static boost::thread_specific_ptr<usrp2_iface::ctrl_priority_t> thread_ctrl_priority;
+
+usrp2_iface::ctrl_priority_t usrp2_iface::get_ctrl_priority(void){
+    if (thread_ctrl_priority.get() == NULL) return CTRL_PRIORITY_NORMAL;
+    return *thread_ctrl_priority;
+}
+
+usrp2_iface::ctrl_priority_scope::ctrl_priority_scope(ctrl_priority_t priority):
+    _prev_priority(get_ctrl_priority())
+{
+    thread_ctrl_priority.reset(new ctrl_priority_t(priority));
+}
+
+usrp2_iface::ctrl_priority_scope::~ctrl_priority_scope(void){
+    thread_ctrl_priority.reset(new ctrl_priority_t(_prev_priority));
+}
+
+/***********************************************************************
+ * Batch helper methods
+ **********************************************************************/
+void usrp2_iface::batch_t::poke32(boost::uint32_t addr, boost::uint32_t data){
+    usrp2_ctrl_batch_op_t op = usrp2_ctrl_batch_op_t();
+    op.action = USRP2_REG_ACTION_FPGA_POKE32;
+    op.addr = addr;
+    op.data = data;
+    ops.push_back(op);
+}
+
+void usrp2_iface::batch_t::peek32(boost::uint32_t addr){
+    usrp2_ctrl_batch_op_t op = usrp2_ctrl_batch_op_t();
+    op.action = USRP2_REG_ACTION_FPGA_PEEK32;
+    op.addr = addr;
+    ops.push_back(op);
+}
+
+void usrp2_iface::batch_t::write_spi(
+    int which_slave,
+    const spi_config_t &config,
+    boost::uint32_t data,
+    size_t num_bits
+){
+    usrp2_ctrl_batch_op_t op = usrp2_ctrl_batch_op_t();
+    op.action = USRP2_REG_ACTION_SPI_WRITE;
+    op.num_bits = num_bits;
+    op.miso_edge = (config.miso_edge == spi_config_t::EDGE_RISE)? USRP2_CLK_EDGE_RISE : USRP2_CLK_EDGE_FALL;
+    op.mosi_edge = (config.mosi_edge == spi_config_t::EDGE_RISE)? USRP2_CLK_EDGE_RISE : USRP2_CLK_EDGE_FALL;
+    op.addr = which_slave;
+    op.data = data;
+    ops.push_back(op);
+}
+
 /***********************************************************************
  * Public make function for usrp2 interface
  **********************************************************************/
@@ -26,7 +26,9 @@
 #include <boost/function.hpp>
 #include <utility>
 #include <string>
+#include <vector>
 #include "usrp2_regs.hpp"
+#include "fw_common.h"
 
 
 //TODO: kill this crap when you have the top level GPS include file
@@ -51,6 +53,84 @@ public:
     virtual gps_recv_fn_t get_gps_read_fn(void) = 0;
     virtual gps_send_fn_t get_gps_write_fn(void) = 0;
 
+    /*!
+     * A batch of register and spi operations:
+     * Operations are collected on the host and performed in order
+     * by the firmware with as few control packets as possible.
+     * The operations are stored in host byte order.
+     */
+    struct batch_t{
+        std::vector<usrp2_ctrl_batch_op_t> ops;
+
+        //! Add a 32-bit register write to the batch
+        void poke32(boost::uint32_t addr, boost::uint32_t data);
+
+        //! Add a 32-bit register read to the batch
+        void peek32(boost::uint32_t addr);
+
+        //! Add a spi write (no readback) to the batch
+        void write_spi(
+            int which_slave,
+            const uhd::spi_config_t &config,
+            boost::uint32_t data,
+            size_t num_bits
+        );
+    };
+
+    /*!
+     * Perform a batch of operations.
+     * Older firmware without batch support gets one transaction per operation.
+     * \param batch the operations to perform
+     * \return the resulting data word for each operation (peek results)
+     */
+    virtual std::vector<boost::uint32_t> transact_batch(const batch_t &batch) = 0;
+
+    /*!
+     * Enable or disable the register shadow (disabled by default).
+     * With the shadow enabled, a 32-bit or 16-bit poke that writes
+     * the value already held by a host-owned register is skipped,
+     * and a 32-bit peek of a host-owned register is served from the shadow.
+     * Strobe, readback, and firmware-owned registers always pass through.
+     * \param enb true to enable the shadow
+     */
+    virtual void set_reg_shadow_enabled(bool enb) = 0;
+
+    //! Forget all shadowed values (ex: after the firmware was reset)
+    virtual void invalidate_reg_shadow(void) = 0;
+
+    //! Get the number of peeks and pokes the shadow has suppressed
+    virtual size_t get_num_suppressed_transactions(void) = 0;
+
+    /*!
+     * The priorities of the control transactions (lowest first):
+     * A waiting transaction goes ahead of the waiting transactions
+     * of a lower priority, the transaction in flight is not cut short.
+     */
+    enum ctrl_priority_t{
+        CTRL_PRIORITY_HOUSEKEEPING = 0, //!< periodic io (device lock, gps, time model)
+        CTRL_PRIORITY_NORMAL = 1,       //!< the default
+        CTRL_PRIORITY_CRITICAL = 2,     //!< stream commands, tune, rate changes
+        NUM_CTRL_PRIORITIES = 3
+    };
+
+    /*!
+     * Sets the control priority of the calling thread for a scope.
+     * The transactions of the thread are made at this priority.
+     */
+    class ctrl_priority_scope : boost::noncopyable{
+    public:
+        ctrl_priority_scope(ctrl_priority_t priority);
+        ~ctrl_priority_scope(void);
+    private:
+        const ctrl_priority_t _prev_priority;
+    };
+
+    //! Get the control priority of the calling thread
+    static ctrl_priority_t get_ctrl_priority(void);
+
+    //! Get the longest wait of a priority for the control path in seconds
+    virtual double get_ctrl_wait_max(ctrl_priority_t priority) = 0;
+
     //! The list of possible revision types
     enum rev_type {
         USRP2_REV3 = 3,
@@ -62,6 +142,9 @@ public:
         USRP_NXXX = 0
     };
 
+    //! Get the protocol compatibility number of the firmware
+    virtual boost::uint32_t get_fw_compat_num(void) = 0;
+
     //! Get the revision type for this device
     virtual rev_type get_rev(void) = 0;
 
@@ -17,6 +17,7 @@
 
 #include "usrp2_impl.hpp"
 #include "fw_common.h"
+#include "desc_cache.hpp"
 #include <uhd/utils/log.hpp>
 #include <uhd/utils/msg.hpp>
 #include <uhd/exception.hpp>
@@ -33,7 +34,12 @@
 #include <boost/bind.hpp>
 #include <boost/asio/ip/address_v4.hpp>
 #include <boost/asio.hpp> //used for htonl and ntohl
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/function.hpp>
 #include <vector>
+#include <list>
+#include <cmath>
 
 using namespace uhd;
 using namespace uhd::usrp;
@@ -43,6 +49,44 @@ namespace asio = boost::asio;
 /***********************************************************************
  * Discovery over the udp transport
  **********************************************************************/
+static const double DISCOVERY_SILENCE_TIMEOUT = 0.1; //seconds without a response
+
+static device_addrs_t usrp2_find(const device_addr_t &hint_);
+
+//! Discover on one interface, results go into the slot for this interface
+static void usrp2_find_task(const device_addr_t &hint, device_addrs_t &usrp2_addrs){
+    try{
+        usrp2_addrs = usrp2_find(hint);
+    }
+    catch(const std::exception &e){
+        UHD_MSG(error) << "USRP2 discovery on " << hint["addr"] << " failed: " << e.what() << std::endl;
+    }
+}
+
+//! Read the name and serial of a responder, marks the address empty when locked
+static void usrp2_identify_task(device_addr_t &new_addr){
+    //Attempt to read the name from the EEPROM and perform filtering.
+    //This operation can throw due to compatibility mismatch.
+    try{
+        usrp2_iface::sptr iface = usrp2_iface::make(udp_simple::make_connected(
+            new_addr["addr"], BOOST_STRINGIZE(USRP2_UDP_CTRL_PORT)
+        ));
+        if (iface->is_device_locked()){ //ignore locked devices
+            new_addr = device_addr_t();
+            return;
+        }
+        mboard_eeprom_t mb_eeprom = iface->mb_eeprom;
+        new_addr["name"] = mb_eeprom["name"];
+        new_addr["serial"] = mb_eeprom["serial"];
+    }
+    catch(const std::exception &){
+        //set these values as empty string so the device may still be found
+        //and the filter's below can still operate on the discovered device
+        new_addr["name"] = "";
+        new_addr["serial"] = "";
+    }
+}
+
 static device_addrs_t usrp2_find(const device_addr_t &hint_){
     //handle the multi-device discovery
     device_addrs_t hints = separate_device_addr(hint_);
@@ -67,18 +111,40 @@ static device_addrs_t usrp2_find(const device_addr_t &hint_){
     //return an empty list of addresses when type is set to non-usrp2
     if (hint.has_key("type") and hint["type"] != "usrp2") return usrp2_addrs;
 
+    //try the cached address for this serial before broadcasting
+    if (not hint.has_key("addr") and hint.has_key("serial") and usrp2_desc_cache::enabled(hint)){
+        const device_addr_t desc = usrp2_desc_cache::lookup("serial", hint["serial"]);
+        if (desc.has_key("addr")){
+            device_addr_t new_hint = hint;
+            new_hint["addr"] = desc["addr"];
+            usrp2_addrs = usrp2_find(new_hint);
+            if (not usrp2_addrs.empty()) return usrp2_addrs;
+        }
+    }
+
     //if no address was specified, send a broadcast on each interface
     if (not hint.has_key("addr")){
+        //create a new hint with the broadcast address of each interface
+        device_addrs_t if_hints;
         BOOST_FOREACH(const if_addrs_t &if_addrs, get_if_addrs()){
             //avoid the loopback device
             if (if_addrs.inet == asio::ip::address_v4::loopback().to_string()) continue;
+            if_hints.push_back(hint);
+            if_hints.back()["addr"] = if_addrs.bcast;
+        }
 
-            //create a new hint with this broadcast address
-            device_addr_t new_hint = hint;
-            new_hint["addr"] = if_addrs.bcast;
+        //call discover on all interfaces at once
+        std::vector<device_addrs_t> if_usrp2_addrs(if_hints.size());
+        boost::thread_group find_threads;
+        for (size_t i = 0; i < if_hints.size(); i++){
+            find_threads.create_thread(boost::bind(
+                &usrp2_find_task, boost::cref(if_hints[i]), boost::ref(if_usrp2_addrs[i])
+            ));
+        }
+        find_threads.join_all();
 
-            //call discover with the new hint and append results
-            device_addrs_t new_usrp2_addrs = usrp2_find(new_hint);
+        //prepend the results of each interface (the last interface comes first)
+        BOOST_FOREACH(const device_addrs_t &new_usrp2_addrs, if_usrp2_addrs){
             usrp2_addrs.insert(usrp2_addrs.begin(),
                 new_usrp2_addrs.begin(), new_usrp2_addrs.end()
             );
@@ -98,50 +164,58 @@ static device_addrs_t usrp2_find(const device_addr_t &hint_){
     ctrl_data_out.id = uhd::htonx<boost::uint32_t>(USRP2_CTRL_ID_WAZZUP_BRO);
     udp_transport->send(boost::asio::buffer(&ctrl_data_out, sizeof(ctrl_data_out)));
 
-    //loop and recieve until the timeout
+    //wait until a silence by default, or for the total time when one is given
+    const bool has_total_timeout = hint.has_key("discovery_timeout");
+    const double discovery_timeout = hint.cast<double>("discovery_timeout", 0.0);
+    const boost::system_time exit_time = boost::get_system_time() +
+        boost::posix_time::microseconds(long(discovery_timeout*1e6));
+
+    //loop and recieve until the timeout,
+    //identify each responder in the background while waiting for the next one
+    //(a list keeps the addresses in place while the threads fill them in)
+    std::list<device_addr_t> new_addrs;
+    boost::thread_group identify_threads;
     boost::uint8_t usrp2_ctrl_data_in_mem[udp_simple::mtu]; //allocate max bytes for recv
     const usrp2_ctrl_data_t *ctrl_data_in = reinterpret_cast<const usrp2_ctrl_data_t *>(usrp2_ctrl_data_in_mem);
     while(true){
-        size_t len = udp_transport->recv(asio::buffer(usrp2_ctrl_data_in_mem));
+        double timeout = DISCOVERY_SILENCE_TIMEOUT;
+        if (has_total_timeout){
+            timeout = (exit_time - boost::get_system_time()).total_microseconds()/1e6;
+            if (timeout <= 0.0) break; //timeout
+        }
+        size_t len = udp_transport->recv(asio::buffer(usrp2_ctrl_data_in_mem), timeout);
         if (len > offsetof(usrp2_ctrl_data_t, data) and ntohl(ctrl_data_in->id) == USRP2_CTRL_ID_WAZZUP_DUDE){
 
             //make a boost asio ipv4 with the raw addr in host byte order
             boost::asio::ip::address_v4 ip_addr(ntohl(ctrl_data_in->data.ip_addr));
-            device_addr_t new_addr;
-            new_addr["type"] = "usrp2";
-            new_addr["addr"] = ip_addr.to_string();
+            new_addrs.push_back(device_addr_t());
+            new_addrs.back()["type"] = "usrp2";
+            new_addrs.back()["addr"] = ip_addr.to_string();
+            identify_threads.create_thread(boost::bind(
+                &usrp2_identify_task, boost::ref(new_addrs.back())
+            ));
 
-            //Attempt to read the name from the EEPROM and perform filtering.
-            //This operation can throw due to compatibility mismatch.
-            try{
-                usrp2_iface::sptr iface = usrp2_iface::make(udp_simple::make_connected(
-                    new_addr["addr"], BOOST_STRINGIZE(USRP2_UDP_CTRL_PORT)
-                ));
-                if (iface->is_device_locked()) continue; //ignore locked devices
-                mboard_eeprom_t mb_eeprom = iface->mb_eeprom;
-                new_addr["name"] = mb_eeprom["name"];
-                new_addr["serial"] = mb_eeprom["serial"];
-            }
-            catch(const std::exception &){
-                //set these values as empty string so the device may still be found
-                //and the filter's below can still operate on the discovered device
-                new_addr["name"] = "";
-                new_addr["serial"] = "";
-            }
-
-            //filter the discovered device below by matching optional keys
-            if (
-                (not hint.has_key("name")   or hint["name"]   == new_addr["name"]) and
-                (not hint.has_key("serial") or hint["serial"] == new_addr["serial"])
-            ){
-                usrp2_addrs.push_back(new_addr);
-            }
+            //a unicast query gets only one response, stop waiting
+            if (ip_addr.to_string() == hint["addr"]) break;
 
             //dont break here, it will exit the while loop
             //just continue on to the next loop iteration
         }
         if (len == 0) break; //timeout
     }
+    identify_threads.join_all();
+
+    BOOST_FOREACH(const device_addr_t &new_addr, new_addrs){
+        if (not new_addr.has_key("addr")) continue; //locked device
+
+        //filter the discovered device below by matching optional keys
+        if (
+            (not hint.has_key("name")   or hint["name"]   == new_addr["name"]) and
+            (not hint.has_key("serial") or hint["serial"] == new_addr["serial"])
+        ){
+            usrp2_addrs.push_back(new_addr);
+        }
+    }
 
     return usrp2_addrs;
 }
@@ -182,6 +256,18 @@ static mtu_result_t determine_mtu(const std::string &addr, const mtu_result_t &u
     ctrl_data->data.echo_args.len = htonl(sizeof(usrp2_ctrl_data_t));
     udp_sock->send(boost::asio::buffer(buffer, sizeof(usrp2_ctrl_data_t)));
     udp_sock->recv(boost::asio::buffer(buffer), echo_timeout);
+
+    //older firmware answers a mismatched compat number with a wazzup:
+    //retry the holler test using the compat number of the firmware
+    boost::uint32_t proto_ver = USRP2_FW_COMPAT_NUM;
+    if (ntohl(ctrl_data->id) == USRP2_CTRL_ID_WAZZUP_DUDE){
+        proto_ver = ntohl(ctrl_data->proto_ver);
+        ctrl_data->id = htonl(USRP2_CTRL_ID_HOLLER_AT_ME_BRO);
+        ctrl_data->proto_ver = htonl(proto_ver);
+        ctrl_data->data.echo_args.len = htonl(sizeof(usrp2_ctrl_data_t));
+        udp_sock->send(boost::asio::buffer(buffer, sizeof(usrp2_ctrl_data_t)));
+        udp_sock->recv(boost::asio::buffer(buffer), echo_timeout);
+    }
     if (ntohl(ctrl_data->id) != USRP2_CTRL_ID_HOLLER_BACK_DUDE)
         throw uhd::not_implemented_error("holler protocol not implemented");
 
@@ -193,7 +279,7 @@ static mtu_result_t determine_mtu(const std::string &addr, const mtu_result_t &u
         size_t test_mtu = (max_recv_mtu/2 + min_recv_mtu/2 + 3) & ~3;
 
         ctrl_data->id = htonl(USRP2_CTRL_ID_HOLLER_AT_ME_BRO);
-        ctrl_data->proto_ver = htonl(USRP2_FW_COMPAT_NUM);
+        ctrl_data->proto_ver = htonl(proto_ver);
         ctrl_data->data.echo_args.len = htonl(test_mtu);
         udp_sock->send(boost::asio::buffer(buffer, sizeof(usrp2_ctrl_data_t)));
 
@@ -209,7 +295,7 @@ static mtu_result_t determine_mtu(const std::string &addr, const mtu_result_t &u
         size_t test_mtu = (max_send_mtu/2 + min_send_mtu/2 + 3) & ~3;
 
         ctrl_data->id = htonl(USRP2_CTRL_ID_HOLLER_AT_ME_BRO);
-        ctrl_data->proto_ver = htonl(USRP2_FW_COMPAT_NUM);
+        ctrl_data->proto_ver = htonl(proto_ver);
         ctrl_data->data.echo_args.len = htonl(sizeof(usrp2_ctrl_data_t));
         udp_sock->send(boost::asio::buffer(buffer, test_mtu));
 
@@ -226,10 +312,161 @@ static mtu_result_t determine_mtu(const std::string &addr, const mtu_result_t &u
     return mtu;
 }
 
+/***********************************************************************
+ * Parallel mboard tasks
+ **********************************************************************/
+static const size_t MAX_MBOARD_TASK_THREADS = 8;
+
+/*!
+ * Run a task for each mboard index on a small pool of threads.
+ * Tasks are started in index order; the first failure stops
+ * the remaining tasks from starting, and the error of the lowest
+ * failed index is thrown once all running tasks have finished.
+ */
+class mboard_task_runner : boost::noncopyable{
+public:
+    typedef boost::function<void(size_t)> task_type;
+
+    mboard_task_runner(const device_addrs_t &device_args, const task_type &task):
+        _device_args(device_args), _task(task),
+        _next_index(0), _failed(false), _errors(device_args.size())
+    {
+        /* NOP */
+    }
+
+    void run(void){
+        //a single mboard runs inline, keeping the original exception type
+        if (_device_args.size() == 1){
+            _task(0);
+            return;
+        }
+
+        boost::thread_group task_threads;
+        const size_t num_threads = std::min(_device_args.size(), MAX_MBOARD_TASK_THREADS);
+        for (size_t i = 0; i < num_threads; i++){
+            task_threads.create_thread(boost::bind(&mboard_task_runner::task_loop, this));
+        }
+        task_threads.join_all();
+
+        for (size_t i = 0; i < _errors.size(); i++){
+            if (_errors[i].empty()) continue;
+            throw uhd::runtime_error(str(boost::format(
+                "USRP2 mboard %d (addr %s) failed:\n%s"
+            ) % i % _device_args[i].get("addr", "?") % _errors[i]));
+        }
+    }
+
+private:
+    void task_loop(void){
+        while(true){
+            size_t index;
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                if (_failed or _next_index == _device_args.size()) return;
+                index = _next_index++;
+            }
+            std::string error;
+            try{
+                _task(index);
+                continue;
+            }
+            catch(const std::exception &e){
+                error = e.what();
+            }
+            catch(...){
+                error = "unknown exception";
+            }
+            boost::mutex::scoped_lock lock(_mutex);
+            _errors[index] = error.empty()? "unknown error" : error;
+            _failed = true;
+        }
+    }
+
+    const device_addrs_t &_device_args;
+    const task_type _task;
+    boost::mutex _mutex;
+    size_t _next_index;
+    bool _failed;
+    std::vector<std::string> _errors;
+};
+
+static void run_mboard_tasks(
+    const device_addrs_t &device_args,
+    const mboard_task_runner::task_type &task
+){
+    mboard_task_runner(device_args, task).run();
+}
+
 /***********************************************************************
  * Structors
  **********************************************************************/
-usrp2_impl::usrp2_impl(const device_addr_t &_device_addr){
+//! The per-mboard results of the control probing that precedes mboard construction
+struct mboard_probe_t{
+    usrp2_iface::sptr iface;
+    uhd::device_addr_t cached_desc;
+    mtu_result_t mtu;
+};
+
+static void probe_mboard_task(
+    const device_addrs_t &device_args,
+    const mtu_result_t &user_mtu,
+    bool use_desc_cache,
+    std::vector<mboard_probe_t> &probes,
+    size_t index
+){
+    const std::string &addr = device_args[index]["addr"];
+    mboard_probe_t &probe = probes[index];
+    probe.iface = usrp2_iface::make(udp_simple::make_connected(
+        addr, BOOST_STRINGIZE(USRP2_UDP_CTRL_PORT)
+    ));
+
+    //use the cached frame sizes when probed with the same limits
+    if (use_desc_cache) probe.cached_desc = usrp2_desc_cache::lookup(*probe.iface, addr);
+    const device_addr_t &desc = probe.cached_desc;
+    if (
+        desc.cast<size_t>("user_recv_mtu", 0) == user_mtu.recv_mtu and
+        desc.cast<size_t>("user_send_mtu", 0) == user_mtu.send_mtu and
+        desc.has_key("recv_mtu") and desc.has_key("send_mtu")
+    ){
+        probe.mtu.recv_mtu = desc.cast<size_t>("recv_mtu", 0);
+        probe.mtu.send_mtu = desc.cast<size_t>("send_mtu", 0);
+        return;
+    }
+
+    try{
+        probe.mtu = determine_mtu(addr, user_mtu);
+    }
+    catch(const uhd::not_implemented_error &){
+        probe.mtu.recv_mtu = probe.mtu.send_mtu = 0; //older fw
+    }
+}
+
+//! Do the descriptors hold the same key/value pairs (in any order)?
+static bool same_desc(const device_addr_t &a, const device_addr_t &b){
+    if (a.size() != b.size()) return false;
+    BOOST_FOREACH(const std::string &key, a.keys()){
+        if (not b.has_key(key) or b[key] != a[key]) return false;
+    }
+    return true;
+}
+
+static void make_mboard_task(
+    const device_addrs_t &mboard_args,
+    usrp2_impl &device,
+    const std::vector<mboard_probe_t> &probes,
+    std::vector<usrp2_mboard_impl::sptr> &mboards,
+    size_t index
+){
+    mboards[index] = usrp2_mboard_impl::sptr(new usrp2_mboard_impl(
+        mboard_args[index], index, device, probes[index].iface, probes[index].cached_desc
+    ));
+}
+
+usrp2_impl::usrp2_impl(const device_addr_t &_device_addr):
+    _stream_cmd_skew(0.0), _stream_cmd_skew_max(0.0),
+    _time_sync_spread(0.0), _time_sync_duration(0.0),
+    _rx_align_num_dropped(0)
+{
     UHD_MSG(status) << "Opening a USRP2/N-Series device..." << std::endl;
     device_addr_t device_addr = _device_addr;
 
@@ -251,24 +488,30 @@ usrp2_impl::usrp2_impl(const device_addr_t &_device_addr){
     user_mtu.recv_mtu = size_t(device_addr.cast<double>("recv_frame_size", udp_simple::mtu));
     user_mtu.send_mtu = size_t(device_addr.cast<double>("recv_frame_size", udp_simple::mtu));
 
-    try{
-        //calculate the minimum send and recv mtu of all devices
-        mtu_result_t mtu = determine_mtu(device_args[0]["addr"], user_mtu);
-        for (size_t i = 1; i < device_args.size(); i++){
-            mtu_result_t mtu_i = determine_mtu(device_args[i]["addr"], user_mtu);
-            mtu.recv_mtu = std::min(mtu.recv_mtu, mtu_i.recv_mtu);
-            mtu.send_mtu = std::min(mtu.send_mtu, mtu_i.send_mtu);
-        }
+    //connect to each device and calculate its send and recv mtu (in parallel)
+    const bool use_desc_cache = usrp2_desc_cache::enabled(device_addr);
+    std::vector<mboard_probe_t> probes(device_args.size());
+    run_mboard_tasks(device_args, boost::bind(
+        &probe_mboard_task, boost::cref(device_args), boost::cref(user_mtu),
+        use_desc_cache, boost::ref(probes), _1
+    ));
+
+    //calculate the minimum send and recv mtu of all devices
+    mtu_result_t mtu = probes.front().mtu;
+    BOOST_FOREACH(const mboard_probe_t &probe, probes){
+        mtu.recv_mtu = std::min(mtu.recv_mtu, probe.mtu.recv_mtu);
+        mtu.send_mtu = std::min(mtu.send_mtu, probe.mtu.send_mtu);
+    }
 
+    //a zero mtu means the holler protocol is not implemented:
+    //just ignore this, makes older fw work...
+    if (mtu.recv_mtu != 0 and mtu.send_mtu != 0){
         device_addr["recv_frame_size"] = boost::lexical_cast<std::string>(mtu.recv_mtu);
         device_addr["send_frame_size"] = boost::lexical_cast<std::string>(mtu.send_mtu);
 
         UHD_MSG(status) << boost::format("Current recv frame size: %d bytes") % mtu.recv_mtu << std::endl;
         UHD_MSG(status) << boost::format("Current send frame size: %d bytes") % mtu.send_mtu << std::endl;
     }
-    catch(const uhd::not_implemented_error &){
-        //just ignore this error, makes older fw work...
-    }
 
     device_args = separate_device_addr(device_addr); //update args for new frame sizes
 
@@ -284,22 +527,56 @@ usrp2_impl::usrp2_impl(const device_addr_t &_device_addr){
 
     //!!!!! set the otw type here before continuing, its used below
 
-    //create a new mboard handler for each control transport
-    for(size_t i = 0; i < device_args.size(); i++){
-        device_addr_t dev_addr_i = device_args[i];
+    //fill in the common args for each mboard
+    device_addrs_t mboard_args = device_args;
+    BOOST_FOREACH(device_addr_t &dev_addr_i, mboard_args){
         BOOST_FOREACH(const std::string &key, device_addr.keys()){
             if (dev_addr_i.has_key(key)) continue;
             dev_addr_i[key] = device_addr[key];
         }
-        _mboards.push_back(usrp2_mboard_impl::sptr(
-            new usrp2_mboard_impl(dev_addr_i, i, *this)
-        ));
+    }
+
+    //the frame sizes used by the io impl (all data transports are identical)
+    recv_frame_size = size_t(mboard_args.front().cast<double>("recv_frame_size", udp_simple::mtu));
+    send_frame_size = size_t(mboard_args.front().cast<double>("send_frame_size", udp_simple::mtu));
+
+    //each mboard fills in its own slots of the transport vectors
+    dsp_xports.resize(mboard_args.size()*usrp2_mboard_impl::MAX_NUM_DSPS);
+    err_xports.resize(mboard_args.size());
+
+    //create a new mboard handler for each control transport (in parallel)
+    _mboards.resize(mboard_args.size());
+    run_mboard_tasks(mboard_args, boost::bind(
+        &make_mboard_task, boost::cref(mboard_args), boost::ref(*this),
+        boost::cref(probes), boost::ref(_mboards), _1
+    ));
+    for(size_t i = 0; i < _mboards.size(); i++){
         //use an empty name when there is only one mboard
-        std::string name = (device_args.size() > 1)? boost::lexical_cast<std::string>(i) : "";
-        _mboard_dict[name] = _mboards.back();
+        std::string name = (_mboards.size() > 1)? boost::lexical_cast<std::string>(i) : "";
+        _mboard_dict[name] = _mboards[i];
+    }
+
+    //one control transaction per mboard at once (the caller makes the first)
+    _mboard_issuer.reset(new concurrent_issuer(_mboards.size()));
+
+    //remember what was learned about each device for the next startup
+    for(size_t i = 0; use_desc_cache and i < _mboards.size(); i++){
+        device_addr_t desc = _mboards[i]->get_cache_desc();
+        desc["addr"] = device_args[i]["addr"];
+        desc["user_recv_mtu"] = boost::lexical_cast<std::string>(user_mtu.recv_mtu);
+        desc["user_send_mtu"] = boost::lexical_cast<std::string>(user_mtu.send_mtu);
+        desc["recv_mtu"] = boost::lexical_cast<std::string>(probes[i].mtu.recv_mtu);
+        desc["send_mtu"] = boost::lexical_cast<std::string>(probes[i].mtu.send_mtu);
+        if (same_desc(desc, probes[i].cached_desc)) continue; //already cached
+        usrp2_desc_cache::store(desc);
     }
 
     //init the send and recv io
+    _recv_zero_fill = device_addr.cast<int>("recv_zero_fill", 0) != 0;
+    _recv_num_workers = device_addr.cast<size_t>("recv_workers", 0);
+    _tx_fc_adapt = device_addr.cast<int>("tx_fc_adapt", 0) != 0;
+    _tx_stage_samps = device_addr.cast<size_t>("tx_stage_samps", 0);
+    _async_msg_depth = std::max<size_t>(1, device_addr.cast<size_t>("async_msg_depth", 100));
     io_init();
 
 }
@@ -308,6 +585,99 @@ usrp2_impl::~usrp2_impl(void){
     /* NOP */
 }
 
+/***********************************************************************
+ * Time Sync
+ * - catch a pps edge on the first mboard (one peek per poll)
+ * - set the time of all mboards at the next pps, at once,
+ *   each mboard polls its last pps time until the pps latched it
+ * - the spread is between the time models of the mboards
+ **********************************************************************/
+static void set_time_next_pps_task(usrp2_mboard_impl::sptr mboard, const time_spec_t &time_spec, size_t index){
+    if (mboard->set_time_next_pps(time_spec, 1.1)) return;
+    throw uhd::runtime_error(str(boost::format(
+        "No PPS latched the time of board %d within the time interval."
+    ) % index));
+}
+
+void usrp2_impl::set_time_unknown_pps(const time_spec_t &time_spec){
+    const double start_time = device_time_model::get_host_time();
+
+    UHD_MSG(status) << "    1) catch time transition at pps edge" << std::endl;
+    if (not _mboards.front()->wait_for_pps(1.1)) throw uhd::runtime_error(
+        "Board 0 may not be getting a PPS signal!\n"
+        "No PPS detected within the time interval.\n"
+        "See the application notes for your device.\n"
+    );
+
+    UHD_MSG(status) << "    2) set times next pps (synchronously)" << std::endl;
+    std::vector<concurrent_issuer::issue_type> issues;
+    for (size_t i = 0; i < _mboards.size(); i++){
+        issues.push_back(boost::bind(&set_time_next_pps_task, _mboards[i], time_spec, i));
+    }
+    _mboard_issuer->issue(issues); //throws when a board did not latch the time
+
+    //the time models were synced once the pps latched the time:
+    //compare their estimates at one host time (no more io, unless a model lost its sync)
+    const double now = device_time_model::get_host_time();
+    time_spec_t time_0;
+    double spread = 0.0, error = 0.0;
+    for (size_t i = 0; i < _mboards.size(); i++){
+        time_spec_t time_i;
+        double error_i;
+        if (not _mboards[i]->estimate_time(now, time_i, error_i)){
+            _mboards[i]->get_time_now_exact(); //syncs the time model
+            if (not _mboards[i]->estimate_time(now, time_i, error_i)) throw uhd::runtime_error(str(boost::format(
+                "No time estimate of board %d after the time was set."
+            ) % i));
+        }
+        if (i == 0) time_0 = time_i;
+        spread = std::max(spread, std::abs((time_i - time_0).get_real_secs()));
+        error = std::max(error, error_i);
+        if (time_i < time_0 - time_spec_t(error_i) or (time_i - time_0) > time_spec_t(0.01)){ //10 ms: greater than RTT but not too big
+            UHD_MSG(warning) << boost::format(
+                "Detected time deviation between board %d and board 0.\n"
+                "Board 0 time is %f seconds.\n"
+                "Board %d time is %f seconds.\n"
+            ) % i % time_0.get_real_secs() % i % time_i.get_real_secs();
+        }
+    }
+    const double duration = device_time_model::get_host_time() - start_time;
+    UHD_MSG(status) << boost::format(
+        "    3) times set: spread %.1f us (error %.1f us), took %.3f s"
+    ) % (spread*1e6) % (error*1e6) % duration << std::endl;
+
+    boost::mutex::scoped_lock lock(_ctrl_stats_mutex);
+    _time_sync_spread = spread;
+    _time_sync_duration = duration;
+}
+
+prop_names_t usrp2_impl::get_ctrl_sensor_names(void){
+    return boost::assign::list_of
+        ("stream_cmd_skew")("stream_cmd_skew_max")
+        ("time_sync_spread")("time_sync_duration")
+        ("rx_align_num_dropped");
+}
+
+sensor_value_t usrp2_impl::get_ctrl_sensor(const std::string &name){
+    boost::mutex::scoped_lock lock(_ctrl_stats_mutex);
+    if (name == "stream_cmd_skew"){
+        return sensor_value_t("Stream command skew", _stream_cmd_skew, "seconds");
+    }
+    if (name == "stream_cmd_skew_max"){
+        return sensor_value_t("Stream command max skew", _stream_cmd_skew_max, "seconds");
+    }
+    if (name == "time_sync_spread"){
+        return sensor_value_t("Time sync spread", _time_sync_spread, "seconds");
+    }
+    if (name == "time_sync_duration"){
+        return sensor_value_t("Time sync duration", _time_sync_duration, "seconds");
+    }
+    if (name == "rx_align_num_dropped"){
+        return sensor_value_t("RX samples dropped to align", int(_rx_align_num_dropped), "samples");
+    }
+    throw uhd::key_error("unknown control sensor: " + name);
+}
+
 /***********************************************************************
  * Device Properties
  **********************************************************************/
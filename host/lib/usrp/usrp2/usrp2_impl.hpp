@@ -21,16 +21,24 @@
 #include "usrp2_iface.hpp"
 #include "clock_ctrl.hpp"
 #include "codec_ctrl.hpp"
+#include "../../transport/device_time_model.hpp"
+#include "../../transport/concurrent_issuer.hpp"
 #include <uhd/usrp/gps_ctrl.hpp>
 #include <uhd/device.hpp>
+#include <uhd/stream.hpp>
 #include <uhd/utils/pimpl.hpp>
 #include <uhd/types/dict.hpp>
 #include <uhd/types/otw_type.hpp>
 #include <uhd/types/stream_cmd.hpp>
 #include <uhd/types/clock_config.hpp>
+#include <uhd/types/sensors.hpp>
 #include <uhd/usrp/dboard_eeprom.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
 #include <uhd/transport/vrt_if_packet.hpp>
 #include <uhd/transport/udp_simple.hpp>
 #include <uhd/transport/udp_zero_copy.hpp>
@@ -89,7 +97,9 @@ public:
     //structors
     usrp2_mboard_impl(
         const uhd::device_addr_t &device_addr,
-        size_t index, usrp2_impl &device
+        size_t index, usrp2_impl &device,
+        usrp2_iface::sptr iface,
+        const uhd::device_addr_t &cached_desc
     );
     ~usrp2_mboard_impl(void);
 
@@ -99,6 +109,40 @@ public:
 
     void handle_overflow(size_t);
 
+    //! Get the tx packets per flow control update (zero when disabled)
+    size_t get_tx_packets_per_up(void) const{
+        boost::mutex::scoped_lock lock(_housekeeping_mutex);
+        return _tx_packets_per_up;
+    }
+
+    //! Request new tx packets per update (applied by the housekeeping thread)
+    void request_tx_packets_per_up(size_t);
+
+    //! Get the identity and dboard ids for the descriptor cache
+    uhd::device_addr_t get_cache_desc(void);
+
+    //! Issue a stream command to a set of ddcs in one control transaction
+    void issue_ddc_stream_cmds(const uhd::stream_cmd_t &, const std::vector<size_t> &);
+
+    //! Read the device time (three peeks), and sync the time model with it
+    uhd::time_spec_t get_time_now_exact(void);
+
+    //! Narrow the time model with a timestamp from the device
+    void observe_time(const uhd::time_spec_t &time_spec){
+        _time_model.observe(_time_model.get_host_time(), time_spec);
+    }
+
+    //! Estimate the device time at a host time (see the device time model)
+    bool estimate_time(double host_time, uhd::time_spec_t &time_spec, double &error) const{
+        return _time_model.estimate(host_time, time_spec, error);
+    }
+
+    //! Wait for a pps edge (one peek per poll), false on timeout
+    bool wait_for_pps(double timeout);
+
+    //! Set the time at the next pps, and wait until the pps latched it (false on timeout)
+    bool set_time_next_pps(const uhd::time_spec_t &time_spec, double timeout);
+
 private:
     size_t _index;
     usrp2_impl &_device;
@@ -118,13 +162,25 @@ private:
     //rx and tx dboard methods and objects
     uhd::usrp::dboard_manager::sptr _dboard_manager;
     uhd::usrp::dboard_iface::sptr _dboard_iface;
-    void dboard_init(void);
+    void dboard_init(const uhd::device_addr_t &cached_desc);
 
     //methods and shadows for clock configuration
     uhd::clock_config_t _clock_config;
     void update_clock_config(void);
     void set_time_spec(const uhd::time_spec_t &time_spec, bool now);
 
+    //host model of the device time, for time now reads without io
+    uhd::transport::device_time_model _time_model;
+
+    //the housekeeping thread makes the periodic control io (the async thread makes none):
+    //it syncs the time model and applies the tx packets per update of the flow control tuning
+    void housekeeping_loop(boost::barrier &spawn_barrier);
+    void set_tx_packets_per_up(size_t);
+    size_t _tx_packets_per_up, _tx_packets_per_up_request;
+    mutable boost::mutex _housekeeping_mutex;
+    boost::condition _housekeeping_cond;
+    boost::thread_group _housekeeping_thread_group;
+
     //properties interface for the codec
     void codec_init(void);
     void rx_codec_get(const wax::obj &, wax::obj &);
@@ -153,15 +209,18 @@ private:
     UHD_PIMPL_DECL(dsp_impl) _dsp_impl;
     void dsp_init(void);
     void issue_ddc_stream_cmd(const uhd::stream_cmd_t &, size_t);
+    void issue_ddc_stream_cmd(const uhd::stream_cmd_t &, size_t, usrp2_iface::batch_t &);
 
     //properties interface for ddc
     void ddc_get(const wax::obj &, wax::obj &, size_t);
     void ddc_set(const wax::obj &, const wax::obj &, size_t);
+    void ddc_set(const wax::obj &, const wax::obj &, size_t, usrp2_iface::batch_t &);
     uhd::dict<std::string, wax_obj_proxy::sptr> _rx_dsp_proxies;
 
     //properties interface for duc
     void duc_get(const wax::obj &, wax::obj &, size_t);
     void duc_set(const wax::obj &, const wax::obj &, size_t);
+    void duc_set(const wax::obj &, const wax::obj &, size_t, usrp2_iface::batch_t &);
     uhd::dict<std::string, wax_obj_proxy::sptr> _tx_dsp_proxies;
     
     //sensors methods for mboard
@@ -180,6 +239,20 @@ public:
     static const boost::uint32_t RECV_SID = 1;
     static const boost::uint32_t ASYNC_SID = 2;
 
+    /*!
+     * The async reports of a tx dsp (with its flow control acks)
+     * carry the async stream id plus the dsp number in the upper bits.
+     */
+    static boost::uint32_t get_async_sid(size_t dsp){
+        return ASYNC_SID | boost::uint32_t(dsp << 4);
+    }
+    static bool is_async_sid(boost::uint32_t sid){
+        return (sid & 0xf) == ASYNC_SID;
+    }
+    static size_t get_async_sid_dsp(boost::uint32_t sid){
+        return size_t(sid >> 4);
+    }
+
     usrp2_impl(const uhd::device_addr_t &);
 
     ~usrp2_impl(void);
@@ -198,6 +271,18 @@ public:
     size_t get_max_send_samps_per_packet(void) const;
     size_t get_max_recv_samps_per_packet(void) const;
     bool recv_async_msg(uhd::async_metadata_t &, double);
+    uhd::rx_stream::sptr get_rx_stream(const std::vector<size_t> &);
+    uhd::rx_stream::sptr subscribe_rx_stream(const std::vector<size_t> &, size_t, subscriber_policy_t);
+    double issue_stream_cmd(const uhd::stream_cmd_t &, const std::vector<size_t> &);
+    void set_time_unknown_pps(const uhd::time_spec_t &);
+
+    //! Get the names and the values of the tx sensors of a dsp (used by the mboard sensors)
+    uhd::prop_names_t get_tx_sensor_names(void);
+    uhd::sensor_value_t get_tx_sensor(size_t dsp_index, const std::string &name);
+
+    //! Get the names and the values of the device-wide sensors: transactions to all mboards, rx alignment (used by the mboard sensors)
+    uhd::prop_names_t get_ctrl_sensor_names(void);
+    uhd::sensor_value_t get_ctrl_sensor(const std::string &name);
 
     void update_xport_channel_mapping(void);
 
@@ -216,11 +301,27 @@ private:
     std::vector<usrp2_mboard_impl::sptr> _mboards;
     uhd::dict<std::string, usrp2_mboard_impl::sptr> _mboard_dict;
 
+    //makes the control transactions to all mboards at once, and their stats
+    uhd::transport::concurrent_issuer::sptr _mboard_issuer;
+    boost::mutex _ctrl_stats_mutex;
+    double _stream_cmd_skew, _stream_cmd_skew_max;
+    double _time_sync_spread, _time_sync_duration;
+    size_t _rx_align_num_dropped;
+
     //io impl methods and members
     uhd::otw_type_t _rx_otw_type, _tx_otw_type;
+    bool _recv_zero_fill;
+    size_t _recv_num_workers;
+    bool _tx_fc_adapt;
+    size_t _tx_stage_samps;
+    size_t _async_msg_depth;
     UHD_PIMPL_DECL(io_impl) _io_impl;
     void io_init(void);
-    void handle_overflow(size_t);
+    size_t send_packets(const send_buffs_type &, size_t, const uhd::tx_metadata_t &, const uhd::io_type_t &, send_mode_t);
+    uhd::rx_stream::sptr make_recv_stream(const std::vector<size_t> &, const std::vector<uhd::transport::zero_copy_if::sptr> &);
+    void handle_overflow(const std::vector<size_t> &, size_t);
+    void observe_rx_time(const std::vector<size_t> &, const uhd::time_spec_t &);
+    void count_rx_align_drops(size_t);
 };
 
 #endif /* INCLUDED_USRP2_IMPL_HPP */
@@ -23,6 +23,7 @@
 #include <uhd/utils/thread_priority.hpp>
 #include <uhd/transport/bounded_buffer.hpp>
 #include "../../transport/vrt_packet_handler.hpp"
+#include "../../transport/vrt_overflow_recovery.hpp"
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
 #include <boost/thread/thread.hpp>
@@ -54,7 +55,8 @@ struct usrp_e100_impl::io_impl{
         get_recv_buffs_fcn(boost::bind(&usrp_e100_impl::io_impl::get_recv_buffs, this, _1)),
         get_send_buffs_fcn(boost::bind(&usrp_e100_impl::io_impl::get_send_buffs, this, _1)),
         recv_pirate_booty(data_xport->get_num_recv_frames()),
-        async_msg_fifo(100/*messages deep*/)
+        async_msg_fifo(100/*messages deep*/),
+        stream_cmds(1)
     {
         /* NOP */
     }
@@ -92,7 +94,10 @@ struct usrp_e100_impl::io_impl{
     //state management for the vrt packet handler code
     vrt_packet_handler::recv_state packet_handler_recv_state;
     vrt_packet_handler::send_state packet_handler_send_state;
-    bool continuous_streaming;
+
+    //overflows are recovered in a thread, recv only signals them
+    vrt_packet_handler::stream_cmd_state stream_cmds;
+    vrt_packet_handler::overflow_recovery::sptr overflow_recovery;
 
     //a pirate's life is the life for me!
     void recv_pirate_loop(boost::barrier &, usrp_e100_clock_ctrl::sptr);
@@ -206,6 +211,11 @@ void usrp_e100_impl::io_init(void){
     _iface->poke32(UE_REG_CTRL_TX_REPORT_SID, tx_async_report_sid);
     _iface->poke32(UE_REG_CTRL_TX_POLICY, UE_FLAG_CTRL_TX_POLICY_NEXT_PACKET);
 
+    //re-issue the stream command after overflows (in the background)
+    _io_impl->overflow_recovery.reset(new vrt_packet_handler::overflow_recovery(
+        1, boost::bind(&usrp_e100_impl::handle_overrun, this, _1)
+    ));
+
     //spawn a pirate, yarrr!
     boost::barrier spawn_barrier(2);
     _io_impl->recv_pirate_crew.create_thread(boost::bind(
@@ -216,7 +226,12 @@ void usrp_e100_impl::io_init(void){
 }
 
 void usrp_e100_impl::issue_stream_cmd(const stream_cmd_t &stream_cmd){
-    _io_impl->continuous_streaming = (stream_cmd.stream_mode == stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    boost::mutex::scoped_lock lock(_io_impl->stream_cmds.get_mutex());
+    _io_impl->stream_cmds.set_continuous(0, stream_cmd.stream_mode == stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    this->poke_stream_cmd(stream_cmd);
+}
+
+void usrp_e100_impl::poke_stream_cmd(const stream_cmd_t &stream_cmd){
     _iface->poke32(UE_REG_CTRL_RX_STREAM_CMD, dsp_type1::calc_stream_cmd_word(stream_cmd));
     _iface->poke32(UE_REG_CTRL_RX_TIME_SECS,  boost::uint32_t(stream_cmd.time_spec.get_full_secs()));
     _iface->poke32(UE_REG_CTRL_RX_TIME_TICKS, stream_cmd.time_spec.get_tick_count(_clock_ctrl->get_fpga_clock_rate()));
@@ -224,8 +239,11 @@ void usrp_e100_impl::issue_stream_cmd(const stream_cmd_t &stream_cmd){
 
 void usrp_e100_impl::handle_overrun(size_t){
     UHD_MSG(fastpath) << "O"; //the famous OOOOOOOOOOO
-    if (_io_impl->continuous_streaming){
-        this->issue_stream_cmd(stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+
+    //check and re-issue under the stream command lock (a stop may be issued meanwhile)
+    boost::mutex::scoped_lock lock(_io_impl->stream_cmds.get_mutex());
+    if (_io_impl->stream_cmds.is_continuous(0)){
+        this->poke_stream_cmd(stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
     }
 }
 
@@ -247,12 +265,28 @@ size_t usrp_e100_impl::send(
     send_mode_t send_mode, double timeout
 ){
     _io_impl->send_timeout = timeout;
+    const double tick_rate = _clock_ctrl->get_fpga_clock_rate();
+
+    //use the packet handler specialized for the common io types (otw type is always le 16-bit)
+    typedef vrt_packet_handler::vrt_codec_le codec;
+    switch(io_type.tid){
+    case io_type_t::COMPLEX_FLOAT32: return vrt_packet_handler::static_handler<codec, std::complex<float> >::send(
+        _io_impl->packet_handler_send_state, buffs, num_samps, metadata, send_mode,
+        tick_rate, *_io_impl, get_max_send_samps_per_packet()
+    );
+    case io_type_t::COMPLEX_INT16: return vrt_packet_handler::static_handler<codec, std::complex<boost::int16_t> >::send(
+        _io_impl->packet_handler_send_state, buffs, num_samps, metadata, send_mode,
+        tick_rate, *_io_impl, get_max_send_samps_per_packet()
+    );
+    default: break;
+    }
+
     return vrt_packet_handler::send(
         _io_impl->packet_handler_send_state,       //last state of the send handler
         buffs, num_samps,                          //buffer to fill
         metadata, send_mode,                       //samples metadata
         io_type, _send_otw_type,                   //input and output types to convert
-        _clock_ctrl->get_fpga_clock_rate(),        //master clock tick rate
+        tick_rate,                                 //master clock tick rate
         uhd::transport::vrt::if_hdr_pack_le,
         _io_impl->get_send_buffs_fcn,
         get_max_send_samps_per_packet()
@@ -278,15 +312,32 @@ size_t usrp_e100_impl::recv(
     recv_mode_t recv_mode, double timeout
 ){
     _io_impl->recv_timeout = timeout;
+    const double tick_rate = _clock_ctrl->get_fpga_clock_rate();
+    const vrt_packet_handler::handle_overflow_t handle_overflow(boost::ref(*_io_impl->overflow_recovery));
+
+    //use the packet handler specialized for the common io types (otw type is always le 16-bit)
+    typedef vrt_packet_handler::vrt_codec_le codec;
+    switch(io_type.tid){
+    case io_type_t::COMPLEX_FLOAT32: return vrt_packet_handler::static_handler<codec, std::complex<float> >::recv(
+        _io_impl->packet_handler_recv_state, buffs, num_samps, metadata, recv_mode,
+        tick_rate, *_io_impl, handle_overflow
+    );
+    case io_type_t::COMPLEX_INT16: return vrt_packet_handler::static_handler<codec, std::complex<boost::int16_t> >::recv(
+        _io_impl->packet_handler_recv_state, buffs, num_samps, metadata, recv_mode,
+        tick_rate, *_io_impl, handle_overflow
+    );
+    default: break;
+    }
+
     return vrt_packet_handler::recv(
         _io_impl->packet_handler_recv_state,       //last state of the recv handler
         buffs, num_samps,                          //buffer to fill
         metadata, recv_mode,                       //samples metadata
         io_type, _recv_otw_type,                   //input and output types to convert
-        _clock_ctrl->get_fpga_clock_rate(),        //master clock tick rate
+        tick_rate,                                 //master clock tick rate
         uhd::transport::vrt::if_hdr_unpack_le,
         _io_impl->get_recv_buffs_fcn,
-        boost::bind(&usrp_e100_impl::handle_overrun, this, _1)
+        handle_overflow
     );
 }
 
@@ -131,7 +131,8 @@ void usrp_e100_impl::mboard_get(const wax::obj &key_, wax::obj &val){
         val = _iface->mb_eeprom;
         return;
 
-    case MBOARD_PROP_TIME_NOW: while(true){
+    case MBOARD_PROP_TIME_NOW:
+    case MBOARD_PROP_TIME_NOW_EXACT: while(true){
         uint32_t secs = _iface->peek32(UE_REG_RB_TIME_NOW_SECS);
         uint32_t ticks = _iface->peek32(UE_REG_RB_TIME_NOW_TICKS);
         if (secs != _iface->peek32(UE_REG_RB_TIME_NOW_SECS)) continue;
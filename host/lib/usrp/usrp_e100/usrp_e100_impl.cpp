@@ -180,7 +180,8 @@ usrp_e100_impl::usrp_e100_impl(
 }
 
 usrp_e100_impl::~usrp_e100_impl(void){
-    /* NOP */
+    //stop the io threads (overflow recovery) before the members they use
+    _io_impl.reset();
 }
 
 /***********************************************************************
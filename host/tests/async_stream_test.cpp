@@ -0,0 +1,241 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include <uhd/async_stream.hpp>
+#include <uhd/transport/bounded_buffer.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <vector>
+
+using namespace uhd;
+
+/***********************************************************************
+ * Paced receive stream:
+ * Each recv fills the buffer with a counter, but only when the test
+ * allows it, otherwise it times out like a stream without samples.
+ **********************************************************************/
+class paced_rx_stream : public rx_stream{
+public:
+    paced_rx_stream(void): _credits(1000), _count(0){
+        /* NOP */
+    }
+
+    void allow(size_t num_recvs){
+        for (size_t i = 0; i < num_recvs; i++) _credits.push_with_haste(true);
+    }
+
+    size_t get_num_channels(void) const{return 1;}
+    size_t get_max_num_samps(void) const{return 100;}
+
+    size_t recv(
+        const device::recv_buffs_type &buffs, size_t nsamps_per_buff,
+        rx_metadata_t &metadata, const io_type_t &io_type,
+        device::recv_mode_t, double timeout
+    ){
+        BOOST_REQUIRE_EQUAL(io_type.size, sizeof(size_t));
+        metadata = rx_metadata_t();
+        bool credit;
+        if (not _credits.pop_with_timed_wait(credit, timeout)){
+            metadata.error_code = rx_metadata_t::ERROR_CODE_TIMEOUT;
+            return 0;
+        }
+        size_t *samps = reinterpret_cast<size_t *>(buffs[0]);
+        for (size_t i = 0; i < nsamps_per_buff; i++) samps[i] = _count++;
+        return nsamps_per_buff;
+    }
+
+private:
+    uhd::transport::bounded_buffer<bool> _credits;
+    size_t _count;
+};
+
+/***********************************************************************
+ * Recording device:
+ * Send takes at most spp samples per call and records them
+ * with the burst flags, the other calls are not used.
+ **********************************************************************/
+class recording_device : public device{
+public:
+    recording_device(size_t spp): num_sobs(0), num_eobs(0), _spp(spp){
+        /* NOP */
+    }
+
+    size_t send(
+        const send_buffs_type &buffs, size_t nsamps_per_buff,
+        const tx_metadata_t &metadata, const io_type_t &,
+        send_mode_t, double
+    ){
+        const size_t num_samps = std::min(nsamps_per_buff, _spp);
+        const size_t *samps = reinterpret_cast<const size_t *>(buffs[0]);
+        boost::mutex::scoped_lock lock(_mutex);
+        samples.insert(samples.end(), samps, samps + num_samps);
+        if (metadata.start_of_burst) num_sobs++;
+        if (metadata.end_of_burst and num_samps == nsamps_per_buff) num_eobs++;
+        return num_samps;
+    }
+
+    size_t recv(const recv_buffs_type &, size_t, rx_metadata_t &, const io_type_t &, recv_mode_t, double){return 0;}
+    size_t get_max_send_samps_per_packet(void) const{return _spp;}
+    size_t get_max_recv_samps_per_packet(void) const{return 0;}
+    bool recv_async_msg(async_metadata_t &, double){return false;}
+
+    std::vector<size_t> samples;
+    size_t num_sobs, num_eobs;
+
+private:
+    const size_t _spp;
+    boost::mutex _mutex;
+};
+
+/***********************************************************************
+ * Completion recorder: the handlers run on the I/O thread
+ **********************************************************************/
+class completions{
+public:
+    void on_recv(async_status_t status, size_t num_samps, const rx_metadata_t &){
+        boost::mutex::scoped_lock lock(_mutex);
+        statuses.push_back(status);
+        nsamps.push_back(num_samps);
+    }
+
+    void on_send(async_status_t status, size_t num_samps){
+        boost::mutex::scoped_lock lock(_mutex);
+        statuses.push_back(status);
+        nsamps.push_back(num_samps);
+    }
+
+    //wait for a number of completions (up to one second)
+    bool wait(size_t num){
+        for (size_t i = 0; i < 100; i++){
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                if (statuses.size() >= num) return true;
+            }
+            boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+        }
+        return false;
+    }
+
+    std::vector<async_status_t> statuses;
+    std::vector<size_t> nsamps;
+
+private:
+    boost::mutex _mutex;
+};
+
+static const size_t nsamps_per_buff = 50;
+static const size_t max_in_flight = 4;
+
+BOOST_AUTO_TEST_CASE(test_async_recv){
+    boost::shared_ptr<paced_rx_stream> stream(new paced_rx_stream());
+    async_rx_stream::sptr async_stream = async_rx_stream::make(stream, io_type_t(sizeof(size_t)), max_in_flight);
+    std::vector<std::vector<size_t> > buffs(10, std::vector<size_t>(nsamps_per_buff));
+    completions done;
+
+    //the bound on the requests in flight holds back the application
+    for (size_t i = 0; i < max_in_flight; i++){
+        BOOST_CHECK(async_stream->submit(std::vector<void *>(1, &buffs[i].front()), nsamps_per_buff,
+            boost::bind(&completions::on_recv, &done, _1, _2, _3)));
+    }
+    BOOST_CHECK(not async_stream->submit(std::vector<void *>(1, &buffs[max_in_flight].front()), nsamps_per_buff,
+        boost::bind(&completions::on_recv, &done, _1, _2, _3), 0.01));
+    BOOST_CHECK_EQUAL(async_stream->get_num_in_flight(), max_in_flight);
+
+    //the requests complete in order as the samples come in
+    stream->allow(buffs.size());
+    for (size_t i = max_in_flight; i < buffs.size(); i++){
+        BOOST_CHECK(async_stream->submit(std::vector<void *>(1, &buffs[i].front()), nsamps_per_buff,
+            boost::bind(&completions::on_recv, &done, _1, _2, _3), 1.0));
+    }
+    BOOST_REQUIRE(done.wait(buffs.size()));
+    for (size_t i = 0; i < buffs.size(); i++){
+        BOOST_CHECK_EQUAL(done.statuses[i], ASYNC_STATUS_DONE);
+        BOOST_CHECK_EQUAL(done.nsamps[i], nsamps_per_buff);
+        BOOST_CHECK_EQUAL(buffs[i].front(), i*nsamps_per_buff);
+    }
+    BOOST_CHECK_EQUAL(async_stream->get_num_in_flight(), size_t(0));
+}
+
+BOOST_AUTO_TEST_CASE(test_async_recv_cancel){
+    boost::shared_ptr<paced_rx_stream> stream(new paced_rx_stream());
+    async_rx_stream::sptr async_stream = async_rx_stream::make(stream, io_type_t(sizeof(size_t)), max_in_flight);
+    std::vector<size_t> buff(nsamps_per_buff);
+    completions done;
+
+    //no samples come in, the requests wait until cancelled
+    for (size_t i = 0; i < max_in_flight; i++){
+        async_stream->submit(std::vector<void *>(1, &buff.front()), nsamps_per_buff,
+            boost::bind(&completions::on_recv, &done, _1, _2, _3));
+    }
+    async_stream->cancel();
+    BOOST_REQUIRE(done.wait(max_in_flight));
+    for (size_t i = 0; i < max_in_flight; i++){
+        BOOST_CHECK_EQUAL(done.statuses[i], ASYNC_STATUS_CANCELLED);
+        BOOST_CHECK_EQUAL(done.nsamps[i], size_t(0));
+    }
+
+    //a request after the cancel is carried out
+    stream->allow(1);
+    async_stream->submit(std::vector<void *>(1, &buff.front()), nsamps_per_buff,
+        boost::bind(&completions::on_recv, &done, _1, _2, _3));
+    BOOST_REQUIRE(done.wait(max_in_flight + 1));
+    BOOST_CHECK_EQUAL(done.statuses.back(), ASYNC_STATUS_DONE);
+}
+
+BOOST_AUTO_TEST_CASE(test_async_recv_shutdown){
+    boost::shared_ptr<paced_rx_stream> stream(new paced_rx_stream());
+    std::vector<size_t> buff(nsamps_per_buff);
+    completions done;
+
+    //the pending requests are cancelled by the time the stream is gone
+    async_rx_stream::sptr async_stream = async_rx_stream::make(stream, io_type_t(sizeof(size_t)), max_in_flight);
+    for (size_t i = 0; i < max_in_flight; i++){
+        async_stream->submit(std::vector<void *>(1, &buff.front()), nsamps_per_buff,
+            boost::bind(&completions::on_recv, &done, _1, _2, _3));
+    }
+    async_stream.reset();
+    BOOST_CHECK_EQUAL(done.statuses.size(), max_in_flight);
+}
+
+BOOST_AUTO_TEST_CASE(test_async_send){
+    static const size_t spp = 16, num_requests = 10;
+    boost::shared_ptr<recording_device> dev(new recording_device(spp));
+    std::vector<size_t> samps(num_requests*nsamps_per_buff);
+    for (size_t i = 0; i < samps.size(); i++) samps[i] = i;
+    completions done;
+
+    //one burst across the requests, each request takes several sends
+    async_tx_stream::sptr async_stream = async_tx_stream::make(dev, io_type_t(sizeof(size_t)), max_in_flight);
+    for (size_t i = 0; i < num_requests; i++){
+        tx_metadata_t md;
+        md.start_of_burst = (i == 0);
+        md.end_of_burst = (i == num_requests - 1);
+        BOOST_CHECK(async_stream->submit(std::vector<const void *>(1, &samps[i*nsamps_per_buff]), nsamps_per_buff, md,
+            boost::bind(&completions::on_send, &done, _1, _2), 1.0));
+    }
+    BOOST_REQUIRE(done.wait(num_requests));
+    for (size_t i = 0; i < num_requests; i++){
+        BOOST_CHECK_EQUAL(done.statuses[i], ASYNC_STATUS_DONE);
+        BOOST_CHECK_EQUAL(done.nsamps[i], nsamps_per_buff);
+    }
+    BOOST_CHECK(dev->samples == samps);
+    BOOST_CHECK_EQUAL(dev->num_sobs, size_t(1));
+    BOOST_CHECK_EQUAL(dev->num_eobs, size_t(1));
+}
@@ -0,0 +1,170 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "burst_tracker.hpp"
+#include "vrt_packet_handler.hpp"
+#include <uhd/transport/udp_zero_copy.hpp>
+#include <uhd/transport/bounded_buffer.hpp>
+#include <uhd/types/metadata.hpp>
+#include <uhd/utils/byteswap.hpp>
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+using namespace uhd;
+using namespace uhd::transport;
+namespace asio = boost::asio;
+
+BOOST_AUTO_TEST_CASE(test_burst_tracker_match){
+    burst_tracker tracker;
+    double latency = 0.0;
+
+    //the acks complete their bursts, a missing ack counts as lost
+    for (boost::uint32_t i = 0; i < 4; i++) tracker.sent(10*i, double(i));
+    BOOST_CHECK(tracker.ack(0, 0.5, latency));
+    BOOST_CHECK_CLOSE(latency, 0.5, 1e-6);
+    BOOST_CHECK(tracker.ack(20, 2.25, latency));
+    BOOST_CHECK_CLOSE(latency, 0.25, 1e-6);
+    BOOST_CHECK_EQUAL(tracker.get_num_acked(), size_t(2));
+    BOOST_CHECK_EQUAL(tracker.get_num_lost(), size_t(1));
+    BOOST_CHECK_EQUAL(tracker.get_num_pending(), size_t(1));
+
+    //an ack without a pending burst is ignored
+    BOOST_CHECK(not tracker.ack(20, 3.0, latency));
+    BOOST_CHECK_CLOSE(tracker.get_latency_min(), 0.25, 1e-6);
+    BOOST_CHECK_CLOSE(tracker.get_latency_max(), 0.5, 1e-6);
+    BOOST_CHECK_CLOSE(tracker.get_latency_mean(), 0.375, 1e-6);
+
+    //the ack carries the low 16 bits of the sequence
+    tracker.sent(0x12345, 4.0);
+    BOOST_CHECK(tracker.ack(0x2345, 4.5, latency));
+    BOOST_CHECK_EQUAL(tracker.get_num_lost(), size_t(2));
+    BOOST_CHECK_EQUAL(tracker.get_num_pending(), size_t(0));
+}
+
+/***********************************************************************
+ * Fake device over loopback udp:
+ * Takes the end of burst packets (the first word is the sequence),
+ * and replies with a burst ack async report for each of them,
+ * except for the bursts that lose their acks.
+ * Then it floods the host with underflow reports.
+ **********************************************************************/
+static const size_t num_bursts = 50, ack_loss_period = 5, num_flood = 40;
+static const double tick_rate = 100e6;
+
+static void fake_device_loop(asio::ip::udp::socket &socket){
+    std::vector<boost::uint32_t> buff(64);
+    asio::ip::udp::endpoint host;
+    socket.receive_from(asio::buffer(buff), host); //the host opens the path
+
+    for (size_t i = 0; i < num_bursts + num_flood; i++){
+        boost::uint32_t seq = 0xffff;
+        if (i < num_bursts){
+            socket.receive(asio::buffer(buff));
+            seq = uhd::ntohx(buff[0]);
+            if (i % ack_loss_period == ack_loss_period - 1) continue;
+        }
+        vrt::if_packet_info_t if_packet_info;
+        if_packet_info.packet_type = vrt::if_packet_info_t::PACKET_TYPE_CONTEXT;
+        if_packet_info.num_payload_words32 = 1;
+        if_packet_info.packet_count = i;
+        if_packet_info.sob = false;
+        if_packet_info.eob = false;
+        if_packet_info.has_sid = true;
+        if_packet_info.sid = 0x10;
+        if_packet_info.has_cid = false;
+        if_packet_info.has_tsi = true;
+        if_packet_info.tsi = boost::uint32_t(i);
+        if_packet_info.has_tsf = true;
+        if_packet_info.tsf = 42;
+        if_packet_info.has_tlr = false;
+        vrt::if_hdr_pack_be(&buff.front(), if_packet_info);
+        const boost::uint32_t code = (i < num_bursts)?
+            async_metadata_t::EVENT_CODE_BURST_ACK : async_metadata_t::EVENT_CODE_UNDERFLOW;
+        buff[if_packet_info.num_header_words32] = uhd::htonx(boost::uint32_t(((seq & 0xffff) << 16) | code));
+        socket.send_to(asio::buffer(&buff.front(), if_packet_info.num_packet_words32*sizeof(boost::uint32_t)), host);
+    }
+}
+
+static void send_word(zero_copy_if::sptr xport, boost::uint32_t word){
+    managed_send_buffer::sptr buff = xport->get_send_buff();
+    BOOST_REQUIRE(buff.get() != NULL);
+    buff->cast<boost::uint32_t *>()[0] = uhd::htonx(word);
+    buff->commit(sizeof(word));
+}
+
+BOOST_AUTO_TEST_CASE(test_burst_ack_loopback){
+    static const size_t async_msg_depth = 16;
+
+    asio::io_service io_service;
+    asio::ip::udp::socket socket(io_service, asio::ip::udp::endpoint(asio::ip::address_v4::loopback(), 0));
+    boost::thread_group device;
+    device.create_thread(boost::bind(&fake_device_loop, boost::ref(socket)));
+
+    zero_copy_if::sptr xport = udp_zero_copy::make(
+        "127.0.0.1", boost::lexical_cast<std::string>(socket.local_endpoint().port())
+    );
+    send_word(xport, 0);
+
+    //send the bursts, the end of burst sequences go past 16 bits
+    burst_tracker tracker;
+    for (size_t i = 0; i < num_bursts; i++){
+        const boost::uint32_t eob_seq = boost::uint32_t(0xfff0 + 3*i);
+        tracker.sent(eob_seq, 0.0);
+        send_word(xport, eob_seq);
+    }
+
+    //take the async reports like the device does
+    bounded_buffer<async_metadata_t> async_msg_fifo(async_msg_depth);
+    size_t num_dropped = 0, num_acks = 0;
+    for (size_t i = 0; i < num_bursts - num_bursts/ack_loss_period + num_flood; i++){
+        managed_recv_buffer::sptr buff = xport->get_recv_buff(1.0);
+        BOOST_REQUIRE(buff.get() != NULL);
+        vrt::if_packet_info_t if_packet_info;
+        if_packet_info.num_packet_words32 = buff->size()/sizeof(boost::uint32_t);
+        const boost::uint32_t *vrt_hdr = buff->cast<const boost::uint32_t *>();
+        vrt::if_hdr_unpack_be(vrt_hdr, if_packet_info);
+        BOOST_REQUIRE(if_packet_info.packet_type != vrt::if_packet_info_t::PACKET_TYPE_DATA);
+
+        async_metadata_t metadata;
+        metadata.channel = 0;
+        metadata.has_time_spec = if_packet_info.has_tsi and if_packet_info.has_tsf;
+        metadata.time_spec = vrt_packet_handler::ticks_to_time_spec(
+            vrt_packet_handler::get_ticks(if_packet_info, vrt_packet_handler::get_ticks_per_sec(tick_rate)), tick_rate
+        );
+        metadata.event_code = vrt_packet_handler::get_context_code_be<async_metadata_t::event_code_t>(vrt_hdr, if_packet_info);
+        if (metadata.event_code == async_metadata_t::EVENT_CODE_BURST_ACK){
+            double latency;
+            BOOST_CHECK(tracker.ack(vrt_packet_handler::get_context_seq_be(vrt_hdr, if_packet_info), 1.0, latency));
+            BOOST_CHECK(metadata.has_time_spec);
+            BOOST_CHECK_EQUAL(metadata.time_spec.get_full_secs(), time_t(if_packet_info.tsi));
+            num_acks++;
+        }
+        if (not async_msg_fifo.push_with_pop_on_full(metadata)) num_dropped++;
+    }
+    device.join_all();
+
+    //every burst is accounted for, the fifo counted what it dropped
+    BOOST_CHECK_EQUAL(num_acks, num_bursts - num_bursts/ack_loss_period);
+    BOOST_CHECK_EQUAL(tracker.get_num_acked(), num_acks);
+    BOOST_CHECK_EQUAL(tracker.get_num_lost(), num_bursts/ack_loss_period - 1); //the last burst is still pending
+    BOOST_CHECK_EQUAL(tracker.get_num_pending(), size_t(1));
+    BOOST_CHECK_CLOSE(tracker.get_latency_mean(), 1.0, 1e-6);
+    BOOST_CHECK_EQUAL(num_dropped, num_acks + num_flood - async_msg_depth);
+}
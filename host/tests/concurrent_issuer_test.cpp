@@ -0,0 +1,111 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "concurrent_issuer.hpp"
+#include <boost/thread/thread.hpp>
+#include <stdexcept>
+#include <vector>
+
+using namespace uhd::transport;
+
+static const size_t num_mboards = 8;
+static const long transact_ms = 20;
+
+/***********************************************************************
+ * A control transaction that takes one round trip,
+ * and records the thread that made it.
+ **********************************************************************/
+static void transact(boost::thread::id &id){
+    id = boost::this_thread::get_id();
+    boost::this_thread::sleep(boost::posix_time::milliseconds(transact_ms));
+}
+
+static void transact_fail(void){
+    throw std::runtime_error("no ack from mboard");
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_issue){
+    concurrent_issuer issuer(num_mboards);
+    std::vector<boost::thread::id> ids(num_mboards);
+
+    //the transactions overlap: the skew is about one round trip, not one per mboard
+    for (size_t n = 0; n < 3; n++){
+        std::vector<concurrent_issuer::issue_type> issues;
+        for (size_t i = 0; i < num_mboards; i++){
+            issues.push_back(boost::bind(&transact, boost::ref(ids[i])));
+        }
+        const boost::system_time start = boost::get_system_time();
+        const double skew = issuer.issue(issues);
+        const double elapsed = double((boost::get_system_time() - start).total_microseconds())/1e6;
+
+        BOOST_CHECK_GE(skew, transact_ms/1e3);
+        BOOST_CHECK_LE(skew, elapsed);
+        BOOST_CHECK_LT(elapsed, 4*transact_ms/1e3); //one after the other: num_mboards*transact_ms
+    }
+
+    //the caller makes the first transaction, the threads the rest
+    BOOST_CHECK(ids[0] == boost::this_thread::get_id());
+    for (size_t i = 1; i < num_mboards; i++) BOOST_CHECK(ids[i] != ids[0]);
+
+    //an issue may use fewer threads than the most
+    std::vector<concurrent_issuer::issue_type> issues(1, boost::bind(&transact, boost::ref(ids[0])));
+    BOOST_CHECK_LT(issuer.issue(issues), 4*transact_ms/1e3);
+    BOOST_CHECK_EQUAL(issuer.issue(std::vector<concurrent_issuer::issue_type>()), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_issue_error){
+    concurrent_issuer issuer(3);
+    std::vector<boost::thread::id> ids(3);
+
+    //a failed transaction is thrown, once all of them have completed
+    std::vector<concurrent_issuer::issue_type> issues;
+    issues.push_back(boost::bind(&transact, boost::ref(ids[0])));
+    issues.push_back(&transact_fail);
+    issues.push_back(boost::bind(&transact, boost::ref(ids[2])));
+    BOOST_CHECK_THROW(issuer.issue(issues), uhd::runtime_error);
+    BOOST_CHECK(ids[2] != boost::thread::id());
+
+    //the issuer is still usable after an error
+    issues[1] = boost::bind(&transact, boost::ref(ids[1]));
+    BOOST_CHECK_GT(issuer.issue(issues), 0.0);
+}
+
+static void issue_loop(concurrent_issuer &issuer, size_t &num_issued){
+    std::vector<boost::thread::id> ids(2);
+    std::vector<concurrent_issuer::issue_type> issues;
+    issues.push_back(boost::bind(&transact, boost::ref(ids[0])));
+    issues.push_back(boost::bind(&transact, boost::ref(ids[1])));
+    for (size_t i = 0; i < 5; i++){
+        issuer.issue(issues);
+        if (ids[0] != boost::thread::id() and ids[1] != boost::thread::id()) num_issued++;
+        ids[0] = ids[1] = boost::thread::id();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_issue_callers){
+    concurrent_issuer issuer(2);
+
+    //the issues of two callers are made one after the other, all of them complete
+    size_t num_issued_0 = 0, num_issued_1 = 0;
+    boost::thread_group callers;
+    callers.create_thread(boost::bind(&issue_loop, boost::ref(issuer), boost::ref(num_issued_0)));
+    callers.create_thread(boost::bind(&issue_loop, boost::ref(issuer), boost::ref(num_issued_1)));
+    callers.join_all();
+    BOOST_CHECK_EQUAL(num_issued_0, size_t(5));
+    BOOST_CHECK_EQUAL(num_issued_1, size_t(5));
+}
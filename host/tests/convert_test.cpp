@@ -16,6 +16,7 @@
 //
 
 #include <uhd/convert.hpp>
+#include <uhd/utils/byteswap.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/foreach.hpp>
 #include <boost/cstdint.hpp>
@@ -107,6 +108,42 @@ BOOST_AUTO_TEST_CASE(test_convert_types_le_sc16){
     }
 }
 
+/***********************************************************************
+ * Test wire format conversion
+ **********************************************************************/
+static void test_convert_types_w32(const otw_type_t &otw_type){
+    static const size_t nsamps = 15;
+    const io_type_t io_type(io_type_t::COMPLEX_INT16_ITEM32_BE);
+    std::vector<boost::uint32_t> input(nsamps), interm(nsamps), output(nsamps);
+    BOOST_FOREACH(boost::uint32_t &in, input) in = boost::uint32_t(std::rand());
+
+    std::vector<const void *> input0(1, &input[0]), input1(1, &interm[0]);
+    std::vector<void *> output0(1, &interm[0]), output1(1, &output[0]);
+    convert::get_converter_cpu_to_otw(io_type, otw_type, 1, 1)(input0, output0, nsamps);
+    convert::get_converter_otw_to_cpu(io_type, otw_type, 1, 1)(input1, output1, nsamps);
+    BOOST_CHECK_EQUAL_COLLECTIONS(input.begin(), input.end(), output.begin(), output.end());
+
+    //the wire format is big endian: a copy for big endian, swapped for little endian
+    for (size_t i = 0; i < nsamps; i++){
+        const boost::uint32_t otw = (otw_type.byteorder == otw_type_t::BO_BIG_ENDIAN)? input[i] : uhd::byteswap(input[i]);
+        BOOST_CHECK_EQUAL(interm[i], otw);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_convert_types_be_w32){
+    otw_type_t otw_type;
+    otw_type.byteorder = otw_type_t::BO_BIG_ENDIAN;
+    otw_type.width = 16;
+    test_convert_types_w32(otw_type);
+}
+
+BOOST_AUTO_TEST_CASE(test_convert_types_le_w32){
+    otw_type_t otw_type;
+    otw_type.byteorder = otw_type_t::BO_LITTLE_ENDIAN;
+    otw_type.width = 16;
+    test_convert_types_w32(otw_type);
+}
+
 /***********************************************************************
  * Test float conversion
  **********************************************************************/
@@ -0,0 +1,144 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "device_time_model.hpp"
+#include <boost/thread/thread.hpp>
+#include <cmath>
+
+using namespace uhd;
+using namespace uhd::transport;
+
+/***********************************************************************
+ * A device clock that runs fast by 20 ppm, from 1000 s at host time 0.
+ * A sync reads it in the middle of a 200 us round trip.
+ **********************************************************************/
+static const double device_drift = 20e-6, rtt = 200e-6;
+
+static time_spec_t device_time(double host_time){
+    return time_spec_t(1000.0) + time_spec_t(host_time*(1.0 + device_drift));
+}
+
+static void sync(device_time_model &model, double host_time){
+    model.sync(host_time - rtt/2, device_time(host_time), host_time + rtt/2);
+}
+
+static double estimate_error(const device_time_model &model, double host_time, double &error){
+    time_spec_t estimate;
+    BOOST_REQUIRE(model.estimate(host_time, estimate, error));
+    return std::abs((estimate - device_time(host_time)).get_real_secs());
+}
+
+BOOST_AUTO_TEST_CASE(test_time_model_fit){
+    device_time_model model;
+    time_spec_t estimate;
+    double error;
+    BOOST_CHECK(not model.estimate(0.0, estimate, error));
+
+    //one sync: the error is half the round trip plus the drift bound
+    sync(model, 1.0);
+    BOOST_CHECK_LE(estimate_error(model, 1.5, error), error);
+    BOOST_CHECK_CLOSE(error, rtt/2 + 50e-6*0.5, 1e-3);
+
+    //the fit takes out the drift, the estimates stay within the bound
+    for (size_t i = 2; i <= 10; i++) sync(model, double(i));
+    BOOST_CHECK_EQUAL(model.get_num_syncs(), size_t(8));
+    for (double host_time = 10.0; host_time < 12.0; host_time += 0.1){
+        BOOST_CHECK_LE(estimate_error(model, host_time, error), error);
+        BOOST_CHECK_LT(estimate_error(model, host_time, error), 1e-6);
+    }
+    BOOST_CHECK_LT(error, rtt/2 + 50e-6*2.0 + 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(test_time_model_observe){
+    device_time_model model;
+    double error;
+    sync(model, 0.0);
+    sync(model, 1.0);
+
+    //a timestamp from shortly before narrows the estimate
+    const double before = estimate_error(model, 1.5, error), wide = error;
+    model.observe(1.5, device_time(1.5) - time_spec_t(10e-6));
+    BOOST_CHECK_LE(estimate_error(model, 1.5, error), error);
+    BOOST_CHECK_LT(error, wide);
+    BOOST_CHECK_LE(before, wide);
+
+    //an older (looser) timestamp does not undo it
+    model.observe(1.6, device_time(1.0));
+    BOOST_CHECK_LE(estimate_error(model, 1.6, error), error);
+    BOOST_CHECK_LT(error, wide);
+
+    //a timestamp ahead of the fit: the time was set, there is no estimate
+    time_spec_t estimate;
+    model.observe(1.7, device_time(1.7) + time_spec_t(1.0));
+    BOOST_CHECK(not model.estimate(1.7, estimate, error));
+}
+
+BOOST_AUTO_TEST_CASE(test_time_model_set){
+    device_time_model model;
+    time_spec_t estimate;
+    double error;
+    for (size_t i = 0; i < 4; i++) sync(model, double(i));
+
+    //a sync the fit does not predict restarts the fit
+    model.sync(4.0, time_spec_t(5.0), 4.0 + rtt);
+    BOOST_CHECK_EQUAL(model.get_num_syncs(), size_t(1));
+    BOOST_REQUIRE(model.estimate(4.5, estimate, error));
+    BOOST_CHECK_CLOSE(estimate.get_real_secs(), 5.5, 1e-2);
+
+    //a set at the next pps: no syncs and no estimate until the hold
+    model.reset(6.0);
+    sync(model, 5.0);
+    BOOST_CHECK_EQUAL(model.get_num_syncs(), size_t(0));
+    BOOST_CHECK(not model.estimate(5.5, estimate, error));
+    sync(model, 6.5);
+    BOOST_CHECK(model.estimate(6.5, estimate, error));
+}
+
+BOOST_AUTO_TEST_CASE(test_time_model_estimates_monotonic){
+    device_time_model model;
+    sync(model, 0.0);
+    sync(model, 1.0);
+
+    //the estimates of later host times never go back
+    time_spec_t estimate, last_estimate;
+    double error;
+    for (size_t i = 0; i < 100000; i++){
+        BOOST_REQUIRE(model.estimate(1.0 + i*1e-6, estimate, error));
+        if (i != 0 and estimate < last_estimate){
+            BOOST_ERROR("the estimate went back at read " << i);
+            break;
+        }
+        last_estimate = estimate;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_time_model_host_time){
+    //the host time never goes back, and counts seconds
+    const double start = device_time_model::get_host_time();
+    double last = start;
+    for (size_t i = 0; i < 100000; i++){
+        const double now = device_time_model::get_host_time();
+        if (now < last){
+            BOOST_ERROR("the host time went back at read " << i);
+            break;
+        }
+        last = now;
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    BOOST_CHECK_GE(device_time_model::get_host_time() - start, 0.019);
+}
@@ -0,0 +1,121 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "flow_control_monitor.hpp"
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace uhd::transport;
+namespace pt = boost::posix_time;
+
+static const flow_control_monitor::seq_type window = 16;
+
+BOOST_AUTO_TEST_CASE(test_fc_window){
+    flow_control_monitor fc_mon(window);
+
+    //the window fills up without acks
+    for (flow_control_monitor::seq_type seq = 0; seq < window; seq++){
+        BOOST_CHECK(fc_mon.check_fc_condition(seq, 0.0));
+    }
+    BOOST_CHECK(not fc_mon.check_fc_condition(window, 0.01));
+
+    //an ack makes room again
+    fc_mon.update_fc_condition(1);
+    BOOST_CHECK(fc_mon.check_fc_condition(window, 0.0));
+    BOOST_CHECK(not fc_mon.check_fc_condition(window + 1, 0.01));
+}
+
+static void ack_later(flow_control_monitor &fc_mon, flow_control_monitor::seq_type seq){
+    boost::this_thread::sleep(pt::milliseconds(50));
+    fc_mon.update_fc_condition(seq);
+}
+
+BOOST_AUTO_TEST_CASE(test_fc_wakeup){
+    flow_control_monitor fc_mon(window);
+
+    //a blocked send thread wakes up on the ack, not on the timeout
+    boost::thread_group acker;
+    acker.create_thread(boost::bind(&ack_later, boost::ref(fc_mon), window));
+    const pt::ptime start = pt::microsec_clock::universal_time();
+    BOOST_CHECK(fc_mon.check_fc_condition(2*window - 1, 10.0));
+    BOOST_CHECK_LT((pt::microsec_clock::universal_time() - start).total_seconds(), 5);
+    acker.join_all();
+}
+
+/***********************************************************************
+ * Simulated device:
+ * Takes the packets that went out and acks them in batches,
+ * like the tx dsp with its packets per update, and checks that
+ * the packets in flight never exceed the window.
+ **********************************************************************/
+class ack_device{
+public:
+    ack_device(flow_control_monitor &fc_mon, size_t num_packets):
+        _fc_mon(fc_mon), _num_packets(num_packets), _num_violations(0)
+    {
+        _thread_group.create_thread(boost::bind(&ack_device::ack_loop, this));
+    }
+
+    ~ack_device(void){
+        _thread_group.join_all();
+    }
+
+    //a packet goes out (called by the send thread)
+    void send(flow_control_monitor::seq_type seq){
+        _num_sent.write(seq + 1);
+    }
+
+    size_t get_num_violations(void){
+        _thread_group.join_all();
+        return _num_violations;
+    }
+
+private:
+    void ack_loop(void){
+        flow_control_monitor::seq_type num_acked = 0;
+        while (num_acked < _num_packets){
+            const flow_control_monitor::seq_type num_sent = _num_sent.read();
+            if (num_sent - num_acked > window) _num_violations++;
+            if (num_sent - num_acked < window/4 and num_sent != _num_packets){
+                boost::this_thread::yield();
+                continue;
+            }
+            //the ack is the sequence of the last packet taken
+            num_acked = num_sent;
+            _fc_mon.update_fc_condition(num_acked - 1);
+        }
+    }
+
+    flow_control_monitor &_fc_mon;
+    const size_t _num_packets;
+    uhd::atomic_uint32_t _num_sent;
+    size_t _num_violations;
+    boost::thread_group _thread_group;
+};
+
+BOOST_AUTO_TEST_CASE(test_fc_stress){
+    static const size_t num_packets = 2000000;
+
+    //every packet gets into the window, and the window is never exceeded
+    flow_control_monitor fc_mon(window);
+    ack_device device(fc_mon, num_packets);
+    for (flow_control_monitor::seq_type seq = 0; seq < num_packets; seq++){
+        BOOST_REQUIRE(fc_mon.check_fc_condition(seq, 1.0));
+        device.send(seq);
+    }
+    BOOST_CHECK_EQUAL(device.get_num_violations(), size_t(0));
+}
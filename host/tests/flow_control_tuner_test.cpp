@@ -0,0 +1,189 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "flow_control_tuner.hpp"
+#include <deque>
+
+using namespace uhd::transport;
+
+static const size_t max_window = 700; //packets in the device buffer
+static const size_t max_packets_per_up = 64;
+
+BOOST_AUTO_TEST_CASE(test_fc_tuner_bounds){
+    flow_control_tuner tuner(max_window, max_packets_per_up);
+    BOOST_CHECK_EQUAL(tuner.get_window(), max_window);
+    BOOST_CHECK_EQUAL(tuner.get_packets_per_up(), max_packets_per_up);
+
+    //underflows never take the window past the device buffer
+    double now = 0.0;
+    tuner.update(now);
+    for (size_t i = 0; i < 20; i++){
+        tuner.on_underflow();
+        tuner.update(now += 1.0);
+        BOOST_CHECK_LE(tuner.get_window(), max_window);
+        BOOST_CHECK_GE(tuner.get_packets_per_up(), size_t(1));
+    }
+    BOOST_CHECK_EQUAL(tuner.get_packets_per_up(), size_t(1));
+
+    //a disabled ack cadence stays disabled
+    flow_control_tuner no_ups(max_window, 0);
+    no_ups.update(0.0);
+    no_ups.on_underflow();
+    no_ups.update(1.0);
+    BOOST_CHECK_EQUAL(no_ups.get_packets_per_up(), size_t(0));
+}
+
+/***********************************************************************
+ * Simulated link and device (discrete time):
+ *  - the host sends while the packets in flight are within the window
+ *  - the packets and the acks take half the round trip time each way,
+ *    and a fraction of the acks is lost
+ *  - the device plays out the packets at a fixed rate from its buffer,
+ *    acks every packets per update (and on a timer),
+ *    and reports an underflow when the buffer runs dry
+ **********************************************************************/
+struct sim_result{
+    double throughput; //fraction of the rate played out
+    size_t num_underflows;
+    double latency; //mean seconds of samples buffered in the device
+};
+
+struct sim_event{
+    double time;
+    size_t count;
+    bool underflow;
+};
+
+static sim_result simulate(double rate, double rtt, double ack_loss, bool adapt){
+    static const double dt = 10e-6, duration = 5.0, warmup = 2.0, up_period = 0.05;
+
+    flow_control_tuner tuner(max_window, max_packets_per_up);
+    size_t window = max_window, packets_per_up = max_packets_per_up;
+    boost::uint32_t lcg = 1; //a deterministic ack loss
+
+    std::deque<double> to_device;
+    std::deque<sim_event> to_host;
+    size_t num_sent = 0, num_acked = 0, rtt_seq = 0;
+    double rtt_time = 0.0;
+    bool rtt_pending = false;
+    size_t num_arrived = 0, num_played = 0, num_last_up = 0;
+    double credit = 0.0, last_up_time = 0.0;
+    bool starved = false;
+
+    sim_result result = {0.0, 0, 0.0};
+    size_t num_played_at_warmup = 0, num_steps = 0;
+    double occupancy = 0.0;
+
+    for (double t = 0.0; t < duration; t += dt){
+        const bool measuring = t >= warmup;
+        if (not measuring) num_played_at_warmup = num_played;
+
+        //host: take the acks and the underflow reports
+        while (not to_host.empty() and to_host.front().time <= t){
+            const sim_event event = to_host.front(); to_host.pop_front();
+            if (event.underflow){
+                tuner.on_underflow();
+                continue;
+            }
+            num_acked = std::max(num_acked, event.count);
+            tuner.on_ack(boost::uint32_t(event.count));
+            if (rtt_pending and event.count > rtt_seq){
+                tuner.on_rtt(t - rtt_time);
+                rtt_pending = false;
+            }
+        }
+        if (adapt and tuner.update(t)){
+            window = tuner.get_window();
+            packets_per_up = tuner.get_packets_per_up();
+        }
+
+        //host: send within the window
+        while (num_sent - num_acked < window){
+            if (not rtt_pending){
+                rtt_seq = num_sent;
+                rtt_time = t;
+                rtt_pending = true;
+            }
+            to_device.push_back(t + rtt/2);
+            num_sent++;
+        }
+
+        //device: take the packets and play them out
+        while (not to_device.empty() and to_device.front() <= t){
+            to_device.pop_front();
+            num_arrived++;
+        }
+        if (num_arrived - num_played > max_window){
+            BOOST_ERROR("the device buffer overflowed at " << t << " s");
+            break;
+        }
+        for (credit += rate*dt; credit >= 1.0; credit -= 1.0){
+            if (num_arrived == num_played){
+                if (not starved and num_played != 0){
+                    sim_event event = {t + rtt/2, 0, true};
+                    to_host.push_back(event);
+                    if (measuring) result.num_underflows++;
+                }
+                starved = true;
+                credit = 0.0;
+                break;
+            }
+            starved = false;
+            num_played++;
+        }
+        occupancy += double(num_arrived - num_played);
+        if (measuring) num_steps++; else occupancy = 0.0;
+
+        //device: ack the packets played out
+        if (num_played != num_last_up and (
+            (packets_per_up != 0 and num_played - num_last_up >= packets_per_up) or
+            t - last_up_time >= up_period
+        )){
+            lcg = lcg*1664525 + 1013904223;
+            if ((lcg >> 8)/double(1 << 24) >= ack_loss){
+                sim_event event = {t + rtt/2, num_played, false};
+                to_host.push_back(event);
+            }
+            num_last_up = num_played;
+            last_up_time = t;
+        }
+    }
+
+    result.throughput = (num_played - num_played_at_warmup)/(rate*(duration - warmup));
+    result.latency = occupancy/num_steps/rate;
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(test_fc_tuner_low_rtt){
+    //a short round trip: the tuned window cuts the latency, not the rate
+    const sim_result fixed = simulate(50e3, 200e-6, 0.0, false);
+    const sim_result tuned = simulate(50e3, 200e-6, 0.0, true);
+    BOOST_CHECK_EQUAL(fixed.num_underflows, size_t(0));
+    BOOST_CHECK_EQUAL(tuned.num_underflows, size_t(0));
+    BOOST_CHECK_GE(tuned.throughput, 0.99);
+    BOOST_CHECK_LT(tuned.latency, fixed.latency/2);
+}
+
+BOOST_AUTO_TEST_CASE(test_fc_tuner_high_rtt_lossy){
+    //a long round trip with lost acks: the tuned acks keep the device fed
+    const sim_result fixed = simulate(50e3, 10e-3, 0.2, false);
+    const sim_result tuned = simulate(50e3, 10e-3, 0.2, true);
+    BOOST_CHECK_GT(fixed.num_underflows, size_t(0));
+    BOOST_CHECK_LT(tuned.num_underflows, fixed.num_underflows);
+    BOOST_CHECK_GE(tuned.throughput, fixed.throughput);
+}
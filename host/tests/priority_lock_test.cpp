@@ -0,0 +1,114 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "priority_lock.hpp"
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <vector>
+
+using namespace uhd::transport;
+
+static const size_t housekeeping = 0, normal = 1, critical = 2;
+
+//! Wait until the waiters are queued on the lock
+static void wait_for_waiters(priority_lock &lock, size_t num_waiters){
+    while (lock.get_num_waiters() < num_waiters){
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+}
+
+/***********************************************************************
+ * A waiter records the order in which it got the lock
+ **********************************************************************/
+static void wait_in_order(
+    priority_lock &lock, size_t priority, size_t id,
+    boost::mutex &order_mutex, std::vector<size_t> &order
+){
+    priority_lock::scoped_lock scoped(lock, priority);
+    boost::mutex::scoped_lock order_lock(order_mutex);
+    order.push_back(id);
+}
+
+BOOST_AUTO_TEST_CASE(test_priority_lock_order){
+    priority_lock lock(3);
+    boost::mutex order_mutex;
+    std::vector<size_t> order;
+    boost::thread_group waiters;
+
+    //queue up the waiters behind the owner, the lowest priorities first
+    lock.lock(normal);
+    const size_t priorities[] = {housekeeping, normal, housekeeping, critical, normal};
+    for (size_t id = 0; id < 5; id++){
+        waiters.create_thread(boost::bind(
+            &wait_in_order, boost::ref(lock), priorities[id], id,
+            boost::ref(order_mutex), boost::ref(order)
+        ));
+        wait_for_waiters(lock, id + 1);
+    }
+    lock.unlock();
+    waiters.join_all();
+
+    //by priority, then first come, first served
+    const size_t expected[] = {3, 1, 4, 0, 2};
+    BOOST_CHECK_EQUAL_COLLECTIONS(order.begin(), order.end(), expected, expected + 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_priority_lock_recursive){
+    priority_lock lock(3);
+
+    //the owner locks again at any priority
+    lock.lock(housekeeping);
+    lock.lock(critical);
+    lock.unlock();
+    lock.unlock();
+    BOOST_CHECK_THROW(lock.unlock(), uhd::assertion_error);
+    BOOST_CHECK_THROW(lock.lock(3), uhd::assertion_error);
+}
+
+/***********************************************************************
+ * Housekeeping transactions are queued behind the one in flight,
+ * then a stream command comes: the position in which it gets the lock.
+ **********************************************************************/
+static size_t stream_cmd_position(size_t priority){
+    priority_lock lock(3);
+    boost::mutex order_mutex;
+    std::vector<size_t> order;
+    boost::thread_group waiters;
+
+    lock.lock(housekeeping); //the transaction in flight
+    for (size_t id = 0; id < 4; id++){
+        waiters.create_thread(boost::bind(
+            &wait_in_order, boost::ref(lock), (id == 3)? priority : housekeeping, id,
+            boost::ref(order_mutex), boost::ref(order)
+        ));
+        wait_for_waiters(lock, id + 1);
+    }
+    lock.unlock();
+    waiters.join_all();
+
+    BOOST_REQUIRE_EQUAL(order.size(), size_t(4));
+    return std::find(order.begin(), order.end(), size_t(3)) - order.begin();
+}
+
+BOOST_AUTO_TEST_CASE(test_priority_lock_latency){
+    //a critical stream command waits for the transaction in flight only,
+    //in one queue it would wait for all of the queued transactions
+    BOOST_CHECK_EQUAL(stream_cmd_position(critical), size_t(0));
+    BOOST_CHECK_EQUAL(stream_cmd_position(housekeeping), size_t(3));
+}
@@ -0,0 +1,139 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INCLUDED_TESTS_RECV_BUFFER_FIXTURES_HPP
+#define INCLUDED_TESTS_RECV_BUFFER_FIXTURES_HPP
+
+#include "vrt_packet_handler.hpp"
+#include <uhd/transport/zero_copy.hpp>
+#include <uhd/transport/bounded_buffer.hpp>
+#include <uhd/transport/vrt_if_packet.hpp>
+#include <uhd/utils/byteswap.hpp>
+#include <boost/cstdint.hpp>
+#include <cstddef>
+#include <vector>
+
+/***********************************************************************
+ * Receive buffer fixtures shared by the transport tests
+ **********************************************************************/
+
+//! A buffer over memory owned by the test, the release does nothing
+class const_recv_buffer : public uhd::transport::managed_recv_buffer{
+public:
+    const_recv_buffer(const void *mem, size_t size): _mem(mem), _size(size){
+        _ref_count.write(0);
+    }
+
+    void release(void){
+        /* NOP */
+    }
+
+private:
+    const void *get_buff(void) const{return _mem;}
+    size_t get_size(void) const{return _size;}
+
+    const void *_mem;
+    size_t _size;
+};
+
+//! A buffer over its own copy of a packet, the release does nothing
+class heap_recv_buffer : public uhd::transport::managed_recv_buffer{
+public:
+    heap_recv_buffer(const std::vector<boost::uint32_t> &mem): _mem(mem){
+        _ref_count.write(0);
+    }
+
+    void release(void){
+        /* NOP */
+    }
+
+private:
+    const void *get_buff(void) const{return &_mem.front();}
+    size_t get_size(void) const{return _mem.size()*sizeof(boost::uint32_t);}
+
+    std::vector<boost::uint32_t> _mem;
+};
+
+//! A frame of a pool like a transport, the release puts it back into the pool
+class pool_recv_buffer : public uhd::transport::managed_recv_buffer{
+public:
+    typedef uhd::transport::bounded_buffer<pool_recv_buffer *> pool_type;
+
+    pool_recv_buffer(pool_type &pool, size_t num_words32):
+        _pool(pool), _mem(num_words32)
+    {
+        _ref_count.write(0);
+    }
+
+    void release(void){
+        _pool.push_with_haste(this);
+    }
+
+    std::vector<boost::uint32_t> &mem(void){
+        return _mem;
+    }
+
+private:
+    const void *get_buff(void) const{return &_mem.front();}
+    size_t get_size(void) const{return _mem.size()*sizeof(boost::uint32_t);}
+
+    pool_type &_pool;
+    std::vector<boost::uint32_t> _mem;
+};
+
+/***********************************************************************
+ * Synthetic data packets:
+ * The sample at tick t carries (t/ticks_per_samp) in the upper 16 bits
+ * and the channel number in the lower 16 bits, so that the samples of
+ * a packet can be checked against its timestamp.
+ **********************************************************************/
+inline boost::uint32_t synthetic_item(boost::uint64_t index, size_t chan){
+    return boost::uint32_t((index & 0xffff) << 16 | chan);
+}
+
+/*!
+ * Pack a big endian synthetic data packet with a trailer.
+ * \param mem the packet memory (max_if_hdr_words32 + nsamps + 1 words)
+ * \return the number of 32-bit words in the packet
+ */
+inline size_t pack_synthetic_packet(
+    boost::uint32_t *mem, size_t chan, size_t packet_count,
+    boost::uint64_t ticks, size_t nsamps,
+    boost::uint64_t ticks_per_sec, boost::uint64_t ticks_per_samp
+){
+    uhd::transport::vrt::if_packet_info_t if_packet_info;
+    if_packet_info.packet_type = uhd::transport::vrt::if_packet_info_t::PACKET_TYPE_DATA;
+    if_packet_info.num_payload_words32 = nsamps;
+    if_packet_info.packet_count = packet_count;
+    if_packet_info.has_sid = true;
+    if_packet_info.sid = boost::uint32_t(chan);
+    if_packet_info.has_cid = false;
+    if_packet_info.has_tsi = true;
+    if_packet_info.has_tsf = true;
+    if_packet_info.has_tlr = true;
+    if_packet_info.tlr = 0;
+    vrt_packet_handler::set_ticks(if_packet_info, ticks, ticks_per_sec);
+
+    uhd::transport::vrt::if_hdr_pack_be(mem, if_packet_info);
+    for (size_t i = 0; i < nsamps; i++){
+        mem[if_packet_info.num_header_words32 + i] = uhd::htonx(synthetic_item(ticks/ticks_per_samp + i, chan));
+    }
+    mem[if_packet_info.num_packet_words32 - 1] = uhd::htonx(if_packet_info.tlr);
+    return if_packet_info.num_packet_words32;
+}
+
+#endif /* INCLUDED_TESTS_RECV_BUFFER_FIXTURES_HPP */
@@ -0,0 +1,159 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "recv_fanout.hpp"
+#include "recv_buffer_fixtures.hpp"
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <vector>
+
+using namespace uhd::transport;
+
+static const size_t num_frames = 32;
+static const size_t num_packets = 100;
+
+/***********************************************************************
+ * Paced source transport:
+ * A pool of frames like a transport, a frame goes back into the pool
+ * when its buffer is released. Each frame carries its sequence number.
+ * The source only makes a frame when the test allows it, so that the
+ * test decides how far the source runs ahead of the subscribers.
+ **********************************************************************/
+static const size_t frame_words32 = 16;
+
+class paced_source : public zero_copy_if{
+public:
+    paced_source(void): _pool(num_frames), _credits(num_packets), _next_seq(0){
+        for (size_t i = 0; i < num_frames; i++){
+            _frames.push_back(boost::shared_ptr<pool_recv_buffer>(new pool_recv_buffer(_pool, frame_words32)));
+            _pool.push_with_haste(_frames.back().get());
+        }
+    }
+
+    //allow the source to make one more frame
+    void allow(void){
+        _credits.push_with_haste(true);
+    }
+
+    //the memory of the frame with a sequence number
+    const void *get_mem(size_t seq){
+        return _mems.at(seq);
+    }
+
+    managed_recv_buffer::sptr get_recv_buff(double timeout){
+        bool credit;
+        if (not _credits.pop_with_timed_wait(credit, timeout)) return managed_recv_buffer::sptr();
+        pool_recv_buffer *frame = NULL;
+        BOOST_REQUIRE(_pool.pop_with_timed_wait(frame, 1.0)); //the subscribers may never exhaust the pool
+        frame->mem().front() = boost::uint32_t(_next_seq++);
+        _mems.push_back(&frame->mem().front());
+        return make_managed_buffer<managed_recv_buffer>(frame);
+    }
+
+    size_t get_num_recv_frames(void) const{return num_frames;}
+    size_t get_recv_frame_size(void) const{return frame_words32*sizeof(boost::uint32_t);}
+
+    managed_send_buffer::sptr get_send_buff(double){return managed_send_buffer::sptr();}
+    size_t get_num_send_frames(void) const{return 0;}
+    size_t get_send_frame_size(void) const{return 0;}
+
+private:
+    pool_recv_buffer::pool_type _pool;
+    bounded_buffer<bool> _credits;
+    std::vector<boost::shared_ptr<pool_recv_buffer> > _frames;
+    std::vector<const void *> _mems;
+    size_t _next_seq;
+};
+
+static size_t get_seq(managed_recv_buffer::sptr buff){
+    return buff->cast<const boost::uint32_t *>()[0];
+}
+
+BOOST_AUTO_TEST_CASE(test_fanout_budget){
+    boost::shared_ptr<paced_source> source(new paced_source());
+    recv_fanout::sptr fanout = recv_fanout::make(source);
+
+    //the reader keeps one frame, the subscribers share the rest
+    zero_copy_if::sptr sub0 = fanout->subscribe(num_frames/2, recv_fanout::DROP_NEWEST);
+    BOOST_CHECK_THROW(fanout->subscribe(num_frames/2, recv_fanout::DROP_NEWEST), uhd::value_error);
+    BOOST_CHECK_THROW(fanout->subscribe(0, recv_fanout::DROP_NEWEST), uhd::value_error);
+    zero_copy_if::sptr sub1 = fanout->subscribe(num_frames/2 - 1, recv_fanout::DROP_NEWEST);
+
+    //the depth of an unsubscribed transport is given back
+    sub0.reset();
+    BOOST_CHECK_NO_THROW(fanout->subscribe(num_frames/2, recv_fanout::DROP_NEWEST));
+}
+
+BOOST_AUTO_TEST_CASE(test_fanout_slow_subscribers){
+    static const size_t slow_depth = 4;
+    boost::shared_ptr<paced_source> source(new paced_source());
+    recv_fanout::sptr fanout = recv_fanout::make(source);
+    zero_copy_if::sptr fast = fanout->subscribe(8, recv_fanout::DROP_NEWEST);
+    zero_copy_if::sptr newest = fanout->subscribe(slow_depth, recv_fanout::DROP_NEWEST);
+    zero_copy_if::sptr oldest = fanout->subscribe(slow_depth, recv_fanout::DROP_OLDEST);
+
+    //the fast subscriber gets every frame while the slow ones hold theirs
+    for (size_t seq = 0; seq < num_packets; seq++){
+        source->allow();
+        managed_recv_buffer::sptr buff = fast->get_recv_buff(1.0);
+        BOOST_REQUIRE(buff.get() != NULL);
+        BOOST_CHECK_EQUAL(get_seq(buff), seq);
+        BOOST_CHECK_EQUAL(buff->cast<const void *>(), source->get_mem(seq)); //not a copy
+    }
+    BOOST_CHECK(fast->get_recv_buff(0.01).get() == NULL);
+    BOOST_CHECK_EQUAL(recv_fanout::get_num_dropped(fast), size_t(0));
+
+    //the slow subscribers get the first or the last frames, and drop the others
+    for (size_t i = 0; i < slow_depth; i++){
+        managed_recv_buffer::sptr buff = newest->get_recv_buff(0.1);
+        BOOST_REQUIRE(buff.get() != NULL);
+        BOOST_CHECK_EQUAL(get_seq(buff), i);
+        BOOST_CHECK_EQUAL(buff->cast<const void *>(), source->get_mem(i));
+
+        buff = oldest->get_recv_buff(0.1);
+        BOOST_REQUIRE(buff.get() != NULL);
+        BOOST_CHECK_EQUAL(get_seq(buff), num_packets - slow_depth + i);
+    }
+    BOOST_CHECK(newest->get_recv_buff(0.01).get() == NULL);
+    BOOST_CHECK(oldest->get_recv_buff(0.01).get() == NULL);
+    BOOST_CHECK_EQUAL(recv_fanout::get_num_dropped(newest), num_packets - slow_depth);
+    BOOST_CHECK_EQUAL(recv_fanout::get_num_dropped(oldest), num_packets - slow_depth);
+}
+
+BOOST_AUTO_TEST_CASE(test_fanout_view_outlives_subscriber){
+    boost::shared_ptr<paced_source> source(new paced_source());
+    recv_fanout::sptr fanout = recv_fanout::make(source);
+    zero_copy_if::sptr sub = fanout->subscribe(4, recv_fanout::DROP_NEWEST);
+    const boost::weak_ptr<recv_fanout> weak_fanout(fanout);
+
+    source->allow();
+    source->allow();
+    managed_recv_buffer::sptr buff = sub->get_recv_buff(1.0);
+    BOOST_REQUIRE(buff.get() != NULL);
+    BOOST_CHECK(sub->get_recv_buff(1.0).get() != NULL); //released right away
+
+    //the view handed out keeps the subscriber (and the fan-out) alive
+    sub.reset();
+    fanout.reset();
+    BOOST_CHECK(not weak_fanout.expired());
+    BOOST_CHECK_EQUAL(get_seq(buff), size_t(0));
+    BOOST_CHECK_EQUAL(buff->cast<const void *>(), source->get_mem(0));
+
+    buff.reset();
+    BOOST_CHECK(weak_fanout.expired());
+}
@@ -0,0 +1,107 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "reg_shadow.hpp"
+
+using namespace uhd::transport;
+
+//the registers below 0x100 are host-owned, the rest are volatile
+static bool is_host_owned(boost::uint32_t addr){
+    return addr < 0x100;
+}
+
+/***********************************************************************
+ * A device that counts the transactions that reach it
+ **********************************************************************/
+struct shadowed_device{
+    shadowed_device(void): shadow(&is_host_owned), num_transactions(0){}
+
+    void poke32(boost::uint32_t addr, boost::uint32_t data){
+        if (shadow.suppress_poke(addr, data)) return;
+        num_transactions++;
+        shadow.update(addr, data);
+    }
+
+    bool peek32_from_shadow(boost::uint32_t addr, boost::uint32_t &data){
+        if (shadow.suppress_peek(addr, data)) return true;
+        num_transactions++;
+        return false;
+    }
+
+    reg_shadow shadow;
+    size_t num_transactions;
+};
+
+BOOST_AUTO_TEST_CASE(test_reg_shadow_disabled){
+    shadowed_device dev;
+
+    //every transaction reaches the device
+    dev.poke32(0x10, 1);
+    dev.poke32(0x10, 1);
+    boost::uint32_t data;
+    BOOST_CHECK(not dev.peek32_from_shadow(0x10, data));
+    BOOST_CHECK_EQUAL(dev.num_transactions, size_t(3));
+    BOOST_CHECK_EQUAL(dev.shadow.get_num_suppressed(), size_t(0));
+}
+
+BOOST_AUTO_TEST_CASE(test_reg_shadow_invalidate){
+    shadowed_device dev;
+    dev.shadow.set_enabled(true);
+
+    //a duplicate write is suppressed, a new value is written
+    dev.poke32(0x10, 1);
+    dev.poke32(0x10, 1);
+    BOOST_CHECK_EQUAL(dev.num_transactions, size_t(1));
+    BOOST_CHECK_EQUAL(dev.shadow.get_num_suppressed(), size_t(1));
+    dev.poke32(0x10, 2);
+    BOOST_CHECK_EQUAL(dev.num_transactions, size_t(2));
+
+    //a held value is read back from the shadow
+    boost::uint32_t data = 0;
+    BOOST_CHECK(dev.peek32_from_shadow(0x10, data));
+    BOOST_CHECK_EQUAL(data, boost::uint32_t(2));
+    BOOST_CHECK_EQUAL(dev.shadow.get_num_suppressed(), size_t(2));
+
+    //after a device restart, the same write is issued again
+    dev.shadow.invalidate();
+    dev.poke32(0x10, 2);
+    BOOST_CHECK_EQUAL(dev.num_transactions, size_t(3));
+    BOOST_CHECK(not dev.peek32_from_shadow(0x20, data));
+    BOOST_CHECK_EQUAL(dev.num_transactions, size_t(4));
+    BOOST_CHECK_EQUAL(dev.shadow.get_num_suppressed(), size_t(2));
+}
+
+BOOST_AUTO_TEST_CASE(test_reg_shadow_volatile){
+    shadowed_device dev;
+    dev.shadow.set_enabled(true);
+
+    //strobes and readback registers always reach the device
+    dev.poke32(0x200, 1);
+    dev.poke32(0x200, 1);
+    boost::uint32_t data;
+    BOOST_CHECK(not dev.peek32_from_shadow(0x200, data));
+    BOOST_CHECK_EQUAL(dev.num_transactions, size_t(3));
+    BOOST_CHECK_EQUAL(dev.shadow.get_num_suppressed(), size_t(0));
+
+    //disabling the shadow forgets the held values
+    dev.poke32(0x10, 1);
+    dev.shadow.set_enabled(false);
+    dev.shadow.set_enabled(true);
+    dev.poke32(0x10, 1);
+    BOOST_CHECK_EQUAL(dev.num_transactions, size_t(5));
+}
@@ -0,0 +1,235 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "send_stager.hpp"
+#include <uhd/transport/bounded_buffer.hpp>
+#include <boost/thread/thread.hpp>
+#include <utility>
+#include <vector>
+
+using namespace uhd::transport;
+
+static const size_t num_frames = 16, frame_size = 100;
+static const size_t hdr_bytes = 8, bytes_per_samp = 4;
+static const size_t samps_per_frame = (frame_size - hdr_bytes)/bytes_per_samp;
+
+//the frames sent by the transports: the transport index and the first word
+typedef std::vector<std::pair<size_t, boost::uint32_t> > sent_type;
+
+/***********************************************************************
+ * Recording transport:
+ * The send frames come from a pool, a commit records the frame.
+ **********************************************************************/
+class recording_xport : public zero_copy_if{
+public:
+    recording_xport(size_t index, sent_type &sent, boost::mutex &mutex):
+        _index(index), _sent(sent), _mutex(mutex),
+        _frames(num_frames, std::vector<boost::uint32_t>(frame_size/sizeof(boost::uint32_t))),
+        _free(num_frames)
+    {
+        for (size_t i = 0; i < num_frames; i++){
+            _buffs.push_back(boost::shared_ptr<pool_send_buffer>(new pool_send_buffer(*this, _frames[i])));
+            _free.push_with_haste(_buffs.back().get());
+        }
+    }
+
+    size_t get_num_free(void){
+        size_t num_free = 0;
+        for (size_t i = 0; i < _buffs.size(); i++){
+            if (not _buffs[i]->in_use) num_free++;
+        }
+        return num_free;
+    }
+
+    managed_recv_buffer::sptr get_recv_buff(double){return managed_recv_buffer::sptr();}
+    size_t get_num_recv_frames(void) const{return 0;}
+    size_t get_recv_frame_size(void) const{return 0;}
+
+    managed_send_buffer::sptr get_send_buff(double timeout){
+        pool_send_buffer *buff;
+        if (not _free.pop_with_timed_wait(buff, timeout)) return managed_send_buffer::sptr();
+        buff->in_use = true;
+        return make_managed_buffer<managed_send_buffer>(buff);
+    }
+    size_t get_num_send_frames(void) const{return num_frames;}
+    size_t get_send_frame_size(void) const{return frame_size;}
+
+private:
+    class pool_send_buffer : public managed_send_buffer{
+    public:
+        pool_send_buffer(recording_xport &xport, std::vector<boost::uint32_t> &mem):
+            in_use(false), _xport(xport), _mem(mem){}
+
+        void commit(size_t num_bytes){
+            if (not in_use) return;
+            in_use = false;
+            if (num_bytes != 0){
+                boost::mutex::scoped_lock lock(_xport._mutex);
+                _xport._sent.push_back(std::make_pair(_xport._index, _mem.front()));
+            }
+            _xport._free.push_with_haste(this);
+        }
+
+        bool in_use;
+
+    private:
+        void *get_buff(void) const{return &_mem.front();}
+        size_t get_size(void) const{return frame_size;}
+
+        recording_xport &_xport;
+        std::vector<boost::uint32_t> &_mem;
+    };
+
+    const size_t _index;
+    sent_type &_sent;
+    boost::mutex &_mutex;
+    std::vector<std::vector<boost::uint32_t> > _frames;
+    std::vector<boost::shared_ptr<pool_send_buffer> > _buffs;
+    bounded_buffer<pool_send_buffer *> _free;
+};
+
+/***********************************************************************
+ * Gate: the send condition, closed like a stalled flow control
+ **********************************************************************/
+class gate{
+public:
+    gate(void): _open(false){}
+
+    void open(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        _open = true;
+        lock.unlock();
+        _cond.notify_all();
+    }
+
+    bool operator()(size_t, boost::uint32_t, double timeout){
+        boost::mutex::scoped_lock lock(_mutex);
+        if (_open) return true;
+        _cond.timed_wait(lock, boost::posix_time::microseconds(long(timeout*1e6)));
+        return _open;
+    }
+
+private:
+    boost::mutex _mutex;
+    boost::condition _cond;
+    bool _open;
+};
+
+static bool stage_frame(send_stager &stager, size_t index, boost::uint32_t seq, double timeout){
+    managed_send_buffer::sptr buff = stager.get_send_buff(index, seq, timeout);
+    if (not buff.get()) return false;
+    buff->cast<boost::uint32_t *>()[0] = seq;
+    buff->commit(frame_size);
+    return true;
+}
+
+//wait for a number of frames to be sent (up to one second)
+static bool wait_sent(sent_type &sent, boost::mutex &mutex, size_t num){
+    for (size_t i = 0; i < 100; i++){
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            if (sent.size() >= num) return true;
+        }
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE(test_send_stager_latency){
+    static const size_t max_frames = 4;
+    sent_type sent;
+    boost::mutex mutex;
+    std::vector<zero_copy_if::sptr> xports(1, zero_copy_if::sptr(new recording_xport(0, sent, mutex)));
+    gate fc_gate;
+    send_stager stager(xports, max_frames*samps_per_frame, bytes_per_samp, hdr_bytes, boost::ref(fc_gate));
+
+    //the send thread does not wait on the stalled flow control within the max latency
+    for (size_t i = 0; i < max_frames; i++){
+        BOOST_CHECK(stage_frame(stager, 0, i, 0.0));
+    }
+    BOOST_CHECK_EQUAL(stager.get_depth(0), max_frames*samps_per_frame);
+    BOOST_CHECK_EQUAL(stager.get_num_blocks(0), size_t(0));
+
+    //past the max latency, the send thread blocks
+    BOOST_CHECK(not stage_frame(stager, 0, max_frames, 0.05));
+    BOOST_CHECK_EQUAL(stager.get_num_blocks(0), size_t(1));
+    BOOST_CHECK(sent.empty());
+
+    //the frames go out in order when the flow control opens
+    fc_gate.open();
+    BOOST_REQUIRE(wait_sent(sent, mutex, max_frames));
+    for (size_t i = 0; i < max_frames; i++){
+        BOOST_CHECK_EQUAL(sent[i].second, i);
+    }
+    BOOST_CHECK(stage_frame(stager, 0, max_frames, 1.0));
+    BOOST_REQUIRE(wait_sent(sent, mutex, max_frames + 1));
+    BOOST_CHECK_EQUAL(stager.get_peak_depth(0), max_frames*samps_per_frame);
+}
+
+BOOST_AUTO_TEST_CASE(test_send_stager_order){
+    static const size_t num_sends = 1000;
+    sent_type sent;
+    boost::mutex mutex;
+    std::vector<zero_copy_if::sptr> xports;
+    xports.push_back(zero_copy_if::sptr(new recording_xport(0, sent, mutex)));
+    xports.push_back(zero_copy_if::sptr(new recording_xport(1, sent, mutex)));
+    gate fc_gate;
+    fc_gate.open();
+    send_stager stager(xports, 2*samps_per_frame, bytes_per_samp, hdr_bytes, boost::ref(fc_gate));
+
+    //the frames of both transports go out in the order staged
+    sent_type staged;
+    for (boost::uint32_t seq = 0; seq < num_sends; seq++){
+        const size_t index = (seq/3)%2;
+        BOOST_REQUIRE(stage_frame(stager, index, seq, 1.0));
+        staged.push_back(std::make_pair(index, seq));
+    }
+    BOOST_REQUIRE(wait_sent(sent, mutex, num_sends));
+    BOOST_CHECK(sent == staged);
+    BOOST_CHECK_LE(stager.get_peak_depth(0), 2*samps_per_frame);
+    BOOST_CHECK_GT(stager.get_mean_depth(0), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_send_stager_release){
+    sent_type sent;
+    boost::mutex mutex;
+    boost::shared_ptr<recording_xport> xport(new recording_xport(0, sent, mutex));
+    std::vector<zero_copy_if::sptr> xports(1, xport);
+    gate fc_gate;
+    fc_gate.open();
+
+    {
+        send_stager stager(xports, samps_per_frame, bytes_per_samp, hdr_bytes, boost::ref(fc_gate));
+
+        //a buffer released without a commit goes back to the transport, unsent
+        stager.get_send_buff(0, 0, 1.0).reset();
+        BOOST_CHECK_EQUAL(xport->get_num_free(), num_frames);
+
+        //the same staged buffer can come back while the old reference is held
+        managed_send_buffer::sptr buff;
+        for (boost::uint32_t seq = 0; seq < 2*num_frames; seq++){
+            buff = stager.get_send_buff(0, seq, 1.0);
+            BOOST_REQUIRE(buff.get() != NULL);
+            buff->cast<boost::uint32_t *>()[0] = seq;
+            buff->commit(frame_size);
+        }
+        buff.reset();
+        BOOST_REQUIRE(wait_sent(sent, mutex, 2*num_frames));
+    }
+    BOOST_CHECK_EQUAL(xport->get_num_free(), num_frames);
+}
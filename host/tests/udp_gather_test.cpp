@@ -0,0 +1,231 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "vrt_packet_handler.hpp"
+#include <uhd/transport/udp_zero_copy.hpp>
+#include <uhd/utils/byteswap.hpp>
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <vector>
+
+using namespace uhd;
+using namespace uhd::transport;
+namespace asio = boost::asio;
+
+typedef vrt_packet_handler::vrt_codec_be codec;
+typedef vrt_packet_handler::copy_converter<codec> copy_converter;
+typedef vrt_packet_handler::static_handler<codec, item32_t, copy_converter> copy_handler;
+typedef vrt_packet_handler::static_handler<codec, item32_t, vrt_packet_handler::gather_converter> gather_handler;
+
+static udp_zero_copy::sptr make_loopback_xport(asio::ip::udp::socket &socket){
+    return udp_zero_copy::make(
+        "127.0.0.1", boost::lexical_cast<std::string>(socket.local_endpoint().port())
+    );
+}
+
+BOOST_AUTO_TEST_CASE(test_udp_send_gather){
+    asio::io_service io_service;
+    asio::ip::udp::socket socket(io_service, asio::ip::udp::endpoint(asio::ip::address_v4::loopback(), 0));
+    udp_zero_copy::sptr xport = make_loopback_xport(socket);
+
+    //the pieces arrive as one datagram, in order
+    const std::string hdr("header:"), payload("the payload"), tail("!");
+    const void *mems[] = {hdr.data(), payload.data(), tail.data()};
+    const size_t lens[] = {hdr.size(), payload.size(), tail.size()};
+    BOOST_CHECK_EQUAL(xport->send_gather(mems, lens, 3), hdr.size() + payload.size() + tail.size());
+
+    std::vector<char> buff(64);
+    const size_t len = socket.receive(asio::buffer(buff));
+    BOOST_CHECK_EQUAL(std::string(&buff.front(), len), hdr + payload + tail);
+
+    //a gathered send goes out between the committed frames
+    managed_send_buffer::sptr send_buff = xport->get_send_buff();
+    BOOST_REQUIRE(send_buff.get() != NULL);
+    send_buff->cast<char *>()[0] = 'a';
+    send_buff->commit(1);
+    xport->send_gather(mems, lens, 1);
+    send_buff = xport->get_send_buff();
+    BOOST_REQUIRE(send_buff.get() != NULL);
+    send_buff->cast<char *>()[0] = 'b';
+    send_buff->commit(1);
+
+    BOOST_CHECK_EQUAL(std::string(&buff.front(), socket.receive(asio::buffer(buff))), "a");
+    BOOST_CHECK_EQUAL(std::string(&buff.front(), socket.receive(asio::buffer(buff))), hdr);
+    BOOST_CHECK_EQUAL(std::string(&buff.front(), socket.receive(asio::buffer(buff))), "b");
+}
+
+/***********************************************************************
+ * Transports for the packet handler:
+ *  - the copy transport gets frames from a zero copy transport
+ *  - the gather transport reuses one header buffer, and a gathered
+ *    commit sends the header with the payload in the io buffer
+ *    (and records where the payload was)
+ **********************************************************************/
+struct copy_transport{
+    zero_copy_if::sptr xport;
+    copy_transport(zero_copy_if::sptr xport): xport(xport){}
+
+    bool get_send_buffs(vrt_packet_handler::managed_send_buffs_t &buffs){
+        buffs[0] = xport->get_send_buff();
+        return buffs[0].get() != NULL;
+    }
+};
+
+class gather_transport{
+public:
+    gather_transport(udp_zero_copy::sptr xport): _buff(xport){}
+
+    bool get_send_buffs(vrt_packet_handler::managed_send_buffs_t &buffs){
+        _buff.armed = true;
+        buffs[0] = managed_send_buffer::sptr(&_buff);
+        return true;
+    }
+
+    const std::vector<const void *> &payloads(void) const{return _buff.payloads;}
+
+private:
+    class header_buffer : public vrt_packet_handler::gather_send_buffer{
+    public:
+        header_buffer(udp_zero_copy::sptr xport): armed(false), _xport(xport){
+            _ref_count.write(1); //held by the transport
+        }
+
+        void commit(size_t){
+            armed = false;
+        }
+
+        void commit_gather(size_t hdr_bytes, const void *payload, size_t payload_bytes){
+            if (not armed) return;
+            armed = false;
+            payloads.push_back(payload);
+            const void *mems[] = {_hdr, payload};
+            const size_t lens[] = {hdr_bytes, payload_bytes};
+            _xport->send_gather(mems, lens, 2);
+        }
+
+        bool armed;
+        std::vector<const void *> payloads;
+
+    private:
+        void *get_buff(void) const{return const_cast<boost::uint32_t *>(_hdr);}
+        size_t get_size(void) const{return sizeof(_hdr);}
+
+        boost::uint32_t _hdr[vrt::max_if_hdr_words32];
+        udp_zero_copy::sptr _xport;
+    };
+
+    header_buffer _buff;
+};
+
+static const size_t spp = 363;
+
+static std::vector<boost::uint32_t> make_wire_samps(size_t num_samps){
+    std::vector<boost::uint32_t> samps(num_samps);
+    for (size_t i = 0; i < num_samps; i++) samps[i] = uhd::htonx(boost::uint32_t(i*0x00010003));
+    return samps;
+}
+
+BOOST_AUTO_TEST_CASE(test_gather_handler){
+    asio::io_service io_service;
+    asio::ip::udp::socket socket(io_service, asio::ip::udp::endpoint(asio::ip::address_v4::loopback(), 0));
+    udp_zero_copy::sptr xport = make_loopback_xport(socket);
+    const std::vector<boost::uint32_t> samps = make_wire_samps(3*spp - 10);
+
+    uhd::tx_metadata_t md;
+    md.has_time_spec = true;
+    md.time_spec = uhd::time_spec_t(1.5);
+    md.start_of_burst = true;
+    md.end_of_burst = true;
+
+    //send the burst on the copy path, then on the gather path
+    vrt_packet_handler::send_state copy_state;
+    copy_transport copy_xport(xport);
+    BOOST_CHECK_EQUAL(copy_handler::send(
+        copy_state, uhd::device::send_buffs_type(&samps.front()), samps.size(), md,
+        uhd::device::SEND_MODE_FULL_BUFF, 100e6, copy_xport, spp
+    ), samps.size());
+
+    vrt_packet_handler::send_state gather_state;
+    gather_transport gather_xport(xport);
+    BOOST_CHECK_EQUAL(gather_handler::send(
+        gather_state, uhd::device::send_buffs_type(&samps.front()), samps.size(), md,
+        uhd::device::SEND_MODE_FULL_BUFF, 100e6, gather_xport, spp
+    ), samps.size());
+
+    //the payloads were sent from the io buffer
+    BOOST_REQUIRE_EQUAL(gather_xport.payloads().size(), size_t(3));
+    for (size_t i = 0; i < 3; i++){
+        BOOST_CHECK(gather_xport.payloads()[i] == &samps[i*spp]);
+    }
+
+    //both paths send the same packets, with the burst flags on the first and last
+    std::vector<std::vector<boost::uint32_t> > packets;
+    for (size_t i = 0; i < 6; i++){
+        std::vector<boost::uint32_t> packet(vrt::max_if_hdr_words32 + spp);
+        packet.resize(socket.receive(asio::buffer(packet))/sizeof(boost::uint32_t));
+        packets.push_back(packet);
+    }
+    for (size_t i = 0; i < 3; i++){
+        BOOST_CHECK(packets[i] == packets[i+3]);
+        vrt::if_packet_info_t if_packet_info;
+        if_packet_info.num_packet_words32 = packets[i].size();
+        vrt::if_hdr_unpack_be(&packets[i].front(), if_packet_info);
+        const bool first = (i == 0), last = (i == 2);
+        //the unpacker leaves out the burst flags, check the header bits
+        const boost::uint32_t vrt_hdr_word = uhd::ntohx(packets[i].front());
+        BOOST_CHECK_EQUAL(bool(vrt_hdr_word & (0x1 << 25)), first);
+        BOOST_CHECK_EQUAL(bool(vrt_hdr_word & (0x1 << 24)), last);
+        BOOST_CHECK_EQUAL(if_packet_info.has_tsi, first);
+        BOOST_CHECK(std::equal(
+            packets[i].begin() + if_packet_info.num_header_words32, packets[i].end(), samps.begin() + i*spp
+        ));
+    }
+}
+
+/***********************************************************************
+ * A long send over loopback:
+ * Every packet of the gather path sends its payload from the io buffer,
+ * none of the samples are copied into a send frame.
+ **********************************************************************/
+BOOST_AUTO_TEST_CASE(test_gather_no_copy){
+    asio::io_service io_service;
+    asio::ip::udp::socket socket(io_service, asio::ip::udp::endpoint(asio::ip::address_v4::loopback(), 0));
+    udp_zero_copy::sptr xport = make_loopback_xport(socket);
+
+    static const size_t num_packets = 100;
+    const std::vector<boost::uint32_t> samps = make_wire_samps(num_packets*spp);
+
+    uhd::tx_metadata_t md;
+    md.has_time_spec = false;
+    md.start_of_burst = false;
+    md.end_of_burst = false;
+
+    vrt_packet_handler::send_state state;
+    gather_transport gather_xport(xport);
+    for (size_t i = 0; i < 2; i++){
+        BOOST_CHECK_EQUAL(gather_handler::send(
+            state, uhd::device::send_buffs_type(&samps.front()), samps.size(), md,
+            uhd::device::SEND_MODE_FULL_BUFF, 100e6, gather_xport, spp
+        ), samps.size());
+    }
+
+    BOOST_REQUIRE_EQUAL(gather_xport.payloads().size(), 2*num_packets);
+    for (size_t i = 0; i < 2*num_packets; i++){
+        BOOST_CHECK(gather_xport.payloads()[i] == &samps[(i%num_packets)*spp]);
+    }
+}
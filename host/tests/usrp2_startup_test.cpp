@@ -0,0 +1,356 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "../lib/usrp/usrp2/fw_common.h"
+#include "../lib/usrp/usrp2/usrp2_regs.hpp"
+#include <uhd/device.hpp>
+#include <uhd/usrp/dboard_id.hpp>
+#include <uhd/usrp/device_props.hpp>
+#include <uhd/usrp/mboard_props.hpp>
+#include <uhd/types/sensors.hpp>
+#include <uhd/utils/algorithm.hpp>
+#include <uhd/utils/byteswap.hpp>
+#include <boost/asio.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/utility.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <vector>
+
+using namespace uhd;
+namespace asio = boost::asio;
+namespace fs = boost::filesystem;
+
+static const size_t fake_mtu = 1472; //udp payload of a 1500 byte ethernet mtu
+static const long fake_ctrl_delay_us = 200; //firmware time per control packet
+
+static double get_elapsed(const boost::system_time &start){
+    return double((boost::get_system_time() - start).total_microseconds())/1e6;
+}
+
+/***********************************************************************
+ * Fake usrp2 over loopback udp:
+ * A firmware that answers every control packet (registers, spi, i2c,
+ * uart, batches), echoes mtu probes up to an ethernet mtu (larger
+ * packets are lost), and sinks the data ports.
+ * The mboard eeprom holds an N200 with a serial, no dboards.
+ **********************************************************************/
+class fake_usrp2 : boost::noncopyable{
+public:
+    fake_usrp2(const std::string &ip, const std::string &serial):
+        _ip(asio::ip::address_v4::from_string(ip)),
+        _ctrl(_io_service, asio::ip::udp::endpoint(_ip, USRP2_UDP_CTRL_PORT)),
+        _start(boost::get_system_time()),
+        _running(true), _num_ctrl(0), _num_hollers(0)
+    {
+        const unsigned short data_ports[] = {USRP2_UDP_DSP0_PORT, USRP2_UDP_ERR0_PORT, USRP2_UDP_DSP1_PORT};
+        for (size_t i = 0; i < 3; i++){
+            _data.push_back(boost::shared_ptr<asio::ip::udp::socket>(new asio::ip::udp::socket(
+                _io_service, asio::ip::udp::endpoint(_ip, data_ports[i])
+            )));
+        }
+
+        std::vector<boost::uint8_t> &mb_eeprom = _eeproms[USRP2_I2C_DEV_EEPROM];
+        mb_eeprom.resize(256, 0xff);
+        mb_eeprom[0x00] = 0x00; mb_eeprom[0x01] = 0x0a; //N200 rev (lsb, msb)
+        std::copy(serial.begin(), serial.end(), mb_eeprom.begin() + 0x18);
+        mb_eeprom[0x18 + serial.size()] = 0;
+
+        _thread_group.create_thread(boost::bind(&fake_usrp2::ctrl_loop, this));
+    }
+
+    ~fake_usrp2(void){
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _running = false;
+        }
+        //wake up the control loop
+        asio::ip::udp::socket waker(_io_service, asio::ip::udp::v4());
+        waker.send_to(asio::buffer("~", 1), asio::ip::udp::endpoint(_ip, USRP2_UDP_CTRL_PORT));
+        _thread_group.join_all();
+    }
+
+    size_t get_num_ctrl(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _num_ctrl;
+    }
+
+    size_t get_num_hollers(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _num_hollers;
+    }
+
+    //! Put a dboard with this id in the slot of the eeprom address
+    void set_dboard_id(boost::uint8_t addr, boost::uint16_t id){
+        boost::mutex::scoped_lock lock(_mutex);
+        std::vector<boost::uint8_t> &eeprom = this->get_eeprom(addr);
+        eeprom[0x00] = 0xdb; //magic
+        eeprom[0x01] = boost::uint8_t(id >> 0);
+        eeprom[0x02] = boost::uint8_t(id >> 8);
+        boost::uint8_t sum = 0;
+        for (size_t i = 0; i < 0x1f; i++) sum -= eeprom[i];
+        eeprom[0x1f] = sum; //checksum
+    }
+
+    //! Get the first and the last time of the mtu probe packets
+    std::pair<boost::system_time, boost::system_time> get_holler_span(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return std::make_pair(_first_holler, _last_holler);
+    }
+
+private:
+    void ctrl_loop(void){
+        std::vector<boost::uint8_t> in(9000), out;
+        while (true){
+            asio::ip::udp::endpoint host;
+            const size_t len = _ctrl.receive_from(asio::buffer(in), host);
+            boost::mutex::scoped_lock lock(_mutex);
+            if (not _running) return;
+            if (len < sizeof(usrp2_ctrl_data_t)) continue;
+            _num_ctrl++;
+
+            const usrp2_ctrl_data_t *req = reinterpret_cast<const usrp2_ctrl_data_t *>(&in.front());
+            out.assign(in.begin(), in.begin() + len);
+            if (not this->handle(*req, len, *reinterpret_cast<usrp2_ctrl_data_t *>(&out.front()), out)) continue;
+            usrp2_ctrl_data_t *rep = reinterpret_cast<usrp2_ctrl_data_t *>(&out.front()); //after a resize
+            rep->proto_ver = uhd::htonx<boost::uint32_t>(USRP2_FW_COMPAT_NUM);
+            rep->seq = req->seq;
+            lock.unlock();
+
+            boost::this_thread::sleep(boost::posix_time::microseconds(fake_ctrl_delay_us));
+            _ctrl.send_to(asio::buffer(out), host);
+        }
+    }
+
+    //! Fill in the reply, false when the packet is lost
+    bool handle(const usrp2_ctrl_data_t &req, size_t len, usrp2_ctrl_data_t &rep, std::vector<boost::uint8_t> &out){
+        switch(uhd::ntohx(req.id)){
+        case USRP2_CTRL_ID_WAZZUP_BRO:
+            rep.id = uhd::htonx<boost::uint32_t>(USRP2_CTRL_ID_WAZZUP_DUDE);
+            rep.data.ip_addr = uhd::htonx<boost::uint32_t>(_ip.to_ulong());
+            out.resize(sizeof(usrp2_ctrl_data_t));
+            return true;
+
+        case USRP2_CTRL_ID_HOLLER_AT_ME_BRO:{
+                const boost::system_time now = boost::get_system_time();
+                if (_num_hollers++ == 0) _first_holler = now;
+                _last_holler = now;
+                const size_t reply_len = std::max(sizeof(usrp2_ctrl_data_t), size_t(uhd::ntohx(req.data.echo_args.len)));
+                if (len > fake_mtu or reply_len > fake_mtu) return false;
+                out.resize(reply_len);
+                usrp2_ctrl_data_t &echo = *reinterpret_cast<usrp2_ctrl_data_t *>(&out.front());
+                echo.id = uhd::htonx<boost::uint32_t>(USRP2_CTRL_ID_HOLLER_BACK_DUDE);
+                echo.data.echo_args.len = uhd::htonx(boost::uint32_t(len));
+                return true;
+            }
+
+        case USRP2_CTRL_ID_GET_THIS_REGISTER_FOR_ME_BRO:
+            rep.id = uhd::htonx<boost::uint32_t>(USRP2_CTRL_ID_OMG_GOT_REGISTER_SO_BAD_DUDE);
+            rep.data.reg_args.data = uhd::htonx(this->reg_action(
+                req.data.reg_args.action, uhd::ntohx(req.data.reg_args.addr), uhd::ntohx(req.data.reg_args.data)
+            ));
+            return true;
+
+        case USRP2_CTRL_ID_DO_ALL_THESE_THINGS_BRO:{
+                rep.id = uhd::htonx<boost::uint32_t>(USRP2_CTRL_ID_DID_ALL_THOSE_THINGS_DUDE);
+                usrp2_ctrl_batch_op_t *ops = reinterpret_cast<usrp2_ctrl_batch_op_t *>(&out.front() + sizeof(usrp2_ctrl_data_t));
+                for (size_t i = 0; i < uhd::ntohx(req.data.batch_args.num_ops); i++){
+                    if (ops[i].action == USRP2_REG_ACTION_SPI_WRITE) continue;
+                    ops[i].data = uhd::htonx(this->reg_action(ops[i].action, uhd::ntohx(ops[i].addr), uhd::ntohx(ops[i].data)));
+                }
+                return true;
+            }
+
+        case USRP2_CTRL_ID_TRANSACT_ME_SOME_SPI_BRO:
+            rep.id = uhd::htonx<boost::uint32_t>(USRP2_CTRL_ID_OMG_TRANSACTED_SPI_DUDE);
+            rep.data.spi_args.data = 0;
+            return true;
+
+        case USRP2_CTRL_ID_WRITE_THESE_I2C_VALUES_BRO:{
+                rep.id = uhd::htonx<boost::uint32_t>(USRP2_CTRL_ID_COOL_IM_DONE_I2C_WRITE_DUDE);
+                std::vector<boost::uint8_t> &eeprom = this->get_eeprom(req.data.i2c_args.addr);
+                size_t &offset = _offsets[req.data.i2c_args.addr];
+                offset = req.data.i2c_args.data[0];
+                for (size_t i = 1; i < req.data.i2c_args.bytes; i++) eeprom[(offset + i - 1) % 256] = req.data.i2c_args.data[i];
+                return true;
+            }
+
+        case USRP2_CTRL_ID_DO_AN_I2C_READ_FOR_ME_BRO:{
+                rep.id = uhd::htonx<boost::uint32_t>(USRP2_CTRL_ID_HERES_THE_I2C_DATA_DUDE);
+                std::vector<boost::uint8_t> &eeprom = this->get_eeprom(req.data.i2c_args.addr);
+                size_t &offset = _offsets[req.data.i2c_args.addr];
+                for (size_t i = 0; i < req.data.i2c_args.bytes; i++) rep.data.i2c_args.data[i] = eeprom[offset++ % 256];
+                return true;
+            }
+
+        case USRP2_CTRL_ID_HEY_WRITE_THIS_UART_FOR_ME_BRO:
+            rep.id = uhd::htonx<boost::uint32_t>(USRP2_CTRL_ID_MAN_I_TOTALLY_WROTE_THAT_UART_DUDE);
+            return true;
+
+        case USRP2_CTRL_ID_SO_LIKE_CAN_YOU_READ_THIS_UART_BRO:
+            rep.id = uhd::htonx<boost::uint32_t>(USRP2_CTRL_ID_I_HELLA_READ_THAT_UART_DUDE);
+            rep.data.uart_args.bytes = 0;
+            return true;
+        }
+        return false;
+    }
+
+    boost::uint32_t reg_action(boost::uint8_t action, boost::uint32_t addr, boost::uint32_t data){
+        switch(action){
+        case USRP2_REG_ACTION_FPGA_POKE32:
+        case USRP2_REG_ACTION_FPGA_POKE16: _fpga_regs[addr] = data; return data;
+        case USRP2_REG_ACTION_FW_POKE32: _fw_regs[addr] = data; return data;
+        case USRP2_REG_ACTION_FW_PEEK32: return _fw_regs[addr];
+        }
+        //the readback registers
+        const boost::uint32_t secs = boost::uint32_t(1000 + get_elapsed(_start));
+        switch(addr){
+        case U2_REG_COMPAT_NUM_RB: return USRP2_FPGA_COMPAT_NUM;
+        case U2_REG_TIME64_SECS_RB_IMM: return secs;
+        case U2_REG_TIME64_SECS_RB_PPS: return secs;
+        case U2_REG_TIME64_TICKS_RB_IMM: return 0;
+        }
+        return _fpga_regs[addr];
+    }
+
+    std::vector<boost::uint8_t> &get_eeprom(boost::uint8_t addr){
+        std::vector<boost::uint8_t> &eeprom = _eeproms[addr];
+        eeprom.resize(256, 0xff); //blank eeproms: no dboards
+        return eeprom;
+    }
+
+    const asio::ip::address_v4 _ip;
+    asio::io_service _io_service;
+    asio::ip::udp::socket _ctrl;
+    std::vector<boost::shared_ptr<asio::ip::udp::socket> > _data;
+    const boost::system_time _start;
+
+    boost::mutex _mutex;
+    bool _running;
+    size_t _num_ctrl, _num_hollers;
+    boost::system_time _first_holler, _last_holler;
+    std::map<boost::uint32_t, boost::uint32_t> _fpga_regs, _fw_regs;
+    std::map<boost::uint8_t, std::vector<boost::uint8_t> > _eeproms;
+    std::map<boost::uint8_t, size_t> _offsets;
+    boost::thread_group _thread_group;
+};
+
+/***********************************************************************
+ * Startup (discovery and construction) against the fake devices
+ **********************************************************************/
+static void make_device(const std::string &args){
+    device::sptr dev = device::make(device_addr_t(args));
+    BOOST_CHECK(dev.get() != NULL);
+}
+
+//! Keeps the descriptor cache of the test in a temporary directory
+struct temp_config_path{
+    temp_config_path(void):
+        path(fs::temp_directory_path() / fs::unique_path("uhd-test-%%%%-%%%%"))
+    {
+        fs::create_directories(path);
+        setenv("UHD_CONFIG_PATH", path.string().c_str(), 1);
+    }
+    ~temp_config_path(void){
+        unsetenv("UHD_CONFIG_PATH");
+        fs::remove_all(path);
+    }
+    const fs::path path;
+};
+
+static bool file_contains(const fs::path &path, const std::string &str){
+    std::ifstream file(path.string().c_str());
+    const std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return contents.find(str) != std::string::npos;
+}
+
+BOOST_AUTO_TEST_CASE(test_usrp2_startup_cache){
+    temp_config_path config_path;
+    fake_usrp2 fake("127.0.0.1", "FAKE1");
+
+    //without the cache, the frame sizes are probed on every startup
+    make_device("type=usrp2, addr=127.0.0.1");
+    const size_t uncached_hollers = fake.get_num_hollers();
+    BOOST_CHECK_GT(uncached_hollers, size_t(0));
+
+    //the first cached startup probes and stores the descriptor
+    size_t num_ctrl = fake.get_num_ctrl();
+    make_device("type=usrp2, addr=127.0.0.1, desc_cache=1");
+    const size_t miss_ctrl = fake.get_num_ctrl() - num_ctrl;
+    BOOST_CHECK_EQUAL(fake.get_num_hollers(), 2*uncached_hollers);
+    BOOST_CHECK(fs::exists(config_path.path / "usrp2_desc_cache"));
+
+    //the next cached startup skips the probing
+    num_ctrl = fake.get_num_ctrl();
+    make_device("type=usrp2, addr=127.0.0.1, desc_cache=1");
+    const size_t hit_ctrl = fake.get_num_ctrl() - num_ctrl;
+    BOOST_CHECK_EQUAL(fake.get_num_hollers(), 2*uncached_hollers);
+    BOOST_CHECK_LT(hit_ctrl, miss_ctrl);
+
+    //a serial hint finds the device at its cached address
+    make_device("type=usrp2, serial=FAKE1, desc_cache=1");
+    BOOST_CHECK_EQUAL(fake.get_num_hollers(), 2*uncached_hollers);
+
+    //a swapped dboard is detected through its eeprom header and the cache is updated
+    const std::string basic_rx_id = usrp::dboard_id_t::from_uint16(0x0001).to_string();
+    BOOST_CHECK(not file_contains(config_path.path / "usrp2_desc_cache", basic_rx_id));
+    fake.set_dboard_id(USRP2_I2C_ADDR_RX_DB, 0x0001);
+    make_device("type=usrp2, addr=127.0.0.1, desc_cache=1");
+    BOOST_CHECK(file_contains(config_path.path / "usrp2_desc_cache", basic_rx_id));
+}
+
+BOOST_AUTO_TEST_CASE(test_usrp2_startup_parallel){
+    temp_config_path config_path;
+    fake_usrp2 fake0("127.0.0.1", "FAKE1");
+    fake_usrp2 fake1("127.0.0.2", "FAKE2");
+
+    //the mboards are probed at the same time: the probe spans overlap
+    make_device("type=usrp2, addr0=127.0.0.1, addr1=127.0.0.2");
+    const std::pair<boost::system_time, boost::system_time> span0 = fake0.get_holler_span();
+    const std::pair<boost::system_time, boost::system_time> span1 = fake1.get_holler_span();
+    BOOST_CHECK_GT(fake0.get_num_hollers(), size_t(0));
+    BOOST_CHECK_GT(fake1.get_num_hollers(), size_t(0));
+    BOOST_CHECK(span0.first < span1.second and span1.first < span0.second);
+}
+
+BOOST_AUTO_TEST_CASE(test_usrp2_sensor_names){
+    temp_config_path config_path;
+    fake_usrp2 fake("127.0.0.1", "FAKE1");
+    device::sptr dev = device::make(device_addr_t("type=usrp2, addr=127.0.0.1"));
+    wax::obj mboard = (*dev)[usrp::DEVICE_PROP_MBOARD];
+
+    //every listed sensor can be read
+    const prop_names_t names = mboard[usrp::MBOARD_PROP_SENSOR_NAMES].as<prop_names_t>();
+    BOOST_CHECK(uhd::has(names, std::string("rx_align_num_dropped")));
+    BOOST_FOREACH(const std::string &name, names){
+        try{
+            mboard[named_prop_t(usrp::MBOARD_PROP_SENSOR, name)].as<sensor_value_t>();
+        }catch(const std::exception &e){
+            BOOST_ERROR("reading sensor " << name << ": " << e.what());
+        }
+    }
+}
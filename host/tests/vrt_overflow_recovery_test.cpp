@@ -0,0 +1,231 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "vrt_overflow_recovery.hpp"
+#include "recv_buffer_fixtures.hpp"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+#include <complex>
+#include <vector>
+
+using namespace uhd::transport;
+namespace pt = boost::posix_time;
+
+static const size_t spp = 100;
+static const long recover_delay_ms = 100;
+
+/***********************************************************************
+ * Fake device that forces overflows:
+ * A continuous stream that sends an overflow context packet on request
+ * and then stops, like the dsp, until the stream command is re-issued.
+ * The recovery sends the stream command over a slow control path.
+ **********************************************************************/
+
+static std::vector<boost::uint32_t> make_packet(bool overflow){
+    vrt::if_packet_info_t if_packet_info;
+    if_packet_info.packet_type = vrt::if_packet_info_t::PACKET_TYPE_DATA;
+    if_packet_info.num_payload_words32 = overflow? 1 : spp;
+    if_packet_info.packet_count = 0;
+    if_packet_info.has_sid = true;
+    if_packet_info.sid = 0;
+    if_packet_info.has_cid = false;
+    if_packet_info.has_tsi = false;
+    if_packet_info.has_tsf = false;
+    if_packet_info.has_tlr = false;
+
+    std::vector<boost::uint32_t> packet(vrt::max_if_hdr_words32 + spp);
+    vrt::if_hdr_pack_be(&packet.front(), if_packet_info);
+    packet.resize(if_packet_info.num_packet_words32);
+    if (overflow){
+        //there is no context packer, set the packet type bits by hand
+        packet[0] = uhd::htonx(boost::uint32_t(uhd::ntohx(packet[0]) | (0x4 << 28)));
+        packet[if_packet_info.num_header_words32] = uhd::htonx(boost::uint32_t(uhd::rx_metadata_t::ERROR_CODE_OVERFLOW));
+    }
+    return packet;
+}
+
+class overflow_device{
+public:
+    overflow_device(void):
+        _data_packet(make_packet(false)), _overflow_packet(make_packet(true)),
+        _data_buff(&_data_packet.front(), _data_packet.size()*sizeof(boost::uint32_t)),
+        _overflow_buff(&_overflow_packet.front(), _overflow_packet.size()*sizeof(boost::uint32_t)),
+        _stream_cmds(1), _streaming(true), _recovering(false),
+        _force_overflow(false), _next_seq(0), _num_stream_cmds(0)
+    {
+        _stream_cmds.set_continuous(0, true);
+    }
+
+    void force_overflow(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        _force_overflow = true;
+    }
+
+    //a stream command of the user
+    void issue_stream_cmd(bool continuous){
+        boost::mutex::scoped_lock lock(_stream_cmds.get_mutex());
+        _stream_cmds.set_continuous(0, continuous);
+        send_stream_cmd(continuous, 0);
+    }
+
+    //the recovery: re-issue the stream command if continuous
+    void recover(size_t){
+        boost::mutex::scoped_lock lock(_stream_cmds.get_mutex());
+        if (not _stream_cmds.is_continuous(0)) return;
+        set_recovering(true);
+        send_stream_cmd(true, recover_delay_ms);
+        set_recovering(false);
+    }
+
+    bool is_recovering(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _recovering;
+    }
+
+    bool is_streaming(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _streaming;
+    }
+
+    size_t get_num_stream_cmds(void){
+        boost::mutex::scoped_lock lock(_mutex);
+        return _num_stream_cmds;
+    }
+
+    bool get_recv_buffs(vrt_packet_handler::managed_recv_buffs_t &buffs){
+        boost::mutex::scoped_lock lock(_mutex);
+        if (not _cond.timed_wait(lock, pt::seconds(1), boost::bind(&overflow_device::streaming, this))) return false;
+
+        std::vector<boost::uint32_t> &packet = _force_overflow? _overflow_packet : _data_packet;
+        const_recv_buffer &buff = _force_overflow? _overflow_buff : _data_buff;
+        if (_force_overflow) _streaming = _force_overflow = false;
+
+        packet[0] = uhd::htonx(boost::uint32_t((uhd::ntohx(packet[0]) & ~(0xf << 16)) | ((_next_seq++ & 0xf) << 16)));
+        buffs[0] = make_managed_buffer<managed_recv_buffer>(&buff);
+        return true;
+    }
+
+private:
+    bool streaming(void) const{return _streaming;}
+
+    //send a stream command, it reaches the device after the delay
+    void send_stream_cmd(bool continuous, long delay_ms){
+        boost::this_thread::sleep(pt::milliseconds(delay_ms));
+        boost::mutex::scoped_lock lock(_mutex);
+        _streaming = continuous;
+        _num_stream_cmds++;
+        lock.unlock();
+        _cond.notify_one();
+    }
+
+    void set_recovering(bool recovering){
+        boost::mutex::scoped_lock lock(_mutex);
+        _recovering = recovering;
+    }
+
+    std::vector<boost::uint32_t> _data_packet, _overflow_packet;
+    const_recv_buffer _data_buff, _overflow_buff;
+    vrt_packet_handler::stream_cmd_state _stream_cmds;
+    boost::mutex _mutex;
+    boost::condition _cond;
+    bool _streaming, _recovering, _force_overflow;
+    size_t _next_seq, _num_stream_cmds;
+};
+
+typedef std::complex<boost::int16_t> sc16_t;
+typedef vrt_packet_handler::static_handler<vrt_packet_handler::vrt_codec_be, sc16_t> static_handler;
+
+static size_t recv_one_packet(
+    overflow_device &device, vrt_packet_handler::recv_state &state,
+    vrt_packet_handler::overflow_recovery &recovery, uhd::rx_metadata_t &md
+){
+    std::vector<sc16_t> samps(spp);
+    return static_handler::recv(
+        state, uhd::device::recv_buffs_type(&samps.front()), spp, md,
+        uhd::device::RECV_MODE_ONE_PACKET, 100e6, device, boost::ref(recovery)
+    );
+}
+
+BOOST_AUTO_TEST_CASE(test_overflow_recovery){
+    overflow_device device;
+    vrt_packet_handler::overflow_recovery recovery(1, boost::bind(&overflow_device::recover, &device, _1));
+    vrt_packet_handler::recv_state state;
+    uhd::rx_metadata_t md;
+
+    BOOST_CHECK_EQUAL(recv_one_packet(device, state, recovery, md), spp);
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+
+    //the overflow is returned right away, without the control round trip
+    device.force_overflow();
+    const pt::ptime start = pt::microsec_clock::universal_time();
+    BOOST_CHECK_EQUAL(recv_one_packet(device, state, recovery, md), size_t(0));
+    const pt::time_duration elapsed = pt::microsec_clock::universal_time() - start;
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_OVERFLOW);
+    BOOST_CHECK_LT(elapsed.total_milliseconds(), recover_delay_ms/2);
+
+    //the stream resumes once recovered in the background
+    BOOST_CHECK_EQUAL(recv_one_packet(device, state, recovery, md), spp);
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+    BOOST_CHECK_EQUAL(device.get_num_stream_cmds(), size_t(1));
+    BOOST_CHECK_EQUAL(recovery.get_num_recoveries(), size_t(1));
+}
+
+BOOST_AUTO_TEST_CASE(test_overflow_recovery_coalesce){
+    overflow_device device;
+    vrt_packet_handler::overflow_recovery recovery(2, boost::bind(&overflow_device::recover, &device, _1));
+
+    //overflows signaled while a recovery is pending make one recovery
+    for (size_t i = 0; i < 10; i++) recovery(1);
+    while (recovery.get_num_recoveries() == 0){
+        boost::this_thread::sleep(pt::milliseconds(10));
+    }
+    BOOST_CHECK_EQUAL(recovery.get_num_recoveries(), size_t(1));
+    BOOST_CHECK_EQUAL(device.get_num_stream_cmds(), size_t(1));
+}
+
+BOOST_AUTO_TEST_CASE(test_overflow_recovery_stop){
+    overflow_device device;
+    vrt_packet_handler::overflow_recovery recovery(1, boost::bind(&overflow_device::recover, &device, _1));
+    vrt_packet_handler::recv_state state;
+    uhd::rx_metadata_t md;
+
+    device.force_overflow();
+    BOOST_CHECK_EQUAL(recv_one_packet(device, state, recovery, md), size_t(0));
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_OVERFLOW);
+
+    //the user stops the stream while the recovery re-issues the stream command
+    while (not device.is_recovering()){
+        boost::this_thread::sleep(pt::milliseconds(1));
+    }
+    device.issue_stream_cmd(false);
+
+    //the stop is sent after the recovery, the device stays stopped
+    while (recovery.get_num_recoveries() == 0){
+        boost::this_thread::sleep(pt::milliseconds(10));
+    }
+    BOOST_CHECK(not device.is_streaming());
+    BOOST_CHECK_EQUAL(device.get_num_stream_cmds(), size_t(2));
+
+    //an overflow signaled after the stop re-issues nothing
+    recovery(0);
+    while (recovery.get_num_recoveries() == 1){
+        boost::this_thread::sleep(pt::milliseconds(10));
+    }
+    BOOST_CHECK(not device.is_streaming());
+    BOOST_CHECK_EQUAL(device.get_num_stream_cmds(), size_t(2));
+}
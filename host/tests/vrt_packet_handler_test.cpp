@@ -0,0 +1,712 @@
+//
+// Copyright 2010-2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "vrt_packet_handler.hpp"
+#include "recv_buffer_fixtures.hpp"
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <complex>
+#include <vector>
+
+using namespace uhd::transport;
+
+/***********************************************************************
+ * Header template vs the vrt packer
+ **********************************************************************/
+static void check_template(
+    const vrt_packet_handler::vrt_packer_t &vrt_packer,
+    vrt::if_packet_info_t &if_packet_info
+){
+    vrt_packet_handler::send_hdr_template hdr_template;
+    hdr_template.make(vrt_packer, if_packet_info);
+    BOOST_REQUIRE(hdr_template.usable);
+    BOOST_CHECK(hdr_template.matches(if_packet_info));
+
+    for (size_t count = 0; count < 20; count++){
+        if_packet_info.packet_count = count;
+        if_packet_info.num_payload_words32 = (count*137)%1500;
+        if_packet_info.sob = (count % 2) == 0;
+        if_packet_info.eob = (count % 3) == 0;
+        if_packet_info.tsi = boost::uint32_t(count*0x01010101);
+        if_packet_info.tsf = boost::uint64_t(count)*0x0123456789abcdefull;
+
+        boost::uint32_t packer_words[vrt::max_if_hdr_words32];
+        vrt::if_packet_info_t packer_info = if_packet_info;
+        vrt_packer(packer_words, packer_info);
+
+        boost::uint32_t template_words[vrt::max_if_hdr_words32];
+        vrt::if_packet_info_t template_info = if_packet_info;
+        hdr_template.pack(template_words, template_info);
+
+        BOOST_CHECK_EQUAL(packer_info.num_header_words32, template_info.num_header_words32);
+        BOOST_CHECK_EQUAL(packer_info.num_packet_words32, template_info.num_packet_words32);
+        for (size_t i = 0; i < packer_info.num_header_words32; i++){
+            BOOST_CHECK_EQUAL(packer_words[i], template_words[i]);
+        }
+    }
+}
+
+static void check_template_flags(const vrt_packet_handler::vrt_packer_t &vrt_packer){
+    for (size_t flags = 0; flags < (1 << 5); flags++){
+        vrt::if_packet_info_t if_packet_info;
+        if_packet_info.packet_type = vrt::if_packet_info_t::PACKET_TYPE_DATA;
+        if_packet_info.has_sid = (flags & (1 << 0)) != 0;
+        if_packet_info.has_cid = (flags & (1 << 1)) != 0;
+        if_packet_info.has_tsi = (flags & (1 << 2)) != 0;
+        if_packet_info.has_tsf = (flags & (1 << 3)) != 0;
+        if_packet_info.has_tlr = (flags & (1 << 4)) != 0;
+        if_packet_info.sid = 0xdeadbeef;
+        if_packet_info.cid = 0x0123456789abcdefull;
+        check_template(vrt_packer, if_packet_info);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_hdr_template_be){
+    check_template_flags(&vrt::if_hdr_pack_be);
+}
+
+BOOST_AUTO_TEST_CASE(test_hdr_template_le){
+    check_template_flags(&vrt::if_hdr_pack_le);
+}
+
+BOOST_AUTO_TEST_CASE(test_hdr_template_matches){
+    vrt::if_packet_info_t if_packet_info;
+    if_packet_info.packet_type = vrt::if_packet_info_t::PACKET_TYPE_DATA;
+    if_packet_info.has_sid = true;
+    if_packet_info.has_cid = false;
+    if_packet_info.has_tsi = false;
+    if_packet_info.has_tsf = false;
+    if_packet_info.has_tlr = false;
+    if_packet_info.sid = 1;
+    if_packet_info.num_payload_words32 = 0;
+
+    vrt_packet_handler::send_hdr_template hdr_template;
+    BOOST_CHECK(not hdr_template.matches(if_packet_info));
+    hdr_template.make(&vrt::if_hdr_pack_be, if_packet_info);
+    BOOST_CHECK(hdr_template.matches(if_packet_info));
+
+    if_packet_info.sid = 2;
+    BOOST_CHECK(not hdr_template.matches(if_packet_info));
+    if_packet_info.sid = 1;
+    if_packet_info.has_tsi = true;
+    BOOST_CHECK(not hdr_template.matches(if_packet_info));
+}
+
+/***********************************************************************
+ * Loopback send:
+ * A dummy transport hands out the same buffer for every packet.
+ * A counting packer shows how often the send path packs a header.
+ **********************************************************************/
+class loopback_send_buffer : public managed_send_buffer{
+public:
+    loopback_send_buffer(size_t size): _mem(size/sizeof(boost::uint32_t)), num_commits(0), num_bytes(0){
+        /* NOP */
+    }
+
+    void commit(size_t num_bytes){
+        if (num_bytes == 0) return;
+        this->num_commits++;
+        this->num_bytes = num_bytes;
+    }
+
+    bool get_send_buffs(vrt_packet_handler::managed_send_buffs_t &buffs){
+        for (size_t i = 0; i < buffs.size(); i++) buffs[i] = make_managed_buffer(this);
+        return true;
+    }
+
+    const boost::uint32_t *mem(void) const{
+        return &_mem.front();
+    }
+
+private:
+    void *get_buff(void) const{return const_cast<boost::uint32_t *>(&_mem.front());}
+    size_t get_size(void) const{return _mem.size()*sizeof(boost::uint32_t);}
+
+    std::vector<boost::uint32_t> _mem;
+
+public:
+    size_t num_commits, num_bytes;
+};
+
+//a packer that cannot be templated, forces the send path onto the packer
+static void if_hdr_pack_untemplated(boost::uint32_t *packet_buff, vrt::if_packet_info_t &if_packet_info){
+    vrt::if_hdr_pack_be(packet_buff, if_packet_info);
+    packet_buff[0] ^= (if_packet_info.packet_count & 0x1) << 8; //hides the count bit from the template
+}
+
+//counts the calls, then packs with the packer
+static void if_hdr_pack_counted(
+    const vrt_packet_handler::vrt_packer_t &vrt_packer, size_t &num_calls,
+    boost::uint32_t *packet_buff, vrt::if_packet_info_t &if_packet_info
+){
+    num_calls++;
+    vrt_packer(packet_buff, if_packet_info);
+}
+
+//! Send packets and get the number of packer calls
+static size_t send_packer_calls(
+    const vrt_packet_handler::vrt_packer_t &vrt_packer,
+    bool expect_template, size_t num_packets
+){
+    static const size_t spp = 363;
+    size_t num_calls = 0;
+    std::vector<std::complex<float> > samps(spp);
+    loopback_send_buffer buff((spp + vrt::max_if_hdr_words32)*sizeof(boost::uint32_t));
+
+    vrt_packet_handler::send_state state;
+    uhd::tx_metadata_t md;
+    uhd::otw_type_t otw_type;
+    otw_type.width = 16;
+    otw_type.shift = 0;
+    otw_type.byteorder = uhd::otw_type_t::BO_BIG_ENDIAN;
+
+    for (size_t i = 0; i < num_packets; i++){
+        vrt_packet_handler::send(
+            state, uhd::device::send_buffs_type(&samps.front()), spp, md,
+            uhd::device::SEND_MODE_FULL_BUFF,
+            uhd::io_type_t::COMPLEX_FLOAT32,
+            otw_type, 100e6, boost::bind(&if_hdr_pack_counted, boost::cref(vrt_packer), boost::ref(num_calls), _1, _2),
+            boost::bind(&loopback_send_buffer::get_send_buffs, &buff, _1),
+            spp
+        );
+    }
+
+    BOOST_CHECK_EQUAL(buff.num_commits, num_packets);
+    BOOST_CHECK_EQUAL(state.hdr_template.usable, expect_template);
+
+    //the last packet header must match the packer
+    vrt::if_packet_info_t if_packet_info = state.hdr_template.info;
+    if_packet_info.packet_count = num_packets - 1;
+    if_packet_info.num_payload_words32 = spp;
+    boost::uint32_t header_buff[vrt::max_if_hdr_words32];
+    vrt_packer(header_buff, if_packet_info);
+    BOOST_CHECK_EQUAL(buff.mem()[0], header_buff[0]);
+
+    return num_calls;
+}
+
+BOOST_AUTO_TEST_CASE(test_send_loopback){
+    //the header template packs the headers: the packer is only called to make the template
+    const size_t template_calls = send_packer_calls(&vrt::if_hdr_pack_be, true, 100);
+    BOOST_CHECK_EQUAL(send_packer_calls(&vrt::if_hdr_pack_be, true, 1000), template_calls);
+    BOOST_CHECK_LT(template_calls, size_t(100));
+
+    //without a usable template, the packer packs every header
+    BOOST_CHECK_GE(send_packer_calls(&if_hdr_pack_untemplated, false, 1000), size_t(1000));
+}
+
+/***********************************************************************
+ * Integer tick timestamps:
+ * Tick rates with a fractional tick period in nanoseconds, and a tick
+ * rate that is not even an integer, over 24 hours worth of ticks.
+ **********************************************************************/
+static const double test_tick_rates[] = {100e6, 61.44e6, 52e6, 64e6/3, 13e6/7};
+static const time_t day_secs = 24*60*60;
+
+BOOST_AUTO_TEST_CASE(test_ticks_round_trip){
+    BOOST_FOREACH(double tick_rate, test_tick_rates){
+        const boost::uint64_t ticks_per_sec = vrt_packet_handler::get_ticks_per_sec(tick_rate);
+        const time_t secs_list[] = {0, 1, 59, 3600, day_secs-1, day_secs, 10*day_secs};
+        const boost::uint64_t frac_ticks_list[] = {0, 1, ticks_per_sec/3, ticks_per_sec/2, ticks_per_sec-1};
+        BOOST_FOREACH(time_t secs, secs_list){
+        BOOST_FOREACH(boost::uint64_t frac_ticks, frac_ticks_list){
+            const boost::uint64_t ticks = secs*ticks_per_sec + frac_ticks;
+
+            //ticks <-> timestamp fields
+            vrt::if_packet_info_t if_packet_info;
+            vrt_packet_handler::set_ticks(if_packet_info, ticks, ticks_per_sec);
+            BOOST_CHECK_EQUAL(if_packet_info.tsi, boost::uint32_t(secs));
+            BOOST_CHECK_EQUAL(if_packet_info.tsf, frac_ticks);
+            BOOST_CHECK_EQUAL(vrt_packet_handler::get_ticks(if_packet_info, ticks_per_sec), ticks);
+
+            //ticks <-> time spec
+            const uhd::time_spec_t time_spec = vrt_packet_handler::ticks_to_time_spec(ticks, tick_rate);
+            BOOST_CHECK_EQUAL(time_spec.get_full_secs(), secs);
+            BOOST_CHECK_EQUAL(time_spec.get_tick_count(tick_rate), long(frac_ticks));
+            BOOST_CHECK_EQUAL(vrt_packet_handler::time_spec_to_ticks(time_spec, tick_rate), ticks);
+        }}
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_ticks_carry){
+    //a fractional second that rounds up to a full second must carry into the seconds
+    const double tick_rate = 100e6;
+    const uhd::time_spec_t time_spec(time_t(5), 1.0 - 0.1/tick_rate);
+    vrt::if_packet_info_t if_packet_info;
+    vrt_packet_handler::set_ticks(
+        if_packet_info, vrt_packet_handler::time_spec_to_ticks(time_spec, tick_rate),
+        vrt_packet_handler::get_ticks_per_sec(tick_rate)
+    );
+    BOOST_CHECK_EQUAL(if_packet_info.tsi, boost::uint32_t(6));
+    BOOST_CHECK_EQUAL(if_packet_info.tsf, boost::uint64_t(0));
+}
+
+BOOST_AUTO_TEST_CASE(test_ticks_no_drift){
+    //stream a day of packets by advancing the timestamp fields
+    static const boost::uint64_t ticks_per_packet = 363*4*1000; //spp * decimation * 1000 packets
+    BOOST_FOREACH(double tick_rate, test_tick_rates){
+        const boost::uint64_t ticks_per_sec = vrt_packet_handler::get_ticks_per_sec(tick_rate);
+        const boost::uint64_t num_packets = (day_secs*ticks_per_sec)/ticks_per_packet;
+
+        vrt::if_packet_info_t if_packet_info;
+        if_packet_info.tsi = 0;
+        if_packet_info.tsf = 0;
+        for (boost::uint64_t i = 0; i < num_packets; i++){
+            vrt_packet_handler::set_ticks(
+                if_packet_info, vrt_packet_handler::get_ticks(if_packet_info, ticks_per_sec) + ticks_per_packet,
+                ticks_per_sec
+            );
+        }
+
+        //the last timestamp is exact
+        const boost::uint64_t ticks = num_packets*ticks_per_packet;
+        BOOST_CHECK_EQUAL(if_packet_info.tsi, boost::uint32_t(ticks/ticks_per_sec));
+        BOOST_CHECK_EQUAL(if_packet_info.tsf, ticks%ticks_per_sec);
+        const uhd::time_spec_t time_spec = vrt_packet_handler::ticks_to_time_spec(
+            vrt_packet_handler::get_ticks(if_packet_info, ticks_per_sec), tick_rate
+        );
+        BOOST_CHECK_EQUAL(time_spec.get_full_secs(), time_t(ticks/ticks_per_sec));
+        BOOST_CHECK_EQUAL(time_spec.get_tick_count(tick_rate), long(ticks%ticks_per_sec));
+    }
+}
+
+/***********************************************************************
+ * Send a timed packet a day into the stream and receive it back
+ **********************************************************************/
+//hands out the same buffer on every channel
+static bool get_loopback_buffs(const_recv_buffer *buff, vrt_packet_handler::managed_recv_buffs_t &buffs){
+    for (size_t i = 0; i < buffs.size(); i++) buffs[i] = make_managed_buffer(buff);
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(test_send_recv_time_spec){
+    static const size_t spp = 100;
+    std::vector<std::complex<float> > samps(spp);
+    uhd::otw_type_t otw_type;
+    otw_type.width = 16;
+    otw_type.shift = 0;
+    otw_type.byteorder = uhd::otw_type_t::BO_BIG_ENDIAN;
+
+    BOOST_FOREACH(double tick_rate, test_tick_rates){
+        const boost::uint64_t ticks_per_sec = vrt_packet_handler::get_ticks_per_sec(tick_rate);
+        const long frac_ticks = long(ticks_per_sec - 7);
+
+        //send one timed packet into the loopback buffer
+        loopback_send_buffer send_buff((spp + vrt::max_if_hdr_words32)*sizeof(boost::uint32_t));
+        vrt_packet_handler::send_state send_state;
+        uhd::tx_metadata_t tx_md;
+        tx_md.has_time_spec = true;
+        tx_md.time_spec = uhd::time_spec_t(day_secs, frac_ticks, tick_rate);
+        BOOST_CHECK_EQUAL(spp, vrt_packet_handler::send(
+            send_state, uhd::device::send_buffs_type(&samps.front()), spp, tx_md,
+            uhd::device::SEND_MODE_ONE_PACKET,
+            uhd::io_type_t::COMPLEX_FLOAT32,
+            otw_type, tick_rate, &vrt::if_hdr_pack_be,
+            boost::bind(&loopback_send_buffer::get_send_buffs, &send_buff, _1),
+            spp
+        ));
+
+        //receive it back and check the time spec
+        const_recv_buffer recv_buff(send_buff.mem(), send_buff.num_bytes);
+        vrt_packet_handler::recv_state recv_state;
+        uhd::rx_metadata_t rx_md;
+        BOOST_CHECK_EQUAL(spp, vrt_packet_handler::recv(
+            recv_state, uhd::device::recv_buffs_type(&samps.front()), spp, rx_md,
+            uhd::device::RECV_MODE_ONE_PACKET,
+            uhd::io_type_t::COMPLEX_FLOAT32,
+            otw_type, tick_rate, &vrt::if_hdr_unpack_be,
+            boost::bind(&get_loopback_buffs, &recv_buff, _1)
+        ));
+        BOOST_CHECK(rx_md.has_time_spec);
+        BOOST_CHECK_EQUAL(rx_md.time_spec.get_full_secs(), day_secs);
+        BOOST_CHECK_EQUAL(rx_md.time_spec.get_tick_count(tick_rate), frac_ticks);
+    }
+}
+
+/***********************************************************************
+ * Sequence gaps:
+ * A mock transport plays back a stream of packets with chosen drops.
+ * Every sample of a packet holds the packet number plus one.
+ **********************************************************************/
+class mock_recv_transport{
+public:
+    mock_recv_transport(
+        size_t num_packets, size_t spp, boost::uint64_t ticks_per_samp,
+        const std::vector<size_t> &drops, bool has_time_spec = true
+    ): _index(0){
+        for (size_t n = 0; n < num_packets; n++){
+            if (std::find(drops.begin(), drops.end(), n) != drops.end()) continue;
+            vrt::if_packet_info_t if_packet_info;
+            if_packet_info.packet_type = vrt::if_packet_info_t::PACKET_TYPE_DATA;
+            if_packet_info.num_payload_words32 = spp;
+            if_packet_info.packet_count = n;
+            if_packet_info.has_sid = false;
+            if_packet_info.has_cid = false;
+            if_packet_info.has_tsi = has_time_spec;
+            if_packet_info.has_tsf = has_time_spec;
+            if_packet_info.has_tlr = false;
+            vrt_packet_handler::set_ticks(if_packet_info, get_ticks(n, spp, ticks_per_samp), ticks_per_sec);
+
+            std::vector<boost::uint32_t> packet(vrt::max_if_hdr_words32 + spp);
+            vrt::if_hdr_pack_be(&packet.front(), if_packet_info);
+            packet.resize(if_packet_info.num_packet_words32);
+            std::fill(packet.begin() + if_packet_info.num_header_words32, packet.end(), uhd::htonx(boost::uint32_t((n+1) << 16 | (n+1))));
+            _packets.push_back(packet);
+        }
+        for (size_t i = 0; i < _packets.size(); i++){
+            _buffs.push_back(const_recv_buffer(&_packets[i].front(), _packets[i].size()*sizeof(boost::uint32_t)));
+        }
+    }
+
+    bool get_recv_buffs(vrt_packet_handler::managed_recv_buffs_t &buffs){
+        if (_index == _buffs.size()) return false; //timeout
+        buffs[0] = make_managed_buffer(&_buffs[_index++]);
+        return true;
+    }
+
+    static boost::uint64_t get_ticks(size_t n, size_t spp, boost::uint64_t ticks_per_samp){
+        return 1234567*ticks_per_sec + n*spp*ticks_per_samp;
+    }
+
+    static const boost::uint64_t ticks_per_sec = 100000000;
+
+private:
+    size_t _index;
+    std::vector<std::vector<boost::uint32_t> > _packets;
+    std::vector<const_recv_buffer> _buffs;
+};
+
+static const size_t gap_spp = 100;
+static const boost::uint64_t gap_ticks_per_samp = 4;
+
+static size_t recv_gap(
+    vrt_packet_handler::recv_state &state,
+    mock_recv_transport &transport,
+    std::vector<std::complex<boost::int16_t> > &samps,
+    uhd::rx_metadata_t &md,
+    uhd::device::recv_mode_t recv_mode = uhd::device::RECV_MODE_ONE_PACKET
+){
+    uhd::otw_type_t otw_type;
+    otw_type.width = 16;
+    otw_type.shift = 0;
+    otw_type.byteorder = uhd::otw_type_t::BO_BIG_ENDIAN;
+    std::fill(samps.begin(), samps.end(), std::complex<boost::int16_t>(-1, -1));
+    return vrt_packet_handler::recv(
+        state, uhd::device::recv_buffs_type(&samps.front()), samps.size(), md,
+        recv_mode, uhd::io_type_t::COMPLEX_INT16,
+        otw_type, double(mock_recv_transport::ticks_per_sec), &vrt::if_hdr_unpack_be,
+        boost::bind(&mock_recv_transport::get_recv_buffs, &transport, _1)
+    );
+}
+
+static void check_packet(
+    const std::vector<std::complex<boost::int16_t> > &samps, size_t num_samps,
+    const uhd::rx_metadata_t &md, size_t n
+){
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+    BOOST_CHECK_EQUAL(num_samps, gap_spp);
+    BOOST_CHECK(md.has_time_spec);
+    BOOST_CHECK_EQUAL(
+        vrt_packet_handler::time_spec_to_ticks(md.time_spec, double(mock_recv_transport::ticks_per_sec)),
+        mock_recv_transport::get_ticks(n, gap_spp, gap_ticks_per_samp)
+    );
+    BOOST_CHECK_EQUAL(samps[0].real(), boost::int16_t(n+1));
+    BOOST_CHECK_EQUAL(samps[num_samps-1].imag(), boost::int16_t(n+1));
+}
+
+static void check_gap(
+    size_t num_samps, const uhd::rx_metadata_t &md,
+    size_t first_lost, size_t num_lost, size_t num_samps_expected = 0
+){
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_SEQUENCE_ERROR);
+    BOOST_CHECK_EQUAL(num_samps, num_samps_expected);
+    BOOST_CHECK_EQUAL(md.num_lost_packets, num_lost);
+    BOOST_CHECK_EQUAL(md.num_lost_samps, num_lost*gap_spp);
+    BOOST_CHECK(md.has_time_spec);
+    BOOST_CHECK_EQUAL(
+        vrt_packet_handler::time_spec_to_ticks(md.time_spec, double(mock_recv_transport::ticks_per_sec)),
+        mock_recv_transport::get_ticks(first_lost, gap_spp, gap_ticks_per_samp)
+    );
+}
+
+BOOST_AUTO_TEST_CASE(test_sequence_no_gap){
+    mock_recv_transport transport(40, gap_spp, gap_ticks_per_samp, std::vector<size_t>());
+    vrt_packet_handler::recv_state state;
+    std::vector<std::complex<boost::int16_t> > samps(gap_spp);
+    uhd::rx_metadata_t md;
+    for (size_t n = 0; n < 40; n++){
+        check_packet(samps, recv_gap(state, transport, samps, md), md, n);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_sequence_gaps){
+    std::vector<size_t> drops;
+    drops.push_back(3);
+    for (size_t n = 10; n < 30; n++) drops.push_back(n); //longer than the sequence wraps
+    mock_recv_transport transport(40, gap_spp, gap_ticks_per_samp, drops);
+    vrt_packet_handler::recv_state state;
+    std::vector<std::complex<boost::int16_t> > samps(gap_spp);
+    uhd::rx_metadata_t md;
+
+    for (size_t n = 0; n < 3; n++){
+        check_packet(samps, recv_gap(state, transport, samps, md), md, n);
+    }
+    check_gap(recv_gap(state, transport, samps, md), md, 3, 1);
+    for (size_t n = 4; n < 10; n++){
+        check_packet(samps, recv_gap(state, transport, samps, md), md, n);
+    }
+    check_gap(recv_gap(state, transport, samps, md), md, 10, 20);
+    for (size_t n = 30; n < 40; n++){
+        check_packet(samps, recv_gap(state, transport, samps, md), md, n);
+    }
+    recv_gap(state, transport, samps, md);
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_TIMEOUT);
+}
+
+BOOST_AUTO_TEST_CASE(test_sequence_gap_no_time_spec){
+    mock_recv_transport transport(10, gap_spp, gap_ticks_per_samp, std::vector<size_t>(1, 5), false);
+    vrt_packet_handler::recv_state state;
+    std::vector<std::complex<boost::int16_t> > samps(gap_spp);
+    uhd::rx_metadata_t md;
+
+    for (size_t n = 0; n < 5; n++){
+        BOOST_CHECK_EQUAL(recv_gap(state, transport, samps, md), gap_spp);
+        BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+    }
+
+    //the lost samples are estimated from the previous packet
+    BOOST_CHECK_EQUAL(recv_gap(state, transport, samps, md), size_t(0));
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_SEQUENCE_ERROR);
+    BOOST_CHECK_EQUAL(md.num_lost_packets, size_t(1));
+    BOOST_CHECK_EQUAL(md.num_lost_samps, gap_spp);
+    BOOST_CHECK(not md.has_time_spec);
+
+    BOOST_CHECK_EQUAL(recv_gap(state, transport, samps, md), gap_spp);
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+    BOOST_CHECK_EQUAL(samps[0].real(), boost::int16_t(6+1));
+}
+
+BOOST_AUTO_TEST_CASE(test_sequence_gap_zero_fill_one_packet){
+    std::vector<size_t> drops;
+    drops.push_back(2);
+    drops.push_back(3);
+    mock_recv_transport transport(10, gap_spp, gap_ticks_per_samp, drops);
+    vrt_packet_handler::recv_state state(1, true);
+    std::vector<std::complex<boost::int16_t> > samps(gap_spp);
+    uhd::rx_metadata_t md;
+
+    for (size_t n = 0; n < 2; n++){
+        check_packet(samps, recv_gap(state, transport, samps, md), md, n);
+    }
+
+    //the first call reports the gap and returns zeros
+    check_gap(recv_gap(state, transport, samps, md), md, 2, 2, gap_spp);
+    BOOST_CHECK_EQUAL(samps[0], std::complex<boost::int16_t>(0, 0));
+    BOOST_CHECK_EQUAL(samps[gap_spp-1], std::complex<boost::int16_t>(0, 0));
+
+    //the second call returns the rest of the zeros
+    BOOST_CHECK_EQUAL(recv_gap(state, transport, samps, md), gap_spp);
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+    BOOST_CHECK_EQUAL(
+        vrt_packet_handler::time_spec_to_ticks(md.time_spec, double(mock_recv_transport::ticks_per_sec)),
+        mock_recv_transport::get_ticks(3, gap_spp, gap_ticks_per_samp)
+    );
+    BOOST_CHECK_EQUAL(samps[gap_spp-1], std::complex<boost::int16_t>(0, 0));
+
+    for (size_t n = 4; n < 10; n++){
+        check_packet(samps, recv_gap(state, transport, samps, md), md, n);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_sequence_gap_zero_fill_full_buff){
+    std::vector<size_t> drops;
+    drops.push_back(2);
+    drops.push_back(3);
+    mock_recv_transport transport(10, gap_spp, gap_ticks_per_samp, drops);
+    vrt_packet_handler::recv_state state(1, true);
+    std::vector<std::complex<boost::int16_t> > samps(10*gap_spp);
+    uhd::rx_metadata_t md;
+
+    //the whole timeline comes back in one buffer with the gap zero filled
+    BOOST_CHECK_EQUAL(recv_gap(state, transport, samps, md, uhd::device::RECV_MODE_FULL_BUFF), samps.size());
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_SEQUENCE_ERROR);
+    BOOST_CHECK_EQUAL(md.num_lost_packets, size_t(2));
+    BOOST_CHECK_EQUAL(md.num_lost_samps, 2*gap_spp);
+    BOOST_CHECK_EQUAL(
+        vrt_packet_handler::time_spec_to_ticks(md.time_spec, double(mock_recv_transport::ticks_per_sec)),
+        mock_recv_transport::get_ticks(0, gap_spp, gap_ticks_per_samp)
+    );
+    for (size_t n = 0; n < 10; n++){
+        const boost::int16_t val = (n == 2 or n == 3)? 0 : boost::int16_t(n+1);
+        BOOST_CHECK_EQUAL(samps[n*gap_spp], std::complex<boost::int16_t>(val, val));
+        BOOST_CHECK_EQUAL(samps[n*gap_spp + gap_spp-1], std::complex<boost::int16_t>(val, val));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_sequence_gap_full_buff){
+    mock_recv_transport transport(10, gap_spp, gap_ticks_per_samp, std::vector<size_t>(1, 4));
+    vrt_packet_handler::recv_state state;
+    std::vector<std::complex<boost::int16_t> > samps(10*gap_spp);
+    uhd::rx_metadata_t md;
+
+    //the buffer ends before the gap, the next call reports it
+    BOOST_CHECK_EQUAL(recv_gap(state, transport, samps, md, uhd::device::RECV_MODE_FULL_BUFF), 4*gap_spp);
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+    check_gap(recv_gap(state, transport, samps, md, uhd::device::RECV_MODE_FULL_BUFF), md, 4, 1);
+    BOOST_CHECK_EQUAL(recv_gap(state, transport, samps, md, uhd::device::RECV_MODE_FULL_BUFF), 5*gap_spp);
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+    BOOST_CHECK_EQUAL(samps[0].real(), boost::int16_t(5+1));
+}
+
+/***********************************************************************
+ * Runtime vs compile-time specialized packet handler:
+ * Both paths must produce the same samples and headers,
+ * for 1 to 4 channels per otw buffer.
+ **********************************************************************/
+class repeat_transport{
+public:
+    repeat_transport(size_t spp):
+        _recv_packet(vrt::max_if_hdr_words32 + spp), _count(0),
+        _send_buff((vrt::max_if_hdr_words32 + spp)*sizeof(boost::uint32_t))
+    {
+        vrt::if_packet_info_t if_packet_info;
+        if_packet_info.packet_type = vrt::if_packet_info_t::PACKET_TYPE_DATA;
+        if_packet_info.num_payload_words32 = spp;
+        if_packet_info.packet_count = 0;
+        if_packet_info.has_sid = true;
+        if_packet_info.sid = 0;
+        if_packet_info.has_cid = false;
+        if_packet_info.has_tsi = true;
+        if_packet_info.has_tsf = true;
+        if_packet_info.tsi = 0;
+        if_packet_info.tsf = 0;
+        if_packet_info.has_tlr = false;
+        vrt::if_hdr_pack_be(&_recv_packet.front(), if_packet_info);
+        _recv_packet.resize(if_packet_info.num_packet_words32);
+        for (size_t i = if_packet_info.num_header_words32; i < _recv_packet.size(); i++){
+            _recv_packet[i] = uhd::htonx(boost::uint32_t(i*0x00010003));
+        }
+        _recv_buff.reset(new const_recv_buffer(&_recv_packet.front(), _recv_packet.size()*sizeof(boost::uint32_t)));
+    }
+
+    //the same packet with the next sequence number every time
+    bool get_recv_buffs(vrt_packet_handler::managed_recv_buffs_t &buffs){
+        _recv_packet[0] = uhd::htonx(boost::uint32_t((uhd::ntohx(_recv_packet[0]) & ~(0xf << 16)) | ((_count++ & 0xf) << 16)));
+        buffs[0] = make_managed_buffer(_recv_buff.get());
+        return true;
+    }
+
+    bool get_send_buffs(vrt_packet_handler::managed_send_buffs_t &buffs){
+        return _send_buff.get_send_buffs(buffs);
+    }
+
+    const loopback_send_buffer &send_buff(void) const{
+        return _send_buff;
+    }
+
+private:
+    std::vector<boost::uint32_t> _recv_packet;
+    size_t _count;
+    boost::shared_ptr<const_recv_buffer> _recv_buff;
+    loopback_send_buffer _send_buff;
+};
+
+static const size_t handler_spp = 363, handler_num_packets = 20;
+
+template <typename cpu_type, size_t width> static void check_static_handler(const uhd::io_type_t &io_type){
+    uhd::otw_type_t otw_type;
+    otw_type.width = 16;
+    otw_type.shift = 0;
+    otw_type.byteorder = uhd::otw_type_t::BO_BIG_ENDIAN;
+    typedef typename vrt_packet_handler::static_converter<vrt_packet_handler::vrt_codec_be, cpu_type, width>::type converter_type;
+    typedef vrt_packet_handler::static_handler<vrt_packet_handler::vrt_codec_be, cpu_type, converter_type> static_handler;
+
+    //one io buffer per channel, the channels share each otw buffer
+    std::vector<std::vector<cpu_type> > runtime_samps(width, std::vector<cpu_type>(handler_spp));
+    std::vector<std::vector<cpu_type> > static_samps(width, std::vector<cpu_type>(handler_spp));
+    std::vector<void *> runtime_buffs, static_buffs;
+    for (size_t w = 0; w < width; w++){
+        runtime_buffs.push_back(&runtime_samps[w].front());
+        static_buffs.push_back(&static_samps[w].front());
+    }
+    uhd::rx_metadata_t md;
+    uhd::tx_metadata_t tx_md;
+    tx_md.has_time_spec = false;
+    tx_md.start_of_burst = false;
+    tx_md.end_of_burst = false;
+
+    repeat_transport runtime_transport(handler_spp*width), static_transport(handler_spp*width);
+    vrt_packet_handler::recv_state runtime_recv_state, static_recv_state;
+    vrt_packet_handler::send_state runtime_send_state, static_send_state;
+    for (size_t i = 0; i < handler_num_packets; i++){
+        //recv: the runtime path
+        BOOST_CHECK_EQUAL(vrt_packet_handler::recv(
+            runtime_recv_state, runtime_buffs, handler_spp, md,
+            uhd::device::RECV_MODE_ONE_PACKET, io_type, otw_type, 100e6, &vrt::if_hdr_unpack_be,
+            boost::bind(&repeat_transport::get_recv_buffs, &runtime_transport, _1),
+            &vrt_packet_handler::handle_overflow_nop, 0, width
+        ), handler_spp);
+        BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+
+        //recv: the static path
+        BOOST_CHECK_EQUAL(static_handler::recv(
+            static_recv_state, static_buffs, handler_spp, md,
+            uhd::device::RECV_MODE_ONE_PACKET, 100e6, static_transport
+        ), handler_spp);
+        BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+        BOOST_CHECK(runtime_samps == static_samps);
+
+        //the channels of the otw buffer are interleaved item by item
+        BOOST_CHECK(width == 1 or runtime_samps[0] != runtime_samps[1]);
+
+        //send: the runtime path
+        BOOST_CHECK_EQUAL(vrt_packet_handler::send(
+            runtime_send_state, runtime_buffs, handler_spp, tx_md,
+            uhd::device::SEND_MODE_ONE_PACKET, io_type, otw_type, 100e6, &vrt::if_hdr_pack_be,
+            boost::bind(&repeat_transport::get_send_buffs, &runtime_transport, _1), handler_spp,
+            0, width
+        ), handler_spp);
+
+        //send: the static path
+        BOOST_CHECK_EQUAL(static_handler::send(
+            static_send_state, static_buffs, handler_spp, tx_md,
+            uhd::device::SEND_MODE_ONE_PACKET, 100e6, static_transport, handler_spp
+        ), handler_spp);
+        BOOST_CHECK_EQUAL(runtime_transport.send_buff().num_bytes, static_transport.send_buff().num_bytes);
+        const size_t num_words = runtime_transport.send_buff().num_bytes/sizeof(boost::uint32_t);
+        BOOST_CHECK(std::equal(
+            runtime_transport.send_buff().mem(), runtime_transport.send_buff().mem() + num_words,
+            static_transport.send_buff().mem()
+        ));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_static_handler_fc32){
+    check_static_handler<std::complex<float>, 1>(uhd::io_type_t::COMPLEX_FLOAT32);
+    check_static_handler<std::complex<float>, 2>(uhd::io_type_t::COMPLEX_FLOAT32);
+    check_static_handler<std::complex<float>, 3>(uhd::io_type_t::COMPLEX_FLOAT32);
+    check_static_handler<std::complex<float>, 4>(uhd::io_type_t::COMPLEX_FLOAT32);
+}
+
+BOOST_AUTO_TEST_CASE(test_static_handler_sc16){
+    check_static_handler<std::complex<boost::int16_t>, 1>(uhd::io_type_t::COMPLEX_INT16);
+    check_static_handler<std::complex<boost::int16_t>, 2>(uhd::io_type_t::COMPLEX_INT16);
+    check_static_handler<std::complex<boost::int16_t>, 3>(uhd::io_type_t::COMPLEX_INT16);
+    check_static_handler<std::complex<boost::int16_t>, 4>(uhd::io_type_t::COMPLEX_INT16);
+}
@@ -0,0 +1,393 @@
+//
+// Copyright 2010-2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "vrt_recv_aligner.hpp"
+#include "recv_buffer_fixtures.hpp"
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <complex>
+#include <vector>
+
+using namespace uhd::transport;
+
+typedef vrt_packet_handler::recv_aligner<vrt_packet_handler::vrt_codec_be> recv_aligner_be;
+
+static const boost::uint64_t ticks_per_sec = 100000; //a second is 250 packets
+static const boost::uint64_t ticks_per_samp = 4;
+static const size_t spp = 100;
+
+/***********************************************************************
+ * Synthetic skewed channel streams:
+ * Each channel plays back its own stream of packets,
+ * the source keeps every packet until the end of the test. The packets
+ * carry synthetic samples, so that the samples of every handed out
+ * buffer can be checked against its timestamp.
+ **********************************************************************/
+
+struct stream_params{
+    boost::uint64_t start_ticks;
+    std::vector<size_t> drops;  //packet numbers lost on the way
+    size_t context_packet;      //packet number replaced by a context packet
+    size_t reset_packet;        //packet number where the time goes back to zero
+
+    stream_params(boost::uint64_t start_ticks = 0):
+        start_ticks(start_ticks), context_packet(~size_t(0)), reset_packet(~size_t(0))
+    {
+        /* NOP */
+    }
+};
+
+class skewed_source{
+public:
+    skewed_source(const std::vector<stream_params> &params):
+        _params(params), _next_packets(params.size(), 0), _num_pulled(0)
+    {
+        /* NOP */
+    }
+
+    managed_recv_buffer::sptr operator()(size_t chan, double) const{
+        const stream_params &params = _params[chan];
+        size_t &n = _next_packets[chan];
+        while (std::find(params.drops.begin(), params.drops.end(), n) != params.drops.end()) n++;
+        _num_pulled++;
+        _buffs.push_back(boost::shared_ptr<heap_recv_buffer>(new heap_recv_buffer(make_packet(chan, n++))));
+        return make_managed_buffer<managed_recv_buffer>(_buffs.back().get());
+    }
+
+    size_t num_pulled(void) const{
+        return _num_pulled;
+    }
+
+    static boost::uint64_t get_ticks(const stream_params &params, size_t n){
+        if (n >= params.reset_packet) return (n - params.reset_packet)*spp*ticks_per_samp;
+        return params.start_ticks + n*spp*ticks_per_samp;
+    }
+
+private:
+    std::vector<boost::uint32_t> make_packet(size_t chan, size_t n) const{
+        const stream_params &params = _params[chan];
+        //a context packet has one payload word (the error code)
+        const bool context = n == params.context_packet;
+
+        std::vector<boost::uint32_t> packet(vrt::max_if_hdr_words32 + spp + 1);
+        packet.resize(pack_synthetic_packet(
+            &packet.front(), chan, n, get_ticks(params, n), context? 1 : spp, ticks_per_sec, ticks_per_samp
+        ));
+
+        //there is no context packer, set the packet type bits by hand
+        if (context) packet[0] = uhd::htonx(boost::uint32_t(uhd::ntohx(packet[0]) | (0x4 << 28)));
+        return packet;
+    }
+
+    std::vector<stream_params> _params;
+    mutable std::vector<size_t> _next_packets;
+    mutable size_t _num_pulled;
+    mutable std::vector<boost::shared_ptr<heap_recv_buffer> > _buffs;
+};
+
+/***********************************************************************
+ * Check one aligned set of buffers:
+ * Every channel must hand out the same timestamp and number of samples,
+ * and the samples must belong to that timestamp.
+ **********************************************************************/
+struct aligned_span{
+    boost::uint64_t ticks;
+    size_t nsamps;
+};
+
+static aligned_span check_aligned(const vrt_packet_handler::managed_recv_buffs_t &buffs){
+    aligned_span span = {0, 0};
+    for (size_t chan = 0; chan < buffs.size(); chan++){
+        BOOST_REQUIRE(buffs[chan].get() != NULL);
+        const boost::uint32_t *words = buffs[chan]->cast<const boost::uint32_t *>();
+        vrt::if_packet_info_t if_packet_info;
+        if_packet_info.num_packet_words32 = buffs[chan]->size()/sizeof(boost::uint32_t);
+        vrt::if_hdr_unpack_be(words, if_packet_info);
+        BOOST_REQUIRE(if_packet_info.has_tsi and if_packet_info.has_tsf);
+        BOOST_CHECK(if_packet_info.has_tlr);
+
+        const boost::uint64_t ticks = vrt_packet_handler::get_ticks(if_packet_info, ticks_per_sec);
+        if (chan == 0){
+            span.ticks = ticks;
+            span.nsamps = if_packet_info.num_payload_words32;
+        }
+        BOOST_CHECK_EQUAL(ticks, span.ticks);
+        BOOST_CHECK_EQUAL(if_packet_info.num_payload_words32, span.nsamps);
+
+        for (size_t i = 0; i < if_packet_info.num_payload_words32; i++){
+            const boost::uint32_t item = uhd::ntohx(words[if_packet_info.num_header_words32 + i]);
+            if (item != synthetic_item(ticks/ticks_per_samp + i, chan)){
+                BOOST_ERROR("wrong sample on channel " << chan << " at index " << i);
+                break;
+            }
+        }
+    }
+    return span;
+}
+
+//! Receive aligned spans until the given tick, check they are contiguous
+static void check_contiguous(
+    recv_aligner_be &aligner, const skewed_source &source,
+    size_t width, boost::uint64_t first_ticks, boost::uint64_t end_ticks
+){
+    vrt_packet_handler::managed_recv_buffs_t buffs(width);
+    boost::uint64_t ticks = first_ticks;
+    while (ticks < end_ticks){
+        BOOST_REQUIRE(aligner.get_recv_buffs(buffs, source, 0.1));
+        const aligned_span span = check_aligned(buffs);
+        BOOST_REQUIRE_EQUAL(span.ticks, ticks);
+        BOOST_REQUIRE(span.nsamps != 0);
+        ticks += span.nsamps*ticks_per_samp;
+    }
+}
+
+/***********************************************************************
+ * Alignment tests
+ **********************************************************************/
+BOOST_AUTO_TEST_CASE(test_aligner_aligned){
+    std::vector<stream_params> params(4, stream_params(1000*ticks_per_samp));
+    skewed_source source(params);
+    recv_aligner_be aligner(params.size(), ticks_per_sec);
+
+    vrt_packet_handler::managed_recv_buffs_t buffs(params.size());
+    for (size_t n = 0; n < 50; n++){
+        BOOST_REQUIRE(aligner.get_recv_buffs(buffs, source, 0.1));
+        const aligned_span span = check_aligned(buffs);
+        BOOST_CHECK_EQUAL(span.ticks, skewed_source::get_ticks(params[0], n));
+        BOOST_CHECK_EQUAL(span.nsamps, spp);
+    }
+    BOOST_CHECK_EQUAL(aligner.get_num_dropped_samps(), size_t(0));
+    BOOST_CHECK_EQUAL(aligner.get_num_seq_gaps(), size_t(0));
+    BOOST_CHECK_EQUAL(source.num_pulled(), 50*params.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_aligner_whole_packet_skew){
+    //channel 2 starts three packets late
+    std::vector<stream_params> params(3, stream_params(0));
+    params[2].start_ticks = 3*spp*ticks_per_samp;
+    skewed_source source(params);
+    recv_aligner_be aligner(params.size(), ticks_per_sec);
+
+    check_contiguous(aligner, source, params.size(), params[2].start_ticks, 40*spp*ticks_per_samp);
+    BOOST_CHECK_EQUAL(aligner.get_num_dropped_samps(), 2*3*spp);
+}
+
+BOOST_AUTO_TEST_CASE(test_aligner_sample_skew){
+    //every channel starts a few samples later than the last
+    std::vector<stream_params> params;
+    params.push_back(stream_params(0));
+    params.push_back(stream_params(30*ticks_per_samp));
+    params.push_back(stream_params(45*ticks_per_samp));
+    params.push_back(stream_params(1045*ticks_per_samp));
+    skewed_source source(params);
+    recv_aligner_be aligner(params.size(), ticks_per_sec);
+
+    //only the samples before the newest start are dropped, none after
+    check_contiguous(aligner, source, params.size(), params[3].start_ticks, 60*spp*ticks_per_samp);
+    BOOST_CHECK_EQUAL(aligner.get_num_dropped_samps(), size_t(1045 + 1015 + 1000));
+}
+
+BOOST_AUTO_TEST_CASE(test_aligner_sub_sample_skew){
+    //less than half a sample apart: aligned without drops
+    std::vector<stream_params> params;
+    params.push_back(stream_params(0));
+    params.push_back(stream_params(1));
+    skewed_source source(params);
+    recv_aligner_be aligner(params.size(), ticks_per_sec);
+
+    vrt_packet_handler::managed_recv_buffs_t buffs(params.size());
+    for (size_t n = 0; n < 20; n++){
+        BOOST_REQUIRE(aligner.get_recv_buffs(buffs, source, 0.1));
+        BOOST_CHECK(buffs[0].get() != NULL and buffs[1].get() != NULL);
+        BOOST_CHECK_EQUAL(buffs[0]->size(), buffs[1]->size());
+    }
+    BOOST_CHECK_EQUAL(aligner.get_num_dropped_samps(), size_t(0));
+}
+
+BOOST_AUTO_TEST_CASE(test_aligner_lost_packet){
+    //channel 0 loses packet 10, the other channels drop it too
+    std::vector<stream_params> params(3, stream_params(0));
+    params[0].drops.push_back(10);
+    skewed_source source(params);
+    recv_aligner_be aligner(params.size(), ticks_per_sec);
+
+    check_contiguous(aligner, source, params.size(), 0, 10*spp*ticks_per_samp);
+    BOOST_CHECK_EQUAL(aligner.get_num_dropped_samps(), size_t(0));
+    check_contiguous(aligner, source, params.size(), 11*spp*ticks_per_samp, 30*spp*ticks_per_samp);
+    BOOST_CHECK_EQUAL(aligner.get_num_dropped_samps(), 2*spp);
+    BOOST_CHECK_EQUAL(aligner.get_num_seq_gaps(), size_t(1));
+}
+
+BOOST_AUTO_TEST_CASE(test_aligner_time_reset){
+    //the time goes back to zero, channel 1 sees it one packet later
+    std::vector<stream_params> params(2, stream_params(5000*ticks_per_samp));
+    params[0].reset_packet = 20;
+    params[1].reset_packet = 21;
+    skewed_source source(params);
+    recv_aligner_be aligner(params.size(), ticks_per_sec);
+
+    check_contiguous(aligner, source, params.size(), params[0].start_ticks, params[0].start_ticks + 20*spp*ticks_per_samp);
+    check_contiguous(aligner, source, params.size(), 0, 30*spp*ticks_per_samp);
+
+    //channel 1 drops its last packet before the reset
+    BOOST_CHECK_EQUAL(aligner.get_num_dropped_samps(), spp);
+}
+
+BOOST_AUTO_TEST_CASE(test_aligner_time_reset_one_channel){
+    //only channel 0 streamed before the time was set
+    std::vector<stream_params> params(2, stream_params(0));
+    params[0].start_ticks = 10*ticks_per_sec;
+    params[0].reset_packet = 3;
+    skewed_source source(params);
+    recv_aligner_be aligner(params.size(), ticks_per_sec);
+
+    //channel 0 drops its packets before the reset, channel 1 none
+    check_contiguous(aligner, source, params.size(), 0, 30*spp*ticks_per_samp);
+    BOOST_CHECK_EQUAL(aligner.get_num_dropped_samps(), 3*spp);
+}
+
+BOOST_AUTO_TEST_CASE(test_aligner_missed_time_reset){
+    //the time is set while both channels stream, channel 1 never sees it
+    std::vector<stream_params> params(2, stream_params(0));
+    params[0].start_ticks = 10*spp*ticks_per_samp;
+    params[0].reset_packet = 3;
+    skewed_source source(params);
+    recv_aligner_be aligner(params.size(), ticks_per_sec);
+
+    //channel 1 joins the new epoch after streaming on the old one for a second
+    check_contiguous(aligner, source, params.size(), params[0].start_ticks, params[0].start_ticks + 3*spp*ticks_per_samp);
+    vrt_packet_handler::managed_recv_buffs_t buffs(params.size());
+    BOOST_REQUIRE(aligner.get_recv_buffs(buffs, source, 0.1));
+    const aligned_span span = check_aligned(buffs);
+    BOOST_CHECK(span.ticks > ticks_per_sec);
+    check_contiguous(aligner, source, params.size(), span.ticks + span.nsamps*ticks_per_samp, span.ticks + 30*spp*ticks_per_samp);
+}
+
+BOOST_AUTO_TEST_CASE(test_aligner_context_packet){
+    std::vector<stream_params> params(2, stream_params(0));
+    params[1].context_packet = 5;
+    skewed_source source(params);
+    recv_aligner_be aligner(params.size(), ticks_per_sec);
+
+    check_contiguous(aligner, source, params.size(), 0, 5*spp*ticks_per_samp);
+
+    //the context packet is handed out alone
+    vrt_packet_handler::managed_recv_buffs_t buffs(params.size());
+    BOOST_REQUIRE(aligner.get_recv_buffs(buffs, source, 0.1));
+    BOOST_CHECK(buffs[0].get() == NULL);
+    BOOST_REQUIRE(buffs[1].get() != NULL);
+    vrt::if_packet_info_t if_packet_info;
+    if_packet_info.num_packet_words32 = buffs[1]->size()/sizeof(boost::uint32_t);
+    vrt::if_hdr_unpack_be(buffs[1]->cast<const boost::uint32_t *>(), if_packet_info);
+    BOOST_CHECK(if_packet_info.packet_type != vrt::if_packet_info_t::PACKET_TYPE_DATA);
+
+    //channel 0 drops the packet that has no partner
+    check_contiguous(aligner, source, params.size(), 6*spp*ticks_per_samp, 20*spp*ticks_per_samp);
+    BOOST_CHECK_EQUAL(aligner.get_num_dropped_samps(), spp);
+}
+
+static void release_all(std::vector<vrt_packet_handler::managed_recv_buffs_t> *held){
+    held->clear();
+}
+
+BOOST_AUTO_TEST_CASE(test_aligner_pieces_outlive_aligner){
+    //a sample skew splits every packet into pieces
+    std::vector<stream_params> params;
+    params.push_back(stream_params(0));
+    params.push_back(stream_params(30*ticks_per_samp));
+    skewed_source source(params);
+
+    std::vector<vrt_packet_handler::managed_recv_buffs_t> held;
+    {
+        recv_aligner_be aligner(params.size(), ticks_per_sec);
+        for (size_t n = 0; n < 10; n++){
+            vrt_packet_handler::managed_recv_buffs_t buffs(params.size());
+            BOOST_REQUIRE(aligner.get_recv_buffs(buffs, source, 0.1));
+            held.push_back(buffs);
+        }
+    }
+
+    //the pieces keep their samples past the aligner, and are released in another thread
+    BOOST_FOREACH(const vrt_packet_handler::managed_recv_buffs_t &buffs, held) check_aligned(buffs);
+    boost::thread releaser(boost::bind(&release_all, &held));
+    releaser.join();
+    BOOST_CHECK(held.empty());
+}
+
+/***********************************************************************
+ * The packet handler on top of the aligner:
+ * Split packets must come out as a contiguous stream without errors.
+ **********************************************************************/
+class aligned_transport{
+public:
+    aligned_transport(recv_aligner_be &aligner, const skewed_source &source):
+        _aligner(aligner), _source(source)
+    {
+        /* NOP */
+    }
+
+    bool get_recv_buffs(vrt_packet_handler::managed_recv_buffs_t &buffs){
+        return _aligner.get_recv_buffs(buffs, _source, 0.1);
+    }
+
+private:
+    recv_aligner_be &_aligner;
+    const skewed_source &_source;
+};
+
+BOOST_AUTO_TEST_CASE(test_aligner_packet_handler){
+    std::vector<stream_params> params;
+    params.push_back(stream_params(0));
+    params.push_back(stream_params(37*ticks_per_samp));
+    skewed_source source(params);
+    recv_aligner_be aligner(params.size(), ticks_per_sec);
+    aligned_transport transport(aligner, source);
+
+    typedef std::complex<boost::int16_t> sc16_t;
+    static const size_t nsamps_per_recv = 1000;
+    std::vector<std::vector<sc16_t> > samps(params.size(), std::vector<sc16_t>(nsamps_per_recv));
+    std::vector<void *> samp_ptrs;
+    for (size_t chan = 0; chan < params.size(); chan++) samp_ptrs.push_back(&samps[chan].front());
+
+    vrt_packet_handler::recv_state state(params.size());
+    size_t index = 37;
+    for (size_t n = 0; n < 20; n++){
+        uhd::rx_metadata_t md;
+        const size_t num_samps = vrt_packet_handler::static_handler<vrt_packet_handler::vrt_codec_be, sc16_t>::recv(
+            state, uhd::device::recv_buffs_type(samp_ptrs), nsamps_per_recv, md,
+            uhd::device::RECV_MODE_FULL_BUFF, double(ticks_per_sec), transport
+        );
+        BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+        BOOST_CHECK_EQUAL(num_samps, nsamps_per_recv);
+        BOOST_CHECK(md.has_time_spec);
+        BOOST_CHECK_EQUAL(
+            vrt_packet_handler::time_spec_to_ticks(md.time_spec, double(ticks_per_sec)), index*ticks_per_samp
+        );
+        for (size_t chan = 0; chan < params.size(); chan++){
+            for (size_t i = 0; i < num_samps; i++){
+                if (samps[chan][i] == sc16_t(boost::int16_t(index + i), boost::int16_t(chan))) continue;
+                BOOST_ERROR("wrong sample on channel " << chan << " at index " << index + i);
+                break;
+            }
+        }
+        index += num_samps;
+    }
+    BOOST_CHECK_EQUAL(aligner.get_num_dropped_samps(), size_t(37));
+}
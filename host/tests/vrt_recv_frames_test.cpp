@@ -0,0 +1,208 @@
+//
+// Copyright 2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "vrt_recv_frames.hpp"
+#include "recv_buffer_fixtures.hpp"
+#include <uhd/utils/byteswap.hpp>
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+using namespace uhd;
+using namespace uhd::transport;
+
+static const size_t num_frames = 8, spp = 100, ticks_per_samp = 4;
+static const double tick_rate = 100e6;
+static const boost::uint64_t ticks_per_sec = 100000000;
+
+/***********************************************************************
+ * Packet transport:
+ * A pool of frames, each get fills a data packet with the next sequence
+ * (the sequences in the skip list are lost), a release returns the frame.
+ * The destructor sets a flag, so that the lifetime can be checked.
+ **********************************************************************/
+class packet_xport : public zero_copy_if{
+public:
+    packet_xport(bool &destroyed, const std::vector<size_t> &skips = std::vector<size_t>()):
+        _destroyed(destroyed), _skips(skips), _seq(0), _pool(num_frames)
+    {
+        for (size_t i = 0; i < num_frames; i++){
+            _frames.push_back(boost::shared_ptr<pool_recv_buffer>(new pool_recv_buffer(_pool, frame_words32)));
+            _pool.push_with_haste(_frames.back().get());
+        }
+    }
+
+    ~packet_xport(void){
+        BOOST_CHECK_EQUAL(get_num_free(), num_frames); //no frame outlives the transport
+        _destroyed = true;
+    }
+
+    size_t get_num_free(void){
+        std::vector<pool_recv_buffer *> free_frames;
+        pool_recv_buffer *frame = NULL;
+        while (_pool.pop_with_haste(frame)) free_frames.push_back(frame);
+        BOOST_FOREACH(pool_recv_buffer *frame, free_frames) _pool.push_with_haste(frame);
+        return free_frames.size();
+    }
+
+    managed_recv_buffer::sptr get_recv_buff(double){
+        pool_recv_buffer *frame = NULL;
+        if (not _pool.pop_with_haste(frame)) return managed_recv_buffer::sptr();
+        while (std::find(_skips.begin(), _skips.end(), _seq) != _skips.end()) _seq++;
+        frame->mem().resize(frame_words32);
+        frame->mem().resize(pack_synthetic_packet(
+            &frame->mem().front(), 0, _seq, _seq*spp*ticks_per_samp, spp, ticks_per_sec, ticks_per_samp
+        ));
+        _seq++;
+        return make_managed_buffer<managed_recv_buffer>(frame);
+    }
+    size_t get_num_recv_frames(void) const{return num_frames;}
+    size_t get_recv_frame_size(void) const{return frame_words32*sizeof(boost::uint32_t);}
+
+    managed_send_buffer::sptr get_send_buff(double){return managed_send_buffer::sptr();}
+    size_t get_num_send_frames(void) const{return 0;}
+    size_t get_send_frame_size(void) const{return 0;}
+
+private:
+    static const size_t frame_words32 = vrt::max_if_hdr_words32 + spp + 1;
+
+    bool &_destroyed;
+    const std::vector<size_t> _skips;
+    size_t _seq;
+    pool_recv_buffer::pool_type _pool;
+    std::vector<boost::shared_ptr<pool_recv_buffer> > _frames;
+};
+
+static bool get_recv_buffs(zero_copy_if::sptr xport, vrt_packet_handler::managed_recv_buffs_t &buffs){
+    buffs[0] = xport->get_recv_buff(0.1);
+    return buffs[0].get() != NULL;
+}
+
+static size_t recv_frames(
+    vrt_packet_handler::recv_state &state, zero_copy_if::sptr xport,
+    std::vector<rx_frame> &frames, rx_metadata_t &md
+){
+    return vrt_packet_handler::recv_frames(
+        state, frames, md, tick_rate, &vrt::if_hdr_unpack_be,
+        boost::bind(&get_recv_buffs, xport, _1)
+    );
+}
+
+//the index of a synthetic sample (see synthetic_item)
+static boost::uint32_t get_samp(const rx_frame &frame, size_t i){
+    return uhd::ntohx(reinterpret_cast<const boost::uint32_t *>(frame.samps)[i]) >> 16;
+}
+
+BOOST_AUTO_TEST_CASE(test_recv_frames_passthrough){
+    bool destroyed = false;
+    boost::shared_ptr<packet_xport> xport(new packet_xport(destroyed));
+    vrt_packet_handler::recv_state state;
+    std::vector<rx_frame> frames;
+    rx_metadata_t md;
+
+    //the frames point into the transport memory, and are held until released
+    std::vector<rx_frame> held;
+    for (size_t seq = 0; seq < 3; seq++){
+        BOOST_CHECK_EQUAL(recv_frames(state, xport, frames, md), spp);
+        BOOST_CHECK_EQUAL(md.error_code, rx_metadata_t::ERROR_CODE_NONE);
+        BOOST_REQUIRE_EQUAL(frames.size(), size_t(1));
+        BOOST_CHECK_EQUAL(frames[0].nsamps, spp);
+        BOOST_CHECK(frames[0].samps > frames[0].buff->cast<const void *>());
+        BOOST_CHECK_EQUAL(get_samp(frames[0], 0), seq*spp);
+        BOOST_CHECK_EQUAL(get_samp(frames[0], spp-1), seq*spp + spp-1);
+        BOOST_CHECK(md.has_time_spec);
+        BOOST_CHECK_EQUAL(md.time_spec.get_tick_count(tick_rate), long(seq*spp*ticks_per_samp));
+        held.push_back(frames[0]);
+    }
+    frames.clear();
+    BOOST_CHECK_EQUAL(xport->get_num_free(), num_frames - 3);
+    held.clear();
+    BOOST_CHECK_EQUAL(xport->get_num_free(), num_frames);
+
+    //the rest of a packet partly copied out by recv comes first
+    std::vector<std::complex<boost::int16_t> > samps(30);
+    otw_type_t otw_type;
+    otw_type.width = 16;
+    otw_type.shift = 0;
+    otw_type.byteorder = otw_type_t::BO_BIG_ENDIAN;
+    BOOST_CHECK_EQUAL(vrt_packet_handler::recv(
+        state, device::recv_buffs_type(&samps.front()), samps.size(), md,
+        device::RECV_MODE_ONE_PACKET, io_type_t::COMPLEX_INT16, otw_type, tick_rate,
+        &vrt::if_hdr_unpack_be, boost::bind(&get_recv_buffs, zero_copy_if::sptr(xport), _1)
+    ), samps.size());
+    BOOST_CHECK_EQUAL(recv_frames(state, xport, frames, md), spp - samps.size());
+    BOOST_CHECK_EQUAL(md.fragment_offset, samps.size());
+    BOOST_CHECK(not md.has_time_spec);
+    BOOST_CHECK_EQUAL(get_samp(frames[0], 0), 3*spp + samps.size());
+    frames.clear();
+    BOOST_CHECK_EQUAL(xport->get_num_free(), num_frames);
+}
+
+BOOST_AUTO_TEST_CASE(test_recv_frames_gap){
+    bool destroyed = false;
+    boost::shared_ptr<packet_xport> xport(new packet_xport(destroyed, std::vector<size_t>(2, 2)));
+    vrt_packet_handler::recv_state state(1, true); //zero fill is not done into frames
+    std::vector<rx_frame> frames;
+    rx_metadata_t md;
+
+    BOOST_CHECK_EQUAL(recv_frames(state, xport, frames, md), spp);
+    BOOST_CHECK_EQUAL(recv_frames(state, xport, frames, md), spp);
+
+    //the gap is reported without frames, the packet after it comes next
+    BOOST_CHECK_EQUAL(recv_frames(state, xport, frames, md), size_t(0));
+    BOOST_CHECK_EQUAL(md.error_code, rx_metadata_t::ERROR_CODE_SEQUENCE_ERROR);
+    BOOST_CHECK_EQUAL(md.num_lost_samps, spp);
+    BOOST_CHECK(frames[0].buff.get() == NULL);
+    BOOST_CHECK_EQUAL(recv_frames(state, xport, frames, md), spp);
+    BOOST_CHECK_EQUAL(md.error_code, rx_metadata_t::ERROR_CODE_NONE);
+    BOOST_CHECK_EQUAL(get_samp(frames[0], 0), 3*spp);
+}
+
+BOOST_AUTO_TEST_CASE(test_recv_frames_leases){
+    bool destroyed = false;
+    boost::shared_ptr<packet_xport> xport(new packet_xport(destroyed));
+    vrt_packet_handler::frame_leases::sptr leases = vrt_packet_handler::frame_leases::make(num_frames/2);
+    std::vector<rx_frame> frames;
+    rx_metadata_t md;
+
+    //the leases are bounded: a full lease waits for a release
+    std::vector<managed_recv_buffer::sptr> held;
+    {
+        vrt_packet_handler::recv_state state;
+        for (size_t i = 0; i < num_frames/2; i++){
+            BOOST_REQUIRE(leases->wait_for_room(1, 0.0));
+            BOOST_REQUIRE_EQUAL(recv_frames(state, xport, frames, md), spp);
+            held.push_back(leases->lease(frames[0].buff, xport));
+            BOOST_CHECK(frames[0].buff.get() == NULL);
+        }
+        BOOST_CHECK(not leases->wait_for_room(1, 0.01));
+        held.front().reset();
+        BOOST_CHECK(leases->wait_for_room(1, 0.0));
+        BOOST_CHECK_EQUAL(leases->get_num_leased(), num_frames/2 - 1);
+    }
+
+    //the leased frames keep the transport alive past the stream
+    xport.reset();
+    leases.reset();
+    BOOST_CHECK(not destroyed);
+    BOOST_CHECK_GT(held.back()->size(), spp*sizeof(boost::uint32_t));
+    held.clear();
+    BOOST_CHECK(destroyed);
+}
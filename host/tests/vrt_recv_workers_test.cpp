@@ -0,0 +1,214 @@
+//
+// Copyright 2010-2011 Ettus Research LLC
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/test/unit_test.hpp>
+#include "vrt_recv_aligner.hpp"
+#include "vrt_recv_workers.hpp"
+#include "recv_buffer_fixtures.hpp"
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+using namespace uhd::transport;
+
+typedef vrt_packet_handler::recv_aligner<vrt_packet_handler::vrt_codec_be> recv_aligner_be;
+
+static const boost::uint64_t ticks_per_sec = 100000000;
+static const boost::uint64_t ticks_per_samp = 4;
+static const size_t spp = 360;
+static const size_t num_frames = 64;
+
+/***********************************************************************
+ * Synthetic multi-channel source:
+ * Each channel has a pool of frames like a transport, a frame goes back
+ * into the pool when its buffer is released. The frames carry synthetic
+ * packets. A channel is only read by one thread at a time.
+ **********************************************************************/
+class synthetic_source{
+public:
+    synthetic_source(size_t width, size_t skew_samps_per_chan):
+        _next_ticks(width)
+    {
+        for (size_t chan = 0; chan < width; chan++){
+            _next_ticks[chan] = chan*skew_samps_per_chan*ticks_per_samp;
+            _pools.push_back(boost::shared_ptr<pool_recv_buffer::pool_type>(new pool_recv_buffer::pool_type(num_frames)));
+            for (size_t i = 0; i < num_frames; i++){
+                _frames.push_back(boost::shared_ptr<pool_recv_buffer>(
+                    new pool_recv_buffer(*_pools.back(), vrt::max_if_hdr_words32 + spp + 1)
+                ));
+                _pools.back()->push_with_haste(_frames.back().get());
+            }
+        }
+    }
+
+    managed_recv_buffer::sptr operator()(size_t chan, double timeout){
+        pool_recv_buffer *frame;
+        if (not _pools[chan]->pop_with_timed_wait(frame, timeout)) return managed_recv_buffer::sptr();
+
+        const boost::uint64_t ticks = _next_ticks[chan];
+        _next_ticks[chan] += spp*ticks_per_samp;
+        pack_synthetic_packet(
+            &frame->mem().front(), chan, size_t(ticks/ticks_per_samp/spp),
+            ticks, spp, ticks_per_sec, ticks_per_samp
+        );
+        return make_managed_buffer<managed_recv_buffer>(frame);
+    }
+
+private:
+    std::vector<boost::uint64_t> _next_ticks;
+    std::vector<boost::shared_ptr<pool_recv_buffer::pool_type> > _pools;
+    std::vector<boost::shared_ptr<pool_recv_buffer> > _frames;
+};
+
+/***********************************************************************
+ * The packet handler over the aligner over the workers
+ **********************************************************************/
+class workers_transport{
+public:
+    workers_transport(size_t width, size_t num_workers, size_t skew_samps_per_chan):
+        _source(width, skew_samps_per_chan),
+        _aligner(width, ticks_per_sec),
+        _workers(width, num_workers, boost::bind(&synthetic_source::operator(), &_source, _1, _2), num_frames/4, num_frames/4),
+        _state(width), _num_buffs_to_throw(0)
+    {
+        /* NOP */
+    }
+
+    //! Throw from the given number of get buffs calls from now (zero never throws)
+    void throw_after(size_t num_buffs){
+        _num_buffs_to_throw = num_buffs;
+    }
+
+    bool get_recv_buffs(vrt_packet_handler::managed_recv_buffs_t &buffs){
+        if (_num_buffs_to_throw != 0 and --_num_buffs_to_throw == 0) throw uhd::io_error("test transport error");
+        return _aligner.get_recv_buffs(buffs, _workers, 1.0);
+    }
+
+    template <typename cpu_type> size_t recv(
+        const std::vector<void *> &buffs, size_t num_samps, uhd::rx_metadata_t &md
+    ){
+        typedef vrt_packet_handler::vrt_codec_be codec;
+        return _workers.recv(
+            _state, uhd::device::recv_buffs_type(buffs), num_samps, md,
+            uhd::device::RECV_MODE_FULL_BUFF, sizeof(cpu_type),
+            typename vrt_packet_handler::static_converter<codec, cpu_type>::type(),
+            double(ticks_per_sec), vrt_packet_handler::vrt_codec_fcns<codec>(),
+            vrt_packet_handler::transport_buffs<workers_transport>(*this)
+        );
+    }
+
+    size_t get_num_dropped_samps(void) const{
+        return _aligner.get_num_dropped_samps();
+    }
+
+private:
+    synthetic_source _source;
+    recv_aligner_be _aligner;
+    vrt_packet_handler::recv_workers _workers;
+    vrt_packet_handler::recv_state _state;
+    size_t _num_buffs_to_throw;
+};
+
+BOOST_AUTO_TEST_CASE(test_workers_samples){
+    typedef std::complex<boost::int16_t> sc16_t;
+    static const size_t width = 8, skew = 3, nsamps_per_recv = 10000; //more than the held packets
+    workers_transport transport(width, 3, skew);
+
+    std::vector<std::vector<sc16_t> > samps(width, std::vector<sc16_t>(nsamps_per_recv));
+    std::vector<void *> samp_ptrs;
+    for (size_t chan = 0; chan < width; chan++) samp_ptrs.push_back(&samps[chan].front());
+
+    //the channels are aligned to the most delayed one
+    size_t index = (width - 1)*skew;
+    for (size_t n = 0; n < 20; n++){
+        uhd::rx_metadata_t md;
+        const size_t num_samps = transport.recv<sc16_t>(samp_ptrs, nsamps_per_recv, md);
+        BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+        BOOST_CHECK_EQUAL(num_samps, nsamps_per_recv);
+        //a recv that starts with the fragment of a packet has no time spec
+        if (n == 0) BOOST_CHECK(md.has_time_spec);
+        if (md.has_time_spec) BOOST_CHECK_EQUAL(
+            vrt_packet_handler::time_spec_to_ticks(md.time_spec, double(ticks_per_sec)), index*ticks_per_samp
+        );
+        for (size_t chan = 0; chan < width; chan++){
+            for (size_t i = 0; i < num_samps; i++){
+                if (samps[chan][i] == sc16_t(boost::int16_t(index + i), boost::int16_t(chan))) continue;
+                BOOST_ERROR("wrong sample on channel " << chan << " at index " << index + i);
+                break;
+            }
+        }
+        index += num_samps;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_workers_same_output){
+    typedef std::complex<float> fc32_t;
+    static const size_t width = 8, nsamps_per_recv = 10000, num_recvs = 20;
+
+    //every number of workers converts the same samples as a single worker
+    std::vector<boost::shared_ptr<workers_transport> > transports;
+    for (size_t num_workers = 1; num_workers <= 4; num_workers *= 2){
+        transports.push_back(boost::shared_ptr<workers_transport>(new workers_transport(width, num_workers, 0)));
+    }
+
+    std::vector<std::vector<std::vector<fc32_t> > > samps(transports.size(),
+        std::vector<std::vector<fc32_t> >(width, std::vector<fc32_t>(nsamps_per_recv))
+    );
+    for (size_t n = 0; n < num_recvs; n++){
+        for (size_t t = 0; t < transports.size(); t++){
+            std::vector<void *> samp_ptrs;
+            for (size_t chan = 0; chan < width; chan++) samp_ptrs.push_back(&samps[t][chan].front());
+            uhd::rx_metadata_t md;
+            BOOST_REQUIRE_EQUAL(transports[t]->recv<fc32_t>(samp_ptrs, nsamps_per_recv, md), nsamps_per_recv);
+            BOOST_REQUIRE_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+            BOOST_CHECK_EQUAL(transports[t]->get_num_dropped_samps(), size_t(0));
+            if (t == 0) continue;
+            for (size_t chan = 0; chan < width; chan++){
+                BOOST_CHECK(samps[t][chan] == samps[0][chan]);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_workers_throw){
+    typedef std::complex<boost::int16_t> sc16_t;
+    static const size_t width = 4, nsamps_per_recv = 10*spp;
+    workers_transport transport(width, 2, 0);
+
+    std::vector<std::vector<sc16_t> > samps0(width, std::vector<sc16_t>(nsamps_per_recv));
+    std::vector<std::vector<sc16_t> > samps1(width, std::vector<sc16_t>(nsamps_per_recv));
+    std::vector<void *> samp_ptrs0, samp_ptrs1;
+    for (size_t chan = 0; chan < width; chan++){
+        samp_ptrs0.push_back(&samps0[chan].front());
+        samp_ptrs1.push_back(&samps1[chan].front());
+    }
+
+    //the transport throws with conversions recorded for the first buffers
+    uhd::rx_metadata_t md;
+    transport.throw_after(3);
+    BOOST_CHECK_THROW(transport.recv<sc16_t>(samp_ptrs0, nsamps_per_recv, md), uhd::io_error);
+
+    //the next call must not run the conversions of the failed call
+    for (size_t chan = 0; chan < width; chan++) std::fill(samps0[chan].begin(), samps0[chan].end(), sc16_t(0, 0));
+    BOOST_CHECK_EQUAL(transport.recv<sc16_t>(samp_ptrs1, nsamps_per_recv, md), nsamps_per_recv);
+    BOOST_CHECK_EQUAL(md.error_code, uhd::rx_metadata_t::ERROR_CODE_NONE);
+    for (size_t chan = 0; chan < width; chan++){
+        BOOST_CHECK(std::count(samps0[chan].begin(), samps0[chan].end(), sc16_t(0, 0)) == std::ptrdiff_t(nsamps_per_recv));
+    }
+}